@@ -0,0 +1,252 @@
+/*
+* Vulkan auto exposure class
+*
+* Luminance histogram based exposure adaptation running entirely on the GPU
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cassert>
+#include <cstring>
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Histogram auto exposure
+	*
+	* A first compute pass sorts the log2 luminance of every input pixel into a 256 bin histogram, using shared memory
+	* atomics per workgroup. A second single workgroup pass reduces the histogram to the average luminance, adapts the
+	* previous value towards it and stores the resulting exposure in a small storage buffer. The buffer never leaves the GPU,
+	* tone mapping passes read it directly.
+	*
+	* Usage:
+	*  - fill shaders with the histogram and average compute shader stages (base/autoexposurehistogram.comp, base/autoexposureaverage.comp)
+	*  - prepare with the input size and setInput with the image view to be measured
+	*  - call update once per frame with the frame time
+	*  - cmdDispatch outside of a render pass after the input has been rendered, the input has to be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	*  - read the exposure from a storage buffer bound with descriptor (struct { float averageLuminance; float exposure; })
+	*/
+	class AutoExposure
+	{
+	private:
+		static const uint32_t binCount = 256;
+
+		struct Params {
+			float minLogLuminance;
+			float logLuminanceRange;
+			float deltaTime;
+			float adaptationRate;
+			float keyValue;
+			uint32_t pixelCount;
+			uint32_t inputSize[2];
+		};
+
+		struct State {
+			float averageLuminance;
+			float exposure;
+		};
+
+		vks::VulkanDevice *device = nullptr;
+		uint32_t inputWidth = 0;
+		uint32_t inputHeight = 0;
+
+		VkSampler sampler = VK_NULL_HANDLE;
+		vks::Buffer histogram;
+		vks::Buffer state;
+		vks::Buffer params;
+
+		struct {
+			VkPipeline histogram = VK_NULL_HANDLE;
+			VkPipeline average = VK_NULL_HANDLE;
+		} pipelines;
+
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+	public:
+		/** @brief Histogram and average compute shader stages, the shader modules are owned by the caller */
+		std::vector<VkPipelineShaderStageCreateInfo> shaders;
+		/** @brief Lower end of the log2 luminance range covered by the histogram */
+		float minLogLuminance = -10.0f;
+		/** @brief Upper end of the log2 luminance range covered by the histogram */
+		float maxLogLuminance = 4.0f;
+		/** @brief Speed of the adaptation, higher values adapt faster */
+		float adaptationRate = 1.5f;
+		/** @brief Exposed value of the average luminance, exposure = keyValue / average luminance */
+		float keyValue = 0.5f;
+		/** @brief Descriptor for reading the adapted luminance and exposure from a storage buffer */
+		VkDescriptorBufferInfo descriptor;
+
+		/**
+		* Create the buffers and the compute pipelines
+		*
+		* @param device Device to create the resources on
+		* @param queue Queue used to initialize the buffers
+		* @param pipelineCache Pipeline cache used for creating the pipelines
+		* @param width Width of the input image
+		* @param height Height of the input image
+		*/
+		void prepare(vks::VulkanDevice *device, VkQueue queue, VkPipelineCache pipelineCache, uint32_t width, uint32_t height)
+		{
+			assert(shaders.size() == 2);
+			this->device = device;
+			inputWidth = width;
+			inputHeight = height;
+
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &histogram, binCount * sizeof(uint32_t)));
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &state, sizeof(State)));
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &params, sizeof(Params)));
+			VK_CHECK_RESULT(params.map());
+			update(0.0f);
+			descriptor = state.descriptor;
+
+			// The histogram starts out empty (it's cleared by the average pass afterwards), the adaptation starts at a luminance of one
+			State initialState = { 1.0f, keyValue };
+			VkCommandBuffer commandBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			vkCmdFillBuffer(commandBuffer, histogram.buffer, 0, VK_WHOLE_SIZE, 0);
+			vkCmdUpdateBuffer(commandBuffer, state.buffer, 0, sizeof(State), &initialState);
+			device->flushCommandBuffer(commandBuffer, queue, true);
+
+			// The input is read with texel fetches, the sampler is only required for the combined image sampler descriptor
+			VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+			samplerCI.magFilter = VK_FILTER_NEAREST;
+			samplerCI.minFilter = VK_FILTER_NEAREST;
+			samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+			samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCI.maxAnisotropy = 1.0f;
+			samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+			VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCI, nullptr, &sampler));
+
+			// Descriptors
+			std::vector<VkDescriptorPoolSize> poolSizes = {
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1),
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2),
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+			};
+			VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 1);
+			VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+			std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+				vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			};
+			VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayout));
+
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, &descriptorSet));
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &histogram.descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &state.descriptor),
+				vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &params.descriptor),
+			};
+			vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+			// Pipelines
+			VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+			VkComputePipelineCreateInfo pipelineCI = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+			pipelineCI.stage = shaders[0];
+			VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.histogram));
+			pipelineCI.stage = shaders[1];
+			VK_CHECK_RESULT(vkCreateComputePipelines(device->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.average));
+		}
+
+		/**
+		* Set the image to be measured, must match the size passed to prepare
+		*
+		* @param view Image view of the input, read in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+		*/
+		void setInput(VkImageView view)
+		{
+			VkDescriptorImageInfo imageDescriptor = vks::initializers::descriptorImageInfo(sampler, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptor);
+			vkUpdateDescriptorSets(device->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+		}
+
+		/**
+		* Update the adaptation parameters, needs to be called every frame as the adaptation depends on the frame time
+		*
+		* @param deltaTime Time since the last frame in seconds
+		*/
+		void update(float deltaTime)
+		{
+			Params values;
+			values.minLogLuminance = minLogLuminance;
+			values.logLuminanceRange = maxLogLuminance - minLogLuminance;
+			values.deltaTime = deltaTime;
+			values.adaptationRate = adaptationRate;
+			values.keyValue = keyValue;
+			values.pixelCount = inputWidth * inputHeight;
+			values.inputSize[0] = inputWidth;
+			values.inputSize[1] = inputHeight;
+			memcpy(params.mapped, &values, sizeof(Params));
+		}
+
+		/**
+		* Record the histogram and average passes, must be called outside of a render pass
+		*
+		* Waits for color attachment writes to the input, makes the exposure visible to fragment shaders afterwards
+		*/
+		void cmdDispatch(VkCommandBuffer commandBuffer)
+		{
+			// The input has just been rendered, and the exposure may still be read by the previous frame's fragment shaders
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.histogram);
+			vkCmdDispatch(commandBuffer, (inputWidth + 15) / 16, (inputHeight + 15) / 16, 1);
+
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.average);
+			vkCmdDispatch(commandBuffer, 1, 1, 1);
+
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
+
+		void destroy()
+		{
+			if (!device) {
+				return;
+			}
+			VkDevice logicalDevice = device->logicalDevice;
+			vkDestroyPipeline(logicalDevice, pipelines.histogram, nullptr);
+			vkDestroyPipeline(logicalDevice, pipelines.average, nullptr);
+			vkDestroyPipelineLayout(logicalDevice, pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(logicalDevice, descriptorSetLayout, nullptr);
+			vkDestroyDescriptorPool(logicalDevice, descriptorPool, nullptr);
+			vkDestroySampler(logicalDevice, sampler, nullptr);
+			histogram.destroy();
+			state.destroy();
+			params.destroy();
+			device = nullptr;
+		}
+	};
+}
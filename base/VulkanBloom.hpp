@@ -0,0 +1,382 @@
+/*
+* Vulkan bloom post-processing class
+*
+* Progressive downsample/upsample bloom using a mip chain
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <cassert>
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Mip chain bloom
+	*
+	* The input image is filtered into a chain of successively halved mip levels with a 13-tap downsample filter, then
+	* the chain is walked back up with a 3x3 tent filter that is added on top of each level. The result ends up in the
+	* first level (half the input resolution) and contains the sum of all levels, so it should be scaled when it's composited.
+	*
+	* Usage:
+	*  - fill shaders with the vertex, downsample and upsample shader stages (base/bloom.vert, base/bloomdownsample.frag, base/bloomupsample.frag)
+	*  - prepare with the input size and setInput with the image view to be filtered
+	*  - cmdDraw outside of a render pass, the input has to be in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	*  - sample the result using descriptor
+	*/
+	class Bloom
+	{
+	private:
+		struct PushConsts {
+			float sourceTexelSize[2];
+			float filterRadius;
+			int32_t karisAverage;
+		};
+
+		struct Level {
+			uint32_t width;
+			uint32_t height;
+			VkImageView view;
+			VkFramebuffer frameBuffer;
+		};
+
+		vks::VulkanDevice *device = nullptr;
+		uint32_t inputWidth = 0;
+		uint32_t inputHeight = 0;
+
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkSampler sampler = VK_NULL_HANDLE;
+		std::vector<Level> levels;
+
+		struct {
+			VkRenderPass downsample = VK_NULL_HANDLE;
+			VkRenderPass upsample = VK_NULL_HANDLE;
+		} renderPasses;
+
+		struct {
+			VkPipeline downsample = VK_NULL_HANDLE;
+			VkPipeline upsample = VK_NULL_HANDLE;
+		} pipelines;
+
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		// Sets for sampling the input (first entry) and each of the levels
+		std::vector<VkDescriptorSet> descriptorSets;
+
+		VkRenderPass createRenderPass(VkAttachmentLoadOp loadOp)
+		{
+			VkAttachmentDescription attachmentDescription = {};
+			attachmentDescription.format = format;
+			attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
+			attachmentDescription.loadOp = loadOp;
+			attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			// The upsample passes blend on top of the downsampled contents
+			attachmentDescription.initialLayout = (loadOp == VK_ATTACHMENT_LOAD_OP_LOAD) ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+			attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+			VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+			VkSubpassDescription subpassDescription = {};
+			subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			subpassDescription.colorAttachmentCount = 1;
+			subpassDescription.pColorAttachments = &colorReference;
+
+			std::array<VkSubpassDependency, 2> dependencies;
+
+			dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+			dependencies[0].dstSubpass = 0;
+			dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			dependencies[0].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			dependencies[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+			dependencies[1].srcSubpass = 0;
+			dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+			VkRenderPassCreateInfo renderPassInfo = vks::initializers::renderPassCreateInfo();
+			renderPassInfo.attachmentCount = 1;
+			renderPassInfo.pAttachments = &attachmentDescription;
+			renderPassInfo.subpassCount = 1;
+			renderPassInfo.pSubpasses = &subpassDescription;
+			renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+			renderPassInfo.pDependencies = dependencies.data();
+
+			VkRenderPass renderPass;
+			VK_CHECK_RESULT(vkCreateRenderPass(device->logicalDevice, &renderPassInfo, nullptr, &renderPass));
+			return renderPass;
+		}
+
+		void drawLevel(VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkPipeline pipeline, const Level &target, uint32_t sourceIndex, uint32_t sourceWidth, uint32_t sourceHeight, bool karisAverage)
+		{
+			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+			renderPassBeginInfo.renderPass = renderPass;
+			renderPassBeginInfo.framebuffer = target.frameBuffer;
+			renderPassBeginInfo.renderArea.extent.width = target.width;
+			renderPassBeginInfo.renderArea.extent.height = target.height;
+			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+			VkViewport viewport = vks::initializers::viewport((float)target.width, (float)target.height, 0.0f, 1.0f);
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+			VkRect2D scissor = vks::initializers::rect2D(target.width, target.height, 0, 0);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+			PushConsts pushConsts;
+			pushConsts.sourceTexelSize[0] = 1.0f / (float)sourceWidth;
+			pushConsts.sourceTexelSize[1] = 1.0f / (float)sourceHeight;
+			pushConsts.filterRadius = filterRadius;
+			pushConsts.karisAverage = karisAverage ? 1 : 0;
+			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConsts), &pushConsts);
+
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[sourceIndex], 0, nullptr);
+			vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+
+			vkCmdEndRenderPass(commandBuffer);
+		}
+
+	public:
+		/** @brief Vertex, downsample and upsample shader stages, the shader modules are owned by the caller */
+		std::vector<VkPipelineShaderStageCreateInfo> shaders;
+		/** @brief Format of the mip chain, needs to support color attachment blending */
+		VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT;
+		/** @brief Radius of the upsample tent filter in texels, changes require the command buffers to be rebuilt */
+		float filterRadius = 1.0f;
+		/** @brief Suppress fireflies in the first downsample with a luminance weighted (Karis) average */
+		bool karisAverage = true;
+		/** @brief Descriptor for sampling the bloom result (the first level of the chain) */
+		VkDescriptorImageInfo descriptor;
+
+		/** @brief Number of levels in the chain */
+		uint32_t mipCount() const
+		{
+			return static_cast<uint32_t>(levels.size());
+		}
+
+		/**
+		* Create the mip chain and the pipelines
+		*
+		* @param device Device to create the resources on
+		* @param pipelineCache Pipeline cache used for creating the pipelines
+		* @param width Width of the input image
+		* @param height Height of the input image
+		* @param maxMipCount Maximum number of levels, the chain stops early once a level would get smaller than 2x2
+		*/
+		void prepare(vks::VulkanDevice *device, VkPipelineCache pipelineCache, uint32_t width, uint32_t height, uint32_t maxMipCount = 6)
+		{
+			assert(shaders.size() == 3);
+			this->device = device;
+			inputWidth = width;
+			inputHeight = height;
+
+			levels.clear();
+			uint32_t levelWidth = width;
+			uint32_t levelHeight = height;
+			while ((levels.size() < maxMipCount) && (levelWidth >= 4) && (levelHeight >= 4)) {
+				levelWidth /= 2;
+				levelHeight /= 2;
+				Level level{};
+				level.width = levelWidth;
+				level.height = levelHeight;
+				levels.push_back(level);
+			}
+			assert(!levels.empty());
+
+			// Image with one mip per level of the chain
+			VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+			imageCI.imageType = VK_IMAGE_TYPE_2D;
+			imageCI.format = format;
+			imageCI.extent = { levels[0].width, levels[0].height, 1 };
+			imageCI.mipLevels = mipCount();
+			imageCI.arrayLayers = 1;
+			imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+			VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCI, nullptr, &image));
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
+			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+			memAlloc.allocationSize = memReqs.size;
+			memAlloc.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAlloc, nullptr, &memory));
+			VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, memory, 0));
+
+			// Each level is sampled and rendered to through its own single mip view
+			VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+			samplerCI.magFilter = VK_FILTER_LINEAR;
+			samplerCI.minFilter = VK_FILTER_LINEAR;
+			samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+			samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCI.maxAnisotropy = 1.0f;
+			samplerCI.minLod = 0.0f;
+			samplerCI.maxLod = 0.0f;
+			samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+			VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCI, nullptr, &sampler));
+
+			renderPasses.downsample = createRenderPass(VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+			renderPasses.upsample = createRenderPass(VK_ATTACHMENT_LOAD_OP_LOAD);
+
+			for (uint32_t i = 0; i < mipCount(); i++) {
+				VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+				viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+				viewCI.format = format;
+				viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 };
+				viewCI.image = image;
+				VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &levels[i].view));
+
+				// Both render passes are compatible, so one framebuffer per level is sufficient
+				VkFramebufferCreateInfo framebufferCI = vks::initializers::framebufferCreateInfo();
+				framebufferCI.renderPass = renderPasses.downsample;
+				framebufferCI.attachmentCount = 1;
+				framebufferCI.pAttachments = &levels[i].view;
+				framebufferCI.width = levels[i].width;
+				framebufferCI.height = levels[i].height;
+				framebufferCI.layers = 1;
+				VK_CHECK_RESULT(vkCreateFramebuffer(device->logicalDevice, &framebufferCI, nullptr, &levels[i].frameBuffer));
+			}
+
+			descriptor = vks::initializers::descriptorImageInfo(sampler, levels[0].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+			// Descriptors
+			std::vector<VkDescriptorPoolSize> poolSizes = {
+				vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, mipCount() + 1)
+			};
+			VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, mipCount() + 1);
+			VK_CHECK_RESULT(vkCreateDescriptorPool(device->logicalDevice, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+			VkDescriptorSetLayoutBinding setLayoutBinding = vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0);
+			VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(&setLayoutBinding, 1);
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->logicalDevice, &descriptorLayoutCI, nullptr, &descriptorSetLayout));
+
+			descriptorSets.resize(mipCount() + 1);
+			std::vector<VkDescriptorSetLayout> setLayouts(descriptorSets.size(), descriptorSetLayout);
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, setLayouts.data(), static_cast<uint32_t>(setLayouts.size()));
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device->logicalDevice, &allocInfo, descriptorSets.data()));
+			for (uint32_t i = 0; i < mipCount(); i++) {
+				VkDescriptorImageInfo imageDescriptor = vks::initializers::descriptorImageInfo(sampler, levels[i].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSets[i + 1], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptor);
+				vkUpdateDescriptorSets(device->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+			}
+
+			// Pipelines
+			VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(PushConsts), 0);
+			VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+			pipelineLayoutCI.pushConstantRangeCount = 1;
+			pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device->logicalDevice, &pipelineLayoutCI, nullptr, &pipelineLayout));
+
+			VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = vks::initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
+			VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE, 0);
+			VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+			VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+			VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_FALSE, VK_FALSE, VK_COMPARE_OP_ALWAYS);
+			VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
+			VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT, 0);
+			std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+			VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+			VkPipelineVertexInputStateCreateInfo emptyInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+			std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = { shaders[0], shaders[1] };
+
+			VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayout, renderPasses.downsample, 0);
+			pipelineCI.pVertexInputState = &emptyInputState;
+			pipelineCI.pInputAssemblyState = &inputAssemblyState;
+			pipelineCI.pRasterizationState = &rasterizationState;
+			pipelineCI.pColorBlendState = &colorBlendState;
+			pipelineCI.pMultisampleState = &multisampleState;
+			pipelineCI.pViewportState = &viewportState;
+			pipelineCI.pDepthStencilState = &depthStencilState;
+			pipelineCI.pDynamicState = &dynamicState;
+			pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+			pipelineCI.pStages = shaderStages.data();
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.downsample));
+
+			// Upsampled results are added on top of the level's downsampled contents
+			blendAttachmentState.blendEnable = VK_TRUE;
+			blendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
+			blendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+			blendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+			blendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
+			blendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+			blendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+			shaderStages[1] = shaders[2];
+			pipelineCI.renderPass = renderPasses.upsample;
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.upsample));
+		}
+
+		/**
+		* Set the image to be filtered, must match the size passed to prepare
+		*
+		* @param view Image view of the input, sampled in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+		*/
+		void setInput(VkImageView view)
+		{
+			VkDescriptorImageInfo imageDescriptor = vks::initializers::descriptorImageInfo(sampler, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSets[0], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptor);
+			vkUpdateDescriptorSets(device->logicalDevice, 1, &writeDescriptorSet, 0, nullptr);
+		}
+
+		/**
+		* Record the downsample and upsample passes, must be called outside of a render pass
+		*
+		* After this the result can be sampled in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL using descriptor
+		*/
+		void cmdDraw(VkCommandBuffer commandBuffer)
+		{
+			// Downsample from the input down to the smallest level
+			for (uint32_t i = 0; i < mipCount(); i++) {
+				uint32_t sourceWidth = (i == 0) ? inputWidth : levels[i - 1].width;
+				uint32_t sourceHeight = (i == 0) ? inputHeight : levels[i - 1].height;
+				drawLevel(commandBuffer, renderPasses.downsample, pipelines.downsample, levels[i], i, sourceWidth, sourceHeight, karisAverage && (i == 0));
+			}
+			// Upsample back to the first level, accumulating each level on the way
+			for (uint32_t i = mipCount() - 1; i > 0; i--) {
+				drawLevel(commandBuffer, renderPasses.upsample, pipelines.upsample, levels[i - 1], i + 1, levels[i].width, levels[i].height, false);
+			}
+		}
+
+		void destroy()
+		{
+			if (!device) {
+				return;
+			}
+			VkDevice logicalDevice = device->logicalDevice;
+			vkDestroyPipeline(logicalDevice, pipelines.downsample, nullptr);
+			vkDestroyPipeline(logicalDevice, pipelines.upsample, nullptr);
+			vkDestroyPipelineLayout(logicalDevice, pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(logicalDevice, descriptorSetLayout, nullptr);
+			vkDestroyDescriptorPool(logicalDevice, descriptorPool, nullptr);
+			for (auto &level : levels) {
+				vkDestroyFramebuffer(logicalDevice, level.frameBuffer, nullptr);
+				vkDestroyImageView(logicalDevice, level.view, nullptr);
+			}
+			levels.clear();
+			vkDestroyRenderPass(logicalDevice, renderPasses.downsample, nullptr);
+			vkDestroyRenderPass(logicalDevice, renderPasses.upsample, nullptr);
+			vkDestroySampler(logicalDevice, sampler, nullptr);
+			vkDestroyImage(logicalDevice, image, nullptr);
+			vkFreeMemory(logicalDevice, memory, nullptr);
+			device = nullptr;
+		}
+	};
+}
@@ -0,0 +1,352 @@
+/*
+* Vulkan compute batch runner
+*
+* Streams large datasets through a compute pipeline in chunks, overlapping upload, dispatch and readback of different chunks
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include "vulkan/vulkan.h"
+#include "VulkanInitializers.hpp"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Pipelined headless compute batch runner
+	*
+	* The input is split into chunks that cycle through a small number of slots (double or triple buffering). Each slot owns
+	* a host visible staging buffer and a device local buffer the compute work operates on in place. A chunk goes through
+	* three submissions that are chained with timeline semaphores (one per stage, the value being the chunk index + 1):
+	*  - upload on the transfer queue (staging -> device buffer)
+	*  - dispatch on the compute queue
+	*  - readback on the transfer queue (device buffer -> staging)
+	* The readback of a chunk is submitted after the upload of the next one, so the transfer queue never stalls an upload
+	* behind a readback that waits for compute. The host fills and drains staging memory of other slots in the meantime and
+	* only blocks when the slot it wants to reuse hasn't been read back yet.
+	*
+	* Transfer and compute queue may be the same queue (e.g. on software implementations with a single queue family), the
+	* pipelining then still overlaps host side work with device work.
+	*
+	* Requires a device created with the timelineSemaphore feature (Vulkan 1.2).
+	*
+	* Usage:
+	*  - create with the device, queues, chunk size and slot count
+	*  - set writeInput, recordDispatch and readOutput
+	*  - use getDeviceBuffer to create per slot descriptors for the compute work
+	*  - call run with the total size in bytes
+	*/
+	class ComputeBatchRunner
+	{
+	public:
+		struct Queue {
+			VkQueue queue;
+			uint32_t familyIndex;
+		};
+
+		struct Statistics {
+			VkDeviceSize bytes = 0;
+			uint32_t chunkCount = 0;
+			// Time spent by the host waiting for slots to become available
+			double waitSeconds = 0.0;
+			double seconds = 0.0;
+			double gigabytesPerSecond() const { return seconds > 0.0 ? (double)bytes / seconds / 1.0e9 : 0.0; }
+		};
+
+		// Fills mapped staging memory with size bytes of input starting at offset
+		std::function<void(VkDeviceSize offset, VkDeviceSize size, void* dst)> writeInput;
+		// Records the compute work for a chunk of size bytes stored in the device buffer of slot
+		std::function<void(VkCommandBuffer commandBuffer, uint32_t slot, VkDeviceSize size)> recordDispatch;
+		// Consumes size bytes of output starting at offset from mapped staging memory
+		std::function<void(VkDeviceSize offset, VkDeviceSize size, const void* src)> readOutput;
+
+	private:
+		struct Slot {
+			VkBuffer stagingBuffer = VK_NULL_HANDLE;
+			VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+			void* mapped = nullptr;
+			VkBuffer deviceBuffer = VK_NULL_HANDLE;
+			VkDeviceMemory deviceMemory = VK_NULL_HANDLE;
+			VkCommandBuffer uploadCmd = VK_NULL_HANDLE;
+			VkCommandBuffer computeCmd = VK_NULL_HANDLE;
+			VkCommandBuffer readbackCmd = VK_NULL_HANDLE;
+			// Chunk currently occupying the slot
+			uint64_t chunk = 0;
+			VkDeviceSize offset = 0;
+			VkDeviceSize size = 0;
+		};
+
+		VkPhysicalDevice physicalDevice;
+		VkDevice device;
+		Queue computeQueue;
+		Queue transferQueue;
+		VkDeviceSize chunkSize;
+		std::vector<Slot> slots;
+		VkCommandPool computePool = VK_NULL_HANDLE;
+		VkCommandPool transferPool = VK_NULL_HANDLE;
+
+		struct {
+			VkSemaphore upload = VK_NULL_HANDLE;
+			VkSemaphore compute = VK_NULL_HANDLE;
+			VkSemaphore readback = VK_NULL_HANDLE;
+		} timelines;
+
+		PFN_vkWaitSemaphores waitSemaphores = nullptr;
+		// Timeline values keep increasing across runs
+		uint64_t submittedChunks = 0;
+
+		uint32_t getMemoryType(uint32_t typeBits, VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags required)
+		{
+			VkPhysicalDeviceMemoryProperties memoryProperties;
+			vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+			for (VkMemoryPropertyFlags flags : { preferred, required }) {
+				for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+					if ((typeBits & (1 << i)) && ((memoryProperties.memoryTypes[i].propertyFlags & flags) == flags)) {
+						return i;
+					}
+				}
+			}
+			throw std::runtime_error("Could not find a matching memory type");
+		}
+
+		void createBuffer(VkBufferUsageFlags usage, VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags required, VkBuffer* buffer, VkDeviceMemory* memory)
+		{
+			VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usage, chunkSize);
+			// Buffers are accessed from both queue families, concurrent sharing saves explicit ownership transfers for every chunk
+			const uint32_t familyIndices[2] = { computeQueue.familyIndex, transferQueue.familyIndex };
+			if (computeQueue.familyIndex != transferQueue.familyIndex) {
+				bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+				bufferCreateInfo.queueFamilyIndexCount = 2;
+				bufferCreateInfo.pQueueFamilyIndices = familyIndices;
+			}
+			VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, buffer));
+			VkMemoryRequirements memReqs;
+			vkGetBufferMemoryRequirements(device, *buffer, &memReqs);
+			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+			memAlloc.allocationSize = memReqs.size;
+			memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, preferred, required);
+			VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, memory));
+			VK_CHECK_RESULT(vkBindBufferMemory(device, *buffer, *memory, 0));
+		}
+
+		VkSemaphore createTimelineSemaphore()
+		{
+			VkSemaphoreTypeCreateInfo semaphoreTypeInfo{};
+			semaphoreTypeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+			semaphoreTypeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+			semaphoreTypeInfo.initialValue = 0;
+			VkSemaphoreCreateInfo semaphoreInfo = vks::initializers::semaphoreCreateInfo();
+			semaphoreInfo.pNext = &semaphoreTypeInfo;
+			VkSemaphore semaphore;
+			VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore));
+			return semaphore;
+		}
+
+		void submit(const Queue& queue, VkCommandBuffer commandBuffer, VkSemaphore waitSemaphore, VkPipelineStageFlags waitStage, VkSemaphore signalSemaphore, uint64_t value)
+		{
+			VkTimelineSemaphoreSubmitInfo timelineInfo{};
+			timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+			timelineInfo.waitSemaphoreValueCount = waitSemaphore != VK_NULL_HANDLE ? 1 : 0;
+			timelineInfo.pWaitSemaphoreValues = &value;
+			timelineInfo.signalSemaphoreValueCount = 1;
+			timelineInfo.pSignalSemaphoreValues = &value;
+			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+			submitInfo.pNext = &timelineInfo;
+			submitInfo.waitSemaphoreCount = timelineInfo.waitSemaphoreValueCount;
+			submitInfo.pWaitSemaphores = &waitSemaphore;
+			submitInfo.pWaitDstStageMask = &waitStage;
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &commandBuffer;
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &signalSemaphore;
+			VK_CHECK_RESULT(vkQueueSubmit(queue.queue, 1, &submitInfo, VK_NULL_HANDLE));
+		}
+
+		void copyBuffer(VkCommandBuffer commandBuffer, VkBuffer src, VkBuffer dst, VkDeviceSize size)
+		{
+			VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+			cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+			VkBufferCopy copyRegion = { 0, 0, size };
+			vkCmdCopyBuffer(commandBuffer, src, dst, 1, &copyRegion);
+		}
+
+		// Waits (on the host) until the given timeline semaphore has reached value
+		void wait(VkSemaphore semaphore, uint64_t value)
+		{
+			VkSemaphoreWaitInfo waitInfo{};
+			waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+			waitInfo.semaphoreCount = 1;
+			waitInfo.pSemaphores = &semaphore;
+			waitInfo.pValues = &value;
+			VK_CHECK_RESULT(waitSemaphores(device, &waitInfo, UINT64_MAX));
+		}
+
+		void submitUpload(Slot& slot)
+		{
+			copyBuffer(slot.uploadCmd, slot.stagingBuffer, slot.deviceBuffer, slot.size);
+			VK_CHECK_RESULT(vkEndCommandBuffer(slot.uploadCmd));
+			// Host writes are made visible by the submission itself, no host barrier required
+			submit(transferQueue, slot.uploadCmd, VK_NULL_HANDLE, 0, timelines.upload, slot.chunk + 1);
+		}
+
+		void submitCompute(Slot& slot, uint32_t slotIndex)
+		{
+			VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+			cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			VK_CHECK_RESULT(vkBeginCommandBuffer(slot.computeCmd, &cmdBufInfo));
+			recordDispatch(slot.computeCmd, slotIndex, slot.size);
+			VK_CHECK_RESULT(vkEndCommandBuffer(slot.computeCmd));
+			submit(computeQueue, slot.computeCmd, timelines.upload, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, timelines.compute, slot.chunk + 1);
+		}
+
+		void submitReadback(Slot& slot)
+		{
+			copyBuffer(slot.readbackCmd, slot.deviceBuffer, slot.stagingBuffer, slot.size);
+			// Make the copied data available to the host
+			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+			bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.buffer = slot.stagingBuffer;
+			bufferBarrier.size = slot.size;
+			vkCmdPipelineBarrier(slot.readbackCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+			VK_CHECK_RESULT(vkEndCommandBuffer(slot.readbackCmd));
+			submit(transferQueue, slot.readbackCmd, timelines.compute, VK_PIPELINE_STAGE_TRANSFER_BIT, timelines.readback, slot.chunk + 1);
+		}
+
+		void finishReadback(Slot& slot, Statistics& statistics)
+		{
+			auto tStart = std::chrono::high_resolution_clock::now();
+			wait(timelines.readback, slot.chunk + 1);
+			statistics.waitSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - tStart).count();
+			if (readOutput) {
+				readOutput(slot.offset, slot.size, slot.mapped);
+			}
+			slot.size = 0;
+		}
+
+	public:
+		ComputeBatchRunner(VkPhysicalDevice physicalDevice, VkDevice device, Queue computeQueue, Queue transferQueue, VkDeviceSize chunkSize, uint32_t slotCount = 3)
+			: physicalDevice(physicalDevice), device(device), computeQueue(computeQueue), transferQueue(transferQueue), chunkSize(chunkSize)
+		{
+			assert(slotCount >= 2);
+
+			waitSemaphores = reinterpret_cast<PFN_vkWaitSemaphores>(vkGetDeviceProcAddr(device, "vkWaitSemaphores"));
+			assert(waitSemaphores);
+
+			VkCommandPoolCreateInfo cmdPoolInfo = vks::initializers::commandPoolCreateInfo();
+			cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+			cmdPoolInfo.queueFamilyIndex = computeQueue.familyIndex;
+			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &computePool));
+			cmdPoolInfo.queueFamilyIndex = transferQueue.familyIndex;
+			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &transferPool));
+
+			slots.resize(slotCount);
+			for (auto& slot : slots) {
+				// Staging memory is also read back by the host, so cached memory is preferred
+				createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+					&slot.stagingBuffer, &slot.stagingMemory);
+				VK_CHECK_RESULT(vkMapMemory(device, slot.stagingMemory, 0, VK_WHOLE_SIZE, 0, &slot.mapped));
+				createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+					0,
+					&slot.deviceBuffer, &slot.deviceMemory);
+
+				VkCommandBufferAllocateInfo allocInfo = vks::initializers::commandBufferAllocateInfo(computePool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+				VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &allocInfo, &slot.computeCmd));
+				allocInfo.commandPool = transferPool;
+				VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &allocInfo, &slot.uploadCmd));
+				VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &allocInfo, &slot.readbackCmd));
+			}
+
+			timelines.upload = createTimelineSemaphore();
+			timelines.compute = createTimelineSemaphore();
+			timelines.readback = createTimelineSemaphore();
+		}
+
+		~ComputeBatchRunner()
+		{
+			vkQueueWaitIdle(computeQueue.queue);
+			vkQueueWaitIdle(transferQueue.queue);
+			vkDestroySemaphore(device, timelines.upload, nullptr);
+			vkDestroySemaphore(device, timelines.compute, nullptr);
+			vkDestroySemaphore(device, timelines.readback, nullptr);
+			for (auto& slot : slots) {
+				vkDestroyBuffer(device, slot.stagingBuffer, nullptr);
+				vkFreeMemory(device, slot.stagingMemory, nullptr);
+				vkDestroyBuffer(device, slot.deviceBuffer, nullptr);
+				vkFreeMemory(device, slot.deviceMemory, nullptr);
+			}
+			vkDestroyCommandPool(device, computePool, nullptr);
+			vkDestroyCommandPool(device, transferPool, nullptr);
+		}
+
+		uint32_t getSlotCount() const { return static_cast<uint32_t>(slots.size()); }
+		VkDeviceSize getChunkSize() const { return chunkSize; }
+
+		// Device buffer the compute work of the given slot operates on (in place)
+		VkBuffer getDeviceBuffer(uint32_t slot) const { return slots[slot].deviceBuffer; }
+
+		/** @brief Streams totalSize bytes through the pipeline and returns once all output has been consumed */
+		Statistics run(VkDeviceSize totalSize)
+		{
+			assert(recordDispatch);
+			Statistics statistics;
+			statistics.bytes = totalSize;
+			statistics.chunkCount = static_cast<uint32_t>((totalSize + chunkSize - 1) / chunkSize);
+
+			auto tStart = std::chrono::high_resolution_clock::now();
+			Slot* pendingReadback = nullptr;
+			for (uint32_t i = 0; i < statistics.chunkCount; i++) {
+				const uint32_t slotIndex = i % static_cast<uint32_t>(slots.size());
+				Slot& slot = slots[slotIndex];
+				// Reuse the slot once the chunk that last occupied it has been read back and consumed
+				if (slot.size > 0) {
+					finishReadback(slot, statistics);
+				}
+
+				slot.chunk = submittedChunks + i;
+				slot.offset = (VkDeviceSize)i * chunkSize;
+				slot.size = std::min(chunkSize, totalSize - slot.offset);
+				if (writeInput) {
+					writeInput(slot.offset, slot.size, slot.mapped);
+				}
+				submitUpload(slot);
+				submitCompute(slot, slotIndex);
+				// The previous chunk's readback goes after this upload, so the upload doesn't queue up behind a readback that waits for compute
+				if (pendingReadback) {
+					submitReadback(*pendingReadback);
+				}
+				pendingReadback = &slot;
+			}
+			if (pendingReadback) {
+				submitReadback(*pendingReadback);
+			}
+
+			// Drain the remaining chunks in submission order
+			for (uint32_t i = 0; i < slots.size(); i++) {
+				Slot& slot = slots[(statistics.chunkCount + i) % slots.size()];
+				if (slot.size > 0) {
+					finishReadback(slot, statistics);
+				}
+			}
+			submittedChunks += statistics.chunkCount;
+			statistics.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - tStart).count();
+			return statistics;
+		}
+	};
+}
@@ -0,0 +1,487 @@
+/*
+* Vulkan frame capture class
+*
+* Captures presented swap chain images into a ring of host visible readback buffers and encodes them on worker threads
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+#include <algorithm>
+#include <iostream>
+#include <cstdio>
+#include <sys/stat.h>
+#if defined(_WIN32)
+#include <direct.h>
+#endif
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanTools.h"
+#include "VulkanInitializers.hpp"
+#include "imageencoder.hpp"
+
+namespace vks
+{
+	/**
+	* @brief Asynchronous capture of presented frames
+	*
+	* A capture copies the swap chain image into the next free slot of a ring of host visible buffers with vkCmdCopyImageToBuffer.
+	* The copy is submitted between rendering and presentation (capture returns the semaphore to present with) and signals a per slot fence.
+	* Fences are polled on the next capture call, retired slots are handed to worker threads which swizzle, encode and write the image.
+	* A slot is released as soon as its texels have been copied out, so the render thread only blocks if all slots are still in flight.
+	*
+	* Usage:
+	*  - prepare once the device is available
+	*  - request a single image or captureSequence for a numbered series of frames
+	*  - capture with the image to be presented and the semaphore presentation would wait on (done by VulkanExampleBase::submitFrame)
+	*  - resize whenever the swap chain has been recreated
+	*/
+	class FrameCapture
+	{
+	private:
+		enum class SlotState { Free, Copying, Encoding };
+
+		struct Slot
+		{
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			uint8_t* mapped = nullptr;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			VkSemaphore semaphore = VK_NULL_HANDLE;
+			SlotState state = SlotState::Free;
+			// Submission order, used to wait for the oldest copy if no slot is free
+			uint64_t submission = 0;
+			std::string filename;
+			imageencoder::Format format = imageencoder::Format::QOI;
+			bool sequence = false;
+		};
+
+		vks::VulkanDevice* vulkanDevice = nullptr;
+		VkQueue queue = VK_NULL_HANDLE;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		bool supported = false;
+		bool swizzle = false;
+		bool coherent = true;
+		bool warned = false;
+		uint64_t submissions = 0;
+		std::vector<Slot> slots;
+
+		// Pending requests
+		std::string requestedFile;
+		imageencoder::Format requestedFormat = imageencoder::Format::PNG;
+		uint32_t sequenceLength = 0;
+		uint32_t sequenceIndex = 0;
+		std::atomic<uint32_t> sequenceSaved{ 0 };
+
+		// Encoder threads share a single job queue, as every job takes about the same time
+		std::vector<std::thread> workers;
+		std::queue<std::function<void()>> jobs;
+		std::mutex mutex;
+		std::condition_variable jobCondition;
+		std::condition_variable slotCondition;
+		uint32_t pendingJobs = 0;
+		bool stopping = false;
+		std::atomic<uint32_t> saved{ 0 };
+		std::string lastSaved;
+
+		void workerLoop()
+		{
+			while (true) {
+				std::function<void()> job;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					jobCondition.wait(lock, [this] { return !jobs.empty() || stopping; });
+					if (jobs.empty()) {
+						return;
+					}
+					job = std::move(jobs.front());
+					jobs.pop();
+				}
+				job();
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					pendingJobs--;
+				}
+				slotCondition.notify_all();
+			}
+		}
+
+		void createSlots()
+		{
+			VkDevice device = vulkanDevice->logicalDevice;
+			const VkDeviceSize size = (VkDeviceSize)width * height * 4;
+			for (auto& slot : slots) {
+				VkBufferCreateInfo bufferCI = vks::initializers::bufferCreateInfo(VK_BUFFER_USAGE_TRANSFER_DST_BIT, size);
+				VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCI, nullptr, &slot.buffer));
+				VkMemoryRequirements memReqs;
+				vkGetBufferMemoryRequirements(device, slot.buffer, &memReqs);
+				// The host reads every texel of a capture, which is very slow from uncached memory
+				VkBool32 memTypeFound = VK_FALSE;
+				VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+				memAlloc.allocationSize = memReqs.size;
+				memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, &memTypeFound);
+				if (!memTypeFound) {
+					memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+				}
+				coherent = (vulkanDevice->memoryProperties.memoryTypes[memAlloc.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+				VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &slot.memory));
+				VK_CHECK_RESULT(vkBindBufferMemory(device, slot.buffer, slot.memory, 0));
+				VK_CHECK_RESULT(vkMapMemory(device, slot.memory, 0, VK_WHOLE_SIZE, 0, (void**)&slot.mapped));
+
+				VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+				VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &slot.commandBuffer));
+				VkFenceCreateInfo fenceCI = vks::initializers::fenceCreateInfo();
+				VK_CHECK_RESULT(vkCreateFence(device, &fenceCI, nullptr, &slot.fence));
+				VkSemaphoreCreateInfo semaphoreCI = vks::initializers::semaphoreCreateInfo();
+				VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCI, nullptr, &slot.semaphore));
+				slot.state = SlotState::Free;
+			}
+			if (workers.empty()) {
+				const uint32_t workerCount = std::max(1u, std::min((uint32_t)slots.size(), std::thread::hardware_concurrency() / 2));
+				for (uint32_t i = 0; i < workerCount; i++) {
+					workers.push_back(std::thread(&FrameCapture::workerLoop, this));
+				}
+			}
+		}
+
+		void destroySlots()
+		{
+			VkDevice device = vulkanDevice->logicalDevice;
+			for (auto& slot : slots) {
+				if (slot.buffer == VK_NULL_HANDLE) {
+					continue;
+				}
+				vkUnmapMemory(device, slot.memory);
+				vkDestroyBuffer(device, slot.buffer, nullptr);
+				vkFreeMemory(device, slot.memory, nullptr);
+				vkFreeCommandBuffers(device, commandPool, 1, &slot.commandBuffer);
+				vkDestroyFence(device, slot.fence, nullptr);
+				vkDestroySemaphore(device, slot.semaphore, nullptr);
+				slot = Slot();
+			}
+		}
+
+		// Hands slots whose copy has finished over to the encoder threads, never waits
+		void retire()
+		{
+			for (uint32_t i = 0; i < slots.size(); i++) {
+				Slot& slot = slots[i];
+				std::lock_guard<std::mutex> lock(mutex);
+				if ((slot.state != SlotState::Copying) || (vkGetFenceStatus(vulkanDevice->logicalDevice, slot.fence) != VK_SUCCESS)) {
+					continue;
+				}
+				slot.state = SlotState::Encoding;
+				pendingJobs++;
+				jobs.push([this, i] { encode(i); });
+				jobCondition.notify_one();
+			}
+		}
+
+		// Runs on an encoder thread
+		void encode(uint32_t slotIndex)
+		{
+			Slot& slot = slots[slotIndex];
+			const std::string filename = slot.filename;
+			const imageencoder::Format format = slot.format;
+			const bool sequence = slot.sequence;
+			if (!coherent) {
+				VkMappedMemoryRange range = vks::initializers::mappedMemoryRange();
+				range.memory = slot.memory;
+				range.size = VK_WHOLE_SIZE;
+				vkInvalidateMappedMemoryRanges(vulkanDevice->logicalDevice, 1, &range);
+			}
+			// Copy the texels out first so the slot can take the next capture while this one is being encoded
+			std::vector<uint8_t> rgb;
+			imageencoder::packRGB(slot.mapped, (size_t)width * 4, width, height, swizzle, rgb);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				slot.state = SlotState::Free;
+			}
+			slotCondition.notify_all();
+
+			std::vector<uint8_t> encoded;
+			imageencoder::encode(format, rgb.data(), width, height, encoded);
+			if (!imageencoder::writeFile(filename, encoded)) {
+				std::cerr << "Could not write captured frame to " << filename << "\n";
+				return;
+			}
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				lastSaved = filename;
+			}
+			saved++;
+			if (sequence && (++sequenceSaved == sequenceLength)) {
+				std::cout << "Captured " << sequenceLength << " frames to " << directory << "\n";
+			}
+		}
+
+		Slot& acquireSlot()
+		{
+			while (true) {
+				Slot* oldest = nullptr;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					for (auto& slot : slots) {
+						if (slot.state == SlotState::Free) {
+							return slot;
+						}
+						if ((slot.state == SlotState::Copying) && (!oldest || slot.submission < oldest->submission)) {
+							oldest = &slot;
+						}
+					}
+					if (!oldest) {
+						// All slots are waiting for an encoder to copy their texels out
+						slotCondition.wait(lock);
+						continue;
+					}
+				}
+				VK_CHECK_RESULT(vkWaitForFences(vulkanDevice->logicalDevice, 1, &oldest->fence, VK_TRUE, UINT64_MAX));
+				retire();
+			}
+		}
+
+		std::string nextFilename(imageencoder::Format& format, bool& sequence)
+		{
+			if (!requestedFile.empty()) {
+				std::string filename = requestedFile;
+				requestedFile.clear();
+				format = requestedFormat;
+				sequence = false;
+				return filename;
+			}
+			if (sequenceIndex < sequenceLength) {
+				char name[32];
+				snprintf(name, sizeof(name), "/frame_%05u.", sequenceIndex++);
+				format = sequenceFormat;
+				sequence = true;
+				return directory + name + imageencoder::extension(format);
+			}
+			return "";
+		}
+
+	public:
+		/** @brief Directory frame sequences are written to */
+		std::string directory = "capture";
+		/** @brief Encoding used for frame sequences, QOI by default as it's the fastest to encode */
+		imageencoder::Format sequenceFormat = imageencoder::Format::QOI;
+		/** @brief Number of readback buffers, more slots allow encoders to fall further behind before the render thread has to wait */
+		uint32_t slotCount = 3;
+
+		~FrameCapture()
+		{
+			destroy();
+		}
+
+		/** @brief Checks if the swap chain images can be captured, buffers are only allocated once the first capture is requested */
+		void prepare(vks::VulkanDevice* vulkanDevice, VkQueue queue, VkFormat colorFormat, VkImageUsageFlags imageUsage, uint32_t width, uint32_t height)
+		{
+			this->vulkanDevice = vulkanDevice;
+			this->queue = queue;
+			if (commandPool == VK_NULL_HANDLE) {
+				VkCommandPoolCreateInfo cmdPoolInfo = vks::initializers::commandPoolCreateInfo();
+				cmdPoolInfo.queueFamilyIndex = vulkanDevice->queueFamilyIndices.graphics;
+				cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+				VK_CHECK_RESULT(vkCreateCommandPool(vulkanDevice->logicalDevice, &cmdPoolInfo, nullptr, &commandPool));
+			}
+			resize(colorFormat, imageUsage, width, height);
+		}
+
+		/** @brief Waits for pending captures and releases the readback buffers, they are recreated with the new size on the next capture */
+		void resize(VkFormat colorFormat, VkImageUsageFlags imageUsage, uint32_t width, uint32_t height)
+		{
+			finish();
+			destroySlots();
+			this->colorFormat = colorFormat;
+			this->width = width;
+			this->height = height;
+			// Only formats with four 8 bit components in RGBA or BGRA order are supported
+			const std::vector<VkFormat> formatsRGBA = { VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_A8B8G8R8_UNORM_PACK32, VK_FORMAT_A8B8G8R8_SRGB_PACK32 };
+			const std::vector<VkFormat> formatsBGRA = { VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_B8G8R8A8_SRGB };
+			swizzle = std::find(formatsBGRA.begin(), formatsBGRA.end(), colorFormat) != formatsBGRA.end();
+			supported = (imageUsage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) && (swizzle || (std::find(formatsRGBA.begin(), formatsRGBA.end(), colorFormat) != formatsRGBA.end()));
+		}
+
+		/** @brief Saves the next presented frame to the given file */
+		void request(const std::string& filename, imageencoder::Format format)
+		{
+			requestedFile = filename;
+			requestedFormat = format;
+		}
+
+		/** @brief Saves the next frameCount presented frames as a numbered sequence to the capture directory */
+		void captureSequence(uint32_t frameCount)
+		{
+#if defined(_WIN32)
+			_mkdir(directory.c_str());
+#else
+			mkdir(directory.c_str(), 0755);
+#endif
+			sequenceLength = frameCount;
+			sequenceIndex = 0;
+			sequenceSaved = 0;
+		}
+
+		/** @brief Number of captures that have been encoded and written to disk */
+		uint32_t savedCount() const
+		{
+			return saved;
+		}
+
+		std::string lastSavedFile()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return lastSaved;
+		}
+
+		/**
+		* @brief Copies the image to be presented into a readback slot if a capture has been requested for this frame
+		* @param image Swap chain image, expected in VK_IMAGE_LAYOUT_PRESENT_SRC_KHR layout
+		* @param waitSemaphore Semaphore signalled once rendering to the image has finished
+		* @return Semaphore presentation has to wait on, the passed semaphore if no capture was requested
+		*/
+		VkSemaphore capture(VkImage image, VkSemaphore waitSemaphore)
+		{
+			if (!vulkanDevice) {
+				return waitSemaphore;
+			}
+			retire();
+			imageencoder::Format format;
+			bool sequence;
+			const std::string filename = nextFilename(format, sequence);
+			if (filename.empty()) {
+				return waitSemaphore;
+			}
+			if (!supported) {
+				if (!warned) {
+					std::cerr << "Swap chain images can't be captured (format " << colorFormat << " or missing transfer source usage)\n";
+					warned = true;
+				}
+				sequenceLength = 0;
+				return waitSemaphore;
+			}
+			if (slots.empty() || slots[0].buffer == VK_NULL_HANDLE) {
+				slots.resize(std::max(1u, slotCount));
+				createSlots();
+			}
+
+			Slot& slot = acquireSlot();
+			slot.filename = filename;
+			slot.format = format;
+			slot.sequence = sequence;
+			slot.submission = submissions++;
+
+			VkCommandBuffer cmd = slot.commandBuffer;
+			VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+			cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			VK_CHECK_RESULT(vkBeginCommandBuffer(cmd, &cmdBufInfo));
+			const VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			// Rendering has been made visible by the semaphore wait
+			vks::tools::insertImageMemoryBarrier(
+				cmd,
+				image,
+				0,
+				VK_ACCESS_TRANSFER_READ_BIT,
+				VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				subresourceRange);
+			// A buffer copy (unlike a blit) works with any source tiling and format support, swizzling is done by the encoder
+			VkBufferImageCopy region = {};
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			region.imageExtent = { width, height, 1 };
+			vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &region);
+			vks::tools::insertImageMemoryBarrier(
+				cmd,
+				image,
+				VK_ACCESS_TRANSFER_READ_BIT,
+				0,
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				subresourceRange);
+			VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
+			bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			bufferBarrier.buffer = slot.buffer;
+			bufferBarrier.size = VK_WHOLE_SIZE;
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+			VK_CHECK_RESULT(vkEndCommandBuffer(cmd));
+
+			const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+			submitInfo.waitSemaphoreCount = (waitSemaphore != VK_NULL_HANDLE) ? 1 : 0;
+			submitInfo.pWaitSemaphores = &waitSemaphore;
+			submitInfo.pWaitDstStageMask = &waitStage;
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &cmd;
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &slot.semaphore;
+			VK_CHECK_RESULT(vkResetFences(vulkanDevice->logicalDevice, 1, &slot.fence));
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, slot.fence));
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				slot.state = SlotState::Copying;
+			}
+			return slot.semaphore;
+		}
+
+		/** @brief Waits until all requested captures have been written to disk */
+		void finish()
+		{
+			for (auto& slot : slots) {
+				bool copying;
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					copying = (slot.state == SlotState::Copying);
+				}
+				if (copying) {
+					VK_CHECK_RESULT(vkWaitForFences(vulkanDevice->logicalDevice, 1, &slot.fence, VK_TRUE, UINT64_MAX));
+				}
+			}
+			if (!slots.empty()) {
+				retire();
+			}
+			std::unique_lock<std::mutex> lock(mutex);
+			slotCondition.wait(lock, [this] { return pendingJobs == 0; });
+		}
+
+		void destroy()
+		{
+			if (!vulkanDevice) {
+				return;
+			}
+			finish();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			jobCondition.notify_all();
+			for (auto& worker : workers) {
+				worker.join();
+			}
+			workers.clear();
+			destroySlots();
+			slots.clear();
+			vkDestroyCommandPool(vulkanDevice->logicalDevice, commandPool, nullptr);
+			commandPool = VK_NULL_HANDLE;
+			vulkanDevice = nullptr;
+		}
+	};
+}
@@ -0,0 +1,241 @@
+/*
+* Vulkan GPU profiler class
+*
+* Measures the GPU time of named passes (scopes) using timestamp queries
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <algorithm>
+#include <iostream>
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanQueryManager.hpp"
+
+namespace vks
+{
+	/**
+	* @brief Scoped GPU timestamp profiler
+	*
+	* Scopes are identified by name and write a timestamp at their start and end. Results are read back through a QueryManager
+	* (so they never stall the CPU), converted to milliseconds using the device's timestampPeriod and averaged over a window of frames.
+	*
+	* Usage (per command buffer, with the index of the command buffer as the frame index):
+	*  - cmdBeginFrame before any scope (outside of a render pass)
+	*  - cmdBeginScope/cmdEndScope around the passes to be measured
+	*  - cmdEndFrame after the last scope
+	*  - update with the frame index before the command buffer is submitted (done by VulkanExampleBase::prepareFrame)
+	*/
+	class GpuProfiler
+	{
+	public:
+		struct Scope
+		{
+			std::string name;
+			/** @brief GPU time averaged over the last windowSize frames in milliseconds */
+			double average = 0.0;
+			/** @brief GPU time of the last frame for which results have been read in milliseconds */
+			double last = 0.0;
+			std::vector<double> samples;
+			uint32_t samplePos = 0;
+		};
+
+	private:
+		static const uint32_t invalidScope = ~0u;
+
+		vks::QueryManager queryManager;
+		uint32_t querySet;
+		uint32_t maxScopes = 0;
+		uint32_t frameCount = 0;
+		float timestampPeriod = 1.0f;
+		uint64_t timestampMask = ~0ULL;
+		std::vector<Scope> scopes;
+		// Scopes written into the command buffer of each frame slot at the time it was recorded
+		std::vector<std::vector<bool>> slotScopes;
+		std::vector<bool> slotRecorded;
+		// Names of scopes that didn't fit into the query set, only used to warn once per name
+		std::vector<std::string> droppedScopes;
+
+		// Returns invalidScope if all maxScopes are in use, the scope is then ignored
+		uint32_t getScopeIndex(const std::string &name)
+		{
+			for (uint32_t i = 0; i < scopes.size(); i++) {
+				if (scopes[i].name == name) {
+					return i;
+				}
+			}
+			if (scopes.size() >= maxScopes) {
+				if (std::find(droppedScopes.begin(), droppedScopes.end(), name) == droppedScopes.end()) {
+					std::cerr << "GPU profiler: Scope \"" << name << "\" exceeds the maximum of " << maxScopes << " scopes and is ignored\n";
+					droppedScopes.push_back(name);
+				}
+				return invalidScope;
+			}
+			Scope scope;
+			scope.name = name;
+			scopes.push_back(scope);
+			return static_cast<uint32_t>(scopes.size() - 1);
+		}
+
+		void onResults(uint32_t frameIndex, uint32_t latency, const std::vector<uint64_t> &timestamps)
+		{
+			this->latency = latency;
+			bool hasScopes = false;
+			uint64_t frameBegin = 0;
+			uint64_t frameEnd = 0;
+			for (uint32_t i = 0; i < scopes.size(); i++) {
+				if (!slotScopes[frameIndex][i]) {
+					continue;
+				}
+				// Timestamps are relative to the first scope of the frame, so counter wrap arounds are handled by the mask
+				if (!hasScopes) {
+					frameBegin = timestamps[i * 2];
+					hasScopes = true;
+				}
+				frameEnd = std::max(frameEnd, (timestamps[i * 2 + 1] - frameBegin) & timestampMask);
+				Scope &scope = scopes[i];
+				const double ms = (double)((timestamps[i * 2 + 1] - timestamps[i * 2]) & timestampMask) * timestampPeriod / 1000000.0;
+				scope.last = ms;
+				if (scope.samples.size() < windowSize) {
+					scope.samples.push_back(ms);
+				} else {
+					scope.samples[scope.samplePos] = ms;
+				}
+				scope.samplePos = (scope.samplePos + 1) % windowSize;
+				scope.average = 0.0;
+				for (auto sample : scope.samples) {
+					scope.average += sample;
+				}
+				scope.average /= (double)scope.samples.size();
+				if (onScopeResult) {
+					onScopeResult(scope.name, ms);
+				}
+			}
+			if (hasScopes && onFrameResult) {
+				onFrameResult((double)frameEnd * timestampPeriod / 1000000.0);
+			}
+		}
+
+	public:
+		/** @brief True if the selected device and graphics queue support timestamps */
+		bool supported = false;
+		/** @brief Number of frames that had been submitted between recording and reading back the last results */
+		uint32_t latency = 0;
+		/** @brief Number of frames the per scope GPU times are averaged over */
+		uint32_t windowSize = 60;
+		/** @brief (Optional) Called for every scope once its GPU time for a frame has been read back */
+		std::function<void(const std::string &name, double ms)> onScopeResult;
+		/** @brief (Optional) Called once per frame with the GPU time from the start of the first to the end of the last scope */
+		std::function<void(double ms)> onFrameResult;
+
+		/**
+		* Prepare the profiler
+		*
+		* @param device Pointer to a valid VulkanDevice
+		* @param frameCount Number of frame slots (usually the number of command buffers)
+		* @param maxScopes (Optional) Maximum number of distinct scopes, additional scopes are ignored with a warning
+		*/
+		void prepare(vks::VulkanDevice *device, uint32_t frameCount, uint32_t maxScopes = 16)
+		{
+			const uint32_t validBits = device->queueFamilyProperties[device->queueFamilyIndices.graphics].timestampValidBits;
+			supported = (validBits > 0) && (device->properties.limits.timestampPeriod > 0.0f);
+			if (!supported) {
+				return;
+			}
+			timestampPeriod = device->properties.limits.timestampPeriod;
+			timestampMask = (validBits >= 64) ? ~0ULL : ((1ULL << validBits) - 1);
+			this->maxScopes = maxScopes;
+			this->frameCount = frameCount;
+			slotScopes.assign(frameCount, std::vector<bool>(maxScopes, false));
+			slotRecorded.assign(frameCount, false);
+			queryManager.prepare(device, frameCount);
+			querySet = queryManager.addQuerySet(VK_QUERY_TYPE_TIMESTAMP, maxScopes * 2, [this](const std::vector<uint64_t> &results, uint32_t frameIndex, uint32_t latency) {
+				onResults(frameIndex, latency, results);
+			});
+		}
+
+		/** @brief Reset the scopes of a frame slot, must be recorded outside of a render pass before the first scope */
+		void cmdBeginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+		{
+			if (!supported || frameIndex >= frameCount) {
+				return;
+			}
+			queryManager.cmdReset(commandBuffer, frameIndex);
+			std::fill(slotScopes[frameIndex].begin(), slotScopes[frameIndex].end(), false);
+			slotRecorded[frameIndex] = true;
+		}
+
+		/** @brief Write the start timestamp of a named scope */
+		void cmdBeginScope(VkCommandBuffer commandBuffer, uint32_t frameIndex, const std::string &name, VkPipelineStageFlagBits pipelineStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT)
+		{
+			if (!supported || frameIndex >= frameCount) {
+				return;
+			}
+			const uint32_t index = getScopeIndex(name);
+			if (index == invalidScope) {
+				return;
+			}
+			queryManager.cmdWriteTimestamp(commandBuffer, querySet, frameIndex, index * 2, pipelineStage);
+			slotScopes[frameIndex][index] = true;
+		}
+
+		/** @brief Write the end timestamp of a named scope */
+		void cmdEndScope(VkCommandBuffer commandBuffer, uint32_t frameIndex, const std::string &name, VkPipelineStageFlagBits pipelineStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT)
+		{
+			if (!supported || frameIndex >= frameCount) {
+				return;
+			}
+			const uint32_t index = getScopeIndex(name);
+			if (index == invalidScope) {
+				return;
+			}
+			queryManager.cmdWriteTimestamp(commandBuffer, querySet, frameIndex, index * 2 + 1, pipelineStage);
+		}
+
+		/** @brief Write placeholder timestamps for all queries that haven't been used by the frame slot, so its results become available */
+		void cmdEndFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+		{
+			if (!supported || frameIndex >= frameCount) {
+				return;
+			}
+			for (uint32_t i = 0; i < maxScopes; i++) {
+				if ((i >= scopes.size()) || !slotScopes[frameIndex][i]) {
+					queryManager.cmdWriteTimestamp(commandBuffer, querySet, frameIndex, i * 2, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+					queryManager.cmdWriteTimestamp(commandBuffer, querySet, frameIndex, i * 2 + 1, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+				}
+			}
+		}
+
+		/** @brief Read back all results that have become available, must be called before the command buffer of the frame slot is submitted */
+		void update(uint32_t frameIndex)
+		{
+			if (!supported || frameIndex >= frameCount || !slotRecorded[frameIndex]) {
+				return;
+			}
+			queryManager.update(frameIndex);
+		}
+
+		/** @brief Returns all scopes recorded so far in order of their first use */
+		const std::vector<Scope>& getScopes() const
+		{
+			return scopes;
+		}
+
+		void destroy()
+		{
+			if (supported) {
+				queryManager.destroy();
+			}
+			slotScopes.clear();
+			slotRecorded.clear();
+			frameCount = 0;
+		}
+	};
+}
@@ -1,259 +1,822 @@
 /*
 * Heightmap terrain generator
 *
+* Chunked quadtree terrain streamed from a tiled height map file with CPU level of detail selection
+*
 * Copyright (C) by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#pragma once
+
 #include <glm/glm.hpp>
-#include <glm/glm.hpp>
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <limits>
+#include <iostream>
+#include <cstdio>
+#include <cmath>
 
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.h"
 #include "VulkanBuffer.h"
+#include "frustum.hpp"
 #include <ktx.h>
 #include <ktxvulkan.h>
 
-namespace vks 
+namespace vks
 {
+	/*
+		Chunked quadtree terrain
+
+		The height map is split into a quadtree of chunks with each chunk being a grid of tileSize x tileSize quads. The root chunk covers
+		the whole map at a coarse resolution and every level halves the sample spacing, down to the leaves that use every texel of the source.
+		Chunks are read from a tiled height map file (see createTiledFile) by background threads when they are needed, so only the node table
+		(bounds and geometric error of all chunks) and a bounded number of resident chunks are kept in memory.
+
+		The quadtree is refined on the CPU every frame based on the screen space error of each chunk and then restricted so that neighbouring
+		chunks differ by at most one level. Chunks outside of the view frustum are culled before they are drawn. Cracks between chunks of
+		different levels are closed by one of 16 shared 16-bit index templates that snap the odd vertices of edges bordering a coarser chunk.
+	*/
 	class HeightMap
 	{
-	private:
-		uint16_t *heightdata;
-		uint32_t dim;
-		uint32_t scale;
-
-		vks::VulkanDevice *device = nullptr;
-		VkQueue copyQueue = VK_NULL_HANDLE;
 	public:
 		enum Topology { topologyTriangles, topologyQuads };
 
+		struct Vertex {
+			glm::vec3 pos;
+			glm::vec3 normal;
+			glm::vec2 uv;
+		};
+
+		// Tiled height map files start with this header, followed by the node table and the height samples of all chunks
+		struct TiledFileHeader {
+			uint32_t magic;
+			uint32_t version;
+			// Dimension of the (square, power of two) source height map
+			uint32_t dim;
+			// Number of quads along a chunk's edge
+			uint32_t tileSize;
+			uint32_t levelCount;
+			uint32_t nodeCount;
+		};
+
+		// Bounds and error of a single chunk as stored in the file's node table, heights are normalized to 16 bits
+		struct NodeInfo {
+			uint16_t minHeight;
+			uint16_t maxHeight;
+			// Max. height difference between the chunk's grid and the full resolution height map
+			float error;
+		};
+
+		// Chunk selected for rendering, the stitch mask selects the index template
+		struct DrawChunk {
+			uint32_t slot;
+			uint32_t stitchMask;
+		};
+
+		// Edges of a chunk that border a coarser chunk
+		enum StitchEdge { stitchTop = 1, stitchRight = 2, stitchBottom = 4, stitchLeft = 8 };
+
+		// These need to be set before calling open
 		float heightScale = 1.0f;
 		float uvScale = 1.0f;
+		// Max. number of chunks kept in memory, this also sizes the vertex buffer
+		uint32_t maxResidentChunks = 512;
+		uint32_t maxPendingLoads = 32;
+
+		// Max. screen space error in pixels before a chunk is replaced by its children
+		float pixelError = 4.0f;
 
+		// Pool of resident chunk vertices, each chunk uses a fixed slot
 		vks::Buffer vertexBuffer;
+		// Stitching index templates, one for every combination of coarser neighbours
 		vks::Buffer indexBuffer;
 
-		struct Vertex {
-			glm::vec3 pos;
-			glm::vec3 normal;
-			glm::vec2 uv;
+		std::vector<DrawChunk> drawChunks;
+
+		struct Statistics {
+			uint32_t residentChunks = 0;
+			uint32_t pendingChunks = 0;
+			uint32_t selectedChunks = 0;
+			uint32_t visibleChunks = 0;
+			uint32_t maxLevel = 0;
+		} statistics;
+
+	private:
+		static const uint32_t tiledFileMagic = 0x54484b56;
+		static const uint32_t tiledFileVersion = 1;
+		// Residency states of chunks that are not in a vertex buffer slot
+		enum { chunkNotResident = -1, chunkPending = -2 };
+
+		struct NodeCoord {
+			uint32_t level;
+			uint32_t x;
+			uint32_t y;
 		};
 
-		size_t vertexBufferSize = 0;
-		size_t indexBufferSize = 0;
-		uint32_t indexCount = 0;
+		struct LoadRequest {
+			uint32_t node;
+			float priority;
+		};
 
-		HeightMap(vks::VulkanDevice *device, VkQueue copyQueue)
-		{
-			this->device = device;
-			this->copyQueue = copyQueue;
+		struct LoadResult {
+			uint32_t node;
+			bool valid;
+			std::vector<Vertex> vertices;
 		};
 
-		~HeightMap()
+		vks::VulkanDevice *device = nullptr;
+		VkQueue copyQueue = VK_NULL_HANDLE;
+
+		std::string filename;
+		TiledFileHeader header{};
+		std::vector<NodeInfo> nodes;
+		std::vector<uint32_t> levelOffsets;
+		uint64_t tileDataOffset = 0;
+		// Samples per tile edge, each tile has a border of one sample for calculating normals
+		uint32_t tileStride = 0;
+		float worldSize = 1.0f;
+
+		uint32_t verticesPerChunk = 0;
+		uint32_t indicesPerTemplate = 0;
+
+		// Residency, only accessed by the thread calling update
+		std::vector<int32_t> nodeSlots;
+		std::vector<uint32_t> slotNodes;
+		std::vector<uint64_t> slotLastUsed;
+		std::vector<uint32_t> freeSlots;
+		uint64_t frameIndex = 0;
+
+		// Level of detail selection
+		vks::Frustum frustum;
+		glm::vec3 cameraPos;
+		float lodFactor = 1.0f;
+		std::vector<uint8_t> splitFlags;
+		std::vector<uint32_t> splitNodes;
+		std::vector<LoadRequest> loadCandidates;
+
+		// Background loading
+		std::vector<std::thread> loaderThreads;
+		std::mutex loaderMutex;
+		std::condition_variable loaderCondition;
+		std::vector<LoadRequest> loadRequests;
+		std::vector<LoadResult> loadResults;
+		uint32_t loadsInFlight = 0;
+		bool stopLoaders = false;
+
+		static bool seekFile(FILE* file, uint64_t offset)
 		{
-			vertexBuffer.destroy();
-			indexBuffer.destroy();
-			delete[] heightdata;
+#if defined(_WIN32)
+			return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+			return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
 		}
 
-		float getHeight(uint32_t x, uint32_t y)
+		uint32_t nodeIndex(const NodeCoord& coord) const
 		{
-			glm::ivec2 rpos = glm::ivec2(x, y) * glm::ivec2(scale);
-			rpos.x = std::max(0, std::min(rpos.x, (int)dim - 1));
-			rpos.y = std::max(0, std::min(rpos.y, (int)dim - 1));
-			rpos /= glm::ivec2(scale);
-			return *(heightdata + (rpos.x + rpos.y * dim) * scale) / 65535.0f * heightScale;
+			return levelOffsets[coord.level] + coord.y * (1u << coord.level) + coord.x;
 		}
 
-#if defined(__ANDROID__)
-		void loadFromFile(const std::string filename, uint32_t patchsize, glm::vec3 scale, Topology topology, AAssetManager* assetManager)
-#else
-		void loadFromFile(const std::string filename, uint32_t patchsize, glm::vec3 scale, Topology topology)
-#endif
+		NodeCoord getNodeCoord(uint32_t index) const
 		{
-			assert(device);
-			assert(copyQueue != VK_NULL_HANDLE);
+			const uint32_t level = static_cast<uint32_t>(std::upper_bound(levelOffsets.begin(), levelOffsets.end(), index) - levelOffsets.begin()) - 1;
+			const uint32_t local = index - levelOffsets[level];
+			return { level, local & ((1u << level) - 1), local >> level };
+		}
 
-			ktxResult result;
-			ktxTexture* ktxTexture;
-#if defined(__ANDROID__)
-			AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
-			assert(asset);
-			size_t size = AAsset_getLength(asset);
-			assert(size > 0);
-			void *textureData = malloc(size);
-			AAsset_read(asset, textureData, size);
-			AAsset_close(asset);
-			result = ktxTexture_CreateFromMemory(textureData, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, target);
-			free(textureData);
-#else
-			result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
-#endif
-			assert(result == KTX_SUCCESS);
-			ktx_size_t ktxSize = ktxTexture_GetImageSize(ktxTexture, 0);
-			ktx_uint8_t* ktxImage = ktxTexture_GetData(ktxTexture);
-			dim = ktxTexture->baseWidth;
-			heightdata = new uint16_t[dim * dim];
-			memcpy(heightdata, ktxImage, ktxSize);
-			this->scale = dim / patchsize;
-			ktxTexture_Destroy(ktxTexture);
+		// Returns the parent of the neighbour in the given direction if that is not the node's own parent
+		bool getNeighbourParent(const NodeCoord& coord, int32_t dx, int32_t dy, NodeCoord& parent) const
+		{
+			if (coord.level == 0) {
+				return false;
+			}
+			const int32_t nodesPerEdge = 1 << coord.level;
+			const int32_t nx = static_cast<int32_t>(coord.x) + dx;
+			const int32_t ny = static_cast<int32_t>(coord.y) + dy;
+			if (nx < 0 || ny < 0 || nx >= nodesPerEdge || ny >= nodesPerEdge) {
+				return false;
+			}
+			parent = { coord.level - 1, static_cast<uint32_t>(nx) / 2, static_cast<uint32_t>(ny) / 2 };
+			return (parent.x != coord.x / 2) || (parent.y != coord.y / 2);
+		}
 
-			// Generate vertices
-			Vertex * vertices = new Vertex[patchsize * patchsize * 4];
+		void getBounds(const NodeCoord& coord, glm::vec3& min, glm::vec3& max) const
+		{
+			const NodeInfo& info = nodes[nodeIndex(coord)];
+			const float size = worldSize / static_cast<float>(1u << coord.level);
+			min = glm::vec3(-worldSize / 2.0f + coord.x * size, -info.maxHeight / 65535.0f * heightScale, -worldSize / 2.0f + coord.y * size);
+			max = glm::vec3(min.x + size, -info.minHeight / 65535.0f * heightScale, min.z + size);
+		}
 
-			const float wx = 2.0f;
-			const float wy = 2.0f;
+		float getScreenSpaceError(const NodeCoord& coord) const
+		{
+			glm::vec3 min, max;
+			getBounds(coord, min, max);
+			const float distance = glm::length(glm::max(glm::max(min - cameraPos, cameraPos - max), glm::vec3(0.0f)));
+			return nodes[nodeIndex(coord)].error * heightScale * lodFactor / std::max(distance, 1.0e-4f);
+		}
 
-			for (uint32_t x = 0; x < patchsize; x++)
-			{
-				for (uint32_t y = 0; y < patchsize; y++)
-				{
-					uint32_t index = (x + y * patchsize);
-					vertices[index].pos[0] = (x * wx + wx / 2.0f - (float)patchsize * wx / 2.0f) * scale.x;
-					vertices[index].pos[1] = -getHeight(x, y);
-					vertices[index].pos[2] = (y * wy + wy / 2.0f - (float)patchsize * wy / 2.0f) * scale.z;
-					vertices[index].uv = glm::vec2((float)x / patchsize, (float)y / patchsize) * uvScale;
+		// Checks if all children of a node are resident and queues loads for the missing ones
+		bool childrenResident(const NodeCoord& coord, float priority)
+		{
+			bool resident = true;
+			for (uint32_t i = 0; i < 4; i++) {
+				const NodeCoord child = { coord.level + 1, coord.x * 2 + (i & 1), coord.y * 2 + (i >> 1) };
+				const uint32_t index = nodeIndex(child);
+				if (nodeSlots[index] < 0) {
+					resident = false;
+					if (nodeSlots[index] == chunkNotResident) {
+						loadCandidates.push_back({ index, priority });
+					}
 				}
 			}
+			return resident;
+		}
 
-			for (uint32_t y = 0; y < patchsize; y++)
-			{
-				for (uint32_t x = 0; x < patchsize; x++)
-				{
-					float dx = getHeight(x < patchsize - 1 ? x + 1 : x, y) - getHeight(x > 0 ? x - 1 : x, y);
-					if (x == 0 || x == patchsize - 1)
-						dx *= 2.0f;
-
-					float dy = getHeight(x, y < patchsize - 1 ? y + 1 : y) - getHeight(x, y > 0 ? y - 1 : y);
-					if (y == 0 || y == patchsize - 1)
-						dy *= 2.0f;
+		void split(const NodeCoord& coord)
+		{
+			const uint32_t index = nodeIndex(coord);
+			splitFlags[index] = 1;
+			splitNodes.push_back(index);
+		}
 
-					glm::vec3 A = glm::vec3(1.0f, 0.0f, dx);
-					glm::vec3 B = glm::vec3(0.0f, 1.0f, dy);
+		void refine(const NodeCoord& coord)
+		{
+			if (coord.level + 1 >= header.levelCount) {
+				return;
+			}
+			const float error = getScreenSpaceError(coord);
+			if (error <= pixelError || !childrenResident(coord, error)) {
+				return;
+			}
+			split(coord);
+			for (uint32_t i = 0; i < 4; i++) {
+				refine({ coord.level + 1, coord.x * 2 + (i & 1), coord.y * 2 + (i >> 1) });
+			}
+		}
 
-					glm::vec3 normal = (glm::normalize(glm::cross(A, B)) + 1.0f) * 0.5f;
+		// Restrict the quadtree so that neighbouring leaves differ by at most one level
+		void balance()
+		{
+			const int32_t directions[4][2] = { { 0, -1 }, { 1, 0 }, { 0, 1 }, { -1, 0 } };
+
+			// A split node requires the parents of its neighbours to be split too, split these where their children are available
+			for (size_t i = 0; i < splitNodes.size(); i++) {
+				const uint32_t index = splitNodes[i];
+				const NodeCoord coord = getNodeCoord(index);
+				for (auto& direction : directions) {
+					NodeCoord parent;
+					if (getNeighbourParent(coord, direction[0], direction[1], parent) && !splitFlags[nodeIndex(parent)]) {
+						if (childrenResident(parent, getScreenSpaceError(parent))) {
+							split(parent);
+						}
+					}
+				}
+			}
 
-					vertices[x + y * patchsize].normal = glm::vec3(normal.x, normal.z, normal.y);
+			// Undo splits that are still unbalanced or that are not part of the tree, this only removes splits so it always terminates
+			bool changed = true;
+			while (changed) {
+				changed = false;
+				for (uint32_t index : splitNodes) {
+					if (!splitFlags[index]) {
+						continue;
+					}
+					const NodeCoord coord = getNodeCoord(index);
+					bool valid = (coord.level == 0) || splitFlags[nodeIndex({ coord.level - 1, coord.x / 2, coord.y / 2 })];
+					for (auto& direction : directions) {
+						NodeCoord parent;
+						if (valid && getNeighbourParent(coord, direction[0], direction[1], parent) && !splitFlags[nodeIndex(parent)]) {
+							valid = false;
+						}
+					}
+					if (!valid) {
+						splitFlags[index] = 0;
+						changed = true;
+					}
 				}
 			}
+		}
 
-			// Generate indices
+		void addLeaf(const NodeCoord& coord)
+		{
+			statistics.selectedChunks++;
+			statistics.maxLevel = std::max(statistics.maxLevel, coord.level);
+			const uint32_t index = nodeIndex(coord);
+			slotLastUsed[nodeSlots[index]] = frameIndex;
+
+			glm::vec3 min, max;
+			getBounds(coord, min, max);
+			if (!frustum.checkSphere((min + max) * 0.5f, glm::length(max - min) * 0.5f)) {
+				return;
+			}
 
-			const uint32_t w = (patchsize - 1);
-			uint32_t *indices;
+			const int32_t directions[4][2] = { { 0, -1 }, { 1, 0 }, { 0, 1 }, { -1, 0 } };
+			uint32_t stitchMask = 0;
+			for (uint32_t i = 0; i < 4; i++) {
+				NodeCoord parent;
+				if (getNeighbourParent(coord, directions[i][0], directions[i][1], parent) && !splitFlags[nodeIndex(parent)]) {
+					stitchMask |= 1 << i;
+				}
+			}
+			drawChunks.push_back({ static_cast<uint32_t>(nodeSlots[index]), stitchMask });
+		}
 
-			switch (topology)
-			{
-			// Indices for triangles
-			case topologyTriangles:
-			{
-				indices = new uint32_t[w * w * 6];
-				for (uint32_t x = 0; x < w; x++)
-				{
-					for (uint32_t y = 0; y < w; y++)
-					{
-						uint32_t index = (x + y * w) * 6;
-						indices[index] = (x + y * patchsize);
-						indices[index + 1] = indices[index] + patchsize;
-						indices[index + 2] = indices[index + 1] + 1;
-
-						indices[index + 3] = indices[index + 1] + 1;
-						indices[index + 4] = indices[index] + 1;
-						indices[index + 5] = indices[index];
-					}
+		bool readTile(FILE* file, uint32_t index, std::vector<uint16_t>& samples) const
+		{
+			samples.resize(tileStride * tileStride);
+			const uint64_t tileSize = samples.size() * sizeof(uint16_t);
+			return seekFile(file, tileDataOffset + index * tileSize) && fread(samples.data(), tileSize, 1, file) == 1;
+		}
+
+		void generateVertices(uint32_t index, const std::vector<uint16_t>& samples, std::vector<Vertex>& vertices) const
+		{
+			const NodeCoord coord = getNodeCoord(index);
+			const uint32_t n = header.tileSize;
+			const uint32_t spacing = header.dim / (n << coord.level);
+			const uint32_t x0 = coord.x * n * spacing;
+			const uint32_t y0 = coord.y * n * spacing;
+			const float quadSize = worldSize * spacing / header.dim;
+
+			auto height = [&](uint32_t i, uint32_t j) {
+				return samples[j * tileStride + i] / 65535.0f * heightScale;
+			};
+
+			vertices.resize(verticesPerChunk);
+			for (uint32_t j = 0; j <= n; j++) {
+				for (uint32_t i = 0; i <= n; i++) {
+					const uint32_t tx = x0 + i * spacing;
+					const uint32_t ty = y0 + j * spacing;
+					Vertex& vertex = vertices[j * (n + 1) + i];
+					vertex.pos = glm::vec3(((float)tx / header.dim - 0.5f) * worldSize, -height(i + 1, j + 1), ((float)ty / header.dim - 0.5f) * worldSize);
+					// Texture coordinates address the center of the sampled texel
+					vertex.uv = glm::vec2((std::min(tx, header.dim - 1) + 0.5f) / header.dim, (std::min(ty, header.dim - 1) + 0.5f) / header.dim) * uvScale;
+					// Central differences using the tile's border samples
+					const float dx = height(i + 2, j + 1) - height(i, j + 1);
+					const float dz = height(i + 1, j + 2) - height(i + 1, j);
+					vertex.normal = glm::normalize(glm::vec3(-dx / (2.0f * quadSize), 1.0f, -dz / (2.0f * quadSize)));
 				}
-				indexCount = (patchsize - 1) * (patchsize - 1) * 6;
-				indexBufferSize = (w * w * 6) * sizeof(uint32_t);
-				break;
 			}
-			// Indices for quad patches (tessellation)
-			case topologyQuads:
-			{
+		}
 
-				indices = new uint32_t[w * w * 4];
-				for (uint32_t x = 0; x < w; x++)
+		void loaderLoop()
+		{
+			FILE* file = fopen(filename.c_str(), "rb");
+			std::vector<uint16_t> samples;
+			while (true) {
+				LoadRequest request;
 				{
-					for (uint32_t y = 0; y < w; y++)
-					{
-						uint32_t index = (x + y * w) * 4;
-						indices[index] = (x + y * patchsize);
-						indices[index + 1] = indices[index] + patchsize;
-						indices[index + 2] = indices[index + 1] + 1;
-						indices[index + 3] = indices[index] + 1;
+					std::unique_lock<std::mutex> lock(loaderMutex);
+					loaderCondition.wait(lock, [this] { return stopLoaders || !loadRequests.empty(); });
+					if (stopLoaders) {
+						break;
 					}
+					// Requests are sorted by ascending priority
+					request = loadRequests.back();
+					loadRequests.pop_back();
+					loadsInFlight++;
+				}
+				LoadResult result;
+				result.node = request.node;
+				result.valid = file && readTile(file, request.node, samples);
+				if (result.valid) {
+					generateVertices(request.node, samples, result.vertices);
+				}
+				{
+					std::lock_guard<std::mutex> lock(loaderMutex);
+					loadResults.push_back(std::move(result));
 				}
-				indexCount = (patchsize - 1) * (patchsize - 1) * 4;
-				indexBufferSize = (w * w * 4) * sizeof(uint32_t);
-				break;
 			}
-
+			if (file) {
+				fclose(file);
 			}
+		}
 
-			assert(indexBufferSize > 0);
+		// Returns a free vertex buffer slot, evicting the least recently used chunk that was not used in the current frame if necessary
+		int32_t allocateSlot()
+		{
+			if (!freeSlots.empty()) {
+				const uint32_t slot = freeSlots.back();
+				freeSlots.pop_back();
+				return static_cast<int32_t>(slot);
+			}
+			int32_t slot = -1;
+			uint64_t oldest = frameIndex;
+			// Slot 0 holds the root chunk, which is never evicted
+			for (uint32_t i = 1; i < slotLastUsed.size(); i++) {
+				if (slotLastUsed[i] < oldest) {
+					oldest = slotLastUsed[i];
+					slot = static_cast<int32_t>(i);
+				}
+			}
+			if (slot >= 0) {
+				nodeSlots[slotNodes[slot]] = chunkNotResident;
+			}
+			return slot;
+		}
 
-			vertexBufferSize = (patchsize * patchsize * 4) * sizeof(Vertex);
+		void storeChunk(uint32_t index, uint32_t slot, const std::vector<Vertex>& vertices)
+		{
+			memcpy(static_cast<Vertex*>(vertexBuffer.mapped) + slot * verticesPerChunk, vertices.data(), verticesPerChunk * sizeof(Vertex));
+			nodeSlots[index] = static_cast<int32_t>(slot);
+			slotNodes[slot] = index;
+			slotLastUsed[slot] = frameIndex;
+		}
 
-			// Generate Vulkan buffers
+		void processLoadResults()
+		{
+			std::vector<LoadResult> results;
+			{
+				std::lock_guard<std::mutex> lock(loaderMutex);
+				results.swap(loadResults);
+				loadsInFlight -= static_cast<uint32_t>(results.size());
+			}
+			for (auto& result : results) {
+				const int32_t slot = result.valid ? allocateSlot() : -1;
+				if (slot < 0) {
+					nodeSlots[result.node] = chunkNotResident;
+					continue;
+				}
+				storeChunk(result.node, static_cast<uint32_t>(slot), result.vertices);
+			}
+		}
 
-			vks::Buffer vertexStaging, indexStaging;
+		// Replaces all requests that have not been started yet with this frame's most important candidates
+		void submitLoadRequests()
+		{
+			std::sort(loadCandidates.begin(), loadCandidates.end(), [](const LoadRequest& a, const LoadRequest& b) { return a.priority > b.priority; });
+			std::lock_guard<std::mutex> lock(loaderMutex);
+			for (auto& request : loadRequests) {
+				nodeSlots[request.node] = chunkNotResident;
+			}
+			loadRequests.clear();
+			for (auto& candidate : loadCandidates) {
+				if (loadsInFlight + loadRequests.size() >= maxPendingLoads) {
+					break;
+				}
+				if (nodeSlots[candidate.node] == chunkNotResident) {
+					nodeSlots[candidate.node] = chunkPending;
+					loadRequests.push_back(candidate);
+				}
+			}
+			std::reverse(loadRequests.begin(), loadRequests.end());
+			statistics.pendingChunks = loadsInFlight + static_cast<uint32_t>(loadRequests.size());
+			loaderCondition.notify_all();
+		}
 
-			// Create staging buffers
-			device->createBuffer(
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				&vertexStaging,
-				vertexBufferSize,
-				vertices);
+		void createIndexTemplates(Topology topology)
+		{
+			const uint32_t n = header.tileSize;
+			std::vector<uint16_t> indices;
+			indices.reserve(16 * n * n * 6);
+			for (uint32_t mask = 0; mask < 16; mask++) {
+				// Odd vertices on edges bordering a coarser chunk are snapped to the previous even vertex, the degenerate primitives this creates are discarded
+				auto vertex = [n, mask](uint32_t i, uint32_t j) {
+					if (((mask & stitchTop) && j == 0) || ((mask & stitchBottom) && j == n)) {
+						i &= ~1u;
+					}
+					if (((mask & stitchLeft) && i == 0) || ((mask & stitchRight) && i == n)) {
+						j &= ~1u;
+					}
+					return static_cast<uint16_t>(j * (n + 1) + i);
+				};
+				for (uint32_t y = 0; y < n; y++) {
+					for (uint32_t x = 0; x < n; x++) {
+						if (topology == topologyQuads) {
+							indices.insert(indices.end(), { vertex(x, y), vertex(x, y + 1), vertex(x + 1, y + 1), vertex(x + 1, y) });
+						} else {
+							indices.insert(indices.end(), { vertex(x, y), vertex(x, y + 1), vertex(x + 1, y + 1), vertex(x + 1, y + 1), vertex(x + 1, y), vertex(x, y) });
+						}
+					}
+				}
+			}
+			indicesPerTemplate = static_cast<uint32_t>(indices.size() / 16);
 
-			device->createBuffer(
+			const VkDeviceSize indexBufferSize = indices.size() * sizeof(uint16_t);
+			vks::Buffer indexStaging;
+			VK_CHECK_RESULT(device->createBuffer(
 				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 				&indexStaging,
 				indexBufferSize,
-				indices);
-
-			// Device local (target) buffer
-			device->createBuffer(
-				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-				&vertexBuffer,
-				vertexBufferSize);
-
-			device->createBuffer(
+				indices.data()));
+			VK_CHECK_RESULT(device->createBuffer(
 				VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 				&indexBuffer,
-				indexBufferSize);
+				indexBufferSize));
 
-			// Copy from staging buffers
 			VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
 			VkBufferCopy copyRegion = {};
+			copyRegion.size = indexBufferSize;
+			vkCmdCopyBuffer(copyCmd, indexStaging.buffer, indexBuffer.buffer, 1, &copyRegion);
+			device->flushCommandBuffer(copyCmd, copyQueue, true);
+			indexStaging.destroy();
+		}
 
-			copyRegion.size = vertexBufferSize;
-			vkCmdCopyBuffer(
-				copyCmd,
-				vertexStaging.buffer,
-				vertexBuffer.buffer,
-				1,
-				&copyRegion);
+	public:
+		HeightMap(vks::VulkanDevice *device, VkQueue copyQueue)
+		{
+			this->device = device;
+			this->copyQueue = copyQueue;
+		}
 
-			copyRegion.size = indexBufferSize;
-			vkCmdCopyBuffer(
-				copyCmd,
-				indexStaging.buffer,
-				indexBuffer.buffer,
-				1,
-				&copyRegion);
+		~HeightMap()
+		{
+			{
+				std::lock_guard<std::mutex> lock(loaderMutex);
+				stopLoaders = true;
+			}
+			loaderCondition.notify_all();
+			for (auto& thread : loaderThreads) {
+				thread.join();
+			}
+			vertexBuffer.destroy();
+			indexBuffer.destroy();
+		}
 
-			device->flushCommandBuffer(copyCmd, copyQueue, true);
+		/*
+			Convert a single channel 16-bit KTX height map into a tiled height map file
+			The source needs to fit into memory for the conversion, this is meant to be done once (or offline) and the resulting file is then streamed
+		*/
+		static bool createTiledFile(const std::string& heightMapFilename, const std::string& tiledFilename, uint32_t tileSize)
+		{
+			ktxResult result;
+			ktxTexture* ktxTexture;
+#if defined(__ANDROID__)
+			AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, heightMapFilename.c_str(), AASSET_MODE_STREAMING);
+			if (!asset) {
+				return false;
+			}
+			size_t size = AAsset_getLength(asset);
+			ktx_uint8_t* textureData = new ktx_uint8_t[size];
+			AAsset_read(asset, textureData, size);
+			AAsset_close(asset);
+			result = ktxTexture_CreateFromMemory(textureData, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
+			delete[] textureData;
+#else
+			result = ktxTexture_CreateFromNamedFile(heightMapFilename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
+#endif
+			if (result != KTX_SUCCESS) {
+				std::cerr << "Could not load height map " << heightMapFilename << std::endl;
+				return false;
+			}
+
+			const uint32_t dim = ktxTexture->baseWidth;
+			// Tiles are limited to 255 quads per edge so all chunk vertices can be addressed with 16-bit indices
+			const bool validSize = (ktxTexture->baseHeight == dim) && ((dim & (dim - 1)) == 0) && ((tileSize & (tileSize - 1)) == 0) && (tileSize >= 2) && (tileSize <= 255) && (dim >= tileSize);
+			if (!validSize) {
+				std::cerr << "Height map " << heightMapFilename << " needs to be square with a power of two size of at least the tile size" << std::endl;
+				ktxTexture_Destroy(ktxTexture);
+				return false;
+			}
+			ktx_size_t imageOffset;
+			ktxTexture_GetImageOffset(ktxTexture, 0, 0, 0, &imageOffset);
+			const uint16_t* heights = reinterpret_cast<const uint16_t*>(ktxTexture_GetData(ktxTexture) + imageOffset);
+
+			TiledFileHeader fileHeader{};
+			fileHeader.magic = tiledFileMagic;
+			fileHeader.version = tiledFileVersion;
+			fileHeader.dim = dim;
+			fileHeader.tileSize = tileSize;
+			fileHeader.levelCount = 1;
+			while ((tileSize << (fileHeader.levelCount - 1)) < dim) {
+				fileHeader.levelCount++;
+			}
+			fileHeader.nodeCount = ((1u << (2 * fileHeader.levelCount)) - 1) / 3;
+
+			// Write to a temporary file first so an interrupted conversion never leaves a truncated file behind
+			const std::string tempFilename = tiledFilename + ".tmp";
+			FILE* file = fopen(tempFilename.c_str(), "wb");
+			if (!file) {
+				std::cerr << "Could not create tiled height map " << tiledFilename << std::endl;
+				ktxTexture_Destroy(ktxTexture);
+				return false;
+			}
+			std::vector<NodeInfo> nodeInfos(fileHeader.nodeCount);
+			fwrite(&fileHeader, sizeof(fileHeader), 1, file);
+			fwrite(nodeInfos.data(), sizeof(NodeInfo), nodeInfos.size(), file);
+
+			const uint32_t stride = tileSize + 3;
+			std::vector<uint16_t> tile(stride * stride);
+			uint32_t nodeIndex = 0;
+			for (uint32_t level = 0; level < fileHeader.levelCount; level++) {
+				const uint32_t nodesPerEdge = 1u << level;
+				const uint32_t spacing = dim / (tileSize << level);
+				const bool leaf = (level == fileHeader.levelCount - 1);
+				for (uint32_t ny = 0; ny < nodesPerEdge; ny++) {
+					for (uint32_t nx = 0; nx < nodesPerEdge; nx++) {
+						const int32_t x0 = nx * tileSize * spacing;
+						const int32_t y0 = ny * tileSize * spacing;
+						// Samples of the chunk's grid including a border of one sample
+						for (uint32_t j = 0; j < stride; j++) {
+							for (uint32_t i = 0; i < stride; i++) {
+								const int32_t tx = std::max(0, std::min(x0 + (static_cast<int32_t>(i) - 1) * static_cast<int32_t>(spacing), static_cast<int32_t>(dim) - 1));
+								const int32_t ty = std::max(0, std::min(y0 + (static_cast<int32_t>(j) - 1) * static_cast<int32_t>(spacing), static_cast<int32_t>(dim) - 1));
+								tile[j * stride + i] = heights[ty * dim + tx];
+							}
+						}
+						fwrite(tile.data(), sizeof(uint16_t), tile.size(), file);
+
+						// Bounds and error against all full resolution texels covered by the chunk
+						NodeInfo& info = nodeInfos[nodeIndex++];
+						info.minHeight = std::numeric_limits<uint16_t>::max();
+						info.maxHeight = 0;
+						float error = 0.0f;
+						const uint32_t xEnd = std::min(x0 + tileSize * spacing, dim - 1);
+						const uint32_t yEnd = std::min(y0 + tileSize * spacing, dim - 1);
+						for (uint32_t ty = y0; ty <= yEnd; ty++) {
+							for (uint32_t tx = x0; tx <= xEnd; tx++) {
+								const uint16_t h = heights[ty * dim + tx];
+								info.minHeight = std::min(info.minHeight, h);
+								info.maxHeight = std::max(info.maxHeight, h);
+								if (!leaf) {
+									const uint32_t ix = std::min((tx - x0) / spacing, tileSize - 1);
+									const uint32_t iy = std::min((ty - y0) / spacing, tileSize - 1);
+									const float fx = static_cast<float>(tx - x0) / spacing - ix;
+									const float fy = static_cast<float>(ty - y0) / spacing - iy;
+									const uint16_t* s = &tile[(iy + 1) * stride + ix + 1];
+									const float interpolated = glm::mix(glm::mix((float)s[0], (float)s[1], fx), glm::mix((float)s[stride], (float)s[stride + 1], fx), fy);
+									error = std::max(error, std::abs(h - interpolated));
+								}
+							}
+						}
+						info.error = error / 65535.0f;
+					}
+				}
+			}
+
+			// Coarser chunks cover the errors of their children
+			for (int32_t level = fileHeader.levelCount - 2; level >= 0; level--) {
+				const uint32_t nodesPerEdge = 1u << level;
+				const uint32_t offset = ((1u << (2 * level)) - 1) / 3;
+				const uint32_t childOffset = ((1u << (2 * (level + 1))) - 1) / 3;
+				for (uint32_t ny = 0; ny < nodesPerEdge; ny++) {
+					for (uint32_t nx = 0; nx < nodesPerEdge; nx++) {
+						NodeInfo& info = nodeInfos[offset + ny * nodesPerEdge + nx];
+						for (uint32_t i = 0; i < 4; i++) {
+							info.error = std::max(info.error, nodeInfos[childOffset + (ny * 2 + (i >> 1)) * nodesPerEdge * 2 + nx * 2 + (i & 1)].error);
+						}
+					}
+				}
+			}
+
+			fseek(file, sizeof(fileHeader), SEEK_SET);
+			fwrite(nodeInfos.data(), sizeof(NodeInfo), nodeInfos.size(), file);
+			const bool success = (ferror(file) == 0);
+			fclose(file);
+			ktxTexture_Destroy(ktxTexture);
+
+			if (!success) {
+				std::cerr << "Could not write tiled height map " << tiledFilename << std::endl;
+				std::remove(tempFilename.c_str());
+				return false;
+			}
+			std::remove(tiledFilename.c_str());
+			std::rename(tempFilename.c_str(), tiledFilename.c_str());
+			return true;
+		}
+
+		/*
+			Open a tiled height map file for streaming
+			Only the node table is read here, the root chunk is loaded right away and all other chunks are loaded on demand by the loader threads
+		*/
+		bool open(const std::string& filename, float worldSize, Topology topology, uint32_t loaderThreadCount = 2)
+		{
+			assert(device);
+			assert(copyQueue != VK_NULL_HANDLE);
+			assert(loaderThreads.empty());
+
+			FILE* file = fopen(filename.c_str(), "rb");
+			if (!file) {
+				return false;
+			}
+			bool valid = (fread(&header, sizeof(header), 1, file) == 1) && (header.magic == tiledFileMagic) && (header.version == tiledFileVersion) && (header.levelCount > 0) && (header.tileSize <= 255);
+			if (valid) {
+				nodes.resize(header.nodeCount);
+				valid = (fread(nodes.data(), sizeof(NodeInfo), nodes.size(), file) == nodes.size());
+			}
+			if (!valid) {
+				fclose(file);
+				return false;
+			}
+
+			this->filename = filename;
+			this->worldSize = worldSize;
+			tileStride = header.tileSize + 3;
+			tileDataOffset = sizeof(TiledFileHeader) + sizeof(NodeInfo) * static_cast<uint64_t>(header.nodeCount);
+			levelOffsets.resize(header.levelCount);
+			for (uint32_t level = 0; level < header.levelCount; level++) {
+				levelOffsets[level] = ((1u << (2 * level)) - 1) / 3;
+			}
+			verticesPerChunk = (header.tileSize + 1) * (header.tileSize + 1);
+
+			maxResidentChunks = std::max(maxResidentChunks, 1u);
+			nodeSlots.assign(header.nodeCount, chunkNotResident);
+			splitFlags.assign(header.nodeCount, 0);
+			slotNodes.assign(maxResidentChunks, 0);
+			slotLastUsed.assign(maxResidentChunks, 0);
+			freeSlots.clear();
+			for (uint32_t i = maxResidentChunks; i > 1; i--) {
+				freeSlots.push_back(i - 1);
+			}
+
+			// Resident chunks are written directly into host visible memory, which is safe as long as the chunk's slot is not used by a frame in flight
+			VK_CHECK_RESULT(device->createBuffer(
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&vertexBuffer,
+				static_cast<VkDeviceSize>(maxResidentChunks) * verticesPerChunk * sizeof(Vertex)));
+			VK_CHECK_RESULT(vertexBuffer.map());
+			createIndexTemplates(topology);
+
+			// The root chunk is always resident and never evicted
+			std::vector<uint16_t> samples;
+			std::vector<Vertex> vertices;
+			valid = readTile(file, 0, samples);
+			fclose(file);
+			if (!valid) {
+				return false;
+			}
+			generateVertices(0, samples, vertices);
+			storeChunk(0, 0, vertices);
+
+			stopLoaders = false;
+			for (uint32_t i = 0; i < std::max(loaderThreadCount, 1u); i++) {
+				loaderThreads.push_back(std::thread(&HeightMap::loaderLoop, this));
+			}
+			return true;
+		}
+
+		// Select the chunks to be drawn for the current view and queue loads for missing chunks
+		void update(const glm::mat4& projection, const glm::mat4& view, float viewportHeight)
+		{
+			frameIndex++;
+			processLoadResults();
+
+			frustum.update(projection * view);
+			cameraPos = glm::vec3(glm::inverse(view)[3]);
+			// Pixels per world unit at a distance of one
+			lodFactor = viewportHeight * 0.5f * std::abs(projection[1][1]);
+
+			for (uint32_t index : splitNodes) {
+				splitFlags[index] = 0;
+			}
+			splitNodes.clear();
+			loadCandidates.clear();
+
+			refine({ 0, 0, 0 });
+			balance();
 
-			vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
-			vkFreeMemory(device->logicalDevice, vertexStaging.memory, nullptr);
-			vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
-			vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
+			drawChunks.clear();
+			statistics.selectedChunks = 0;
+			statistics.maxLevel = 0;
+			if (!splitFlags[0]) {
+				addLeaf({ 0, 0, 0 });
+			}
+			for (uint32_t index : splitNodes) {
+				if (!splitFlags[index]) {
+					continue;
+				}
+				const NodeCoord coord = getNodeCoord(index);
+				if (nodeSlots[index] >= 0) {
+					slotLastUsed[nodeSlots[index]] = frameIndex;
+				}
+				for (uint32_t i = 0; i < 4; i++) {
+					const NodeCoord child = { coord.level + 1, coord.x * 2 + (i & 1), coord.y * 2 + (i >> 1) };
+					if (!splitFlags[nodeIndex(child)]) {
+						addLeaf(child);
+					}
+				}
+			}
+			statistics.visibleChunks = static_cast<uint32_t>(drawChunks.size());
+			statistics.residentChunks = maxResidentChunks - static_cast<uint32_t>(freeSlots.size());
+
+			submitLoadRequests();
+		}
+
+		// Draw all chunks selected by the last update, the pipeline needs to use a 16-bit index type compatible layout matching Vertex
+		void draw(VkCommandBuffer commandBuffer)
+		{
+			VkDeviceSize offsets[1] = { 0 };
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, offsets);
+			vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+			for (auto& chunk : drawChunks) {
+				vkCmdDrawIndexed(commandBuffer, indicesPerTemplate, 1, chunk.stitchMask * indicesPerTemplate, static_cast<int32_t>(chunk.slot * verticesPerChunk), 0);
+			}
+		}
+
+		uint32_t getLevelCount() const
+		{
+			return header.levelCount;
 		}
 	};
 }
@@ -0,0 +1,299 @@
+/*
+* Vulkan query manager class
+*
+* Manages ring-buffered query pools (one slot per frame/command buffer) and delivers results
+* asynchronously once the GPU has made them available, without stalling the CPU
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <functional>
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanBuffer.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	/**
+	* @brief Callback invoked once the results of a query set for a given frame have become available
+	* @param results Result values of all queries in the set, laid out as [query][value] (one value per query for occlusion and timestamp queries, one per enabled counter for pipeline statistics)
+	* @param frameIndex Index of the frame slot the results were recorded for
+	* @param latency Number of frames that have been submitted since the results were recorded
+	*/
+	typedef std::function<void(const std::vector<uint64_t> &results, uint32_t frameIndex, uint32_t latency)> QueryCallback;
+
+	/**
+	* @brief Ring-buffered, non-blocking GPU query results manager
+	*
+	* Each query set owns a query pool with one range of queries per frame slot (usually one per swap chain image/command buffer).
+	* Results are never waited for on the host: they are either read with VK_QUERY_RESULT_WITH_AVAILABILITY_BIT or copied into a
+	* host visible buffer with vkCmdCopyQueryPoolResults, and are handed to the set's callback one or more frames later.
+	*
+	* Usage:
+	*  - Add query sets with addQuerySet before recording command buffers
+	*  - Per command buffer: cmdReset (outside of a render pass), begin/end or write the queries, cmdCopyResults (outside of a render pass, copy sets only)
+	*  - Call update with the frame slot's index before submitting its command buffer
+	*
+	* @note All queries of a set need to be written in every command buffer that resets them, otherwise the slot never becomes available
+	*/
+	class QueryManager
+	{
+	private:
+		struct QuerySet
+		{
+			VkQueryType type;
+			VkQueryPool pool = VK_NULL_HANDLE;
+			uint32_t queryCount;
+			uint32_t valuesPerQuery;
+			bool copyToBuffer;
+			vks::Buffer resultBuffer;
+			QueryCallback callback;
+			std::vector<uint64_t> results;
+		};
+		struct FrameSlot
+		{
+			bool pending = false;
+			uint64_t frameNumber = 0;
+		};
+		vks::VulkanDevice *device = nullptr;
+		std::vector<QuerySet> querySets;
+		std::vector<FrameSlot> frameSlots;
+		uint64_t frameNumber = 0;
+		std::vector<uint64_t> scratch;
+
+		// Stride in bytes of one query result including the trailing availability value
+		VkDeviceSize resultStride(const QuerySet &querySet) const
+		{
+			return (querySet.valuesPerQuery + 1) * sizeof(uint64_t);
+		}
+
+		VkDeviceSize slotSize(const QuerySet &querySet) const
+		{
+			return querySet.queryCount * resultStride(querySet);
+		}
+
+		// Fetches the results of the given set for a frame slot without waiting, returns true if all queries were available
+		bool fetchResults(QuerySet &querySet, uint32_t frameIndex)
+		{
+			const uint32_t stride = querySet.valuesPerQuery + 1;
+			const uint64_t *data;
+			if (querySet.copyToBuffer) {
+				if (!(querySet.resultBuffer.memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+					querySet.resultBuffer.invalidate();
+				}
+				data = reinterpret_cast<const uint64_t*>(static_cast<const uint8_t*>(querySet.resultBuffer.mapped) + frameIndex * slotSize(querySet));
+			} else {
+				scratch.resize(querySet.queryCount * stride);
+				VkResult result = vkGetQueryPoolResults(device->logicalDevice, querySet.pool, frameIndex * querySet.queryCount, querySet.queryCount, scratch.size() * sizeof(uint64_t), scratch.data(), resultStride(querySet), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+				if (result == VK_NOT_READY) {
+					return false;
+				}
+				VK_CHECK_RESULT(result);
+				data = scratch.data();
+			}
+			for (uint32_t i = 0; i < querySet.queryCount; i++) {
+				if (data[i * stride + querySet.valuesPerQuery] == 0) {
+					return false;
+				}
+			}
+			for (uint32_t i = 0; i < querySet.queryCount; i++) {
+				for (uint32_t j = 0; j < querySet.valuesPerQuery; j++) {
+					querySet.results[i * querySet.valuesPerQuery + j] = data[i * stride + j];
+				}
+			}
+			return true;
+		}
+
+	public:
+		/** @brief Number of frames whose results were discarded because their slot was reused before they became available */
+		uint64_t droppedFrames = 0;
+
+		/**
+		* Prepare the query manager
+		*
+		* @param device Pointer to a valid VulkanDevice
+		* @param frameCount Number of frame slots in the ring (usually the number of command buffers)
+		*/
+		void prepare(vks::VulkanDevice *device, uint32_t frameCount)
+		{
+			assert(device);
+			assert(frameCount > 0);
+			this->device = device;
+			frameSlots.resize(frameCount);
+		}
+
+		/**
+		* Add a set of queries of the same type
+		*
+		* @param type Type of the queries (occlusion, timestamp or pipeline statistics)
+		* @param queryCount Number of queries in the set per frame
+		* @param callback Function called with the results of a frame once they have become available
+		* @param pipelineStatistics (Optional) Counters to collect for pipeline statistics queries
+		* @param copyToBuffer (Optional) Copy results on the GPU with vkCmdCopyQueryPoolResults into a host visible buffer instead of reading them from the pool
+		*
+		* @return Index of the new query set
+		*/
+		uint32_t addQuerySet(VkQueryType type, uint32_t queryCount, QueryCallback callback, VkQueryPipelineStatisticFlags pipelineStatistics = 0, bool copyToBuffer = false)
+		{
+			assert(device);
+			QuerySet querySet{};
+			querySet.type = type;
+			querySet.queryCount = queryCount;
+			querySet.callback = callback;
+			querySet.copyToBuffer = copyToBuffer;
+			querySet.valuesPerQuery = 1;
+			if (type == VK_QUERY_TYPE_PIPELINE_STATISTICS) {
+				assert(pipelineStatistics != 0);
+				querySet.valuesPerQuery = 0;
+				for (VkQueryPipelineStatisticFlags bits = pipelineStatistics; bits != 0; bits &= bits - 1) {
+					querySet.valuesPerQuery++;
+				}
+			}
+			querySet.results.resize(queryCount * querySet.valuesPerQuery);
+
+			VkQueryPoolCreateInfo queryPoolInfo = {};
+			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolInfo.queryType = type;
+			queryPoolInfo.queryCount = queryCount * static_cast<uint32_t>(frameSlots.size());
+			queryPoolInfo.pipelineStatistics = pipelineStatistics;
+			VK_CHECK_RESULT(vkCreateQueryPool(device->logicalDevice, &queryPoolInfo, nullptr, &querySet.pool));
+
+			if (copyToBuffer) {
+				VK_CHECK_RESULT(device->createBuffer(
+					VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+					&querySet.resultBuffer,
+					slotSize(querySet) * frameSlots.size()));
+				VK_CHECK_RESULT(querySet.resultBuffer.map());
+				memset(querySet.resultBuffer.mapped, 0, querySet.resultBuffer.size);
+			}
+
+			querySets.push_back(querySet);
+			return static_cast<uint32_t>(querySets.size() - 1);
+		}
+
+		/** @brief Returns the query pool of a set, e.g. for use with conditional rendering */
+		VkQueryPool getQueryPool(uint32_t querySet) const
+		{
+			return querySets[querySet].pool;
+		}
+
+		/** @brief Returns the index of a query of a set inside its pool for the given frame slot */
+		uint32_t getQueryIndex(uint32_t querySet, uint32_t frameIndex, uint32_t query) const
+		{
+			return frameIndex * querySets[querySet].queryCount + query;
+		}
+
+		/** @brief Reset the queries of all sets for a frame slot (must be recorded outside of a render pass) */
+		void cmdReset(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+		{
+			for (auto &querySet : querySets) {
+				vkCmdResetQueryPool(commandBuffer, querySet.pool, frameIndex * querySet.queryCount, querySet.queryCount);
+			}
+		}
+
+		void cmdBeginQuery(VkCommandBuffer commandBuffer, uint32_t querySet, uint32_t frameIndex, uint32_t query, VkQueryControlFlags flags = 0)
+		{
+			vkCmdBeginQuery(commandBuffer, querySets[querySet].pool, getQueryIndex(querySet, frameIndex, query), flags);
+		}
+
+		void cmdEndQuery(VkCommandBuffer commandBuffer, uint32_t querySet, uint32_t frameIndex, uint32_t query)
+		{
+			vkCmdEndQuery(commandBuffer, querySets[querySet].pool, getQueryIndex(querySet, frameIndex, query));
+		}
+
+		void cmdWriteTimestamp(VkCommandBuffer commandBuffer, uint32_t querySet, uint32_t frameIndex, uint32_t query, VkPipelineStageFlagBits pipelineStage)
+		{
+			assert(querySets[querySet].type == VK_QUERY_TYPE_TIMESTAMP);
+			vkCmdWriteTimestamp(commandBuffer, pipelineStage, querySets[querySet].pool, getQueryIndex(querySet, frameIndex, query));
+		}
+
+		/**
+		* Copy the results of all sets created with copyToBuffer for a frame slot into their host visible buffers
+		*
+		* @note Must be recorded outside of a render pass after all queries of the frame have ended
+		*/
+		void cmdCopyResults(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+		{
+			bool copied = false;
+			for (auto &querySet : querySets) {
+				if (!querySet.copyToBuffer) {
+					continue;
+				}
+				// The wait bit only makes the GPU wait for the queries, the host never blocks on them
+				vkCmdCopyQueryPoolResults(commandBuffer, querySet.pool, frameIndex * querySet.queryCount, querySet.queryCount, querySet.resultBuffer.buffer, frameIndex * slotSize(querySet), resultStride(querySet), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+				copied = true;
+			}
+			if (copied) {
+				VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+				memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			}
+		}
+
+		/**
+		* Deliver all results that have become available and mark the given frame slot as in flight
+		*
+		* @param frameIndex Index of the frame slot whose command buffer is about to be submitted
+		*
+		* @note Must be called before the command buffer of the frame slot is submitted
+		*/
+		void update(uint32_t frameIndex)
+		{
+			assert(frameIndex < frameSlots.size());
+			// Collect all slots that have finished since the last call
+			for (uint32_t i = 0; i < frameSlots.size(); i++) {
+				FrameSlot &slot = frameSlots[i];
+				if (!slot.pending) {
+					continue;
+				}
+				bool available = true;
+				for (auto &querySet : querySets) {
+					available &= fetchResults(querySet, i);
+				}
+				if (available) {
+					for (auto &querySet : querySets) {
+						if (querySet.callback) {
+							querySet.callback(querySet.results, i, static_cast<uint32_t>(frameNumber - slot.frameNumber));
+						}
+					}
+					slot.pending = false;
+				}
+			}
+			// The slot is about to be reused, results that didn't make it in time are lost
+			FrameSlot &slot = frameSlots[frameIndex];
+			if (slot.pending) {
+				droppedFrames++;
+			}
+			// Clear the copy target so stale availability values from the last use of this slot aren't picked up
+			for (auto &querySet : querySets) {
+				if (querySet.copyToBuffer) {
+					memset(static_cast<uint8_t*>(querySet.resultBuffer.mapped) + frameIndex * slotSize(querySet), 0, slotSize(querySet));
+				}
+			}
+			slot.pending = true;
+			slot.frameNumber = frameNumber;
+			frameNumber++;
+		}
+
+		/** @brief Release all Vulkan resources of the query manager */
+		void destroy()
+		{
+			for (auto &querySet : querySets) {
+				vkDestroyQueryPool(device->logicalDevice, querySet.pool, nullptr);
+				if (querySet.copyToBuffer) {
+					querySet.resultBuffer.destroy();
+				}
+			}
+			querySets.clear();
+			frameSlots.clear();
+		}
+	};
+}
@@ -15,9 +15,6 @@
 
 class VulkanRaytracingSample : public VulkanExampleBase
 {
-protected:
-	// Update the default render pass with different color attachment load ops
-	virtual void updateRenderPass();
 public:
 	// Function pointers for ray tracing related stuff
 	PFN_vkGetBufferDeviceAddressKHR vkGetBufferDeviceAddressKHR;
@@ -83,8 +80,5 @@ public:
 	void deleteStorageImage();
 	VkStridedDeviceAddressRegionKHR getSbtEntryStridedDeviceAddressRegion(VkBuffer buffer, uint32_t handleCount);
 	void createShaderBindingTable(ShaderBindingTable& shaderBindingTable, uint32_t handleCount);
-	// Draw the ImGUI UI overlay using a render pass
-	void drawUI(VkCommandBuffer commandBuffer, VkFramebuffer framebuffer);
-
 	virtual void prepare();
 };
@@ -364,6 +364,7 @@ void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool
 	}
 
 	VK_CHECK_RESULT(fpCreateSwapchainKHR(device, &swapchainCI, nullptr, &swapChain));
+	imageUsage = swapchainCI.imageUsage;
 
 	// If an existing swap chain is re-created, destroy the old swap chain
 	// This also cleans up all the presentable images
@@ -52,6 +52,7 @@ private:
 public:
 	VkFormat colorFormat;
 	VkColorSpaceKHR colorSpace;
+	VkImageUsageFlags imageUsage = 0;
 	VkSwapchainKHR swapChain = VK_NULL_HANDLE;	
 	uint32_t imageCount;
 	std::vector<VkImage> images;
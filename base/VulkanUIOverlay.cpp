@@ -214,11 +214,107 @@ namespace vks
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &fontDescriptor)
 		};
 		vkUpdateDescriptorSets(device->logicalDevice, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		commandPool = device->createCommandPool(device->queueFamilyIndices.graphics);
+	}
+
+	/** (Re)create the frame buffers for the swap chain images, per image resources are created if the number of images changed */
+	void UIOverlay::prepareFrames(const std::vector<VkImageView> &views, uint32_t width, uint32_t height)
+	{
+		this->width = width;
+		this->height = height;
+		for (size_t i = views.size(); i < frames.size(); i++) {
+			destroyFrame(frames[i]);
+		}
+		const size_t prevCount = frames.size();
+		frames.resize(views.size());
+		for (size_t i = 0; i < frames.size(); i++) {
+			Frame& frame = frames[i];
+			if (i >= prevCount) {
+				VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+				VK_CHECK_RESULT(vkAllocateCommandBuffers(device->logicalDevice, &cmdBufAllocateInfo, &frame.commandBuffer));
+				VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+				VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceCreateInfo, nullptr, &frame.fence));
+				VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+				VK_CHECK_RESULT(vkCreateSemaphore(device->logicalDevice, &semaphoreCreateInfo, nullptr, &frame.semaphore));
+			}
+			else {
+				// The old frame buffer may still be used by the frame's last submission
+				VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &frame.fence, VK_TRUE, UINT64_MAX));
+				vkDestroyFramebuffer(device->logicalDevice, frame.frameBuffer, nullptr);
+			}
+			VkFramebufferCreateInfo frameBufferCreateInfo = vks::initializers::framebufferCreateInfo();
+			frameBufferCreateInfo.renderPass = renderPass;
+			frameBufferCreateInfo.attachmentCount = 1;
+			frameBufferCreateInfo.pAttachments = &views[i];
+			frameBufferCreateInfo.width = width;
+			frameBufferCreateInfo.height = height;
+			frameBufferCreateInfo.layers = 1;
+			VK_CHECK_RESULT(vkCreateFramebuffer(device->logicalDevice, &frameBufferCreateInfo, nullptr, &frame.frameBuffer));
+		}
+	}
+
+	void UIOverlay::destroyFrame(Frame &frame)
+	{
+		VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &frame.fence, VK_TRUE, UINT64_MAX));
+		frame.vertexBuffer.destroy();
+		frame.indexBuffer.destroy();
+		vkDestroyFramebuffer(device->logicalDevice, frame.frameBuffer, nullptr);
+		vkFreeCommandBuffers(device->logicalDevice, commandPool, 1, &frame.commandBuffer);
+		vkDestroyFence(device->logicalDevice, frame.fence, nullptr);
+		vkDestroySemaphore(device->logicalDevice, frame.semaphore, nullptr);
 	}
 
 	/** Prepare a separate pipeline for the UI overlay rendering decoupled from the main application */
-	void UIOverlay::preparePipeline(const VkPipelineCache pipelineCache, const VkRenderPass renderPass, const VkFormat colorFormat, const VkFormat depthFormat)
+	void UIOverlay::preparePipeline(const VkPipelineCache pipelineCache, const VkFormat colorFormat)
 	{
+		// Render pass drawing on top of the presented swap chain image, which is handed on to presentation afterwards
+		// Swap chain images are always single sampled, multisampled examples have resolved into them before the overlay is drawn
+		VkAttachmentDescription attachment = {};
+		attachment.format = colorFormat;
+		attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.initialLayout = initialLayout;
+		attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+		VkSubpassDescription subpassDescription = {};
+		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescription.colorAttachmentCount = 1;
+		subpassDescription.pColorAttachments = &colorReference;
+
+		// The example's rendering to the image has been made available by the semaphore the submission waits on
+		std::array<VkSubpassDependency, 2> dependencies;
+
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask = 0;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = 0;
+
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = 0;
+		dependencies[1].dependencyFlags = 0;
+
+		VkRenderPassCreateInfo renderPassInfo = vks::initializers::renderPassCreateInfo();
+		renderPassInfo.attachmentCount = 1;
+		renderPassInfo.pAttachments = &attachment;
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpassDescription;
+		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassInfo.pDependencies = dependencies.data();
+		VK_CHECK_RESULT(vkCreateRenderPass(device->logicalDevice, &renderPassInfo, nullptr, &renderPass));
+
 		// Pipeline layout
 		// Push constants for UI rendering parameters
 		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(PushConstBlock), 0);
@@ -255,7 +351,7 @@ namespace vks
 			vks::initializers::pipelineViewportStateCreateInfo(1, 1, 0);
 
 		VkPipelineMultisampleStateCreateInfo multisampleState =
-			vks::initializers::pipelineMultisampleStateCreateInfo(rasterizationSamples);
+			vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT);
 
 		std::vector<VkDynamicState> dynamicStateEnables = {
 			VK_DYNAMIC_STATE_VIEWPORT,
@@ -275,20 +371,6 @@ namespace vks
 		pipelineCreateInfo.pDynamicState = &dynamicState;
 		pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaders.size());
 		pipelineCreateInfo.pStages = shaders.data();
-		pipelineCreateInfo.subpass = subpass;
-		
-#if defined(VK_KHR_dynamic_rendering)
-		// SRS - if we are using dynamic rendering (i.e. renderPass null), must define color, depth and stencil attachments at pipeline create time
-		VkPipelineRenderingCreateInfo pipelineRenderingCreateInfo = {};
-		if (renderPass == VK_NULL_HANDLE) {
-			pipelineRenderingCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
-			pipelineRenderingCreateInfo.colorAttachmentCount = 1;
-			pipelineRenderingCreateInfo.pColorAttachmentFormats = &colorFormat;
-			pipelineRenderingCreateInfo.depthAttachmentFormat = depthFormat;
-			pipelineRenderingCreateInfo.stencilAttachmentFormat = depthFormat;
-			pipelineCreateInfo.pNext = &pipelineRenderingCreateInfo;
-		}
-#endif
 
 		// Vertex bindings an attributes based on ImGui vertex definition
 		std::vector<VkVertexInputBindingDescription> vertexInputBindings = {
@@ -310,47 +392,35 @@ namespace vks
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device->logicalDevice, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline));
 	}
 
-	/** Update vertex and index buffer containing the imGui elements when required */
-	bool UIOverlay::update()
+	/** Write the current ImGui frame to the geometry buffers of the given frame, the buffers are grown if the frame doesn't fit */
+	void UIOverlay::update(uint32_t frameIndex)
 	{
+		VKS_PROFILE_FUNCTION();
 		ImDrawData* imDrawData = ImGui::GetDrawData();
-		bool updateCmdBuffers = false;
 
-		if (!imDrawData) { return false; };
-
-		// Note: Alignment is done inside buffer creation
-		VkDeviceSize vertexBufferSize = imDrawData->TotalVtxCount * sizeof(ImDrawVert);
-		VkDeviceSize indexBufferSize = imDrawData->TotalIdxCount * sizeof(ImDrawIdx);
-
-		// Update buffers only if vertex or index count has been changed compared to current buffer size
-		if ((vertexBufferSize == 0) || (indexBufferSize == 0)) {
-			return false;
+		if ((!imDrawData) || (imDrawData->TotalVtxCount == 0) || (imDrawData->TotalIdxCount == 0)) {
+			return;
 		}
 
-		// Vertex buffer
-		if ((vertexBuffer.buffer == VK_NULL_HANDLE) || (vertexCount != imDrawData->TotalVtxCount)) {
-			vertexBuffer.unmap();
-			vertexBuffer.destroy();
-			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &vertexBuffer, vertexBufferSize));
-			vertexCount = imDrawData->TotalVtxCount;
-			vertexBuffer.unmap();
-			vertexBuffer.map();
-			updateCmdBuffers = true;
-		}
+		Frame& frame = frames[frameIndex];
 
-		// Index buffer
-		if ((indexBuffer.buffer == VK_NULL_HANDLE) || (indexCount < imDrawData->TotalIdxCount)) {
-			indexBuffer.unmap();
-			indexBuffer.destroy();
-			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &indexBuffer, indexBufferSize));
-			indexCount = imDrawData->TotalIdxCount;
-			indexBuffer.map();
-			updateCmdBuffers = true;
+		// Buffers grow with headroom so that a growing UI doesn't cause repeated reallocations, the frame's last submission has finished so they can be replaced right away
+		if (frame.vertexCount < imDrawData->TotalVtxCount) {
+			frame.vertexBuffer.destroy();
+			frame.vertexCount = imDrawData->TotalVtxCount + imDrawData->TotalVtxCount / 2;
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &frame.vertexBuffer, frame.vertexCount * sizeof(ImDrawVert)));
+			VK_CHECK_RESULT(frame.vertexBuffer.map());
+		}
+		if (frame.indexCount < imDrawData->TotalIdxCount) {
+			frame.indexBuffer.destroy();
+			frame.indexCount = imDrawData->TotalIdxCount + imDrawData->TotalIdxCount / 2;
+			VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &frame.indexBuffer, frame.indexCount * sizeof(ImDrawIdx)));
+			VK_CHECK_RESULT(frame.indexBuffer.map());
 		}
 
 		// Upload data
-		ImDrawVert* vtxDst = (ImDrawVert*)vertexBuffer.mapped;
-		ImDrawIdx* idxDst = (ImDrawIdx*)indexBuffer.mapped;
+		ImDrawVert* vtxDst = (ImDrawVert*)frame.vertexBuffer.mapped;
+		ImDrawIdx* idxDst = (ImDrawIdx*)frame.indexBuffer.mapped;
 
 		for (int n = 0; n < imDrawData->CmdListsCount; n++) {
 			const ImDrawList* cmd_list = imDrawData->CmdLists[n];
@@ -359,25 +429,21 @@ namespace vks
 			vtxDst += cmd_list->VtxBuffer.Size;
 			idxDst += cmd_list->IdxBuffer.Size;
 		}
-
-		// Flush to make writes visible to GPU
-		vertexBuffer.flush();
-		indexBuffer.flush();
-
-		return updateCmdBuffers;
 	}
 
-	void UIOverlay::draw(const VkCommandBuffer commandBuffer)
+	/** Record the draws of the current ImGui frame using the geometry buffers of the given frame */
+	void UIOverlay::draw(const VkCommandBuffer commandBuffer, uint32_t frameIndex)
 	{
 		ImDrawData* imDrawData = ImGui::GetDrawData();
 		int32_t vertexOffset = 0;
 		int32_t indexOffset = 0;
 
-		if ((!imDrawData) || (imDrawData->CmdListsCount == 0)) {
+		if ((!imDrawData) || (imDrawData->CmdListsCount == 0) || (imDrawData->TotalIdxCount == 0)) {
 			return;
 		}
 
 		ImGuiIO& io = ImGui::GetIO();
+		const Frame& frame = frames[frameIndex];
 
 		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
@@ -387,8 +453,8 @@ namespace vks
 		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
 
 		VkDeviceSize offsets[1] = { 0 };
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &frame.vertexBuffer.buffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, frame.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
 
 		for (int32_t i = 0; i < imDrawData->CmdListsCount; i++)
 		{
@@ -409,6 +475,58 @@ namespace vks
 		}
 	}
 
+	/**
+	* Record and submit the overlay for the given frame
+	*
+	* @param frameIndex Index of the swap chain image the overlay is drawn to
+	* @param waitSemaphore Semaphore signalled once the example's rendering to the image has finished
+	*
+	* @return Semaphore presentation has to wait on, the passed semaphore if the overlay is hidden
+	*/
+	VkSemaphore UIOverlay::submit(uint32_t frameIndex, VkSemaphore waitSemaphore)
+	{
+		VKS_PROFILE_FUNCTION();
+		if (!visible || (frameIndex >= frames.size())) {
+			return waitSemaphore;
+		}
+
+		Frame& frame = frames[frameIndex];
+		VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &frame.fence, VK_TRUE, UINT64_MAX));
+		VK_CHECK_RESULT(vkResetFences(device->logicalDevice, 1, &frame.fence));
+
+		update(frameIndex);
+
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(frame.commandBuffer, &cmdBufInfo));
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.framebuffer = frame.frameBuffer;
+		renderPassBeginInfo.renderArea.extent.width = width;
+		renderPassBeginInfo.renderArea.extent.height = height;
+		vkCmdBeginRenderPass(frame.commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(frame.commandBuffer, 0, 1, &viewport);
+		draw(frame.commandBuffer, frameIndex);
+		vkCmdEndRenderPass(frame.commandBuffer);
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(frame.commandBuffer));
+
+		const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.waitSemaphoreCount = (waitSemaphore != VK_NULL_HANDLE) ? 1 : 0;
+		submitInfo.pWaitSemaphores = &waitSemaphore;
+		submitInfo.pWaitDstStageMask = &waitStage;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &frame.commandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &frame.semaphore;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, frame.fence));
+
+		return frame.semaphore;
+	}
+
 	void UIOverlay::resize(uint32_t width, uint32_t height)
 	{
 		ImGuiIO& io = ImGui::GetIO();
@@ -417,8 +535,12 @@ namespace vks
 
 	void UIOverlay::freeResources()
 	{
-		vertexBuffer.destroy();
-		indexBuffer.destroy();
+		for (auto& frame : frames) {
+			destroyFrame(frame);
+		}
+		frames.clear();
+		vkDestroyCommandPool(device->logicalDevice, commandPool, nullptr);
+		vkDestroyRenderPass(device->logicalDevice, renderPass, nullptr);
 		vkDestroyImageView(device->logicalDevice, fontView, nullptr);
 		vkDestroyImage(device->logicalDevice, fontImage, nullptr);
 		vkFreeMemory(device->logicalDevice, fontMemory, nullptr);
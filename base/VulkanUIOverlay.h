@@ -13,12 +13,14 @@
 #include <string.h>
 #include <assert.h>
 #include <vector>
+#include <array>
 #include <sstream>
 #include <iomanip>
 
 #include <vulkan/vulkan.h>
 #include "VulkanTools.h"
 #include "VulkanDebug.h"
+#include "cpuprofiler.hpp"
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
 
@@ -36,13 +38,29 @@ namespace vks
 		vks::VulkanDevice *device;
 		VkQueue queue;
 
-		VkSampleCountFlagBits rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-		uint32_t subpass = 0;
-
-		vks::Buffer vertexBuffer;
-		vks::Buffer indexBuffer;
-		int32_t vertexCount = 0;
-		int32_t indexCount = 0;
+		// Layout the example leaves the swap chain images in, needs to be set before preparePipeline if it's not the present layout
+		VkImageLayout initialLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+		// The overlay is drawn in its own render pass on top of the swap chain image after the example's command buffer has been executed
+		// Each swap chain image has its own command buffer and geometry buffers, which are recorded and written every frame,
+		// so the examples' command buffers don't depend on the UI and never have to be rebuilt because of it
+		struct Frame {
+			vks::Buffer vertexBuffer;
+			vks::Buffer indexBuffer;
+			// Capacity of the buffers, they only grow (with headroom) and are never shrunk
+			int32_t vertexCount = 0;
+			int32_t indexCount = 0;
+			VkFramebuffer frameBuffer = VK_NULL_HANDLE;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			// Signalled once the frame's last submission has finished, so its command buffer and geometry buffers can be reused
+			VkFence fence = VK_NULL_HANDLE;
+			// Signalled once the overlay has been drawn, presentation has to wait on this
+			VkSemaphore semaphore = VK_NULL_HANDLE;
+		};
+		std::vector<Frame> frames;
+
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
 
 		std::vector<VkPipelineShaderStageCreateInfo> shaders;
 
@@ -69,11 +87,13 @@ namespace vks
 		UIOverlay();
 		~UIOverlay();
 
-		void preparePipeline(const VkPipelineCache pipelineCache, const VkRenderPass renderPass, const VkFormat colorFormat, const VkFormat depthFormat);
+		void preparePipeline(const VkPipelineCache pipelineCache, const VkFormat colorFormat);
 		void prepareResources();
+		void prepareFrames(const std::vector<VkImageView> &views, uint32_t width, uint32_t height);
 
-		bool update();
-		void draw(const VkCommandBuffer commandBuffer);
+		void update(uint32_t frameIndex);
+		void draw(const VkCommandBuffer commandBuffer, uint32_t frameIndex);
+		VkSemaphore submit(uint32_t frameIndex, VkSemaphore waitSemaphore);
 		void resize(uint32_t width, uint32_t height);
 
 		void freeResources();
@@ -89,5 +109,11 @@ namespace vks
 		bool button(const char* caption);
 		bool colorPicker(const char* caption, float* color);
 		void text(const char* formatstr, ...);
+
+	private:
+		uint32_t width = 0;
+		uint32_t height = 0;
+
+		void destroyFrame(Frame &frame);
 	};
 }
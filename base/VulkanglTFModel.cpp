@@ -12,6 +12,7 @@
 #define TINYGLTF_NO_STB_IMAGE_WRITE
 
 #include "VulkanglTFModel.h"
+#include "cpuprofiler.hpp"
 
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutImage = VK_NULL_HANDLE;
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutUbo = VK_NULL_HANDLE;
@@ -1486,6 +1487,7 @@ void vkglTF::Model::getSceneDimensions()
 
 void vkglTF::Model::updateAnimation(uint32_t index, float time)
 {
+	VKS_PROFILE_FUNCTION();
 	if (index > static_cast<uint32_t>(animations.size()) - 1) {
 		std::cout << "No animation with index " << index << std::endl;
 		return;
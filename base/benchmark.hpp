@@ -13,6 +13,11 @@
 #include <functional>
 #include <chrono>
 #include <iomanip>
+#include <numeric>
+#include <cmath>
+#include <sstream>
+
+#include "json.hpp"
 
 namespace vks
 {
@@ -20,6 +25,191 @@ namespace vks
 	private:
 		FILE *stream;
 		VkPhysicalDeviceProperties deviceProps;
+		// Set once the warmup phase is done, GPU times are only accumulated after that
+		bool measuring = false;
+		// Time the current frame spent waiting for the GPU
+		double frameWaitTime = 0.0;
+
+		struct Statistics {
+			double min = 0.0;
+			double max = 0.0;
+			double avg = 0.0;
+			double stdDev = 0.0;
+			double p50 = 0.0;
+			double p90 = 0.0;
+			double p99 = 0.0;
+			double p999 = 0.0;
+			uint32_t stutterFrames = 0;
+			std::vector<uint32_t> histogram;
+			// Number of values beyond the last histogram bin
+			uint32_t histogramOverflow = 0;
+		};
+
+		// Percentile using the nearest rank method on sorted values
+		static double percentile(const std::vector<double> &sorted, double p) {
+			size_t rank = (size_t)std::ceil(p * (double)sorted.size());
+			return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+		}
+
+		Statistics getStatistics(const std::vector<double> &values) {
+			Statistics stats;
+			if (values.empty()) {
+				return stats;
+			}
+			std::vector<double> sorted(values);
+			std::sort(sorted.begin(), sorted.end());
+			stats.min = sorted.front();
+			stats.max = sorted.back();
+			stats.avg = std::accumulate(sorted.begin(), sorted.end(), 0.0) / (double)sorted.size();
+			double variance = 0.0;
+			for (auto value : sorted) {
+				variance += (value - stats.avg) * (value - stats.avg);
+			}
+			stats.stdDev = std::sqrt(variance / (double)sorted.size());
+			stats.p50 = percentile(sorted, 0.5);
+			stats.p90 = percentile(sorted, 0.9);
+			stats.p99 = percentile(sorted, 0.99);
+			stats.p999 = percentile(sorted, 0.999);
+			// A stutter is a frame that takes considerably longer than the median frame
+			for (auto value : values) {
+				if (value > stats.p50 * stutterFactor) {
+					stats.stutterFrames++;
+				}
+			}
+			// The number of bins is limited, so a single long hitch doesn't blow up the histogram
+			const size_t binCount = std::min((size_t)(stats.max / histogramBinWidth) + 1, (size_t)histogramMaxBins);
+			stats.histogram.resize(binCount, 0);
+			for (auto value : values) {
+				const size_t bin = (size_t)(value / histogramBinWidth);
+				if (bin < binCount) {
+					stats.histogram[bin]++;
+				} else {
+					stats.histogramOverflow++;
+				}
+			}
+			return stats;
+		}
+
+		void printStatistics(const std::string &name, const std::vector<double> &values) {
+			if (values.empty()) {
+				return;
+			}
+			Statistics stats = getStatistics(values);
+			std::cout << name << ": avg " << stats.avg << " ms, std dev " << stats.stdDev << " ms, min " << stats.min << " ms, max " << stats.max << " ms" << "\n";
+			std::cout << "         p50 " << stats.p50 << " ms, p90 " << stats.p90 << " ms, p99 " << stats.p99 << " ms, p99.9 " << stats.p999 << " ms, stutters " << stats.stutterFrames << "\n";
+		}
+
+		void writeJsonStatistics(std::ofstream &result, const std::string &name, const std::vector<double> &values, bool last) {
+			result << "\t\t" << vks::json::quoted(name) << ": ";
+			if (values.empty()) {
+				result << "null" << (last ? "" : ",") << "\n";
+				return;
+			}
+			Statistics stats = getStatistics(values);
+			result << "{\n";
+			result << "\t\t\t\"samples\": " << values.size() << ",\n";
+			result << "\t\t\t\"min\": " << stats.min << ",\n";
+			result << "\t\t\t\"max\": " << stats.max << ",\n";
+			result << "\t\t\t\"avg\": " << stats.avg << ",\n";
+			result << "\t\t\t\"stdDev\": " << stats.stdDev << ",\n";
+			result << "\t\t\t\"p50\": " << stats.p50 << ",\n";
+			result << "\t\t\t\"p90\": " << stats.p90 << ",\n";
+			result << "\t\t\t\"p99\": " << stats.p99 << ",\n";
+			result << "\t\t\t\"p99.9\": " << stats.p999 << ",\n";
+			result << "\t\t\t\"stutterFrames\": " << stats.stutterFrames << ",\n";
+			result << "\t\t\t\"histogram\": { \"binWidth\": " << histogramBinWidth << ", \"counts\": [";
+			for (size_t i = 0; i < stats.histogram.size(); i++) {
+				result << (i > 0 ? ", " : "") << stats.histogram[i];
+			}
+			result << "], \"overflow\": " << stats.histogramOverflow << " }\n";
+			result << "\t\t}" << (last ? "" : ",") << "\n";
+		}
+
+		void saveCsv() {
+			std::ofstream result(filename, std::ios::out);
+			if (result.is_open()) {
+				result << std::fixed << std::setprecision(4);
+
+				result << "device,driverversion,duration (ms),frames,fps";
+				for (auto &name : gpuPassNames) {
+					result << "," << name << " gpu (ms)";
+				}
+				result << "\n";
+				result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << frameCount / (runtime / 1000.0);
+				for (size_t i = 0; i < gpuPassNames.size(); i++) {
+					result << "," << getGpuPassAverage(i);
+				}
+				result << "\n";
+
+				if (outputFrameTimes) {
+					result << "\n" << "frame,ms,cpu ms" << "\n";
+					for (size_t i = 0; i < frameTimes.size(); i++) {
+						result << i << "," << frameTimes[i] << "," << cpuTimes[i] << "\n";
+					}
+				}
+
+				result.flush();
+			}
+		}
+
+		void saveJson() {
+			std::ofstream result(jsonFilename, std::ios::out);
+			if (result.is_open()) {
+				result << std::fixed << std::setprecision(4);
+
+				result << "{\n";
+				result << "\t\"device\": {\n";
+				result << "\t\t\"name\": " << vks::json::quoted(deviceProps.deviceName) << ",\n";
+				result << "\t\t\"vendorID\": " << deviceProps.vendorID << ",\n";
+				result << "\t\t\"deviceID\": " << deviceProps.deviceID << ",\n";
+				result << "\t\t\"deviceType\": " << vks::json::quoted(vks::tools::physicalDeviceTypeString(deviceProps.deviceType)) << ",\n";
+				result << "\t\t\"driverVersion\": " << deviceProps.driverVersion << ",\n";
+				result << "\t\t\"apiVersion\": \"" << (deviceProps.apiVersion >> 22) << "." << ((deviceProps.apiVersion >> 12) & 0x3ff) << "." << (deviceProps.apiVersion & 0xfff) << "\"\n";
+				result << "\t},\n";
+
+				result << "\t\"commandLine\": [";
+				for (size_t i = 0; i < commandLine.size(); i++) {
+					result << (i > 0 ? ", " : "") << vks::json::quoted(commandLine[i]);
+				}
+				result << "],\n";
+
+				result << "\t\"settings\": {\n";
+				result << "\t\t\"warmup\": " << warmup << ",\n";
+				result << "\t\t\"duration\": " << duration << ",\n";
+				result << "\t\t\"frameLimit\": " << outputFrames << ",\n";
+				result << "\t\t\"deterministic\": " << (deterministic ? "true" : "false") << ",\n";
+				result << "\t\t\"fixedFrameTime\": " << fixedFrameTime << ",\n";
+				result << "\t\t\"seed\": " << seed << ",\n";
+				result << "\t\t\"stutterFactor\": " << stutterFactor << "\n";
+				result << "\t},\n";
+
+				result << "\t\"results\": {\n";
+				result << "\t\t\"runtime\": " << runtime << ",\n";
+				result << "\t\t\"frames\": " << frameCount << ",\n";
+				result << "\t\t\"fps\": " << frameCount / (runtime / 1000.0) << ",\n";
+				writeJsonStatistics(result, "frameTime", frameTimes, false);
+				writeJsonStatistics(result, "cpuTime", cpuTimes, false);
+				writeJsonStatistics(result, "gpuTime", gpuTimes, false);
+				result << "\t\t\"gpuPasses\": {";
+				for (size_t i = 0; i < gpuPassNames.size(); i++) {
+					result << (i > 0 ? ", " : " ") << vks::json::quoted(gpuPassNames[i]) << ": " << getGpuPassAverage(i);
+				}
+				result << " }\n";
+				result << "\t}";
+
+				if (outputFrameTimes) {
+					result << ",\n\t\"frames\": [\n";
+					for (size_t i = 0; i < frameTimes.size(); i++) {
+						result << "\t\t{ \"ms\": " << frameTimes[i] << ", \"cpu\": " << cpuTimes[i] << " }" << ((i < frameTimes.size() - 1) ? "," : "") << "\n";
+					}
+					result << "\t]";
+				}
+				result << "\n}\n";
+
+				result.flush();
+			}
+		}
+
 	public:
 		bool active = false;
 		bool outputFrameTimes = false;
@@ -27,11 +217,71 @@ namespace vks
 		uint32_t warmup = 1;
 		uint32_t duration = 10;
 		std::vector<double> frameTimes;
+		// CPU time of each frame, excluding the time spent waiting for the GPU to finish
+		std::vector<double> cpuTimes;
+		// GPU time of each frame as reported by the GPU profiler (only available for examples using profiler scopes)
+		std::vector<double> gpuTimes;
 		std::string filename = "";
+		std::string jsonFilename = "";
+
+		// Deterministic mode: Animations advance by a fixed frame time, warmup and benchmark run a fixed number of frames
+		// and random number generators are seeded with a fixed seed, so results of two builds can be compared frame by frame
+		bool deterministic = false;
+		double fixedFrameTime = 1000.0 / 60.0;
+		uint32_t seed = 0;
+
+		// Frames taking longer than this factor times the median frame time are counted as stutters
+		double stutterFactor = 2.0;
+		// Width of the frame time histogram bins in ms
+		double histogramBinWidth = 0.5;
+		// Frame times beyond the last bin are only counted as overflow
+		uint32_t histogramMaxBins = 200;
+
+		// Command line the example was started with (written to the JSON results)
+		std::vector<std::string> commandLine;
 
 		double runtime = 0.0;
 		uint32_t frameCount = 0;
 
+		// Accumulated GPU times of the passes reported by the GPU profiler (written as additional columns to the results file)
+		std::vector<std::string> gpuPassNames;
+		std::vector<double> gpuPassTimes;
+		std::vector<uint32_t> gpuPassSamples;
+
+		void addGpuPassTime(const std::string &name, double ms) {
+			if (!measuring) {
+				return;
+			}
+			size_t index = std::find(gpuPassNames.begin(), gpuPassNames.end(), name) - gpuPassNames.begin();
+			if (index == gpuPassNames.size()) {
+				gpuPassNames.push_back(name);
+				gpuPassTimes.push_back(0.0);
+				gpuPassSamples.push_back(0);
+			}
+			gpuPassTimes[index] += ms;
+			gpuPassSamples[index]++;
+		}
+
+		void addGpuFrameTime(double ms) {
+			if (measuring) {
+				gpuTimes.push_back(ms);
+			}
+		}
+
+		// Time the CPU spent blocked on the GPU during the current frame, subtracted from the frame time to get the CPU time
+		void addWaitTime(double ms) {
+			frameWaitTime += ms;
+		}
+
+		// True while in the benchmark phase (after warmup)
+		bool isMeasuring() const {
+			return measuring;
+		}
+
+		double getGpuPassAverage(size_t index) {
+			return (gpuPassSamples[index] > 0) ? gpuPassTimes[index] / (double)gpuPassSamples[index] : 0.0;
+		}
+
 		void run(std::function<void()> renderFunc, VkPhysicalDeviceProperties deviceProps) {
 			active = true;
 			this->deviceProps = deviceProps;
@@ -42,63 +292,66 @@ namespace vks
 #endif
 			std::cout << std::fixed << std::setprecision(3);
 
+			// In deterministic mode the number of frames must not depend on how fast they are rendered
+			const uint32_t warmupFrames = static_cast<uint32_t>(warmup * 1000.0 / fixedFrameTime);
+			if (deterministic && outputFrames == -1) {
+				outputFrames = static_cast<int>(duration * 1000.0 / fixedFrameTime);
+			}
+
 			// Warm up phase to get more stable frame rates
 			{
 				double tMeasured = 0.0;
-				while (tMeasured < (warmup * 1000)) {
+				uint32_t frames = 0;
+				while (deterministic ? (frames < warmupFrames) : (tMeasured < (warmup * 1000))) {
 					auto tStart = std::chrono::high_resolution_clock::now();
 					renderFunc();
 					auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
 					tMeasured += tDiff;
+					frames++;
 				};
 			}
 
 			// Benchmark phase
 			{
-				while (runtime < (duration * 1000.0)) {
+				measuring = true;
+				while (deterministic || (runtime < (duration * 1000.0))) {
+					frameWaitTime = 0.0;
 					auto tStart = std::chrono::high_resolution_clock::now();
 					renderFunc();
 					auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
 					runtime += tDiff;
 					frameTimes.push_back(tDiff);
+					cpuTimes.push_back(std::max(tDiff - frameWaitTime, 0.0));
 					frameCount++;
-					if (outputFrames != -1 && outputFrames == frameCount) break;
+					// A frame limit of zero (e.g. a duration shorter than one fixed frame) still ends after the first frame
+					if (outputFrames != -1 && frameCount >= static_cast<uint32_t>(outputFrames)) break;
 				};
 				std::cout << "Benchmark finished" << "\n";
 				std::cout << "device : " << deviceProps.deviceName << " (driver version: " << deviceProps.driverVersion << ")" << "\n";
 				std::cout << "runtime: " << (runtime / 1000.0) << "\n";
 				std::cout << "frames : " << frameCount << "\n";
 				std::cout << "fps    : " << frameCount / (runtime / 1000.0) << "\n";
+				printStatistics("frame  ", frameTimes);
+				printStatistics("cpu    ", cpuTimes);
+				printStatistics("gpu    ", gpuTimes);
+				for (size_t i = 0; i < gpuPassNames.size(); i++) {
+					std::cout << "gpu    : " << gpuPassNames[i] << " " << getGpuPassAverage(i) << " ms" << "\n";
+				}
+				std::cout << "\n";
+				measuring = false;
 			}
 		}
 
 		void saveResults() {
-			std::ofstream result(filename, std::ios::out);
-			if (result.is_open()) {
-				result << std::fixed << std::setprecision(4);
-
-				result << "device,driverversion,duration (ms),frames,fps" << "\n";
-				result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << frameCount / (runtime / 1000.0) << "\n";
-
-				if (outputFrameTimes) {
-					result << "\n" << "frame,ms" << "\n";
-					for (size_t i = 0; i < frameTimes.size(); i++) {
-						result << i << "," << frameTimes[i] << "\n";
-					}
-					double tMin = *std::min_element(frameTimes.begin(), frameTimes.end());
-					double tMax = *std::max_element(frameTimes.begin(), frameTimes.end());
-					double tAvg = std::accumulate(frameTimes.begin(), frameTimes.end(), 0.0) / (double)frameTimes.size();
-					std::cout << "best   : " << (1000.0 / tMin) << " fps (" << tMin << " ms)" << "\n";
-					std::cout << "worst  : " << (1000.0 / tMax) << " fps (" << tMax << " ms)" << "\n";
-					std::cout << "avg    : " << (1000.0 / tAvg) << " fps (" << tAvg << " ms)" << "\n";
-					std::cout << "\n";
-				}
-
-				result.flush();
+			if (filename != "") {
+				saveCsv();
+			}
+			if (jsonFilename != "") {
+				saveJson();
+			}
 #if defined(_WIN32)
-				FreeConsole();
+			FreeConsole();
 #endif
-			}
 		}
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,159 @@
+/*
+* Camera path class
+*
+* Records camera keyframes to a file and replays them with smooth interpolation (e.g. for deterministic benchmarks)
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	class CameraPath
+	{
+	public:
+		struct Keyframe
+		{
+			// Time of the keyframe in seconds
+			float time;
+			glm::vec3 position;
+			// Euler angles in degrees, as used by the Camera class
+			glm::vec3 rotation;
+		};
+
+	private:
+		std::vector<Keyframe> keyframes;
+
+		static glm::vec3 catmullRom(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2, const glm::vec3 &p3, float t)
+		{
+			const float t2 = t * t;
+			const float t3 = t2 * t;
+			return 0.5f * ((2.0f * p1) + (-p0 + p2) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 + (-p0 + 3.0f * p1 - 3.0f * p2 + p3) * t3);
+		}
+
+	public:
+		/** @brief Minimum time in seconds between two recorded keyframes */
+		float recordInterval = 0.1f;
+
+		void clear()
+		{
+			keyframes.clear();
+		}
+
+		bool empty() const
+		{
+			return keyframes.empty();
+		}
+
+		/** @brief Duration of the path in seconds */
+		float duration() const
+		{
+			return keyframes.empty() ? 0.0f : keyframes.back().time;
+		}
+
+		const std::vector<Keyframe>& getKeyframes() const
+		{
+			return keyframes;
+		}
+
+		/**
+		* Record the camera pose at the given time, a keyframe is only added if at least recordInterval seconds have passed since the last one
+		*
+		* @param time Time since the start of the recording in seconds
+		* @param position Position of the camera
+		* @param rotation Rotation of the camera (Euler angles in degrees)
+		*/
+		void record(float time, const glm::vec3 &position, const glm::vec3 &rotation)
+		{
+			if (!keyframes.empty() && (time - keyframes.back().time < recordInterval)) {
+				return;
+			}
+			keyframes.push_back({ time, position, rotation });
+		}
+
+		/**
+		* Returns the interpolated camera pose at the given time
+		*
+		* @param time Time on the path in seconds
+		* @param loop (Optional) If true, times beyond the duration wrap around to the start, otherwise they are clamped to the last keyframe
+		*/
+		Keyframe evaluate(float time, bool loop = false) const
+		{
+			assert(!keyframes.empty());
+			if ((keyframes.size() == 1) || (duration() <= 0.0f)) {
+				return keyframes.front();
+			}
+			time = std::max(time, 0.0f);
+			time = loop ? fmod(time, duration()) : std::min(time, duration());
+			// Find the segment containing the given time
+			size_t index = std::upper_bound(keyframes.begin(), keyframes.end(), time, [](float t, const Keyframe &keyframe) { return t < keyframe.time; }) - keyframes.begin();
+			const size_t i1 = std::min(std::max(index, (size_t)1), keyframes.size() - 1) - 1;
+			const size_t i2 = i1 + 1;
+			const size_t i0 = (i1 > 0) ? i1 - 1 : i1;
+			const size_t i3 = std::min(i2 + 1, keyframes.size() - 1);
+			const float segment = keyframes[i2].time - keyframes[i1].time;
+			const float t = (segment > 0.0f) ? (time - keyframes[i1].time) / segment : 0.0f;
+			Keyframe keyframe;
+			keyframe.time = time;
+			keyframe.position = catmullRom(keyframes[i0].position, keyframes[i1].position, keyframes[i2].position, keyframes[i3].position, t);
+			keyframe.rotation = catmullRom(keyframes[i0].rotation, keyframes[i1].rotation, keyframes[i2].rotation, keyframes[i3].rotation, t);
+			return keyframe;
+		}
+
+		/** @brief Save the keyframes to a text file (one keyframe per line: time, position, rotation) */
+		bool saveToFile(const std::string &filename) const
+		{
+			std::ofstream file(filename, std::ios::out);
+			if (!file.is_open()) {
+				std::cerr << "Could not write camera path to " << filename << "\n";
+				return false;
+			}
+			file << std::fixed << std::setprecision(6);
+			file << "# time position.x position.y position.z rotation.x rotation.y rotation.z" << "\n";
+			for (auto &keyframe : keyframes) {
+				file << keyframe.time << " " << keyframe.position.x << " " << keyframe.position.y << " " << keyframe.position.z << " ";
+				file << keyframe.rotation.x << " " << keyframe.rotation.y << " " << keyframe.rotation.z << "\n";
+			}
+			return true;
+		}
+
+		/** @brief Load keyframes from a file written by saveToFile */
+		bool loadFromFile(const std::string &filename)
+		{
+			std::ifstream file(filename, std::ios::in);
+			if (!file.is_open()) {
+				std::cerr << "Could not open camera path " << filename << "\n";
+				return false;
+			}
+			keyframes.clear();
+			std::string line;
+			while (std::getline(file, line)) {
+				if (line.empty() || line[0] == '#') {
+					continue;
+				}
+				std::istringstream ss(line);
+				Keyframe keyframe;
+				if (ss >> keyframe.time >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z >> keyframe.rotation.x >> keyframe.rotation.y >> keyframe.rotation.z) {
+					keyframes.push_back(keyframe);
+				}
+			}
+			// Keyframes need to be ordered by time for evaluation
+			std::stable_sort(keyframes.begin(), keyframes.end(), [](const Keyframe &a, const Keyframe &b) { return a.time < b.time; });
+			return !keyframes.empty();
+		}
+	};
+}
@@ -0,0 +1,261 @@
+/*
+* Scoped CPU profiler with Chrome trace export
+*
+* Zones are recorded into per-thread ring buffers without locking and can be written as a Chrome/Perfetto trace (JSON)
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <iomanip>
+
+#include "json.hpp"
+
+/*
+	Instrumentation macros
+
+	Zone names must be string literals (or otherwise outlive the profiler), as only the pointer is stored
+	If VKS_CPU_PROFILER is not defined (see the USE_CPU_PROFILER CMake option), all macros expand to nothing
+*/
+#if defined(VKS_CPU_PROFILER)
+#define VKS_PROFILER_CONCAT_INNER(a, b) a##b
+#define VKS_PROFILER_CONCAT(a, b) VKS_PROFILER_CONCAT_INNER(a, b)
+#define VKS_PROFILE_ZONE(name) vks::CpuProfiler::Zone VKS_PROFILER_CONCAT(profilerZone, __LINE__)(name)
+#define VKS_PROFILE_FUNCTION() VKS_PROFILE_ZONE(__FUNCTION__)
+#define VKS_PROFILE_THREAD_NAME(name) vks::CpuProfiler::get().setThreadName(name)
+#define VKS_PROFILE_FRAME_END() vks::CpuProfiler::get().frameEnd()
+#else
+#define VKS_PROFILE_ZONE(name)
+#define VKS_PROFILE_FUNCTION()
+#define VKS_PROFILE_THREAD_NAME(name)
+#define VKS_PROFILE_FRAME_END()
+#endif
+
+namespace vks
+{
+	class CpuProfiler
+	{
+	public:
+		struct Event
+		{
+			const char* name;
+			// Start and end relative to the creation of the profiler in nanoseconds
+			int64_t start;
+			int64_t end;
+		};
+
+		/**
+		* @brief Ring buffer of the events recorded by a single thread
+		*
+		* Only the owning thread writes, and only while capturing. The owning thread flags itself as writing before it
+		* checks if the capture is still running, so once the capture has ended and the flag is cleared the events
+		* can be read from another thread (e.g. when writing the trace) without locking
+		*/
+		struct ThreadBuffer
+		{
+			uint32_t id;
+			std::string name;
+			std::vector<Event> events;
+			std::atomic<uint64_t> writePos{ 0 };
+			std::atomic<bool> writing{ false };
+		};
+
+	private:
+		std::chrono::high_resolution_clock::time_point epoch;
+		// Only taken when a thread records its first zone and when writing the trace
+		std::mutex threadsMutex;
+		std::vector<std::unique_ptr<ThreadBuffer>> threads;
+		std::atomic<bool> capturing{ false };
+		uint32_t captureFrames = 0;
+		uint32_t capturedFrames = 0;
+		std::string captureFilename;
+
+		CpuProfiler()
+		{
+			epoch = std::chrono::high_resolution_clock::now();
+		}
+
+		// Name of the calling thread, kept separately so naming a thread doesn't allocate its ring buffer
+		static std::string& threadName()
+		{
+			static thread_local std::string name;
+			return name;
+		}
+
+		static ThreadBuffer*& threadBuffer()
+		{
+			static thread_local ThreadBuffer* buffer = nullptr;
+			return buffer;
+		}
+
+		// The ring buffer of a thread is allocated when it records its first zone
+		ThreadBuffer* getThreadBuffer()
+		{
+			ThreadBuffer*& buffer = threadBuffer();
+			if (!buffer) {
+				std::lock_guard<std::mutex> lock(threadsMutex);
+				threads.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer()));
+				buffer = threads.back().get();
+				buffer->id = static_cast<uint32_t>(threads.size());
+				buffer->name = threadName().empty() ? "Thread " + std::to_string(buffer->id) : threadName();
+				buffer->events.resize(eventsPerThread);
+			}
+			return buffer;
+		}
+
+	public:
+		/** @brief Number of events each thread keeps, older events are overwritten once the ring buffer is full */
+		static const uint32_t eventsPerThread = 1 << 16;
+
+		class Zone
+		{
+		private:
+			const char* name;
+			int64_t start;
+			bool active;
+		public:
+			Zone(const char* name) : name(name), start(0)
+			{
+				CpuProfiler &profiler = CpuProfiler::get();
+				active = profiler.capturing.load(std::memory_order_relaxed);
+				if (active) {
+					start = profiler.now();
+				}
+			}
+			~Zone()
+			{
+				if (active) {
+					CpuProfiler::get().addEvent(name, start, CpuProfiler::get().now());
+				}
+			}
+		};
+
+		static CpuProfiler& get()
+		{
+			static CpuProfiler profiler;
+			return profiler;
+		}
+
+		int64_t now() const
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - epoch).count();
+		}
+
+		void addEvent(const char* name, int64_t start, int64_t end)
+		{
+			ThreadBuffer* buffer = getThreadBuffer();
+			// Zones started before the end of a capture may finish after it, their events are dropped (see writeTrace)
+			buffer->writing.store(true);
+			if (capturing.load()) {
+				const uint64_t pos = buffer->writePos.load(std::memory_order_relaxed);
+				Event &event = buffer->events[pos % eventsPerThread];
+				event.name = name;
+				event.start = start;
+				event.end = end;
+				buffer->writePos.store(pos + 1, std::memory_order_release);
+			}
+			buffer->writing.store(false, std::memory_order_release);
+		}
+
+		/** @brief Sets the name of the calling thread as displayed in the trace */
+		void setThreadName(const std::string &name)
+		{
+			threadName() = name;
+			if (threadBuffer()) {
+				std::lock_guard<std::mutex> lock(threadsMutex);
+				threadBuffer()->name = name;
+			}
+		}
+
+		/**
+		* Start capturing zones, the trace is written to the given file after the given number of frames
+		*
+		* @param filename Name of the JSON trace file
+		* @param frames Number of frames (calls to frameEnd) to capture
+		*/
+		void beginCapture(const std::string &filename, uint32_t frames)
+		{
+			captureFilename = filename;
+			captureFrames = frames;
+			capturedFrames = 0;
+			capturing.store(true);
+		}
+
+		bool isCapturing() const
+		{
+			return capturing.load(std::memory_order_relaxed);
+		}
+
+		/** @brief Marks the end of a frame, writes the trace once the requested number of frames has been captured */
+		void frameEnd()
+		{
+			if (!capturing.load(std::memory_order_relaxed)) {
+				return;
+			}
+			capturedFrames++;
+			if (capturedFrames >= captureFrames) {
+				endCapture();
+			}
+		}
+
+		/** @brief Stops capturing and writes all recorded zones to the trace file */
+		void endCapture()
+		{
+			if (!capturing.exchange(false)) {
+				return;
+			}
+			writeTrace(captureFilename);
+		}
+
+	private:
+		/**
+		* Writes all zones still held in the thread ring buffers as a Chrome trace event file (chrome://tracing, ui.perfetto.dev)
+		*
+		* Must only be called after capturing has been stopped. Threads that are still adding an event are waited for,
+		* any event they add afterwards sees the stopped capture and is dropped, so the ring buffers are no longer written
+		*/
+		void writeTrace(const std::string &filename)
+		{
+			std::ofstream file(filename, std::ios::out);
+			if (!file.is_open()) {
+				std::cerr << "Could not write CPU trace to " << filename << "\n";
+				return;
+			}
+			std::lock_guard<std::mutex> lock(threadsMutex);
+			for (auto &thread : threads) {
+				while (thread->writing.load(std::memory_order_acquire)) {
+					std::this_thread::yield();
+				}
+			}
+			file << std::fixed << std::setprecision(3);
+			file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+			bool first = true;
+			for (auto &thread : threads) {
+				file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->id << ",\"args\":{\"name\":" << vks::json::quoted(thread->name) << "}}";
+				first = false;
+				const uint64_t end = thread->writePos.load(std::memory_order_acquire);
+				const uint64_t begin = (end > eventsPerThread) ? end - eventsPerThread : 0;
+				for (uint64_t i = begin; i < end; i++) {
+					const Event &event = thread->events[i % eventsPerThread];
+					file << ",\n{\"name\":" << vks::json::quoted(event.name) << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread->id;
+					file << ",\"ts\":" << (double)event.start / 1000.0 << ",\"dur\":" << (double)(event.end - event.start) / 1000.0 << "}";
+				}
+			}
+			file << "\n]}\n";
+			std::cout << "CPU trace written to " << filename << "\n";
+		}
+	};
+}
@@ -0,0 +1,416 @@
+/*
+* Image encoders for saving captured frames (PPM, QOI and PNG)
+*
+* Self-contained so frames can be written without pulling in an image library, all functions are thread safe
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+
+namespace vks
+{
+	namespace imageencoder
+	{
+		enum class Format { PPM, QOI, PNG };
+
+		inline const char* extension(Format format)
+		{
+			switch (format) {
+			case Format::PPM:
+				return "ppm";
+			case Format::QOI:
+				return "qoi";
+			default:
+				return "png";
+			}
+		}
+
+		/** @brief Returns the format for a file extension or command line value (ppm, qoi or png), defaults to QOI for unknown values */
+		inline Format formatFromName(const std::string& name)
+		{
+			if (name == "ppm") {
+				return Format::PPM;
+			}
+			if (name == "png") {
+				return Format::PNG;
+			}
+			return Format::QOI;
+		}
+
+		/**
+		* @brief Packs four component 8 bit texels into tightly packed RGB
+		* @param src First row of the source texels
+		* @param rowPitch Distance between two source rows in bytes
+		* @param swizzle Swap the red and blue components (for BGRA sources)
+		*/
+		inline void packRGB(const uint8_t* src, size_t rowPitch, uint32_t width, uint32_t height, bool swizzle, std::vector<uint8_t>& dst)
+		{
+			dst.resize((size_t)width * height * 3);
+			uint8_t* out = dst.data();
+			const uint32_t r = swizzle ? 2 : 0;
+			const uint32_t b = swizzle ? 0 : 2;
+			for (uint32_t y = 0; y < height; y++) {
+				const uint8_t* row = src + y * rowPitch;
+				for (uint32_t x = 0; x < width; x++) {
+					out[0] = row[r];
+					out[1] = row[1];
+					out[2] = row[b];
+					out += 3;
+					row += 4;
+				}
+			}
+		}
+
+		inline void encodePPM(const uint8_t* rgb, uint32_t width, uint32_t height, std::vector<uint8_t>& out)
+		{
+			const std::string header = "P6\n" + std::to_string(width) + "\n" + std::to_string(height) + "\n255\n";
+			out.assign(header.begin(), header.end());
+			out.insert(out.end(), rgb, rgb + (size_t)width * height * 3);
+		}
+
+		/**
+		* @brief Encodes an RGB image as QOI (https://qoiformat.org)
+		* Much faster to encode than PNG at a similar size for rendered content, which makes it the default for frame sequences
+		*/
+		inline void encodeQOI(const uint8_t* rgb, uint32_t width, uint32_t height, std::vector<uint8_t>& out)
+		{
+			const size_t pixelCount = (size_t)width * height;
+			out.clear();
+			// Worst case is one four byte QOI_OP_RGB per pixel
+			out.reserve(14 + pixelCount * 4 + 8);
+			const uint8_t header[14] = {
+				'q', 'o', 'i', 'f',
+				(uint8_t)(width >> 24), (uint8_t)(width >> 16), (uint8_t)(width >> 8), (uint8_t)width,
+				(uint8_t)(height >> 24), (uint8_t)(height >> 16), (uint8_t)(height >> 8), (uint8_t)height,
+				3, 0 };
+			out.insert(out.end(), header, header + 14);
+
+			uint32_t index[64] = {};
+			uint8_t prev[3] = { 0, 0, 0 };
+			uint32_t run = 0;
+			for (size_t i = 0; i < pixelCount; i++) {
+				const uint8_t* px = rgb + i * 3;
+				if (px[0] == prev[0] && px[1] == prev[1] && px[2] == prev[2]) {
+					run++;
+					if (run == 62 || i == pixelCount - 1) {
+						out.push_back((uint8_t)(0xc0 | (run - 1)));
+						run = 0;
+					}
+					continue;
+				}
+				if (run > 0) {
+					out.push_back((uint8_t)(0xc0 | (run - 1)));
+					run = 0;
+				}
+				// Alpha is always 255 for RGB images
+				const uint32_t hash = (px[0] * 3 + px[1] * 5 + px[2] * 7 + 255 * 11) % 64;
+				// The index holds RGBA, so alpha needs to be part of the packed value or opaque black would match the zero initialized slots
+				const uint32_t packed = px[0] | (px[1] << 8) | (px[2] << 16) | (0xffu << 24);
+				if (index[hash] == packed) {
+					out.push_back((uint8_t)hash);
+				} else {
+					index[hash] = packed;
+					const int8_t dr = (int8_t)(px[0] - prev[0]);
+					const int8_t dg = (int8_t)(px[1] - prev[1]);
+					const int8_t db = (int8_t)(px[2] - prev[2]);
+					const int8_t drdg = (int8_t)(dr - dg);
+					const int8_t dbdg = (int8_t)(db - dg);
+					if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+						out.push_back((uint8_t)(0x40 | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2)));
+					} else if (dg >= -32 && dg <= 31 && drdg >= -8 && drdg <= 7 && dbdg >= -8 && dbdg <= 7) {
+						out.push_back((uint8_t)(0x80 | (dg + 32)));
+						out.push_back((uint8_t)(((drdg + 8) << 4) | (dbdg + 8)));
+					} else {
+						out.push_back(0xfe);
+						out.insert(out.end(), px, px + 3);
+					}
+				}
+				memcpy(prev, px, 3);
+			}
+			const uint8_t padding[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+			out.insert(out.end(), padding, padding + 8);
+		}
+
+		namespace detail
+		{
+			inline uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+			{
+				struct Table {
+					uint32_t values[256];
+					Table() {
+						for (uint32_t n = 0; n < 256; n++) {
+							uint32_t c = n;
+							for (uint32_t k = 0; k < 8; k++) {
+								c = (c & 1) ? (0xedb88320u ^ (c >> 1)) : (c >> 1);
+							}
+							values[n] = c;
+						}
+					}
+				};
+				static const Table table;
+				crc = ~crc;
+				for (size_t i = 0; i < size; i++) {
+					crc = table.values[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+				}
+				return ~crc;
+			}
+
+			inline uint32_t adler32(const uint8_t* data, size_t size)
+			{
+				uint32_t a = 1, b = 0;
+				while (size > 0) {
+					// 5552 is the largest block for which b can't overflow before the modulo
+					const size_t block = size < 5552 ? size : 5552;
+					for (size_t i = 0; i < block; i++) {
+						a += data[i];
+						b += a;
+					}
+					a %= 65521;
+					b %= 65521;
+					data += block;
+					size -= block;
+				}
+				return (b << 16) | a;
+			}
+
+			class BitWriter
+			{
+			public:
+				std::vector<uint8_t>& out;
+				uint32_t bits = 0;
+				uint32_t count = 0;
+				BitWriter(std::vector<uint8_t>& out) : out(out) {}
+				void put(uint32_t value, uint32_t length)
+				{
+					bits |= value << count;
+					count += length;
+					while (count >= 8) {
+						out.push_back((uint8_t)bits);
+						bits >>= 8;
+						count -= 8;
+					}
+				}
+				// Huffman codes are stored starting with their most significant bit
+				void putCode(uint32_t code, uint32_t length)
+				{
+					uint32_t reversed = 0;
+					for (uint32_t i = 0; i < length; i++) {
+						reversed = (reversed << 1) | ((code >> i) & 1);
+					}
+					put(reversed, length);
+				}
+				void flush()
+				{
+					if (count > 0) {
+						out.push_back((uint8_t)bits);
+					}
+					bits = 0;
+					count = 0;
+				}
+			};
+
+			// Lookup tables for the deflate length and distance codes
+			struct DeflateTables
+			{
+				uint16_t lengthBase[29];
+				uint8_t lengthExtra[29];
+				uint16_t distanceBase[30];
+				uint8_t distanceExtra[30];
+				uint8_t lengthCode[259];
+				uint8_t distanceCodeLow[256];
+				uint8_t distanceCodeHigh[256];
+				DeflateTables()
+				{
+					uint32_t base = 3;
+					for (uint32_t i = 0; i < 28; i++) {
+						lengthExtra[i] = (i < 8) ? 0 : (uint8_t)((i - 4) / 4);
+						lengthBase[i] = (uint16_t)base;
+						base += 1 << lengthExtra[i];
+					}
+					lengthBase[28] = 258;
+					lengthExtra[28] = 0;
+					for (uint32_t i = 0; i < 29; i++) {
+						for (uint32_t l = lengthBase[i]; l < 259 && (i == 28 || l < lengthBase[i + 1]); l++) {
+							lengthCode[l] = (uint8_t)i;
+						}
+					}
+					base = 1;
+					for (uint32_t i = 0; i < 30; i++) {
+						distanceExtra[i] = (i < 4) ? 0 : (uint8_t)((i - 2) / 2);
+						distanceBase[i] = (uint16_t)base;
+						base += 1 << distanceExtra[i];
+					}
+					// Distances up to 256 are looked up directly, larger ones by their upper bits
+					for (uint32_t i = 0; i < 30; i++) {
+						const uint32_t end = (i == 29) ? 32769 : distanceBase[i + 1];
+						for (uint32_t d = distanceBase[i]; d < end; d++) {
+							if (d <= 256) {
+								distanceCodeLow[d - 1] = (uint8_t)i;
+							} else {
+								distanceCodeHigh[(d - 1) >> 7] = (uint8_t)i;
+							}
+						}
+					}
+				}
+			};
+
+			inline void putLiteral(BitWriter& writer, uint32_t value)
+			{
+				if (value < 144) {
+					writer.putCode(0x30 + value, 8);
+				} else if (value < 256) {
+					writer.putCode(0x190 + (value - 144), 9);
+				} else if (value < 280) {
+					writer.putCode(value - 256, 7);
+				} else {
+					writer.putCode(0xc0 + (value - 280), 8);
+				}
+			}
+
+			/**
+			* @brief Compresses data into a zlib stream using a single fixed Huffman deflate block
+			* A greedy LZ77 pass with a single entry hash table keeps this fast while still collapsing the long runs of filtered zeros in rendered images
+			*/
+			inline void deflate(const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+			{
+				static const DeflateTables tables;
+				const uint32_t hashBits = 15;
+				const uint32_t windowSize = 32768;
+				std::vector<int64_t> head((size_t)1 << hashBits, -1);
+
+				// zlib header (deflate with 32K window, fastest compression level)
+				out.push_back(0x78);
+				out.push_back(0x01);
+				BitWriter writer(out);
+				// Final block with fixed Huffman codes
+				writer.put(1, 1);
+				writer.put(1, 2);
+				size_t i = 0;
+				while (i < size) {
+					uint32_t matchLength = 0;
+					size_t matchDistance = 0;
+					if (i + 3 <= size) {
+						const uint32_t hash = ((data[i] << 16 | data[i + 1] << 8 | data[i + 2]) * 2654435761u) >> (32 - hashBits);
+						const int64_t candidate = head[hash];
+						head[hash] = (int64_t)i;
+						if (candidate >= 0 && i - (size_t)candidate <= windowSize) {
+							const uint8_t* a = data + candidate;
+							const uint8_t* b = data + i;
+							const size_t maxLength = (size - i) < 258 ? (size - i) : 258;
+							uint32_t length = 0;
+							while (length < maxLength && a[length] == b[length]) {
+								length++;
+							}
+							if (length >= 3) {
+								matchLength = length;
+								matchDistance = i - (size_t)candidate;
+							}
+						}
+					}
+					if (matchLength > 0) {
+						const uint32_t lengthCode = tables.lengthCode[matchLength];
+						putLiteral(writer, 257 + lengthCode);
+						writer.put(matchLength - tables.lengthBase[lengthCode], tables.lengthExtra[lengthCode]);
+						const uint32_t distanceCode = (matchDistance <= 256) ? tables.distanceCodeLow[matchDistance - 1] : tables.distanceCodeHigh[(matchDistance - 1) >> 7];
+						writer.putCode(distanceCode, 5);
+						writer.put((uint32_t)matchDistance - tables.distanceBase[distanceCode], tables.distanceExtra[distanceCode]);
+						i += matchLength;
+					} else {
+						putLiteral(writer, data[i]);
+						i++;
+					}
+				}
+				// End of block
+				putLiteral(writer, 256);
+				writer.flush();
+				const uint32_t adler = adler32(data, size);
+				out.push_back((uint8_t)(adler >> 24));
+				out.push_back((uint8_t)(adler >> 16));
+				out.push_back((uint8_t)(adler >> 8));
+				out.push_back((uint8_t)adler);
+			}
+
+			inline void writeChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data)
+			{
+				const uint32_t size = (uint32_t)data.size();
+				const uint8_t length[4] = { (uint8_t)(size >> 24), (uint8_t)(size >> 16), (uint8_t)(size >> 8), (uint8_t)size };
+				out.insert(out.end(), length, length + 4);
+				const size_t start = out.size();
+				out.insert(out.end(), type, type + 4);
+				out.insert(out.end(), data.begin(), data.end());
+				const uint32_t crc = crc32(out.data() + start, out.size() - start);
+				const uint8_t crcBytes[4] = { (uint8_t)(crc >> 24), (uint8_t)(crc >> 16), (uint8_t)(crc >> 8), (uint8_t)crc };
+				out.insert(out.end(), crcBytes, crcBytes + 4);
+			}
+		}
+
+		/** @brief Encodes an RGB image as an 8 bit PNG, rows use the "up" filter which turns static image regions into runs of zeros */
+		inline void encodePNG(const uint8_t* rgb, uint32_t width, uint32_t height, std::vector<uint8_t>& out)
+		{
+			const size_t rowSize = (size_t)width * 3;
+			std::vector<uint8_t> filtered((rowSize + 1) * height);
+			for (uint32_t y = 0; y < height; y++) {
+				uint8_t* dst = filtered.data() + y * (rowSize + 1);
+				const uint8_t* row = rgb + y * rowSize;
+				dst[0] = 2;
+				if (y == 0) {
+					memcpy(dst + 1, row, rowSize);
+				} else {
+					const uint8_t* above = row - rowSize;
+					for (size_t x = 0; x < rowSize; x++) {
+						dst[1 + x] = (uint8_t)(row[x] - above[x]);
+					}
+				}
+			}
+
+			const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+			out.assign(signature, signature + 8);
+			std::vector<uint8_t> header = {
+				(uint8_t)(width >> 24), (uint8_t)(width >> 16), (uint8_t)(width >> 8), (uint8_t)width,
+				(uint8_t)(height >> 24), (uint8_t)(height >> 16), (uint8_t)(height >> 8), (uint8_t)height,
+				// 8 bit RGB, deflate, adaptive filtering, no interlace
+				8, 2, 0, 0, 0 };
+			detail::writeChunk(out, "IHDR", header);
+			std::vector<uint8_t> compressed;
+			compressed.reserve(filtered.size() / 2);
+			detail::deflate(filtered.data(), filtered.size(), compressed);
+			detail::writeChunk(out, "IDAT", compressed);
+			detail::writeChunk(out, "IEND", std::vector<uint8_t>());
+		}
+
+		inline void encode(Format format, const uint8_t* rgb, uint32_t width, uint32_t height, std::vector<uint8_t>& out)
+		{
+			switch (format) {
+			case Format::PPM:
+				encodePPM(rgb, width, height, out);
+				break;
+			case Format::QOI:
+				encodeQOI(rgb, width, height, out);
+				break;
+			case Format::PNG:
+				encodePNG(rgb, width, height, out);
+				break;
+			}
+		}
+
+		/** @brief Writes an encoded image with a single call instead of per texel stream writes */
+		inline bool writeFile(const std::string& filename, const std::vector<uint8_t>& data)
+		{
+			FILE* file = fopen(filename.c_str(), "wb");
+			if (!file) {
+				return false;
+			}
+			const bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+			return (fclose(file) == 0) && written;
+		}
+	}
+}
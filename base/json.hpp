@@ -0,0 +1,43 @@
+/*
+* Helpers for writing JSON output (benchmark results, CPU traces)
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <string>
+#include <sstream>
+#include <iomanip>
+
+namespace vks
+{
+	namespace json
+	{
+		/** @brief Returns value as a quoted JSON string with quotes, backslashes and control characters escaped */
+		inline std::string quoted(const std::string &value)
+		{
+			std::stringstream ss;
+			ss << "\"";
+			for (auto c : value) {
+				switch (c) {
+				case '"': ss << "\\\""; break;
+				case '\\': ss << "\\\\"; break;
+				case '\n': ss << "\\n"; break;
+				case '\r': ss << "\\r"; break;
+				case '\t': ss << "\\t"; break;
+				default:
+					if ((unsigned char)c < 0x20) {
+						ss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c << std::dec;
+					} else {
+						ss << c;
+					}
+				}
+			}
+			ss << "\"";
+			return ss.str();
+		}
+	}
+}
@@ -43,6 +43,7 @@
 // for textoverlay example
 #define KEY_SPACE 0x3E		// AKEYCODE_SPACE
 #define KEY_KPADD 0x9D		// AKEYCODE_NUMPAD_ADD
+#define KEY_L 0x28			// AKEYCODE_L
 
 #elif (defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK))
 #if !defined(VK_EXAMPLE_XCODE_GENERATED)
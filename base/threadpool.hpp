@@ -12,6 +12,7 @@
 #include <mutex>
 #include <condition_variable>
 #include <functional>
+#include "cpuprofiler.hpp"
 
 // make_unique is not available in C++11
 // Taken from Herb Sutter's blog (https://herbsutter.com/gotw/_102/)
@@ -48,7 +49,10 @@ namespace vks
 					job = jobQueue.front();
 				}
 
-				job();
+				{
+					VKS_PROFILE_ZONE("Thread pool job");
+					job();
+				}
 
 				{
 					std::lock_guard<std::mutex> lock(queueMutex);
@@ -105,6 +109,9 @@ namespace vks
 			for (auto i = 0; i < count; i++)
 			{
 				threads.push_back(make_unique<Thread>());
+#if defined(VKS_CPU_PROFILER)
+				threads.back()->addJob([i] { VKS_PROFILE_THREAD_NAME("Worker " + std::to_string(i)); });
+#endif
 			}
 		}
 
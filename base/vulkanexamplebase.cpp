@@ -209,6 +209,12 @@ void VulkanExampleBase::prepare()
 	setupSwapChain();
 	createCommandBuffers();
 	createSynchronizationPrimitives();
+	gpuProfiler.prepare(vulkanDevice, static_cast<uint32_t>(drawCmdBuffers.size()));
+	frameCapture.prepare(vulkanDevice, queue, swapChain.colorFormat, swapChain.imageUsage, width, height);
+	if (benchmark.active) {
+		gpuProfiler.onScopeResult = [this](const std::string &name, double ms) { benchmark.addGpuPassTime(name, ms); };
+		gpuProfiler.onFrameResult = [this](double ms) { benchmark.addGpuFrameTime(ms); };
+	}
 	setupDepthStencil();
 	setupRenderPass();
 	createPipelineCache();
@@ -222,7 +228,13 @@ void VulkanExampleBase::prepare()
 			loadShader(getShadersPath() + "base/uioverlay.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT),
 		};
 		UIOverlay.prepareResources();
-		UIOverlay.preparePipeline(pipelineCache, renderPass, swapChain.colorFormat, depthFormat);
+		UIOverlay.preparePipeline(pipelineCache, swapChain.colorFormat);
+		std::vector<VkImageView> views;
+		for (auto& buffer : swapChain.buffers) {
+			views.push_back(buffer.view);
+		}
+		UIOverlay.prepareFrames(views, width, height);
+		UIOverlay.resize(width, height);
 	}
 }
 
@@ -251,7 +263,10 @@ void VulkanExampleBase::nextFrame()
 		viewChanged();
 	}
 
-	render();
+	{
+		VKS_PROFILE_ZONE("render");
+		render();
+	}
 	frameCounter++;
 	auto tEnd = std::chrono::high_resolution_clock::now();
 #if (defined(VK_USE_PLATFORM_IOS_MVK) || (defined(VK_USE_PLATFORM_MACOS_MVK) && !defined(VK_EXAMPLE_XCODE_GENERATED)))
@@ -266,6 +281,10 @@ void VulkanExampleBase::nextFrame()
 	{
 		viewUpdated = true;
 	}
+	if (!cameraPath.recordFile.empty()) {
+		cameraPath.path.record(cameraPath.recordTime, camera.position, camera.rotation);
+		cameraPath.recordTime += frameTimer;
+	}
 	// Convert to clamped timer value
 	if (!paused)
 	{
@@ -292,19 +311,53 @@ void VulkanExampleBase::nextFrame()
 	
 	// TODO: Cap UI overlay update rates
 	updateOverlay();
+
+	VKS_PROFILE_FRAME_END();
+}
+
+void VulkanExampleBase::renderBenchmarkFrame()
+{
+	if (cameraPath.replay) {
+		// The position on the path is derived from the frame index instead of the measured frame time, warmup is done at the start of the path
+		const float time = benchmark.isMeasuring() ? (float)(benchmark.frameCount * benchmark.fixedFrameTime / 1000.0) : 0.0f;
+		const vks::CameraPath::Keyframe keyframe = cameraPath.path.evaluate(time);
+		camera.setPosition(keyframe.position);
+		camera.setRotation(keyframe.rotation);
+		viewChanged();
+	}
+	{
+		VKS_PROFILE_ZONE("render");
+		render();
+	}
+	VKS_PROFILE_FRAME_END();
+	// In deterministic mode animations advance by a fixed time step, so that two runs render the same sequence of frames
+	if (benchmark.deterministic) {
+		frameTimer = (float)(benchmark.fixedFrameTime / 1000.0);
+		camera.update(frameTimer);
+		if (!paused) {
+			timer += timerSpeed * frameTimer;
+			if (timer > 1.0) {
+				timer -= 1.0f;
+			}
+		}
+	}
 }
 
 void VulkanExampleBase::renderLoop()
 {
+#if defined(VKS_CPU_PROFILER)
+	if (!settings.traceFile.empty()) {
+		VKS_PROFILE_THREAD_NAME("Main");
+		vks::CpuProfiler::get().beginCapture(settings.traceFile, settings.traceFrames);
+	}
+#endif
 // SRS - for non-apple plaforms, handle benchmarking here within VulkanExampleBase::renderLoop()
 //     - for macOS, handle benchmarking within NSApp rendering loop via displayLinkOutputCb()
 #if !(defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK))
 	if (benchmark.active) {
-		benchmark.run([=] { render(); }, vulkanDevice->properties);
+		benchmark.run([=] { renderBenchmarkFrame(); }, vulkanDevice->properties);
 		vkDeviceWaitIdle(device);
-		if (benchmark.filename != "") {
-			benchmark.saveResults();
-		}
+		benchmark.saveResults();
 		return;
 	}
 #endif
@@ -669,6 +722,8 @@ void VulkanExampleBase::updateOverlay()
 	if (!settings.overlay)
 		return;
 
+	VKS_PROFILE_FUNCTION();
+
 	ImGuiIO& io = ImGui::GetIO();
 
 	io.DisplaySize = ImVec2((float)width, (float)height);
@@ -695,6 +750,18 @@ void VulkanExampleBase::updateOverlay()
 	ImGui::PushItemWidth(110.0f * UIOverlay.scale);
 	OnUpdateUIOverlay(&UIOverlay);
 	ImGui::PopItemWidth();
+
+	// Per pass GPU times of examples that use profiler scopes
+	if (!gpuProfiler.getScopes().empty()) {
+		if (UIOverlay.header("GPU timings")) {
+			for (auto &scope : gpuProfiler.getScopes()) {
+				ImGui::TextUnformatted(scope.name.c_str());
+				ImGui::SameLine(120.0f * UIOverlay.scale);
+				ImGui::Text("%.3f ms", scope.average);
+			}
+			ImGui::Text("Readback latency: %d frames", gpuProfiler.latency);
+		}
+	}
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	ImGui::PopStyleVar();
 #endif
@@ -703,7 +770,9 @@ void VulkanExampleBase::updateOverlay()
 	ImGui::PopStyleVar();
 	ImGui::Render();
 
-	if (UIOverlay.update() || UIOverlay.updated) {
+	// The overlay is recorded every frame on its own, command buffers only need to be rebuilt if a UI element changed a setting
+	if (UIOverlay.updated) {
+		VKS_PROFILE_ZONE("buildCommandBuffers");
 		buildCommandBuffers();
 		UIOverlay.updated = false;
 	}
@@ -715,20 +784,9 @@ void VulkanExampleBase::updateOverlay()
 #endif
 }
 
-void VulkanExampleBase::drawUI(const VkCommandBuffer commandBuffer)
-{
-	if (settings.overlay && UIOverlay.visible) {
-		const VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-		const VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-		UIOverlay.draw(commandBuffer);
-	}
-}
-
 void VulkanExampleBase::prepareFrame()
 {
+	VKS_PROFILE_FUNCTION();
 	// Acquire the next image from the swap chain
 	VkResult result = swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer);
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE)
@@ -742,11 +800,23 @@ void VulkanExampleBase::prepareFrame()
 	else {
 		VK_CHECK_RESULT(result);
 	}
+	// Read back GPU timings of previous frames before the command buffer for this image is submitted again
+	gpuProfiler.update(currentBuffer);
 }
 
 void VulkanExampleBase::submitFrame()
 {
-	VkResult result = swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete);
+	VKS_PROFILE_FUNCTION();
+	// Frame sequences start with the first frame that is measured, so warmup frames aren't captured in benchmark mode
+	if ((settings.captureFrames > 0) && (!benchmark.active || benchmark.isMeasuring())) {
+		frameCapture.captureSequence(settings.captureFrames);
+		settings.captureFrames = 0;
+	}
+	// The overlay is drawn on top of the image once the example's rendering has finished
+	const VkSemaphore renderWaitSemaphore = settings.overlay ? UIOverlay.submit(currentBuffer, semaphores.renderComplete) : semaphores.renderComplete;
+	// If a capture has been requested, presentation waits for the copy of the image instead of the rendering
+	const VkSemaphore presentWaitSemaphore = frameCapture.capture(swapChain.images[currentBuffer], renderWaitSemaphore);
+	VkResult result = swapChain.queuePresent(queue, currentBuffer, presentWaitSemaphore);
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
 	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
 		windowResize();
@@ -757,7 +827,14 @@ void VulkanExampleBase::submitFrame()
 	else {
 		VK_CHECK_RESULT(result);
 	}
-	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	if (benchmark.active) {
+		// Separates the CPU time of a frame from the time spent waiting for the GPU
+		auto tStart = std::chrono::high_resolution_clock::now();
+		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+		benchmark.addWaitTime(std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count());
+	} else {
+		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	}
 }
 
 VulkanExampleBase::VulkanExampleBase(bool enableValidation)
@@ -795,6 +872,16 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	commandLineParser.add("benchmarkresultfile", { "-bf", "--benchfilename" }, 1, "Set file name for benchmark results");
 	commandLineParser.add("benchmarkresultframes", { "-bt", "--benchframetimes" }, 0, "Save frame times to benchmark results file");
 	commandLineParser.add("benchmarkframes", { "-bfs", "--benchmarkframes" }, 1, "Only render the given number of frames");
+	commandLineParser.add("benchmarkresultjson", { "-bj", "--benchjson" }, 1, "Set file name for benchmark results and statistics in JSON format");
+	commandLineParser.add("benchmarkdeterministic", { "-bd", "--benchdeterministic" }, 0, "Deterministic benchmark with fixed frame time and frame counts");
+	commandLineParser.add("benchmarkseed", { "-bsd", "--benchseed" }, 1, "Set seed for random number generators in benchmark mode");
+	commandLineParser.add("camerapath", { "-cp", "--camerapath" }, 1, "Replay a recorded camera path in benchmark mode (implies deterministic mode)");
+	commandLineParser.add("recordcamerapath", { "-rcp", "--recordcamerapath" }, 1, "Record the camera path to the given file (written on exit)");
+	commandLineParser.add("trace", { "-tr", "--trace" }, 1, "Write a Chrome trace (JSON) of the CPU profiling zones to the given file");
+	commandLineParser.add("traceframes", { "-trf", "--traceframes" }, 1, "Set number of frames to capture for the CPU trace (default 100)");
+	commandLineParser.add("captureframes", { "-cf", "--capture-frames" }, 1, "Save the given number of presented frames to the capture directory");
+	commandLineParser.add("captureformat", { "-cff", "--capture-format" }, 1, "Set image format for captured frames (qoi, png or ppm, default qoi)");
+	commandLineParser.add("capturedir", { "-cfd", "--capture-dir" }, 1, "Set directory for captured frames (default capture)");
 
 	commandLineParser.parse(args);
 	if (commandLineParser.isSet("help")) {
@@ -848,6 +935,53 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	if (commandLineParser.isSet("benchmarkframes")) {
 		benchmark.outputFrames = commandLineParser.getValueAsInt("benchmarkframes", benchmark.outputFrames);
 	}
+	if (commandLineParser.isSet("benchmarkresultjson")) {
+		benchmark.jsonFilename = commandLineParser.getValueAsString("benchmarkresultjson", benchmark.jsonFilename);
+	}
+	if (commandLineParser.isSet("benchmarkdeterministic")) {
+		benchmark.deterministic = true;
+		frameTimer = (float)(benchmark.fixedFrameTime / 1000.0);
+	}
+	if (commandLineParser.isSet("benchmarkseed")) {
+		benchmark.seed = commandLineParser.getValueAsInt("benchmarkseed", benchmark.seed);
+	}
+	for (auto arg : args) {
+		benchmark.commandLine.push_back(arg);
+	}
+	if (commandLineParser.isSet("camerapath")) {
+		std::string filename = commandLineParser.getValueAsString("camerapath", "");
+		if (cameraPath.path.loadFromFile(filename)) {
+			cameraPath.replay = true;
+			// Replay is always deterministic, if no frame count has been specified the whole path is rendered once
+			benchmark.deterministic = true;
+			frameTimer = (float)(benchmark.fixedFrameTime / 1000.0);
+			if (benchmark.outputFrames == -1) {
+				benchmark.outputFrames = static_cast<int>(cameraPath.path.duration() * 1000.0 / benchmark.fixedFrameTime) + 1;
+			}
+		}
+	}
+	if (commandLineParser.isSet("recordcamerapath")) {
+		cameraPath.recordFile = commandLineParser.getValueAsString("recordcamerapath", cameraPath.recordFile);
+	}
+	if (commandLineParser.isSet("trace")) {
+#if defined(VKS_CPU_PROFILER)
+		settings.traceFile = commandLineParser.getValueAsString("trace", settings.traceFile);
+#else
+		std::cerr << "CPU profiling has been disabled at compile time (USE_CPU_PROFILER), no trace will be written\n";
+#endif
+	}
+	if (commandLineParser.isSet("traceframes")) {
+		settings.traceFrames = commandLineParser.getValueAsInt("traceframes", settings.traceFrames);
+	}
+	if (commandLineParser.isSet("captureframes")) {
+		settings.captureFrames = commandLineParser.getValueAsInt("captureframes", settings.captureFrames);
+	}
+	if (commandLineParser.isSet("captureformat")) {
+		frameCapture.sequenceFormat = vks::imageencoder::formatFromName(commandLineParser.getValueAsString("captureformat", "qoi"));
+	}
+	if (commandLineParser.isSet("capturedir")) {
+		frameCapture.directory = commandLineParser.getValueAsString("capturedir", frameCapture.directory);
+	}
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	// Vulkan library is loaded dynamically on Android
@@ -873,6 +1007,13 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 
 VulkanExampleBase::~VulkanExampleBase()
 {
+	// Write the CPU trace if the example was closed before all requested frames have been captured
+	vks::CpuProfiler::get().endCapture();
+
+	if (!cameraPath.recordFile.empty() && cameraPath.path.saveToFile(cameraPath.recordFile)) {
+		std::cout << "Camera path with " << cameraPath.path.getKeyframes().size() << " keyframes written to " << cameraPath.recordFile << "\n";
+	}
+
 	// Clean up Vulkan resources
 	swapChain.cleanup();
 	if (descriptorPool != VK_NULL_HANDLE)
@@ -911,6 +1052,11 @@ VulkanExampleBase::~VulkanExampleBase()
 		UIOverlay.freeResources();
 	}
 
+	gpuProfiler.destroy();
+
+	// Writes all captures that are still being encoded
+	frameCapture.destroy();
+
 	delete vulkanDevice;
 
 	if (settings.validation)
@@ -1243,7 +1389,6 @@ void VulkanExampleBase::handleMessages(HWND hWnd, UINT uMsg, WPARAM wParam, LPAR
 			break;
 		case KEY_F1:
 			UIOverlay.visible = !UIOverlay.visible;
-			UIOverlay.updated = true;
 			break;
 		case KEY_ESCAPE:
 			PostQuitMessage(0);
@@ -1478,7 +1623,6 @@ int32_t VulkanExampleBase::handleAppInput(struct android_app* app, AInputEvent*
 		case AKEYCODE_F1:
 		case AKEYCODE_BUTTON_L1:
 			vulkanExample->UIOverlay.visible = !vulkanExample->UIOverlay.visible;
-			vulkanExample->UIOverlay.updated = true;
 			break;
 		case AKEYCODE_BUTTON_R1:
 			vulkanExample->keyPressed(GAMEPAD_BUTTON_R1);
@@ -1670,7 +1814,6 @@ static CVReturn displayLinkOutputCallback(CVDisplayLinkRef displayLink, const CV
 		case KEY_1:										// support keyboards with no function keys
 		case KEY_F1:
 			vulkanExample->UIOverlay.visible = !vulkanExample->UIOverlay.visible;
-			vulkanExample->UIOverlay.updated = true;
 			break;
 		case KEY_DELETE:								// support keyboards with no escape key
 		case KEY_ESCAPE:
@@ -1871,10 +2014,8 @@ void VulkanExampleBase::displayLinkOutputCb()
 {
 #if defined(VK_EXAMPLE_XCODE_GENERATED)
 	if (benchmark.active) {
-		benchmark.run([=] { render(); }, vulkanDevice->properties);
-		if (benchmark.filename != "") {
-			benchmark.saveResults();
-		}
+		benchmark.run([=] { renderBenchmarkFrame(); }, vulkanDevice->properties);
+		benchmark.saveResults();
 		quit = true;	// SRS - quit NSApp rendering loop when benchmarking complete
 		return;
 	}
@@ -2060,7 +2201,6 @@ void VulkanExampleBase::handleEvent(const DFBWindowEvent *event)
 				break;
 			case KEY_F1:
 				UIOverlay.visible = !UIOverlay.visible;
-				UIOverlay.updated = true;
 				break;
 			default:
 				break;
@@ -2235,7 +2375,6 @@ void VulkanExampleBase::keyboardKey(struct wl_keyboard *keyboard,
 	case KEY_F1:
 		if (state) {
 			UIOverlay.visible = !UIOverlay.visible;
-			UIOverlay.updated = true;
 		}
 		break;
 	case KEY_ESCAPE:
@@ -2597,7 +2736,6 @@ void VulkanExampleBase::handleEvent(const xcb_generic_event_t *event)
 				break;
 			case KEY_F1:
 				UIOverlay.visible = !UIOverlay.visible;
-				UIOverlay.updated = true;
 				break;
 		}
 	}
@@ -2855,11 +2993,22 @@ void VulkanExampleBase::windowResize()
 			UIOverlay.resize(width, height);
 		}
 	}
+	if (settings.overlay) {
+		std::vector<VkImageView> views;
+		for (auto& buffer : swapChain.buffers) {
+			views.push_back(buffer.view);
+		}
+		UIOverlay.prepareFrames(views, width, height);
+	}
+	frameCapture.resize(swapChain.colorFormat, swapChain.imageUsage, width, height);
 
 	// Command buffers need to be recreated as they may store
 	// references to the recreated frame buffer
 	destroyCommandBuffers();
 	createCommandBuffers();
+	// The profiler's queries are per command buffer, so they need to be recreated along with them
+	gpuProfiler.destroy();
+	gpuProfiler.prepare(vulkanDevice, static_cast<uint32_t>(drawCmdBuffers.size()));
 	buildCommandBuffers();
 	
 	// SRS - Recreate fences in case number of swapchain images has changed on resize
@@ -68,10 +68,15 @@
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
 #include "VulkanTexture.h"
+#include "VulkanQueryManager.hpp"
+#include "VulkanGpuProfiler.hpp"
+#include "VulkanFrameCapture.hpp"
 
 #include "VulkanInitializers.hpp"
 #include "camera.hpp"
+#include "camerapath.hpp"
 #include "benchmark.hpp"
+#include "cpuprofiler.hpp"
 
 class VulkanExampleBase
 {
@@ -170,6 +175,12 @@ public:
 
 	vks::Benchmark benchmark;
 
+	/** @brief GPU timestamp profiler, examples can place named scopes around their passes to have their GPU times displayed and benchmarked */
+	vks::GpuProfiler gpuProfiler;
+
+	/** @brief Asynchronous capture of presented frames to disk, used for screenshots and --capture-frames */
+	vks::FrameCapture frameCapture;
+
 	/** @brief Encapsulated physical and logical vulkan device */
 	vks::VulkanDevice *vulkanDevice;
 
@@ -183,11 +194,18 @@ public:
 		bool vsync = false;
 		/** @brief Enable UI overlay */
 		bool overlay = true;
+		/** @brief File name for a trace of the CPU profiling zones (written after traceFrames frames), no trace is captured if empty */
+		std::string traceFile = "";
+		uint32_t traceFrames = 100;
+		/** @brief Number of frames to capture to disk, starts with the first frame (or the first measured frame in benchmark mode) */
+		uint32_t captureFrames = 0;
 	} settings;
 
 	VkClearColorValue defaultClearColor = { { 0.025f, 0.025f, 0.025f, 1.0f } };
 
 	static std::vector<const char*> args;
+	/** @brief Called before the example is created, examples can hide this to handle command line tasks that don't need Vulkan (returning true exits before initialization) */
+	static bool runWithoutVulkan() { return false; }
 
 	// Defines a frame rate independent timer value clamped from -1.0...1.0
 	// For use in animations, rotations, etc.
@@ -197,6 +215,14 @@ public:
 	bool paused = false;
 
 	Camera camera;
+
+	/** @brief Camera path recorded with --recordcamerapath (written on exit) or replayed in benchmark mode with --camerapath */
+	struct {
+		vks::CameraPath path;
+		std::string recordFile = "";
+		float recordTime = 0.0f;
+		bool replay = false;
+	} cameraPath;
 	glm::vec2 mousePos;
 
 	std::string title = "Vulkan Example";
@@ -377,12 +403,11 @@ public:
 	/** @brief Loads a SPIR-V shader file for the given shader stage */
 	VkPipelineShaderStageCreateInfo loadShader(std::string fileName, VkShaderStageFlagBits stage);
 
+	/** @brief Renders a single frame in benchmark mode, advancing animations by a fixed time step in deterministic mode */
+	void renderBenchmarkFrame();
 	/** @brief Entry point for the main render loop */
 	void renderLoop();
 
-	/** @brief Adds the drawing commands for the ImGui overlay to the given command buffer */
-	void drawUI(const VkCommandBuffer commandBuffer);
-
 	/** Prepare the next frame for workload submission by acquiring the next swap chain image */
 	void prepareFrame();
 	/** @brief Presents the current image to the swap chain */
@@ -414,6 +439,7 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)									\
 {																									\
 	for (int32_t i = 0; i < __argc; i++) { VulkanExample::args.push_back(__argv[i]); };  			\
+	if (VulkanExample::runWithoutVulkan()) { return 0; }											\
 	vulkanExample = new VulkanExample();															\
 	vulkanExample->initVulkan();																	\
 	vulkanExample->setupWindow(hInstance, WndProc);													\
@@ -447,6 +473,7 @@ static void handleEvent()                                											\
 int main(const int argc, const char *argv[])													    \
 {																									\
 	for (size_t i = 0; i < argc; i++) { VulkanExample::args.push_back(argv[i]); };  				\
+	if (VulkanExample::runWithoutVulkan()) { return 0; }											\
 	vulkanExample = new VulkanExample();															\
 	vulkanExample->initVulkan();																	\
 	vulkanExample->prepare();																		\
@@ -467,6 +494,7 @@ static void handleEvent(const DFBWindowEvent *event)												\
 int main(const int argc, const char *argv[])													    \
 {																									\
 	for (size_t i = 0; i < argc; i++) { VulkanExample::args.push_back(argv[i]); };  				\
+	if (VulkanExample::runWithoutVulkan()) { return 0; }											\
 	vulkanExample = new VulkanExample();															\
 	vulkanExample->initVulkan();																	\
 	vulkanExample->setupWindow();					 												\
@@ -481,6 +509,7 @@ VulkanExample *vulkanExample;																		\
 int main(const int argc, const char *argv[])													    \
 {																									\
 	for (size_t i = 0; i < argc; i++) { VulkanExample::args.push_back(argv[i]); };  				\
+	if (VulkanExample::runWithoutVulkan()) { return 0; }											\
 	vulkanExample = new VulkanExample();															\
 	vulkanExample->initVulkan();																	\
 	vulkanExample->setupWindow();					 												\
@@ -502,6 +531,7 @@ static void handleEvent(const xcb_generic_event_t *event)											\
 int main(const int argc, const char *argv[])													    \
 {																									\
 	for (size_t i = 0; i < argc; i++) { VulkanExample::args.push_back(argv[i]); };  				\
+	if (VulkanExample::runWithoutVulkan()) { return 0; }											\
 	vulkanExample = new VulkanExample();															\
 	vulkanExample->initVulkan();																	\
 	vulkanExample->setupWindow();					 												\
@@ -519,6 +549,7 @@ int main(const int argc, const char *argv[])														\
 	@autoreleasepool																				\
 	{																								\
 		for (size_t i = 0; i < argc; i++) { VulkanExample::args.push_back(argv[i]); };				\
+		if (VulkanExample::runWithoutVulkan()) { return 0; }										\
 		vulkanExample = new VulkanExample();														\
 		vulkanExample->initVulkan();																\
 		vulkanExample->setupWindow(nullptr);														\
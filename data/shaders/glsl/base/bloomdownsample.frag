@@ -0,0 +1,68 @@
+#version 450
+
+// 13-tap downsample filter, combining five overlapping 2x2 box filters (Jimenez, "Next generation post processing in Call of Duty: Advanced Warfare")
+
+layout (binding = 0) uniform sampler2D samplerSource;
+
+layout (push_constant) uniform PushConsts {
+	vec2 sourceTexelSize;
+	float filterRadius;
+	// Set for the first downsample to suppress fireflies (single very bright pixels) with a Karis average
+	int karisAverage;
+} pushConsts;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+float karisWeight(vec3 color)
+{
+	float luma = dot(color, vec3(0.2126, 0.7152, 0.0722));
+	return 1.0 / (1.0 + luma);
+}
+
+void main()
+{
+	vec2 t = pushConsts.sourceTexelSize;
+
+	vec3 a = texture(samplerSource, inUV + t * vec2(-2.0,  2.0)).rgb;
+	vec3 b = texture(samplerSource, inUV + t * vec2( 0.0,  2.0)).rgb;
+	vec3 c = texture(samplerSource, inUV + t * vec2( 2.0,  2.0)).rgb;
+	vec3 d = texture(samplerSource, inUV + t * vec2(-2.0,  0.0)).rgb;
+	vec3 e = texture(samplerSource, inUV).rgb;
+	vec3 f = texture(samplerSource, inUV + t * vec2( 2.0,  0.0)).rgb;
+	vec3 g = texture(samplerSource, inUV + t * vec2(-2.0, -2.0)).rgb;
+	vec3 h = texture(samplerSource, inUV + t * vec2( 0.0, -2.0)).rgb;
+	vec3 i = texture(samplerSource, inUV + t * vec2( 2.0, -2.0)).rgb;
+	vec3 j = texture(samplerSource, inUV + t * vec2(-1.0,  1.0)).rgb;
+	vec3 k = texture(samplerSource, inUV + t * vec2( 1.0,  1.0)).rgb;
+	vec3 l = texture(samplerSource, inUV + t * vec2(-1.0, -1.0)).rgb;
+	vec3 m = texture(samplerSource, inUV + t * vec2( 1.0, -1.0)).rgb;
+
+	// The center box contributes half, the four corner boxes an eighth each
+	vec3 boxes[5] = vec3[](
+		(j + k + l + m) * 0.25,
+		(a + b + d + e) * 0.25,
+		(b + c + e + f) * 0.25,
+		(d + e + g + h) * 0.25,
+		(e + f + h + i) * 0.25
+	);
+	float weights[5] = float[](0.5, 0.125, 0.125, 0.125, 0.125);
+
+	vec3 color = vec3(0.0);
+	if (pushConsts.karisAverage == 1) {
+		float weightSum = 0.0;
+		for (int n = 0; n < 5; n++) {
+			float w = weights[n] * karisWeight(boxes[n]);
+			color += boxes[n] * w;
+			weightSum += w;
+		}
+		color /= weightSum;
+	} else {
+		for (int n = 0; n < 5; n++) {
+			color += boxes[n] * weights[n];
+		}
+	}
+
+	outFragColor = vec4(color, 1.0);
+}
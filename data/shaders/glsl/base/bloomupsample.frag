@@ -0,0 +1,32 @@
+#version 450
+
+// 3x3 tent filter upsample, the result is added to the destination mip level using additive blending
+
+layout (binding = 0) uniform sampler2D samplerSource;
+
+layout (push_constant) uniform PushConsts {
+	vec2 sourceTexelSize;
+	float filterRadius;
+	int karisAverage;
+} pushConsts;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main()
+{
+	vec2 t = pushConsts.sourceTexelSize * pushConsts.filterRadius;
+
+	vec3 color = texture(samplerSource, inUV).rgb * 4.0;
+	color += texture(samplerSource, inUV + t * vec2( 0.0,  1.0)).rgb * 2.0;
+	color += texture(samplerSource, inUV + t * vec2(-1.0,  0.0)).rgb * 2.0;
+	color += texture(samplerSource, inUV + t * vec2( 1.0,  0.0)).rgb * 2.0;
+	color += texture(samplerSource, inUV + t * vec2( 0.0, -1.0)).rgb * 2.0;
+	color += texture(samplerSource, inUV + t * vec2(-1.0,  1.0)).rgb;
+	color += texture(samplerSource, inUV + t * vec2( 1.0,  1.0)).rgb;
+	color += texture(samplerSource, inUV + t * vec2(-1.0, -1.0)).rgb;
+	color += texture(samplerSource, inUV + t * vec2( 1.0, -1.0)).rgb;
+
+	outFragColor = vec4(color / 16.0, 1.0);
+}
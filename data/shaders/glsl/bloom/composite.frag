@@ -0,0 +1,18 @@
+#version 450
+
+layout (binding = 1) uniform sampler2D samplerBloom;
+
+layout (binding = 0) uniform UBO
+{
+	float strength;
+} ubo;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main()
+{
+	// Added on top of the scene using additive blending
+	outFragColor = vec4(texture(samplerBloom, inUV).rgb * ubo.strength, 1.0);
+}
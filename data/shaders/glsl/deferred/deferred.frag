@@ -8,87 +8,136 @@ layout (location = 0) in vec2 inUV;
 
 layout (location = 0) out vec4 outFragcolor;
 
+#define MAX_LIGHTS_PER_CLUSTER 256
+
 struct Light {
+	// xyz = world space position, w = range
 	vec4 position;
 	vec3 color;
 	float radius;
 };
 
-layout (binding = 4) uniform UBO 
+layout (binding = 4) uniform UBO
 {
-	Light lights[6];
 	vec4 viewPos;
 	int displayDebugTarget;
 } ubo;
 
-void main() 
+layout (std430, binding = 5) readonly buffer Lights
+{
+	Light lights[];
+};
+
+layout (std430, binding = 6) readonly buffer ClusterLightCounts
+{
+	uint clusterLightCounts[];
+};
+
+layout (std430, binding = 7) readonly buffer ClusterLightIndices
+{
+	uint clusterLightIndices[];
+};
+
+layout (binding = 8) uniform UBOClusters
+{
+	mat4 view;
+	mat4 inverseProjection;
+	vec4 screen;
+	uvec4 grid;
+} uboClusters;
+
+// Index of the cluster containing the given world space position, must match the cluster assignment of the light culling compute shader
+uint clusterIndex(vec3 fragPos)
+{
+	float depth = max(-(uboClusters.view * vec4(fragPos, 1.0)).z, uboClusters.screen.z);
+	uvec2 tile = min(uvec2(gl_FragCoord.xy / uboClusters.screen.xy * vec2(uboClusters.grid.xy)), uboClusters.grid.xy - 1u);
+	float slice = floor(log(depth / uboClusters.screen.z) / log(uboClusters.screen.w / uboClusters.screen.z) * float(uboClusters.grid.z));
+	uint z = uint(clamp(slice, 0.0, float(uboClusters.grid.z - 1u)));
+	return tile.x + tile.y * uboClusters.grid.x + z * uboClusters.grid.x * uboClusters.grid.y;
+}
+
+void main()
 {
 	// Get G-Buffer values
 	vec3 fragPos = texture(samplerposition, inUV).rgb;
 	vec3 normal = texture(samplerNormal, inUV).rgb;
 	vec4 albedo = texture(samplerAlbedo, inUV);
-	
+
+	uint cluster = clusterIndex(fragPos);
+	uint lightCount = clusterLightCounts[cluster];
+
 	// Debug display
 	if (ubo.displayDebugTarget > 0) {
 		switch (ubo.displayDebugTarget) {
-			case 1: 
+			case 1:
 				outFragcolor.rgb = fragPos;
 				break;
-			case 2: 
+			case 2:
 				outFragcolor.rgb = normal;
 				break;
-			case 3: 
+			case 3:
 				outFragcolor.rgb = albedo.rgb;
 				break;
-			case 4: 
+			case 4:
 				outFragcolor.rgb = albedo.aaa;
 				break;
-		}		
+			case 5:
+				// Number of lights in the fragment's cluster (green = none, red = MAX_LIGHTS_PER_CLUSTER / 4 or more, magenta = lights had to be dropped)
+				float heat = clamp(float(lightCount) / float(MAX_LIGHTS_PER_CLUSTER / 4), 0.0, 1.0);
+				outFragcolor.rgb = mix(vec3(0.0, 1.0, 0.0), vec3(1.0, 0.0, 0.0), heat) * (lightCount > 0 ? 1.0 : 0.25);
+				if (lightCount > MAX_LIGHTS_PER_CLUSTER) {
+					outFragcolor.rgb = vec3(1.0, 0.0, 1.0);
+				}
+				break;
+		}
 		outFragcolor.a = 1.0;
 		return;
 	}
 
 	// Render-target composition
 
-	#define lightCount 6
 	#define ambient 0.0
-	
+
 	// Ambient part
 	vec3 fragcolor  = albedo.rgb * ambient;
-	
-	for(int i = 0; i < lightCount; ++i)
+
+	// Only the lights assigned to this fragment's cluster need to be evaluated, clusters that overflowed only store the first MAX_LIGHTS_PER_CLUSTER lights
+	for(uint i = 0; i < min(lightCount, uint(MAX_LIGHTS_PER_CLUSTER)); ++i)
 	{
+		Light light = lights[clusterLightIndices[cluster * MAX_LIGHTS_PER_CLUSTER + i]];
+
 		// Vector to light
-		vec3 L = ubo.lights[i].position.xyz - fragPos;
+		vec3 L = light.position.xyz - fragPos;
 		// Distance from light to fragment position
 		float dist = length(L);
 
 		// Viewer to fragment
 		vec3 V = ubo.viewPos.xyz - fragPos;
 		V = normalize(V);
-		
-		//if(dist < ubo.lights[i].radius)
+
+		if(dist < light.position.w)
 		{
 			// Light to fragment
 			L = normalize(L);
 
-			// Attenuation
-			float atten = ubo.lights[i].radius / (pow(dist, 2.0) + 1.0);
+			// Attenuation, windowed so the light's contribution smoothly falls to zero at its range
+			float window = clamp(1.0 - pow(dist / light.position.w, 4.0), 0.0, 1.0);
+			float atten = light.radius / (pow(dist, 2.0) + 1.0) * window * window;
 
 			// Diffuse part
 			vec3 N = normalize(normal);
 			float NdotL = max(0.0, dot(N, L));
-			vec3 diff = ubo.lights[i].color * albedo.rgb * NdotL * atten;
+			vec3 diff = light.color * albedo.rgb * NdotL * atten;
 
 			// Specular part
 			// Specular map values are stored in alpha of albedo mrt
 			vec3 R = reflect(-L, N);
 			float NdotR = max(0.0, dot(R, V));
-			vec3 spec = ubo.lights[i].color * albedo.a * pow(NdotR, 16.0) * atten;
-
-			fragcolor += diff + spec;	
-		}	
-	}    	
-   
-  outFragcolor = vec4(fragcolor, 1.0);	
-}
\ No newline at end of file
+			vec3 spec = light.color * albedo.a * pow(NdotR, 16.0) * atten;
+
+			fragcolor += diff + spec;
+		}
+	}
+
+  outFragcolor = vec4(fragcolor, 1.0);
+}
@@ -10,6 +10,7 @@ layout (location = 0) in vec2 inUV;
 layout (location = 0) out vec4 outFragColor;
 
 #define LIGHT_COUNT 3
+#define MAX_LIGHTS_PER_CLUSTER 256
 #define SHADOW_FACTOR 0.25
 #define AMBIENT_LIGHT 0.1
 #define USE_PCF
@@ -30,6 +31,37 @@ layout (binding = 4) uniform UBO
 	int debugDisplayTarget;
 } ubo;
 
+// Unshadowed point lights, assigned to view space clusters by the light culling compute shader
+struct PointLight {
+	// xyz = world space position, w = range
+	vec4 position;
+	vec3 color;
+	float radius;
+};
+
+layout (std430, binding = 6) readonly buffer PointLights
+{
+	PointLight pointLights[];
+};
+
+layout (std430, binding = 7) readonly buffer ClusterLightCounts
+{
+	uint clusterLightCounts[];
+};
+
+layout (std430, binding = 8) readonly buffer ClusterLightIndices
+{
+	uint clusterLightIndices[];
+};
+
+layout (binding = 9) uniform UBOClusters
+{
+	mat4 view;
+	mat4 inverseProjection;
+	vec4 screen;
+	uvec4 grid;
+} uboClusters;
+
 float textureProj(vec4 P, float layer, vec2 offset)
 {
 	float shadow = 1.0;
@@ -70,6 +102,16 @@ float filterPCF(vec4 sc, float layer)
 	return shadowFactor / count;
 }
 
+// Index of the cluster containing the given world space position, must match the cluster assignment of the light culling compute shader
+uint clusterIndex(vec3 fragPos)
+{
+	float depth = max(-(uboClusters.view * vec4(fragPos, 1.0)).z, uboClusters.screen.z);
+	uvec2 tile = min(uvec2(gl_FragCoord.xy / uboClusters.screen.xy * vec2(uboClusters.grid.xy)), uboClusters.grid.xy - 1u);
+	float slice = floor(log(depth / uboClusters.screen.z) / log(uboClusters.screen.w / uboClusters.screen.z) * float(uboClusters.grid.z));
+	uint z = uint(clamp(slice, 0.0, float(uboClusters.grid.z - 1u)));
+	return tile.x + tile.y * uboClusters.grid.x + z * uboClusters.grid.x * uboClusters.grid.y;
+}
+
 vec3 shadow(vec3 fragcolor, vec3 fragpos) {
 	for(int i = 0; i < LIGHT_COUNT; ++i)
 	{
@@ -94,6 +136,9 @@ void main()
 	vec3 normal = texture(samplerNormal, inUV).rgb;
 	vec4 albedo = texture(samplerAlbedo, inUV);
 
+	uint cluster = clusterIndex(fragPos);
+	uint lightCount = clusterLightCounts[cluster];
+
 	// Debug display
 	if (ubo.debugDisplayTarget > 0) {
 		switch (ubo.debugDisplayTarget) {
@@ -112,6 +157,14 @@ void main()
 			case 5: 
 				outFragColor.rgb = albedo.aaa;
 				break;
+			case 6:
+				// Number of point lights in the fragment's cluster (green = none, red = MAX_LIGHTS_PER_CLUSTER / 4 or more, magenta = lights had to be dropped)
+				float heat = clamp(float(lightCount) / float(MAX_LIGHTS_PER_CLUSTER / 4), 0.0, 1.0);
+				outFragColor.rgb = mix(vec3(0.0, 1.0, 0.0), vec3(1.0, 0.0, 0.0), heat) * (lightCount > 0 ? 1.0 : 0.25);
+				if (lightCount > MAX_LIGHTS_PER_CLUSTER) {
+					outFragColor.rgb = vec3(1.0, 0.0, 1.0);
+				}
+				break;
 		}		
 		outFragColor.a = 1.0;
 		return;
@@ -164,5 +217,28 @@ void main()
 		fragcolor = shadow(fragcolor, fragPos);
 	}
 
+	// Point lights don't cast shadows, only the ones assigned to this fragment's cluster need to be evaluated
+	vec3 V = normalize(ubo.viewPos.xyz - fragPos);
+	for(uint i = 0; i < min(lightCount, uint(MAX_LIGHTS_PER_CLUSTER)); ++i)
+	{
+		PointLight light = pointLights[clusterLightIndices[cluster * MAX_LIGHTS_PER_CLUSTER + i]];
+
+		vec3 L = light.position.xyz - fragPos;
+		float dist = length(L);
+		if (dist < light.position.w)
+		{
+			L = normalize(L);
+
+			// Attenuation, windowed so the light's contribution smoothly falls to zero at its range
+			float window = clamp(1.0 - pow(dist / light.position.w, 4.0), 0.0, 1.0);
+			float atten = light.radius / (pow(dist, 2.0) + 1.0) * window * window;
+
+			float NdotL = max(0.0, dot(N, L));
+			vec3 R = reflect(-L, N);
+			float NdotR = max(0.0, dot(R, V));
+			fragcolor += light.color * (albedo.rgb * NdotL + albedo.a * pow(NdotR, 16.0)) * atten;
+		}
+	}
+
 	outFragColor = vec4(fragcolor, 1.0);
 }
\ No newline at end of file
@@ -10,6 +10,7 @@ layout (binding = 2) uniform UBO
 } ubo;
 
 layout (location = 0) in vec2 inUV;
+layout (location = 1) in vec4 inColor;
 
 layout (location = 0) out vec4 outFragColor;
 
@@ -18,7 +19,7 @@ void main()
     float distance = texture(samplerColor, inUV).a;
     float smoothWidth = fwidth(distance);	
     float alpha = smoothstep(0.5 - smoothWidth, 0.5 + smoothWidth, distance);
-	vec3 rgb = vec3(alpha);
+	vec3 rgb = vec3(alpha) * inColor.rgb;
 									 
 	if (ubo.outline > 0.0) 
 	{
@@ -1,7 +1,9 @@
 #version 450
 
-layout (location = 0) in vec3 inPos;
-layout (location = 1) in vec2 inUV;
+// Per instance glyph data
+layout (location = 0) in vec2 inPos;
+layout (location = 1) in uvec2 inIndices;
+layout (location = 2) in vec4 inColor;
 
 layout (binding = 0) uniform UBO 
 {
@@ -9,10 +11,32 @@ layout (binding = 0) uniform UBO
 	mat4 model;
 } ubo;
 
+struct Glyph
+{
+	vec4 uv;
+	vec4 quad;
+};
+
+layout (binding = 3) uniform Glyphs 
+{
+	Glyph glyphs[256];
+};
+
+layout (std430, binding = 4) readonly buffer Strings 
+{
+	mat4 strings[];
+};
+
 layout (location = 0) out vec2 outUV;
+layout (location = 1) out vec4 outColor;
 
 void main() 
 {
-	outUV = inUV;
-	gl_Position = ubo.projection * ubo.model * vec4(inPos.xyz, 1.0);
+	// Generate the glyph quad's corners for a triangle strip of four vertices
+	vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+	Glyph glyph = glyphs[inIndices.x];
+	vec2 pos = inPos + glyph.quad.xy + corner * glyph.quad.zw;
+	outUV = mix(glyph.uv.xy, glyph.uv.zw, corner);
+	outColor = inColor;
+	gl_Position = ubo.projection * ubo.model * strings[inIndices.y] * vec4(pos, 0.0, 1.0);
 }
@@ -1,7 +1,17 @@
 #version 450
 
 layout (binding = 0) uniform sampler2D samplerColor0;
-layout (binding = 1) uniform sampler2D samplerColor1;
+
+layout (binding = 2) uniform Params {
+	float exposure;
+	int autoExposure;
+} params;
+
+// Written by the auto exposure compute passes
+layout (binding = 3) buffer readonly AutoExposure {
+	float averageLuminance;
+	float exposure;
+} autoExposure;
 
 layout (location = 0) in vec2 inUV;
 
@@ -9,5 +19,7 @@ layout (location = 0) out vec4 outColor;
 
 void main() 
 {
-	outColor = texture(samplerColor0, inUV);
-}
\ No newline at end of file
+	vec4 color = texture(samplerColor0, inUV);
+	float exposure = (params.autoExposure == 1) ? autoExposure.exposure : params.exposure;
+	outColor = vec4(vec3(1.0) - exp(-color.rgb * exposure), color.a);
+}
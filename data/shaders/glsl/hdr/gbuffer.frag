@@ -22,9 +22,16 @@ layout (constant_id = 0) const int type = 0;
 #define PI 3.1415926
 #define TwoPI (2.0 * PI)
 
-layout (binding = 2) uniform Exposure {
+layout (binding = 2) uniform Params {
 	float exposure;
-} exposure;
+	int autoExposure;
+} params;
+
+// Written by the auto exposure compute passes
+layout (binding = 3) buffer readonly AutoExposure {
+	float averageLuminance;
+	float exposure;
+} autoExposure;
 
 void main()
 {
@@ -85,12 +92,14 @@ void main()
 	}
 
 
-	// Color with manual exposure into attachment 0
-	outColor0.rgb = vec3(1.0) - exp(-color.rgb * exposure.exposure);
+	// High dynamic range color into attachment 0, exposure and tone mapping are applied by the composition pass
+	outColor0 = vec4(color.rgb, 1.0);
 
 	// Bright parts for bloom into attachment 1
-	float l = dot(outColor0.rgb, vec3(0.2126, 0.7152, 0.0722));
+	float exposure = (params.autoExposure == 1) ? autoExposure.exposure : params.exposure;
+	vec3 mapped = vec3(1.0) - exp(-color.rgb * exposure);
+	float l = dot(mapped, vec3(0.2126, 0.7152, 0.0722));
 	float threshold = 0.75;
-	outColor1.rgb = (l > threshold) ? outColor0.rgb : vec3(0.0);
+	outColor1.rgb = (l > threshold) ? mapped : vec3(0.0);
 	outColor1.a = 1.0;
 }
\ No newline at end of file
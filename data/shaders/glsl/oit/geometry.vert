@@ -13,8 +13,12 @@ layout(push_constant) uniform PushConsts {
     vec4 color;
 } pushConsts;
 
+layout (location = 0) out float outViewDepth;
+
 void main()
 {
-    mat4 PVM = renderPassUBO.projection * renderPassUBO.view * pushConsts.model;
-    gl_Position = PVM * vec4(inPos, 1.0);
+    vec4 viewPos = renderPassUBO.view * pushConsts.model * vec4(inPos, 1.0);
+    // Linear view space depth used by the weighted blending modes
+    outViewDepth = -viewPos.z;
+    gl_Position = renderPassUBO.projection * viewPos;
 }
@@ -0,0 +1,50 @@
+#version 450
+
+#define KBUFFER_LAYER_COUNT 8
+
+layout (location = 0) in float inViewDepth;
+
+layout (set = 0, binding = 0) uniform RenderPassUBO
+{
+    mat4 projection;
+    mat4 view;
+    uvec4 screen;
+} renderPassUBO;
+
+layout (set = 0, binding = 4) buffer KBufferSBO
+{
+    uint kbuffer[];
+};
+
+layout(push_constant) uniform PushConsts {
+	mat4 model;
+    vec4 color;
+} pushConsts;
+
+layout (location = 0) out vec4 outAccumulation;
+layout (location = 1) out float outRevealage;
+
+void main()
+{
+    uint base = (uint(gl_FragCoord.y) * renderPassUBO.screen.x + uint(gl_FragCoord.x)) * KBUFFER_LAYER_COUNT;
+    uint colorOffset = renderPassUBO.screen.x * renderPassUBO.screen.y * KBUFFER_LAYER_COUNT;
+    uint depth = floatBitsToUint(gl_FragCoord.z);
+    vec4 color = pushConsts.color;
+
+    // Fragments that made it into the k-buffer store their color for the sorted blend of the resolve pass
+    for (uint i = 0; i < KBUFFER_LAYER_COUNT; i++)
+    {
+        if (kbuffer[base + i] == depth)
+        {
+            kbuffer[colorOffset + base + i] = packUnorm4x8(color);
+            outAccumulation = vec4(0.0);
+            outRevealage = 0.0;
+            return;
+        }
+    }
+
+    // Fragments behind the k nearest ones are approximated using weighted blending
+    float weight = color.a * clamp(10.0 / (1e-5 + pow(inViewDepth / 5.0, 2.0) + pow(inViewDepth / 200.0, 6.0)), 1e-2, 3e3);
+    outAccumulation = vec4(color.rgb * color.a, color.a) * weight;
+    outRevealage = color.a;
+}
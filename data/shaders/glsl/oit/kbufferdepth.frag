@@ -0,0 +1,36 @@
+#version 450
+
+layout (early_fragment_tests) in;
+
+#define KBUFFER_LAYER_COUNT 8
+
+layout (set = 0, binding = 0) uniform RenderPassUBO
+{
+    mat4 projection;
+    mat4 view;
+    uvec4 screen;
+} renderPassUBO;
+
+// Depths of the nearest KBUFFER_LAYER_COUNT fragments per pixel in ascending order, followed by their packed colors
+layout (set = 0, binding = 4) buffer KBufferSBO
+{
+    uint kbuffer[];
+};
+
+void main()
+{
+    uint base = (uint(gl_FragCoord.y) * renderPassUBO.screen.x + uint(gl_FragCoord.x)) * KBUFFER_LAYER_COUNT;
+
+    // Positive floats compare like their bit patterns, so the depth can be inserted with atomic min operations
+    // A depth that's pushed out of a slot moves on to the next one until an empty slot is reached
+    uint depth = floatBitsToUint(gl_FragCoord.z);
+    for (uint i = 0; i < KBUFFER_LAYER_COUNT; i++)
+    {
+        uint prevDepth = atomicMin(kbuffer[base + i], depth);
+        if (prevDepth == 0xffffffff)
+        {
+            break;
+        }
+        depth = max(prevDepth, depth);
+    }
+}
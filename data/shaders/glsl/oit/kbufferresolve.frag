@@ -0,0 +1,45 @@
+#version 450
+
+#define KBUFFER_LAYER_COUNT 8
+
+layout (location = 0) out vec4 outFragColor;
+
+layout (set = 0, binding = 2) uniform sampler2D samplerAccumulation;
+layout (set = 0, binding = 3) uniform sampler2D samplerRevealage;
+
+layout (set = 0, binding = 4) buffer KBufferSBO
+{
+    uint kbuffer[];
+};
+
+layout (set = 0, binding = 5) uniform RenderPassUBO
+{
+    mat4 projection;
+    mat4 view;
+    uvec4 screen;
+} renderPassUBO;
+
+void main()
+{
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    uint base = (uint(coord.y) * renderPassUBO.screen.x + uint(coord.x)) * KBUFFER_LAYER_COUNT;
+    uint colorOffset = renderPassUBO.screen.x * renderPassUBO.screen.y * KBUFFER_LAYER_COUNT;
+
+    // Blend the weighted blended tail of fragments behind the k-buffer over the background
+    vec4 accumulation = texelFetch(samplerAccumulation, coord, 0);
+    float revealage = texelFetch(samplerRevealage, coord, 0).r;
+    vec4 color = vec4(0.025, 0.025, 0.025, 1.0f);
+    color.rgb = mix(color.rgb, accumulation.rgb / max(accumulation.a, 1e-5), 1.0 - revealage);
+
+    // The k-buffer is already sorted, blend from the farthest to the nearest fragment
+    for (int i = KBUFFER_LAYER_COUNT - 1; i >= 0; --i)
+    {
+        if (kbuffer[base + i] != 0xffffffff)
+        {
+            vec4 fragmentColor = unpackUnorm4x8(kbuffer[colorOffset + base + i]);
+            color = mix(color, fragmentColor, fragmentColor.a);
+        }
+    }
+
+    outFragColor = color;
+}
@@ -0,0 +1,25 @@
+#version 450
+
+layout (location = 0) in float inViewDepth;
+
+layout(push_constant) uniform PushConsts {
+	mat4 model;
+    vec4 color;
+} pushConsts;
+
+layout (location = 0) out vec4 outAccumulation;
+layout (location = 1) out float outRevealage;
+
+void main()
+{
+    vec4 color = pushConsts.color;
+
+    // Depth based weight (McGuire and Bavoil, "Weighted Blended Order-Independent Transparency", eq. 7)
+    // Clamped so the weighted sums stay within the range of the half float accumulation target
+    float weight = color.a * clamp(10.0 / (1e-5 + pow(inViewDepth / 5.0, 2.0) + pow(inViewDepth / 200.0, 6.0)), 1e-2, 3e3);
+
+    // Additively blended sum of weighted premultiplied colors
+    outAccumulation = vec4(color.rgb * color.a, color.a) * weight;
+    // Multiplicatively blended product of (1 - alpha)
+    outRevealage = color.a;
+}
@@ -0,0 +1,18 @@
+#version 450
+
+layout (location = 0) out vec4 outFragColor;
+
+layout (set = 0, binding = 2) uniform sampler2D samplerAccumulation;
+layout (set = 0, binding = 3) uniform sampler2D samplerRevealage;
+
+void main()
+{
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    vec4 accumulation = texelFetch(samplerAccumulation, coord, 0);
+    float revealage = texelFetch(samplerRevealage, coord, 0).r;
+
+    // Weighted average color of all fragments, covering the background by the combined opacity
+    vec3 background = vec3(0.025);
+    vec3 average = accumulation.rgb / max(accumulation.a, 1e-5);
+    outFragColor = vec4(mix(background, average, 1.0 - revealage), 1.0);
+}
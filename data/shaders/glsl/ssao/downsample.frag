@@ -0,0 +1,30 @@
+#version 450
+
+layout (binding = 0) uniform sampler2D samplerPositionDepth;
+layout (binding = 1) uniform sampler2D samplerNormal;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out vec4 outPosition;
+layout (location = 1) out vec4 outNormal;
+
+void main() 
+{
+	// Select the closest of the 2x2 source texels instead of averaging, so no positions/normals are invented at depth discontinuities
+	ivec2 srcCoord = ivec2(gl_FragCoord.xy) * 2;
+	ivec2 srcMax = textureSize(samplerPositionDepth, 0) - 1;
+	ivec2 closest = min(srcCoord, srcMax);
+	float closestDepth = texelFetch(samplerPositionDepth, closest, 0).w;
+	for (int i = 1; i < 4; i++)
+	{
+		ivec2 coord = min(srcCoord + ivec2(i & 1, i >> 1), srcMax);
+		float depth = texelFetch(samplerPositionDepth, coord, 0).w;
+		if (depth < closestDepth)
+		{
+			closestDepth = depth;
+			closest = coord;
+		}
+	}
+	outPosition = texelFetch(samplerPositionDepth, closest, 0);
+	outNormal = texelFetch(samplerNormal, closest, 0);
+}
@@ -6,6 +6,8 @@ layout (binding = 2) uniform sampler2D ssaoNoise;
 
 layout (constant_id = 0) const int SSAO_KERNEL_SIZE = 64;
 layout (constant_id = 1) const float SSAO_RADIUS = 0.5;
+// Number of kernel samples evaluated per pixel, if lower than the kernel size a different subset of the kernel is used every frame
+layout (constant_id = 2) const int SSAO_SAMPLE_COUNT = 64;
 
 layout (binding = 3) uniform UBOSSAOKernel
 {
@@ -15,6 +17,11 @@ layout (binding = 3) uniform UBOSSAOKernel
 layout (binding = 4) uniform UBO 
 {
 	mat4 projection;
+	int ssao;
+	int ssaoOnly;
+	int ssaoBlur;
+	// Changes every frame if the result is accumulated temporally, zero otherwise
+	uint frameIndex;
 } ubo;
 
 layout (location = 0) in vec2 inUV;
@@ -32,6 +39,9 @@ void main()
 	ivec2 noiseDim = textureSize(ssaoNoise, 0);
 	const vec2 noiseUV = vec2(float(texDim.x)/float(noiseDim.x), float(texDim.y)/(noiseDim.y)) * inUV;  
 	vec3 randomVec = texture(ssaoNoise, noiseUV).xyz * 2.0 - 1.0;
+	// Rotate the noise by the golden angle every frame, so temporal accumulation converges to a smooth result
+	float angle = float(ubo.frameIndex) * 2.39996323;
+	randomVec.xy = mat2(cos(angle), sin(angle), -sin(angle), cos(angle)) * randomVec.xy;
 	
 	// Create TBN matrix
 	vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
@@ -42,9 +52,11 @@ void main()
 	float occlusion = 0.0f;
 	// remove banding
 	const float bias = 0.025f;
-	for(int i = 0; i < SSAO_KERNEL_SIZE; i++)
+	const int kernelStride = SSAO_KERNEL_SIZE / SSAO_SAMPLE_COUNT;
+	const int kernelOffset = int(ubo.frameIndex % uint(kernelStride));
+	for(int i = 0; i < SSAO_SAMPLE_COUNT; i++)
 	{		
-		vec3 samplePos = TBN * uboSSAOKernel.samples[i].xyz; 
+		vec3 samplePos = TBN * uboSSAOKernel.samples[i * kernelStride + kernelOffset].xyz; 
 		samplePos = fragPos + samplePos * SSAO_RADIUS; 
 		
 		// project
@@ -58,7 +70,7 @@ void main()
 		float rangeCheck = smoothstep(0.0f, 1.0f, SSAO_RADIUS / abs(fragPos.z - sampleDepth));
 		occlusion += (sampleDepth >= samplePos.z + bias ? 1.0f : 0.0f) * rangeCheck;           
 	}
-	occlusion = 1.0 - (occlusion / float(SSAO_KERNEL_SIZE));
+	occlusion = 1.0 - (occlusion / float(SSAO_SAMPLE_COUNT));
 	
 	outFragColor = occlusion;
 }
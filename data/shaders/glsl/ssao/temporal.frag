@@ -0,0 +1,42 @@
+#version 450
+
+layout (binding = 0) uniform sampler2D samplerSSAO;
+layout (binding = 1) uniform sampler2D samplerPositionDepth;
+layout (binding = 2) uniform sampler2D samplerHistory;
+
+layout (binding = 3) uniform UBO 
+{
+	// Transforms current view space positions into the previous frame's clip space
+	mat4 reprojection;
+	float blendFactor;
+	int historyValid;
+} ubo;
+
+layout (location = 0) in vec2 inUV;
+
+// Accumulated occlusion and view space depth (for disocclusion tests and the depth-aware upsampling)
+layout (location = 0) out vec2 outFragColor;
+
+void main() 
+{
+	vec3 fragPos = texture(samplerPositionDepth, inUV).xyz;
+	float occlusion = texture(samplerSSAO, inUV).r;
+
+	if (ubo.historyValid == 1)
+	{
+		// Find the position of this fragment in the previous frame
+		vec4 prevPos = ubo.reprojection * vec4(fragPos, 1.0);
+		vec2 prevUV = prevPos.xy / prevPos.w * 0.5 + 0.5;
+		if (all(greaterThanEqual(prevUV, vec2(0.0))) && all(lessThanEqual(prevUV, vec2(1.0))))
+		{
+			vec2 history = texture(samplerHistory, prevUV).rg;
+			// Discard the history if the depths don't match (the surface was occluded in the previous frame)
+			if (abs(history.g - prevPos.w) < 0.05 * prevPos.w)
+			{
+				occlusion = mix(history.r, occlusion, ubo.blendFactor);
+			}
+		}
+	}
+
+	outFragColor = vec2(occlusion, -fragPos.z);
+}
@@ -0,0 +1,32 @@
+#version 450
+
+layout (binding = 0) uniform sampler2D samplerSSAO;
+layout (binding = 1) uniform sampler2D samplerPositionDepth;
+
+layout (location = 0) in vec2 inUV;
+
+layout (location = 0) out float outFragColor;
+
+void main() 
+{
+	float depth = -texture(samplerPositionDepth, inUV).z;
+
+	// Bilinear weights of the four closest low resolution texels, scaled down for texels with a different depth
+	ivec2 texDim = textureSize(samplerSSAO, 0);
+	vec2 texPos = inUV * vec2(texDim) - 0.5;
+	ivec2 baseCoord = ivec2(floor(texPos));
+	vec2 f = fract(texPos);
+	float occlusion = 0.0;
+	float weightSum = 0.0;
+	for (int i = 0; i < 4; i++)
+	{
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		vec2 ssao = texelFetch(samplerSSAO, clamp(baseCoord + offset, ivec2(0), texDim - 1), 0).rg;
+		float bilinearWeight = (offset.x == 1 ? f.x : 1.0 - f.x) * (offset.y == 1 ? f.y : 1.0 - f.y);
+		float depthWeight = 1.0 / (0.001 + abs(ssao.g - depth) / max(depth, 0.001));
+		float weight = bilinearWeight * depthWeight;
+		occlusion += ssao.r * weight;
+		weightSum += weight;
+	}
+	outFragColor = (weightSum > 0.0) ? occlusion / weightSum : texture(samplerSSAO, inUV).r;
+}
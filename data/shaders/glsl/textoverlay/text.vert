@@ -1,7 +1,13 @@
 #version 450 core
 
-layout (location = 0) in vec2 inPos;
-layout (location = 1) in vec2 inUV;
+// Per instance glyph data
+layout (location = 0) in vec4 inRect;
+layout (location = 1) in vec4 inUV;
+
+layout (push_constant) uniform PushConsts {
+	// Pixel to normalized device coordinate scale
+	vec2 scale;
+} pushConsts;
 
 layout (location = 0) out vec2 outUV;
 
@@ -12,6 +18,8 @@ out gl_PerVertex
 
 void main(void)
 {
-	gl_Position = vec4(inPos, 0.0, 1.0);
-	outUV = inUV;
+	// Generate the quad's corners for a triangle strip of four vertices
+	vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+	gl_Position = vec4(mix(inRect.xy, inRect.zw, corner) * pushConsts.scale - 1.0, 0.0, 1.0);
+	outUV = mix(inUV.xy, inUV.zw, corner);
 }
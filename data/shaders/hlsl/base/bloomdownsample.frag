@@ -0,0 +1,66 @@
+// Copyright 2020 Google LLC
+
+// 13-tap downsample filter, combining five overlapping 2x2 box filters (Jimenez, "Next generation post processing in Call of Duty: Advanced Warfare")
+
+Texture2D textureSource : register(t0);
+SamplerState samplerSource : register(s0);
+
+struct PushConsts {
+	float2 sourceTexelSize;
+	float filterRadius;
+	// Set for the first downsample to suppress fireflies (single very bright pixels) with a Karis average
+	int karisAverage;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
+float karisWeight(float3 color)
+{
+	float luma = dot(color, float3(0.2126, 0.7152, 0.0722));
+	return 1.0 / (1.0 + luma);
+}
+
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	float2 t = pushConsts.sourceTexelSize;
+
+	float3 a = textureSource.Sample(samplerSource, inUV + t * float2(-2.0,  2.0)).rgb;
+	float3 b = textureSource.Sample(samplerSource, inUV + t * float2( 0.0,  2.0)).rgb;
+	float3 c = textureSource.Sample(samplerSource, inUV + t * float2( 2.0,  2.0)).rgb;
+	float3 d = textureSource.Sample(samplerSource, inUV + t * float2(-2.0,  0.0)).rgb;
+	float3 e = textureSource.Sample(samplerSource, inUV).rgb;
+	float3 f = textureSource.Sample(samplerSource, inUV + t * float2( 2.0,  0.0)).rgb;
+	float3 g = textureSource.Sample(samplerSource, inUV + t * float2(-2.0, -2.0)).rgb;
+	float3 h = textureSource.Sample(samplerSource, inUV + t * float2( 0.0, -2.0)).rgb;
+	float3 i = textureSource.Sample(samplerSource, inUV + t * float2( 2.0, -2.0)).rgb;
+	float3 j = textureSource.Sample(samplerSource, inUV + t * float2(-1.0,  1.0)).rgb;
+	float3 k = textureSource.Sample(samplerSource, inUV + t * float2( 1.0,  1.0)).rgb;
+	float3 l = textureSource.Sample(samplerSource, inUV + t * float2(-1.0, -1.0)).rgb;
+	float3 m = textureSource.Sample(samplerSource, inUV + t * float2( 1.0, -1.0)).rgb;
+
+	// The center box contributes half, the four corner boxes an eighth each
+	float3 boxes[5] = {
+		(j + k + l + m) * 0.25,
+		(a + b + d + e) * 0.25,
+		(b + c + e + f) * 0.25,
+		(d + e + g + h) * 0.25,
+		(e + f + h + i) * 0.25
+	};
+	float weights[5] = { 0.5, 0.125, 0.125, 0.125, 0.125 };
+
+	float3 color = float3(0.0, 0.0, 0.0);
+	if (pushConsts.karisAverage == 1) {
+		float weightSum = 0.0;
+		for (int n = 0; n < 5; n++) {
+			float w = weights[n] * karisWeight(boxes[n]);
+			color += boxes[n] * w;
+			weightSum += w;
+		}
+		color /= weightSum;
+	} else {
+		for (int n = 0; n < 5; n++) {
+			color += boxes[n] * weights[n];
+		}
+	}
+
+	return float4(color, 1.0);
+}
@@ -0,0 +1,30 @@
+// Copyright 2020 Google LLC
+
+// 3x3 tent filter upsample, the result is added to the destination mip level using additive blending
+
+Texture2D textureSource : register(t0);
+SamplerState samplerSource : register(s0);
+
+struct PushConsts {
+	float2 sourceTexelSize;
+	float filterRadius;
+	int karisAverage;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	float2 t = pushConsts.sourceTexelSize * pushConsts.filterRadius;
+
+	float3 color = textureSource.Sample(samplerSource, inUV).rgb * 4.0;
+	color += textureSource.Sample(samplerSource, inUV + t * float2( 0.0,  1.0)).rgb * 2.0;
+	color += textureSource.Sample(samplerSource, inUV + t * float2(-1.0,  0.0)).rgb * 2.0;
+	color += textureSource.Sample(samplerSource, inUV + t * float2( 1.0,  0.0)).rgb * 2.0;
+	color += textureSource.Sample(samplerSource, inUV + t * float2( 0.0, -1.0)).rgb * 2.0;
+	color += textureSource.Sample(samplerSource, inUV + t * float2(-1.0,  1.0)).rgb;
+	color += textureSource.Sample(samplerSource, inUV + t * float2( 1.0,  1.0)).rgb;
+	color += textureSource.Sample(samplerSource, inUV + t * float2(-1.0, -1.0)).rgb;
+	color += textureSource.Sample(samplerSource, inUV + t * float2( 1.0, -1.0)).rgb;
+
+	return float4(color / 16.0, 1.0);
+}
@@ -0,0 +1,15 @@
+// Copyright 2020 Google LLC
+
+Texture2D textureBloom : register(t1);
+SamplerState samplerBloom : register(s1);
+
+cbuffer UBO : register(b0)
+{
+	float strength;
+};
+
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	// Added on top of the scene using additive blending
+	return float4(textureBloom.Sample(samplerBloom, inUV).rgb * strength, 1.0);
+}
@@ -67,6 +67,7 @@ for root, dirs, files in os.walk(dir_path):
                 '-fspv-extension=SPV_KHR_multiview',
                 '-fspv-extension=SPV_KHR_shader_draw_parameters',
                 '-fspv-extension=SPV_EXT_descriptor_indexing',
+                '-fspv-extension=SPV_EXT_shader_viewport_index_layer',
                 target,
                 hlsl_file,
                 '-Fo', spv_out])
@@ -7,7 +7,10 @@ SamplerState samplerNormal : register(s2);
 Texture2D textureAlbedo : register(t3);
 SamplerState samplerAlbedo : register(s3);
 
+#define MAX_LIGHTS_PER_CLUSTER 256
+
 struct Light {
+	// xyz = world space position, w = range
 	float4 position;
 	float3 color;
 	float radius;
@@ -15,52 +18,87 @@ struct Light {
 
 struct UBO
 {
-	Light lights[6];
 	float4 viewPos;
 	int displayDebugTarget;
 };
 
 cbuffer ubo : register(b4) { UBO ubo; }
 
+StructuredBuffer<Light> lights : register(t5);
+StructuredBuffer<uint> clusterLightCounts : register(t6);
+StructuredBuffer<uint> clusterLightIndices : register(t7);
+
+struct UBOClusters
+{
+	float4x4 view;
+	float4x4 inverseProjection;
+	float4 screen;
+	uint4 grid;
+};
+
+cbuffer uboClusters : register(b8) { UBOClusters uboClusters; }
 
-float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+// Index of the cluster containing the given world space position, must match the cluster assignment of the light culling compute shader
+uint clusterIndex(float3 fragPos, float2 fragCoord)
+{
+	float depth = max(-mul(uboClusters.view, float4(fragPos, 1.0)).z, uboClusters.screen.z);
+	uint2 tile = min(uint2(fragCoord / uboClusters.screen.xy * float2(uboClusters.grid.xy)), uboClusters.grid.xy - 1);
+	float slice = floor(log(depth / uboClusters.screen.z) / log(uboClusters.screen.w / uboClusters.screen.z) * float(uboClusters.grid.z));
+	uint z = uint(clamp(slice, 0.0, float(uboClusters.grid.z - 1)));
+	return tile.x + tile.y * uboClusters.grid.x + z * uboClusters.grid.x * uboClusters.grid.y;
+}
+
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0, float4 fragCoord : SV_POSITION) : SV_TARGET
 {
 	// Get G-Buffer values
 	float3 fragPos = textureposition.Sample(samplerposition, inUV).rgb;
 	float3 normal = textureNormal.Sample(samplerNormal, inUV).rgb;
 	float4 albedo = textureAlbedo.Sample(samplerAlbedo, inUV);
 
+	uint cluster = clusterIndex(fragPos, fragCoord.xy);
+	uint lightCount = clusterLightCounts[cluster];
+
 	float3 fragcolor;
 
 	// Debug display
 	if (ubo.displayDebugTarget > 0) {
 		switch (ubo.displayDebugTarget) {
-			case 1: 
+			case 1:
 				fragcolor.rgb = fragPos;
 				break;
-			case 2: 
+			case 2:
 				fragcolor.rgb = normal;
 				break;
-			case 3: 
+			case 3:
 				fragcolor.rgb = albedo.rgb;
 				break;
-			case 4: 
+			case 4:
 				fragcolor.rgb = albedo.aaa;
 				break;
-		}		
+			case 5:
+				// Number of lights in the fragment's cluster (green = none, red = MAX_LIGHTS_PER_CLUSTER / 4 or more, magenta = lights had to be dropped)
+				float heat = clamp(float(lightCount) / float(MAX_LIGHTS_PER_CLUSTER / 4), 0.0, 1.0);
+				fragcolor.rgb = lerp(float3(0.0, 1.0, 0.0), float3(1.0, 0.0, 0.0), heat) * (lightCount > 0 ? 1.0 : 0.25);
+				if (lightCount > MAX_LIGHTS_PER_CLUSTER) {
+					fragcolor.rgb = float3(1.0, 0.0, 1.0);
+				}
+				break;
+		}
 		return float4(fragcolor, 1.0);
 	}
 
-	#define lightCount 6
 	#define ambient 0.0
 
 	// Ambient part
 	fragcolor = albedo.rgb * ambient;
 
-	for(int i = 0; i < lightCount; ++i)
+	// Only the lights assigned to this fragment's cluster need to be evaluated, clusters that overflowed only store the first MAX_LIGHTS_PER_CLUSTER lights
+	for(uint i = 0; i < min(lightCount, (uint)MAX_LIGHTS_PER_CLUSTER); ++i)
 	{
+		Light light = lights[clusterLightIndices[cluster * MAX_LIGHTS_PER_CLUSTER + i]];
+
 		// Vector to light
-		float3 L = ubo.lights[i].position.xyz - fragPos;
+		float3 L = light.position.xyz - fragPos;
 		// Distance from light to fragment position
 		float dist = length(L);
 
@@ -68,28 +106,29 @@ float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 		float3 V = ubo.viewPos.xyz - fragPos;
 		V = normalize(V);
 
-		//if(dist < ubo.lights[i].radius)
+		if(dist < light.position.w)
 		{
 			// Light to fragment
 			L = normalize(L);
 
-			// Attenuation
-			float atten = ubo.lights[i].radius / (pow(dist, 2.0) + 1.0);
+			// Attenuation, windowed so the light's contribution smoothly falls to zero at its range
+			float window = clamp(1.0 - pow(dist / light.position.w, 4.0), 0.0, 1.0);
+			float atten = light.radius / (pow(dist, 2.0) + 1.0) * window * window;
 
 			// Diffuse part
 			float3 N = normalize(normal);
 			float NdotL = max(0.0, dot(N, L));
-			float3 diff = ubo.lights[i].color * albedo.rgb * NdotL * atten;
+			float3 diff = light.color * albedo.rgb * NdotL * atten;
 
 			// Specular part
 			// Specular map values are stored in alpha of albedo mrt
 			float3 R = reflect(-L, N);
 			float NdotR = max(0.0, dot(R, V));
-			float3 spec = ubo.lights[i].color * albedo.a * pow(NdotR, 16.0) * atten;
+			float3 spec = light.color * albedo.a * pow(NdotR, 16.0) * atten;
 
 			fragcolor += diff + spec;
 		}
 	}
 
   return float4(fragcolor, 1.0);
-}
\ No newline at end of file
+}
@@ -12,6 +12,7 @@ Texture2DArray textureShadowMap : register(t5);
 SamplerState samplerShadowMap : register(s5);
 
 #define LIGHT_COUNT 3
+#define MAX_LIGHTS_PER_CLUSTER 256
 #define SHADOW_FACTOR 0.25
 #define AMBIENT_LIGHT 0.1
 #define USE_PCF
@@ -34,6 +35,28 @@ struct UBO
 
 cbuffer ubo : register(b4) { UBO ubo; }
 
+// Unshadowed point lights, assigned to view space clusters by the light culling compute shader
+struct PointLight {
+	// xyz = world space position, w = range
+	float4 position;
+	float3 color;
+	float radius;
+};
+
+StructuredBuffer<PointLight> pointLights : register(t6);
+StructuredBuffer<uint> clusterLightCounts : register(t7);
+StructuredBuffer<uint> clusterLightIndices : register(t8);
+
+struct UBOClusters
+{
+	float4x4 view;
+	float4x4 inverseProjection;
+	float4 screen;
+	uint4 grid;
+};
+
+cbuffer uboClusters : register(b9) { UBOClusters uboClusters; }
+
 float textureProj(float4 P, float layer, float2 offset)
 {
 	float shadow = 1.0;
@@ -75,6 +98,16 @@ float filterPCF(float4 sc, float layer)
 	return shadowFactor / count;
 }
 
+// Index of the cluster containing the given world space position, must match the cluster assignment of the light culling compute shader
+uint clusterIndex(float3 fragPos, float2 fragCoord)
+{
+	float depth = max(-mul(uboClusters.view, float4(fragPos, 1.0)).z, uboClusters.screen.z);
+	uint2 tile = min(uint2(fragCoord / uboClusters.screen.xy * float2(uboClusters.grid.xy)), uboClusters.grid.xy - 1);
+	float slice = floor(log(depth / uboClusters.screen.z) / log(uboClusters.screen.w / uboClusters.screen.z) * float(uboClusters.grid.z));
+	uint z = uint(clamp(slice, 0.0, float(uboClusters.grid.z - 1)));
+	return tile.x + tile.y * uboClusters.grid.x + z * uboClusters.grid.x * uboClusters.grid.y;
+}
+
 float3 shadow(float3 fragcolor, float3 fragPos) {
 	for (int i = 0; i < LIGHT_COUNT; ++i)
 	{
@@ -92,13 +125,16 @@ float3 shadow(float3 fragcolor, float3 fragPos) {
 	return fragcolor;
 }
 
-float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0, float4 fragCoord : SV_POSITION) : SV_TARGET
 {
 	// Get G-Buffer values
 	float3 fragPos = textureposition.Sample(samplerposition, inUV).rgb;
 	float3 normal = textureNormal.Sample(samplerNormal, inUV).rgb;
 	float4 albedo = textureAlbedo.Sample(samplerAlbedo, inUV);
 
+	uint cluster = clusterIndex(fragPos, fragCoord.xy);
+	uint lightCount = clusterLightCounts[cluster];
+
 	float3 fragcolor;
 
 	// Debug display
@@ -119,6 +155,14 @@ float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 			case 5: 
 				fragcolor.rgb = albedo.aaa;
 				break;
+			case 6:
+				// Number of point lights in the fragment's cluster (green = none, red = MAX_LIGHTS_PER_CLUSTER / 4 or more, magenta = lights had to be dropped)
+				float heat = clamp(float(lightCount) / float(MAX_LIGHTS_PER_CLUSTER / 4), 0.0, 1.0);
+				fragcolor.rgb = lerp(float3(0.0, 1.0, 0.0), float3(1.0, 0.0, 0.0), heat) * (lightCount > 0 ? 1.0 : 0.25);
+				if (lightCount > MAX_LIGHTS_PER_CLUSTER) {
+					fragcolor.rgb = float3(1.0, 0.0, 1.0);
+				}
+				break;
 		}		
 		return float4(fragcolor, 1.0);
 	}
@@ -170,5 +214,28 @@ float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 		fragcolor = shadow(fragcolor, fragPos);
 	}
 
+	// Point lights don't cast shadows, only the ones assigned to this fragment's cluster need to be evaluated
+	float3 V = normalize(ubo.viewPos.xyz - fragPos);
+	for(uint i = 0; i < min(lightCount, (uint)MAX_LIGHTS_PER_CLUSTER); ++i)
+	{
+		PointLight light = pointLights[clusterLightIndices[cluster * MAX_LIGHTS_PER_CLUSTER + i]];
+
+		float3 L = light.position.xyz - fragPos;
+		float dist = length(L);
+		if (dist < light.position.w)
+		{
+			L = normalize(L);
+
+			// Attenuation, windowed so the light's contribution smoothly falls to zero at its range
+			float window = clamp(1.0 - pow(dist / light.position.w, 4.0), 0.0, 1.0);
+			float atten = light.radius / (pow(dist, 2.0) + 1.0) * window * window;
+
+			float NdotL = max(0.0, dot(N, L));
+			float3 R = reflect(-L, N);
+			float NdotR = max(0.0, dot(R, V));
+			fragcolor += light.color * (albedo.rgb * NdotL + albedo.a * pow(NdotR, 16.0)) * atten;
+		}
+	}
+
 	return float4(fragcolor, 1);
 }
\ No newline at end of file
@@ -3,7 +3,7 @@
 Texture2D textureColor : register(t1);
 SamplerState samplerColor : register(s1);
 
-float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0, [[vk::location(1)]] float4 inColor : COLOR0) : SV_TARGET
 {
-	return textureColor.Sample(samplerColor, inUV).aaaa;
+	return textureColor.Sample(samplerColor, inUV).a * inColor;
 }
\ No newline at end of file
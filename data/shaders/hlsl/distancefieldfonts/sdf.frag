@@ -12,12 +12,12 @@ struct UBO
 
 cbuffer ubo : register(b2) { UBO ubo; }
 
-float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0, [[vk::location(1)]] float4 inColor : COLOR0) : SV_TARGET
 {
     float dist = textureColor.Sample(samplerColor, inUV).a;
     float smoothWidth = fwidth(dist);
     float alpha = smoothstep(0.5 - smoothWidth, 0.5 + smoothWidth, dist);
-	float3 rgb = alpha.xxx;
+	float3 rgb = alpha.xxx * inColor.rgb;
 
 	if (ubo.outline > 0.0)
 	{
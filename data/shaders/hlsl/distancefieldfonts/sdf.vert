@@ -1,9 +1,12 @@
 // Copyright 2020 Google LLC
 
+// Per instance glyph data
 struct VSInput
 {
-[[vk::location(0)]] float3 Pos : POSITION0;
-[[vk::location(1)]] float2 UV : TEXCOORD0;
+[[vk::location(0)]] float2 Pos : POSITION0;
+[[vk::location(1)]] uint2 Indices : TEXCOORD0;
+[[vk::location(2)]] float4 Color : COLOR0;
+uint VertexIndex : SV_VertexID;
 };
 
 struct UBO
@@ -14,16 +17,32 @@ struct UBO
 
 cbuffer ubo : register(b0) { UBO ubo; }
 
+struct Glyph
+{
+	float4 uv;
+	float4 quad;
+};
+
+cbuffer glyphs : register(b3) { Glyph glyphs[256]; }
+
+StructuredBuffer<float4x4> strings : register(t4);
+
 struct VSOutput
 {
 	float4 Pos : SV_POSITION;
 [[vk::location(0)]] float2 UV : TEXCOORD0;
+[[vk::location(1)]] float4 Color : COLOR0;
 };
 
 VSOutput main(VSInput input)
 {
 	VSOutput output = (VSOutput)0;
-	output.UV = input.UV;
-	output.Pos = mul(ubo.projection, mul(ubo.model, float4(input.Pos.xyz, 1.0)));
+	// Generate the glyph quad's corners for a triangle strip of four vertices
+	float2 corner = float2(input.VertexIndex & 1, input.VertexIndex >> 1);
+	Glyph glyph = glyphs[input.Indices.x];
+	float2 pos = input.Pos + glyph.quad.xy + corner * glyph.quad.zw;
+	output.UV = lerp(glyph.uv.xy, glyph.uv.zw, corner);
+	output.Color = input.Color;
+	output.Pos = mul(ubo.projection, mul(ubo.model, mul(strings[input.Indices.y], float4(pos, 0.0, 1.0))));
 	return output;
 }
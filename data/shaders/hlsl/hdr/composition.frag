@@ -2,10 +2,25 @@
 
 Texture2D textureColor0 : register(t0);
 SamplerState samplerColor0 : register(s0);
-Texture2D textureColor1 : register(t1);
-SamplerState samplerColor1 : register(s1);
+
+struct Params {
+	float exposure;
+	int autoExposure;
+};
+
+cbuffer params : register(b2) { Params params; }
+
+struct AutoExposure {
+	float averageLuminance;
+	float exposure;
+};
+
+// Written by the auto exposure compute passes
+StructuredBuffer<AutoExposure> autoExposure : register(t3);
 
 float4 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 {
-	return textureColor0.Sample(samplerColor0, inUV);
-}
\ No newline at end of file
+	float4 color = textureColor0.Sample(samplerColor0, inUV);
+	float exposure = (params.autoExposure == 1) ? autoExposure[0].exposure : params.exposure;
+	return float4(float3(1.0, 1.0, 1.0) - exp(-color.rgb * exposure), color.a);
+}
@@ -31,10 +31,20 @@ struct UBO  {
 
 cbuffer ubo : register(b0) { UBO ubo; }
 
-cbuffer Exposure : register(b2)
-{
+struct Params {
 	float exposure;
-}
+	int autoExposure;
+};
+
+cbuffer params : register(b2) { Params params; }
+
+struct AutoExposure {
+	float averageLuminance;
+	float exposure;
+};
+
+// Written by the auto exposure compute passes
+StructuredBuffer<AutoExposure> autoExposure : register(t3);
 
 FSOutput main(VSOutput input)
 {
@@ -96,13 +106,15 @@ FSOutput main(VSOutput input)
 	}
 
 
-	// Color with manual exposure into attachment 0
-	output.Color0.rgb = float3(1.0, 1.0, 1.0) - exp(-color.rgb * exposure);
+	// High dynamic range color into attachment 0, exposure and tone mapping are applied by the composition pass
+	output.Color0 = float4(color.rgb, 1.0);
 
 	// Bright parts for bloom into attachment 1
-	float l = dot(output.Color0.rgb, float3(0.2126, 0.7152, 0.0722));
+	float exposure = (params.autoExposure == 1) ? autoExposure[0].exposure : params.exposure;
+	float3 mapped = float3(1.0, 1.0, 1.0) - exp(-color.rgb * exposure);
+	float l = dot(mapped, float3(0.2126, 0.7152, 0.0722));
 	float threshold = 0.75;
-	output.Color1.rgb = (l > threshold) ? output.Color0.rgb : float3(0.0, 0.0, 0.0);
+	output.Color1.rgb = (l > threshold) ? mapped : float3(0.0, 0.0, 0.0);
 	output.Color1.a = 1.0;
 	return output;
 }
\ No newline at end of file
@@ -22,11 +22,15 @@ struct PushConsts {
 struct VSOutput
 {
 	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float ViewDepth : TEXCOORD0;
 };
 
 VSOutput main(VSInput input)
 {
 	VSOutput output = (VSOutput)0;
-	output.Pos = mul(renderPassUBO.projection, mul(renderPassUBO.view, mul(pushConsts.model, input.Pos)));
+	float4 viewPos = mul(renderPassUBO.view, mul(pushConsts.model, input.Pos));
+	// Linear view space depth used by the weighted blending modes
+	output.ViewDepth = -viewPos.z;
+	output.Pos = mul(renderPassUBO.projection, viewPos);
     return output;
 }
@@ -0,0 +1,63 @@
+// Copyright 2020 Sascha Willems
+
+#define KBUFFER_LAYER_COUNT 8
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float ViewDepth : TEXCOORD0;
+};
+
+struct RenderPassUBO
+{
+    float4x4 projection;
+    float4x4 view;
+    uint4 screen;
+};
+
+cbuffer renderPassUBO : register(b0) { RenderPassUBO renderPassUBO; }
+
+RWStructuredBuffer<uint> kbuffer : register(u4);
+
+struct PushConsts {
+	float4x4 model;
+	float4 color;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
+struct FSOutput
+{
+	float4 Accumulation : SV_TARGET0;
+	float Revealage : SV_TARGET1;
+};
+
+uint packColor(float4 color)
+{
+	uint4 c = uint4(round(saturate(color) * 255.0));
+	return c.r | (c.g << 8) | (c.b << 16) | (c.a << 24);
+}
+
+FSOutput main(VSOutput input)
+{
+	FSOutput output = (FSOutput)0;
+	uint base = (uint(input.Pos.y) * renderPassUBO.screen.x + uint(input.Pos.x)) * KBUFFER_LAYER_COUNT;
+	uint colorOffset = renderPassUBO.screen.x * renderPassUBO.screen.y * KBUFFER_LAYER_COUNT;
+	uint depth = asuint(input.Pos.z);
+	float4 color = pushConsts.color;
+
+	// Fragments that made it into the k-buffer store their color for the sorted blend of the resolve pass
+	for (uint i = 0; i < KBUFFER_LAYER_COUNT; i++)
+	{
+		if (kbuffer[base + i] == depth)
+		{
+			kbuffer[colorOffset + base + i] = packColor(color);
+			return output;
+		}
+	}
+
+	// Fragments behind the k nearest ones are approximated using weighted blending
+	float weight = color.a * clamp(10.0 / (1e-5 + pow(input.ViewDepth / 5.0, 2.0) + pow(input.ViewDepth / 200.0, 6.0)), 1e-2, 3e3);
+	output.Accumulation = float4(color.rgb * color.a, color.a) * weight;
+	output.Revealage = color.a;
+	return output;
+}
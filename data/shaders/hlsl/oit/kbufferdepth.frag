@@ -0,0 +1,40 @@
+// Copyright 2020 Sascha Willems
+
+#define KBUFFER_LAYER_COUNT 8
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+};
+
+struct RenderPassUBO
+{
+    float4x4 projection;
+    float4x4 view;
+    uint4 screen;
+};
+
+cbuffer renderPassUBO : register(b0) { RenderPassUBO renderPassUBO; }
+
+// Depths of the nearest KBUFFER_LAYER_COUNT fragments per pixel in ascending order, followed by their packed colors
+RWStructuredBuffer<uint> kbuffer : register(u4);
+
+[earlydepthstencil]
+void main(VSOutput input)
+{
+    uint base = (uint(input.Pos.y) * renderPassUBO.screen.x + uint(input.Pos.x)) * KBUFFER_LAYER_COUNT;
+
+    // Positive floats compare like their bit patterns, so the depth can be inserted with atomic min operations
+    // A depth that's pushed out of a slot moves on to the next one until an empty slot is reached
+    uint depth = asuint(input.Pos.z);
+    for (uint i = 0; i < KBUFFER_LAYER_COUNT; i++)
+    {
+        uint prevDepth;
+        InterlockedMin(kbuffer[base + i], depth, prevDepth);
+        if (prevDepth == 0xffffffff)
+        {
+            break;
+        }
+        depth = max(prevDepth, depth);
+    }
+}
@@ -0,0 +1,54 @@
+// Copyright 2020 Sascha Willems
+
+#define KBUFFER_LAYER_COUNT 8
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+};
+
+Texture2D textureAccumulation : register(t2);
+SamplerState samplerAccumulation : register(s2);
+Texture2D textureRevealage : register(t3);
+SamplerState samplerRevealage : register(s3);
+
+RWStructuredBuffer<uint> kbuffer : register(u4);
+
+struct RenderPassUBO
+{
+    float4x4 projection;
+    float4x4 view;
+    uint4 screen;
+};
+
+cbuffer renderPassUBO : register(b5) { RenderPassUBO renderPassUBO; }
+
+float4 unpackColor(uint color)
+{
+	return float4(color & 0xff, (color >> 8) & 0xff, (color >> 16) & 0xff, color >> 24) / 255.0;
+}
+
+float4 main(VSOutput input) : SV_TARGET
+{
+	int3 coord = int3(input.Pos.xy, 0);
+	uint base = (uint(coord.y) * renderPassUBO.screen.x + uint(coord.x)) * KBUFFER_LAYER_COUNT;
+	uint colorOffset = renderPassUBO.screen.x * renderPassUBO.screen.y * KBUFFER_LAYER_COUNT;
+
+	// Blend the weighted blended tail of fragments behind the k-buffer over the background
+	float4 accumulation = textureAccumulation.Load(coord);
+	float revealage = textureRevealage.Load(coord).r;
+	float4 color = float4(0.025, 0.025, 0.025, 1.0f);
+	color.rgb = lerp(color.rgb, accumulation.rgb / max(accumulation.a, 1e-5), 1.0 - revealage);
+
+	// The k-buffer is already sorted, blend from the farthest to the nearest fragment
+	for (int i = KBUFFER_LAYER_COUNT - 1; i >= 0; --i)
+	{
+		if (kbuffer[base + i] != 0xffffffff)
+		{
+			float4 fragmentColor = unpackColor(kbuffer[colorOffset + base + i]);
+			color = lerp(color, fragmentColor, fragmentColor.a);
+		}
+	}
+
+	return color;
+}
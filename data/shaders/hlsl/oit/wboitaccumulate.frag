@@ -0,0 +1,35 @@
+// Copyright 2020 Sascha Willems
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+[[vk::location(0)]] float ViewDepth : TEXCOORD0;
+};
+
+struct PushConsts {
+	float4x4 model;
+	float4 color;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
+struct FSOutput
+{
+	float4 Accumulation : SV_TARGET0;
+	float Revealage : SV_TARGET1;
+};
+
+FSOutput main(VSOutput input)
+{
+	FSOutput output = (FSOutput)0;
+	float4 color = pushConsts.color;
+
+	// Depth based weight (McGuire and Bavoil, "Weighted Blended Order-Independent Transparency", eq. 7)
+	// Clamped so the weighted sums stay within the range of the half float accumulation target
+	float weight = color.a * clamp(10.0 / (1e-5 + pow(input.ViewDepth / 5.0, 2.0) + pow(input.ViewDepth / 200.0, 6.0)), 1e-2, 3e3);
+
+	// Additively blended sum of weighted premultiplied colors
+	output.Accumulation = float4(color.rgb * color.a, color.a) * weight;
+	// Multiplicatively blended product of (1 - alpha)
+	output.Revealage = color.a;
+	return output;
+}
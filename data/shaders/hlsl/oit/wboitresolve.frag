@@ -0,0 +1,23 @@
+// Copyright 2020 Sascha Willems
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+};
+
+Texture2D textureAccumulation : register(t2);
+SamplerState samplerAccumulation : register(s2);
+Texture2D textureRevealage : register(t3);
+SamplerState samplerRevealage : register(s3);
+
+float4 main(VSOutput input) : SV_TARGET
+{
+	int3 coord = int3(input.Pos.xy, 0);
+	float4 accumulation = textureAccumulation.Load(coord);
+	float revealage = textureRevealage.Load(coord).r;
+
+	// Weighted average color of all fragments, covering the background by the combined opacity
+	float3 background = float3(0.025, 0.025, 0.025);
+	float3 average = accumulation.rgb / max(accumulation.a, 1e-5);
+	return float4(lerp(background, average, 1.0 - revealage), 1.0);
+}
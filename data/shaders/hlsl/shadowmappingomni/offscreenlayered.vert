@@ -0,0 +1,32 @@
+// Copyright 2020 Google LLC
+
+struct VSOutput
+{
+	float4 Pos : SV_POSITION;
+	uint Layer : SV_RenderTargetArrayIndex;
+[[vk::location(0)]] float4 WorldPos : POSITION0;
+[[vk::location(1)]] float3 LightPos : POSITION1;
+};
+
+struct UBO
+{
+	float4x4 projection;
+	float4x4 view;
+	float4x4 model;
+	float4 lightPos;
+	float4x4 faceViews[6];
+};
+
+cbuffer ubo : register(b0) { UBO ubo; }
+
+// Face is the cube map face this instance is rendered to
+VSOutput main([[vk::location(0)]] float3 Pos : POSITION0, [[vk::location(1)]] uint Face : TEXCOORD0)
+{
+	VSOutput output = (VSOutput)0;
+	output.Pos = mul(ubo.projection, mul(ubo.faceViews[Face], mul(ubo.model, float4(Pos, 1.0))));
+	output.Layer = Face;
+
+	output.WorldPos = float4(Pos, 1.0);
+	output.LightPos = ubo.lightPos.xyz;
+	return output;
+}
@@ -0,0 +1,37 @@
+// Copyright 2020 Google LLC
+
+Texture2D texturePositionDepth : register(t0);
+SamplerState samplerPositionDepth : register(s0);
+Texture2D textureNormal : register(t1);
+SamplerState samplerNormal : register(s1);
+
+struct FSOutput
+{
+	float4 Position : SV_TARGET0;
+	float4 Normal : SV_TARGET1;
+};
+
+FSOutput main(float4 fragCoord : SV_POSITION)
+{
+	// Select the closest of the 2x2 source texels instead of averaging, so no positions/normals are invented at depth discontinuities
+	int2 srcCoord = int2(fragCoord.xy) * 2;
+	int2 srcDim;
+	texturePositionDepth.GetDimensions(srcDim.x, srcDim.y);
+	int2 srcMax = srcDim - 1;
+	int2 closest = min(srcCoord, srcMax);
+	float closestDepth = texturePositionDepth.Load(int3(closest, 0)).w;
+	for (int i = 1; i < 4; i++)
+	{
+		int2 coord = min(srcCoord + int2(i & 1, i >> 1), srcMax);
+		float depth = texturePositionDepth.Load(int3(coord, 0)).w;
+		if (depth < closestDepth)
+		{
+			closestDepth = depth;
+			closest = coord;
+		}
+	}
+	FSOutput output = (FSOutput)0;
+	output.Position = texturePositionDepth.Load(int3(closest, 0));
+	output.Normal = textureNormal.Load(int3(closest, 0));
+	return output;
+}
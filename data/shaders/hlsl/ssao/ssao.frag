@@ -10,6 +10,8 @@ SamplerState ssaoNoiseSampler : register(s2);
 #define SSAO_KERNEL_ARRAY_SIZE 64
 [[vk::constant_id(0)]] const int SSAO_KERNEL_SIZE = 64;
 [[vk::constant_id(1)]] const float SSAO_RADIUS = 0.5;
+// Number of kernel samples evaluated per pixel, if lower than the kernel size a different subset of the kernel is used every frame
+[[vk::constant_id(2)]] const int SSAO_SAMPLE_COUNT = 64;
 
 struct UBOSSAOKernel
 {
@@ -20,6 +22,11 @@ cbuffer uboSSAOKernel : register(b3) { UBOSSAOKernel uboSSAOKernel; };
 struct UBO
 {
 	float4x4 projection;
+	int ssao;
+	int ssaoOnly;
+	int ssaoBlur;
+	// Changes every frame if the result is accumulated temporally, zero otherwise
+	uint frameIndex;
 };
 cbuffer ubo : register(b4) { UBO ubo; };
 
@@ -36,6 +43,9 @@ float main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 	ssaoNoiseTexture.GetDimensions(noiseDim.x, noiseDim.y);
 	const float2 noiseUV = float2(float(texDim.x)/float(noiseDim.x), float(texDim.y)/(noiseDim.y)) * inUV;
 	float3 randomVec = ssaoNoiseTexture.Sample(ssaoNoiseSampler, noiseUV).xyz * 2.0 - 1.0;
+	// Rotate the noise by the golden angle every frame, so temporal accumulation converges to a smooth result
+	float angle = float(ubo.frameIndex) * 2.39996323;
+	randomVec.xy = float2(cos(angle) * randomVec.x - sin(angle) * randomVec.y, sin(angle) * randomVec.x + cos(angle) * randomVec.y);
 
 	// Create TBN matrix
 	float3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
@@ -44,9 +54,11 @@ float main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 
 	// Calculate occlusion value
 	float occlusion = 0.0f;
-	for(int i = 0; i < SSAO_KERNEL_SIZE; i++)
+	const int kernelStride = SSAO_KERNEL_SIZE / SSAO_SAMPLE_COUNT;
+	const int kernelOffset = int(ubo.frameIndex % uint(kernelStride));
+	for(int i = 0; i < SSAO_SAMPLE_COUNT; i++)
 	{
-		float3 samplePos = mul(TBN, uboSSAOKernel.samples[i].xyz);
+		float3 samplePos = mul(TBN, uboSSAOKernel.samples[i * kernelStride + kernelOffset].xyz);
 		samplePos = fragPos + samplePos * SSAO_RADIUS;
 
 		// project
@@ -60,7 +72,7 @@ float main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
 		float rangeCheck = smoothstep(0.0f, 1.0f, SSAO_RADIUS / abs(fragPos.z - sampleDepth));
 		occlusion += (sampleDepth >= samplePos.z ? 1.0f : 0.0f) * rangeCheck;
 	}
-	occlusion = 1.0 - (occlusion / float(SSAO_KERNEL_SIZE));
+	occlusion = 1.0 - (occlusion / float(SSAO_SAMPLE_COUNT));
 
 	return occlusion;
 }
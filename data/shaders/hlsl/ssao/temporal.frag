@@ -0,0 +1,42 @@
+// Copyright 2020 Google LLC
+
+Texture2D textureSSAO : register(t0);
+SamplerState samplerSSAO : register(s0);
+Texture2D texturePositionDepth : register(t1);
+SamplerState samplerPositionDepth : register(s1);
+Texture2D textureHistory : register(t2);
+SamplerState samplerHistory : register(s2);
+
+struct UBO
+{
+	// Transforms current view space positions into the previous frame's clip space
+	float4x4 reprojection;
+	float blendFactor;
+	int historyValid;
+};
+cbuffer ubo : register(b3) { UBO ubo; };
+
+// Returns the accumulated occlusion and view space depth (for disocclusion tests and the depth-aware upsampling)
+float2 main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	float3 fragPos = texturePositionDepth.Sample(samplerPositionDepth, inUV).xyz;
+	float occlusion = textureSSAO.Sample(samplerSSAO, inUV).r;
+
+	if (ubo.historyValid == 1)
+	{
+		// Find the position of this fragment in the previous frame
+		float4 prevPos = mul(ubo.reprojection, float4(fragPos, 1.0));
+		float2 prevUV = prevPos.xy / prevPos.w * 0.5 + 0.5;
+		if (all(prevUV >= float2(0.0, 0.0)) && all(prevUV <= float2(1.0, 1.0)))
+		{
+			float2 history = textureHistory.Sample(samplerHistory, prevUV).rg;
+			// Discard the history if the depths don't match (the surface was occluded in the previous frame)
+			if (abs(history.g - prevPos.w) < 0.05 * prevPos.w)
+			{
+				occlusion = lerp(history.r, occlusion, ubo.blendFactor);
+			}
+		}
+	}
+
+	return float2(occlusion, -fragPos.z);
+}
@@ -0,0 +1,31 @@
+// Copyright 2020 Google LLC
+
+Texture2D textureSSAO : register(t0);
+SamplerState samplerSSAO : register(s0);
+Texture2D texturePositionDepth : register(t1);
+SamplerState samplerPositionDepth : register(s1);
+
+float main([[vk::location(0)]] float2 inUV : TEXCOORD0) : SV_TARGET
+{
+	float depth = -texturePositionDepth.Sample(samplerPositionDepth, inUV).z;
+
+	// Bilinear weights of the four closest low resolution texels, scaled down for texels with a different depth
+	int2 texDim;
+	textureSSAO.GetDimensions(texDim.x, texDim.y);
+	float2 texPos = inUV * float2(texDim) - 0.5;
+	int2 baseCoord = int2(floor(texPos));
+	float2 f = frac(texPos);
+	float occlusion = 0.0;
+	float weightSum = 0.0;
+	for (int i = 0; i < 4; i++)
+	{
+		int2 offset = int2(i & 1, i >> 1);
+		float2 ssao = textureSSAO.Load(int3(clamp(baseCoord + offset, int2(0, 0), texDim - 1), 0)).rg;
+		float bilinearWeight = (offset.x == 1 ? f.x : 1.0 - f.x) * (offset.y == 1 ? f.y : 1.0 - f.y);
+		float depthWeight = 1.0 / (0.001 + abs(ssao.g - depth) / max(depth, 0.001));
+		float weight = bilinearWeight * depthWeight;
+		occlusion += ssao.r * weight;
+		weightSum += weight;
+	}
+	return (weightSum > 0.0) ? occlusion / weightSum : textureSSAO.Sample(samplerSSAO, inUV).r;
+}
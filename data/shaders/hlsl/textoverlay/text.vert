@@ -2,10 +2,18 @@
 
 struct VSInput
 {
-[[vk::location(0)]] float2 Pos : POSITION0;
-[[vk::location(1)]] float2 UV : TEXCOORD0;
+[[vk::location(0)]] float4 Rect : POSITION0;
+[[vk::location(1)]] float4 UV : TEXCOORD0;
+uint VertexIndex : SV_VertexID;
 };
 
+struct PushConsts
+{
+	// Pixel to normalized device coordinate scale
+	float2 scale;
+};
+[[vk::push_constant]] PushConsts pushConsts;
+
 struct VSOutput
 {
 	float4 Pos : SV_POSITION;
@@ -15,7 +23,9 @@ struct VSOutput
 VSOutput main(VSInput input)
 {
 	VSOutput output = (VSOutput)0;
-	output.Pos = float4(input.Pos, 0.0, 1.0);
-	output.UV = input.UV;
+	// Generate the quad's corners for a triangle strip of four vertices
+	float2 corner = float2(input.VertexIndex & 1, input.VertexIndex >> 1);
+	output.Pos = float4(lerp(input.Rect.xy, input.Rect.zw, corner) * pushConsts.scale - 1.0, 0.0, 1.0);
+	output.UV = lerp(input.UV.xy, input.UV.zw, corner);
 	return output;
 }
@@ -1,5 +1,5 @@
 /*
-* Vulkan Example - Implements a separable two-pass fullscreen blur (also known as bloom)
+* Vulkan Example - Implements a progressive downsample/upsample mip chain bloom
 *
 * Copyright (C) Sascha Willems - www.saschawillems.de
 *
@@ -8,11 +8,11 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanBloom.hpp"
 
 #define ENABLE_VALIDATION false
 
 // Offscreen frame buffer properties
-#define FB_DIM 256
 #define FB_COLOR_FORMAT VK_FORMAT_R8G8B8A8_UNORM
 
 class VulkanExample : public VulkanExampleBase
@@ -31,7 +31,7 @@ public:
 	struct {
 		vks::Buffer scene;
 		vks::Buffer skyBox;
-		vks::Buffer blurParams;
+		vks::Buffer bloomParams;
 	} uniformBuffers;
 
 	struct UBO {
@@ -40,38 +40,36 @@ public:
 		glm::mat4 model;
 	};
 
-	struct UBOBlurParams {
-		float blurScale = 1.0f;
-		float blurStrength = 1.5f;
+	struct UBOBloomParams {
+		// The bloom chain returns the sum of all its levels, so this is scaled down accordingly
+		float strength = 0.3f;
 	};
 
 	struct {
 		UBO scene, skyBox;
-		UBOBlurParams blurParams;
+		UBOBloomParams bloomParams;
 	} ubos;
 
 	struct {
-		VkPipeline blurVert;
-		VkPipeline blurHorz;
+		VkPipeline composite;
 		VkPipeline glowPass;
 		VkPipeline phongPass;
 		VkPipeline skyBox;
 	} pipelines;
 
 	struct {
-		VkPipelineLayout blur;
+		VkPipelineLayout composite;
 		VkPipelineLayout scene;
 	} pipelineLayouts;
 
 	struct {
-		VkDescriptorSet blurVert;
-		VkDescriptorSet blurHorz;
+		VkDescriptorSet composite;
 		VkDescriptorSet scene;
 		VkDescriptorSet skyBox;
 	} descriptorSets;
 
 	struct {
-		VkDescriptorSetLayout blur;
+		VkDescriptorSetLayout composite;
 		VkDescriptorSetLayout scene;
 	} descriptorSetLayouts;
 
@@ -88,11 +86,15 @@ public:
 	};
 	struct OffscreenPass {
 		int32_t width, height;
+		VkFormat depthFormat;
 		VkRenderPass renderPass;
 		VkSampler sampler;
-		std::array<FrameBuffer, 2> framebuffers;
+		FrameBuffer framebuffer;
 	} offscreenPass;
 
+	// Progressive downsample/upsample bloom applied to the glow pass
+	vks::Bloom bloomPass;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Bloom (offscreen rendering)";
@@ -111,50 +113,40 @@ public:
 		vkDestroySampler(device, offscreenPass.sampler, nullptr);
 
 		// Frame buffer
-		for (auto& framebuffer : offscreenPass.framebuffers)
-		{
-			// Attachments
-			vkDestroyImageView(device, framebuffer.color.view, nullptr);
-			vkDestroyImage(device, framebuffer.color.image, nullptr);
-			vkFreeMemory(device, framebuffer.color.mem, nullptr);
-			vkDestroyImageView(device, framebuffer.depth.view, nullptr);
-			vkDestroyImage(device, framebuffer.depth.image, nullptr);
-			vkFreeMemory(device, framebuffer.depth.mem, nullptr);
-
-			vkDestroyFramebuffer(device, framebuffer.framebuffer, nullptr);
-		}
+		destroyOffscreenFramebuffer(&offscreenPass.framebuffer);
 		vkDestroyRenderPass(device, offscreenPass.renderPass, nullptr);
 
-		vkDestroyPipeline(device, pipelines.blurHorz, nullptr);
-		vkDestroyPipeline(device, pipelines.blurVert, nullptr);
+		bloomPass.destroy();
+
+		vkDestroyPipeline(device, pipelines.composite, nullptr);
 		vkDestroyPipeline(device, pipelines.phongPass, nullptr);
 		vkDestroyPipeline(device, pipelines.glowPass, nullptr);
 		vkDestroyPipeline(device, pipelines.skyBox, nullptr);
 
-		vkDestroyPipelineLayout(device, pipelineLayouts.blur , nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.composite, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.scene, nullptr);
 
-		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.blur, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.composite, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.scene, nullptr);
 
 		// Uniform buffers
 		uniformBuffers.scene.destroy();
 		uniformBuffers.skyBox.destroy();
-		uniformBuffers.blurParams.destroy();
+		uniformBuffers.bloomParams.destroy();
 
 		cubemap.destroy();
 	}
 
-	// Setup the offscreen framebuffer for rendering the mirrored scene
-	// The color attachment of this framebuffer will then be sampled from
+	// Setup the offscreen framebuffer for rendering the glowing parts of the scene
+	// The color attachment of this framebuffer is the input of the bloom chain
 	void prepareOffscreenFramebuffer(FrameBuffer *frameBuf, VkFormat colorFormat, VkFormat depthFormat)
 	{
 		// Color attachment
 		VkImageCreateInfo image = vks::initializers::imageCreateInfo();
 		image.imageType = VK_IMAGE_TYPE_2D;
 		image.format = colorFormat;
-		image.extent.width = FB_DIM;
-		image.extent.height = FB_DIM;
+		image.extent.width = offscreenPass.width;
+		image.extent.height = offscreenPass.height;
 		image.extent.depth = 1;
 		image.mipLevels = 1;
 		image.arrayLayers = 1;
@@ -223,8 +215,8 @@ public:
 		fbufCreateInfo.renderPass = offscreenPass.renderPass;
 		fbufCreateInfo.attachmentCount = 2;
 		fbufCreateInfo.pAttachments = attachments;
-		fbufCreateInfo.width = FB_DIM;
-		fbufCreateInfo.height = FB_DIM;
+		fbufCreateInfo.width = offscreenPass.width;
+		fbufCreateInfo.height = offscreenPass.height;
 		fbufCreateInfo.layers = 1;
 
 		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &frameBuf->framebuffer));
@@ -235,15 +227,25 @@ public:
 		frameBuf->descriptor.sampler = offscreenPass.sampler;
 	}
 
-	// Prepare the offscreen framebuffers used for the vertical- and horizontal blur
+	void destroyOffscreenFramebuffer(FrameBuffer *frameBuf)
+	{
+		vkDestroyImageView(device, frameBuf->color.view, nullptr);
+		vkDestroyImage(device, frameBuf->color.image, nullptr);
+		vkFreeMemory(device, frameBuf->color.mem, nullptr);
+		vkDestroyImageView(device, frameBuf->depth.view, nullptr);
+		vkDestroyImage(device, frameBuf->depth.image, nullptr);
+		vkFreeMemory(device, frameBuf->depth.mem, nullptr);
+		vkDestroyFramebuffer(device, frameBuf->framebuffer, nullptr);
+	}
+
+	// Prepare the offscreen framebuffer for the glow pass and the bloom chain filtering it
 	void prepareOffscreen()
 	{
-		offscreenPass.width = FB_DIM;
-		offscreenPass.height = FB_DIM;
+		offscreenPass.width = width;
+		offscreenPass.height = height;
 
 		// Find a suitable depth format
-		VkFormat fbDepthFormat;
-		VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &fbDepthFormat);
+		VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &offscreenPass.depthFormat);
 		assert(validDepthFormat);
 
 		// Create a separate render pass for the offscreen rendering as it may differ from the one used for scene rendering
@@ -259,7 +261,7 @@ public:
 		attchmentDescriptions[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		attchmentDescriptions[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 		// Depth attachment
-		attchmentDescriptions[1].format = fbDepthFormat;
+		attchmentDescriptions[1].format = offscreenPass.depthFormat;
 		attchmentDescriptions[1].samples = VK_SAMPLE_COUNT_1_BIT;
 		attchmentDescriptions[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 		attchmentDescriptions[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
@@ -323,9 +325,16 @@ public:
 		sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
 		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &offscreenPass.sampler));
 
-		// Create two frame buffers
-		prepareOffscreenFramebuffer(&offscreenPass.framebuffers[0], FB_COLOR_FORMAT, fbDepthFormat);
-		prepareOffscreenFramebuffer(&offscreenPass.framebuffers[1], FB_COLOR_FORMAT, fbDepthFormat);
+		prepareOffscreenFramebuffer(&offscreenPass.framebuffer, FB_COLOR_FORMAT, offscreenPass.depthFormat);
+
+		// Bloom chain fed by the glow pass
+		bloomPass.shaders = {
+			loadShader(getShadersPath() + "base/bloom.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
+			loadShader(getShadersPath() + "base/bloomdownsample.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT),
+			loadShader(getShadersPath() + "base/bloomupsample.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT),
+		};
+		bloomPass.prepare(vulkanDevice, pipelineCache, offscreenPass.width, offscreenPass.height);
+		bloomPass.setInput(offscreenPass.framebuffer.color.view);
 	}
 
 	void buildCommandBuffers()
@@ -337,21 +346,24 @@ public:
 		VkRect2D scissor;
 
 		/*
-			The blur method used in this example is multi pass and renders the vertical blur first and then the horizontal one
-			While it's possible to blur in one pass, this method is widely used as it requires far less samples to generate the blur
+			The glow pass is filtered by a mip chain: it's successively downsampled with a wide filter, and then
+			upsampled back with a tent filter, adding each level on the way. Lower levels cover a large radius at a
+			fraction of the texel fetches a separable blur of the same radius would need
 		*/
 
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			gpuProfiler.cmdBeginFrame(drawCmdBuffers[i], i);
+
 			if (bloom) {
 				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
 				clearValues[1].depthStencil = { 1.0f, 0 };
 
 				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
 				renderPassBeginInfo.renderPass = offscreenPass.renderPass;
-				renderPassBeginInfo.framebuffer = offscreenPass.framebuffers[0].framebuffer;
+				renderPassBeginInfo.framebuffer = offscreenPass.framebuffer.framebuffer;
 				renderPassBeginInfo.renderArea.extent.width = offscreenPass.width;
 				renderPassBeginInfo.renderArea.extent.height = offscreenPass.height;
 				renderPassBeginInfo.clearValueCount = 2;
@@ -367,6 +379,7 @@ public:
 					First render pass: Render glow parts of the model (separate mesh) to an offscreen frame buffer
 				*/
 
+				gpuProfiler.cmdBeginScope(drawCmdBuffers[i], i, "Glow");
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.scene, 0, NULL);
@@ -375,23 +388,15 @@ public:
 				models.ufoGlow.draw(drawCmdBuffers[i]);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				gpuProfiler.cmdEndScope(drawCmdBuffers[i], i, "Glow");
 
 				/*
-					Second render pass: Vertical blur
-
-					Render contents of the first pass into a second framebuffer and apply a vertical blur
-					This is the first blur pass, the horizontal blur is applied when rendering on top of the scene
+					Second pass: Downsample and upsample the glow through the bloom mip chain
 				*/
 
-				renderPassBeginInfo.framebuffer = offscreenPass.framebuffers[1].framebuffer;
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.blur, 0, 1, &descriptorSets.blurVert, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.blurVert);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				gpuProfiler.cmdBeginScope(drawCmdBuffers[i], i, "Bloom");
+				bloomPass.cmdDraw(drawCmdBuffers[i]);
+				gpuProfiler.cmdEndScope(drawCmdBuffers[i], i, "Bloom");
 			}
 
 			/*
@@ -399,9 +404,7 @@ public:
 			*/
 
 			/*
-				Third render pass: Scene rendering with applied vertical blur
-
-				Renders the scene and the (vertically blurred) contents of the second framebuffer and apply a horizontal blur
+				Third render pass: Scene rendering with the bloom result added on top
 
 			*/
 			{
@@ -416,6 +419,7 @@ public:
 				renderPassBeginInfo.clearValueCount = 2;
 				renderPassBeginInfo.pClearValues = clearValues;
 
+				gpuProfiler.cmdBeginScope(drawCmdBuffers[i], i, "Scene");
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 				VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -436,17 +440,17 @@ public:
 
 				if (bloom)
 				{
-					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.blur, 0, 1, &descriptorSets.blurHorz, 0, NULL);
-					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.blurHorz);
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.composite, 0, 1, &descriptorSets.composite, 0, NULL);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.composite);
 					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 				}
 
-				drawUI(drawCmdBuffers[i]);
-
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
-
+				gpuProfiler.cmdEndScope(drawCmdBuffers[i], i, "Scene");
 			}
 
+			gpuProfiler.cmdEndFrame(drawCmdBuffers[i], i);
+
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
@@ -463,10 +467,10 @@ public:
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 8),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 6),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4)
 		};
-		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 5);
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 3);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
 
@@ -476,15 +480,15 @@ public:
 		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
 		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo;
 
-		// Fullscreen blur
+		// Fullscreen bloom composition
 		setLayoutBindings = {
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),			// Binding 0: Fragment shader uniform buffer
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1)	// Binding 1: Fragment shader image sampler
 		};
 		descriptorSetLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayouts.blur));
-		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.blur, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.blur));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayouts.composite));
+		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.composite, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.composite));
 
 		// Scene rendering
 		setLayoutBindings = {
@@ -504,21 +508,12 @@ public:
 		VkDescriptorSetAllocateInfo descriptorSetAllocInfo;
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets;
 
-		// Full screen blur
-		// Vertical
-		descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.blur, 1);
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSets.blurVert));
-		writeDescriptorSets = {
-			vks::initializers::writeDescriptorSet(descriptorSets.blurVert, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.blurParams.descriptor),				// Binding 0: Fragment shader uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSets.blurVert, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &offscreenPass.framebuffers[0].descriptor),	// Binding 1: Fragment shader texture sampler
-		};
-		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
-		// Horizontal
-		descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.blur, 1);
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSets.blurHorz));
+		// Full screen bloom composition
+		descriptorSetAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.composite, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSets.composite));
 		writeDescriptorSets = {
-			vks::initializers::writeDescriptorSet(descriptorSets.blurHorz, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.blurParams.descriptor),				// Binding 0: Fragment shader uniform buffer
-			vks::initializers::writeDescriptorSet(descriptorSets.blurHorz, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &offscreenPass.framebuffers[1].descriptor),	// Binding 1: Fragment shader texture sampler
+			vks::initializers::writeDescriptorSet(descriptorSets.composite, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.bloomParams.descriptor),			// Binding 0: Fragment shader uniform buffer
+			vks::initializers::writeDescriptorSet(descriptorSets.composite, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &bloomPass.descriptor),						// Binding 1: Fragment shader texture sampler
 		};
 		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
 
@@ -552,7 +547,7 @@ public:
 		VkPipelineDynamicStateCreateInfo dynamicStateCI = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables.data(), dynamicStateEnables.size(), 0);
 		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
 
-		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayouts.blur, renderPass, 0);
+		VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(pipelineLayouts.composite, renderPass, 0);
 		pipelineCI.pInputAssemblyState = &inputAssemblyStateCI;
 		pipelineCI.pRasterizationState = &rasterizationStateCI;
 		pipelineCI.pColorBlendState = &colorBlendStateCI;
@@ -563,13 +558,13 @@ public:
 		pipelineCI.stageCount = shaderStages.size();
 		pipelineCI.pStages = shaderStages.data();
 
-		// Blur pipelines
-		shaderStages[0] = loadShader(getShadersPath() + "bloom/gaussblur.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = loadShader(getShadersPath() + "bloom/gaussblur.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		// Bloom composition pipeline
+		shaderStages[0] = loadShader(getShadersPath() + "base/bloom.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(getShadersPath() + "bloom/composite.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 		// Empty vertex input state
 		VkPipelineVertexInputStateCreateInfo emptyInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
 		pipelineCI.pVertexInputState = &emptyInputState;
-		pipelineCI.layout = pipelineLayouts.blur;
+		pipelineCI.layout = pipelineLayouts.composite;
 		// Additive blending
 		blendAttachmentState.colorWriteMask = 0xF;
 		blendAttachmentState.blendEnable = VK_TRUE;
@@ -579,19 +574,8 @@ public:
 		blendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
 		blendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
 		blendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_DST_ALPHA;
-
-		// Use specialization constants to select between horizontal and vertical blur
-		uint32_t blurdirection = 0;
-		VkSpecializationMapEntry specializationMapEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(uint32_t));
-		VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(uint32_t), &blurdirection);
-		shaderStages[1].pSpecializationInfo = &specializationInfo;
-		// Vertical blur pipeline
-		pipelineCI.renderPass = offscreenPass.renderPass;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.blurVert));
-		// Horizontal blur pipeline
-		blurdirection = 1;
 		pipelineCI.renderPass = renderPass;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.blurHorz));
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.composite));
 
 		// Phong pass (3D model)
 		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({vkglTF::VertexComponent::Position, vkglTF::VertexComponent::UV, vkglTF::VertexComponent::Color, vkglTF::VertexComponent::Normal});
@@ -629,12 +613,12 @@ public:
 			&uniformBuffers.scene,
 			sizeof(ubos.scene)));
 
-		// Blur parameters uniform buffers
+		// Bloom composition parameters uniform buffer
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&uniformBuffers.blurParams,
-			sizeof(ubos.blurParams)));
+			&uniformBuffers.bloomParams,
+			sizeof(ubos.bloomParams)));
 
 		// Skybox
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
@@ -645,17 +629,18 @@ public:
 
 		// Map persistent
 		VK_CHECK_RESULT(uniformBuffers.scene.map());
-		VK_CHECK_RESULT(uniformBuffers.blurParams.map());
+		VK_CHECK_RESULT(uniformBuffers.bloomParams.map());
 		VK_CHECK_RESULT(uniformBuffers.skyBox.map());
 
 		// Initialize uniform buffers
 		updateUniformBuffersScene();
-		updateUniformBuffersBlur();
+		updateUniformBuffersBloom();
 	}
 
 	// Update uniform buffers for rendering the 3D scene
 	void updateUniformBuffersScene()
 	{
+		VKS_PROFILE_FUNCTION();
 		// UFO
 		ubos.scene.projection = camera.matrices.perspective;
 		ubos.scene.view = camera.matrices.view;
@@ -674,10 +659,10 @@ public:
 		memcpy(uniformBuffers.skyBox.mapped, &ubos.skyBox, sizeof(ubos.skyBox));
 	}
 
-	// Update blur pass parameter uniform buffer
-	void updateUniformBuffersBlur()
+	// Update bloom composition parameter uniform buffer
+	void updateUniformBuffersBloom()
 	{
-		memcpy(uniformBuffers.blurParams.mapped, &ubos.blurParams, sizeof(ubos.blurParams));
+		memcpy(uniformBuffers.bloomParams.mapped, &ubos.bloomParams, sizeof(ubos.bloomParams));
 	}
 
 	void draw()
@@ -685,7 +670,10 @@ public:
 		VulkanExampleBase::prepareFrame();
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		{
+			VKS_PROFILE_ZONE("vkQueueSubmit");
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		}
 		VulkanExampleBase::submitFrame();
 	}
 
@@ -714,14 +702,37 @@ public:
 		}
 	}
 
+	// The glow pass and the bloom chain are sized to the window, so they need to be recreated along with it
+	virtual void windowResized()
+	{
+		offscreenPass.width = width;
+		offscreenPass.height = height;
+		destroyOffscreenFramebuffer(&offscreenPass.framebuffer);
+		prepareOffscreenFramebuffer(&offscreenPass.framebuffer, FB_COLOR_FORMAT, offscreenPass.depthFormat);
+
+		// The shader stages loaded in prepareOffscreen are kept and reused
+		bloomPass.destroy();
+		bloomPass.prepare(vulkanDevice, pipelineCache, offscreenPass.width, offscreenPass.height);
+		bloomPass.setInput(offscreenPass.framebuffer.color.view);
+
+		// Binding 1: Bloom result
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSets.composite, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &bloomPass.descriptor);
+		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+
+		buildCommandBuffers();
+	}
+
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
 			if (overlay->checkBox("Bloom", &bloom)) {
 				buildCommandBuffers();
 			}
-			if (overlay->inputFloat("Scale", &ubos.blurParams.blurScale, 0.1f, 2)) {
-				updateUniformBuffersBlur();
+			if (overlay->inputFloat("Strength", &ubos.bloomParams.strength, 0.05f, 2)) {
+				updateUniformBuffersBloom();
+			}
+			if (overlay->inputFloat("Filter radius", &bloomPass.filterRadius, 0.1f, 2)) {
+				buildCommandBuffers();
 			}
 		}
 	}
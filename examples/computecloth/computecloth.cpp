@@ -262,8 +262,6 @@ public:
 			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &compute.storageBuffers.output.buffer, offsets);
 			vkCmdDrawIndexed(drawCmdBuffers[i], indexCount, 1, 0, 0, 0);
 
-			drawUI(drawCmdBuffers[i]);
-
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
 			// release the storage buffers to the compute queue
@@ -676,7 +674,7 @@ public:
 			compute.ubo.deltaT = fmin(frameTimer, 0.02) * 0.0025f;
 
 			if (simulateWind) {
-				std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
+				std::default_random_engine rndEngine(benchmark.active ? benchmark.seed : (unsigned)time(nullptr));
 				std::uniform_real_distribution<float> rd(1.0f, 12.0f);
 				compute.ubo.gravity.x = cos(glm::radians(-timer * 360.0f)) * (rd(rndEngine) - rd(rndEngine));
 				compute.ubo.gravity.z = sin(glm::radians(timer * 360.0f)) * (rd(rndEngine) - rd(rndEngine));
@@ -1,6 +1,11 @@
 /*
 * Vulkan Example - Compute shader culling and LOD using indirect rendering
 *
+* Objects are culled against the view frustum and occlusion culled against a hierarchical depth (hi-Z) pyramid in two passes:
+* The first pass tests all objects against the depth pyramid of the last frame and the survivors are drawn. The depth buffer
+* of that pass is then reduced into a new pyramid, and a second pass tests the objects rejected by the first one against it
+* and draws the ones that have become visible (disoccluded)
+*
 * Copyright (C) 2016-2022 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
@@ -40,16 +45,21 @@ public:
 
 	// Contains the instanced data
 	vks::Buffer instanceBuffer;
-	// Contains the indirect drawing commands
+	// Contains the indirect drawing commands, one per object for each of the two culling passes
 	vks::Buffer indirectCommandsBuffer;
 	vks::Buffer indirectDrawCountBuffer;
 
 	// Indirect draw statistics (updated via compute)
 	struct {
 		uint32_t drawCount;						// Total number of indirect draw counts to be issued
+		uint32_t occludedCount;					// Number of objects inside the frustum that were rejected by both occlusion tests
+		uint32_t secondPassCount;				// Number of objects rejected by the first occlusion test that were drawn by the second pass
 		uint32_t lodCount[MAX_LOD_LEVEL + 1];	// Statistics for number of draws per LOD level (written by compute shader)
 	} indirectStats;
 
+	// Number of triangles of each LOD level, used to display the number of drawn triangles
+	std::vector<uint32_t> lodTriangleCounts;
+
 	// Store the indirect draw commands containing index offsets and instance count per object
 	std::vector<VkDrawIndexedIndirectCommand> indirectCommands;
 
@@ -58,6 +68,8 @@ public:
 		glm::mat4 modelview;
 		glm::vec4 cameraPos;
 		glm::vec4 frustumPlanes[6];
+		float meshRadius;						// Radius of the bounding sphere of an unscaled object
+		uint32_t occlusionCulling = 1;
 	} uboScene;
 
 	struct {
@@ -72,6 +84,27 @@ public:
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
+	// Render pass for objects drawn by the second culling pass, continues the color and depth output of the first one
+	VkRenderPass renderPassLoad = VK_NULL_HANDLE;
+
+	// Hierarchical depth pyramid, each texel stores the farthest depth of the area it covers in the level above
+	struct {
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory;
+		VkImageView view;							// View of all mip levels, sampled by the culling shader
+		std::vector<VkImageView> levelViews;		// Views of single mip levels, written by the reduction shader
+		VkSampler sampler = VK_NULL_HANDLE;
+		uint32_t width;
+		uint32_t height;
+		uint32_t levelCount;
+		VkImageView depthView = VK_NULL_HANDLE;		// Depth only view of the depth attachment, input of the first reduction
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout;
+		std::vector<VkDescriptorSet> descriptorSets;	// One per mip level
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipeline;
+	} depthPyramid;
+
 	// Resources for the compute part of the example
 	struct {
 		vks::Buffer lodLevelsBuffers;				// Contains index start and counts for the different lod levels
@@ -83,7 +116,8 @@ public:
 		VkDescriptorSetLayout descriptorSetLayout;	// Compute shader binding layout
 		VkDescriptorSet descriptorSet;				// Compute shader bindings
 		VkPipelineLayout pipelineLayout;			// Layout of the compute pipeline
-		VkPipeline pipeline;						// Compute pipeline for updating particle positions
+		VkPipeline pipeline;						// Compute pipeline for the first culling pass
+		VkPipeline pipelineSecondPass;				// Compute pipeline for the second culling pass (recorded into the graphics command buffers)
 	} compute;
 
 	// View frustum for culling invisible objects
@@ -114,6 +148,14 @@ public:
 		vkDestroyPipelineLayout(device, compute.pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
 		vkDestroyPipeline(device, compute.pipeline, nullptr);
+		vkDestroyPipeline(device, compute.pipelineSecondPass, nullptr);
+		vkDestroyRenderPass(device, renderPassLoad, nullptr);
+		destroyDepthPyramid();
+		vkDestroyImageView(device, depthPyramid.depthView, nullptr);
+		vkDestroySampler(device, depthPyramid.sampler, nullptr);
+		vkDestroyPipeline(device, depthPyramid.pipeline, nullptr);
+		vkDestroyPipelineLayout(device, depthPyramid.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, depthPyramid.descriptorSetLayout, nullptr);
 		vkDestroyFence(device, compute.fence, nullptr);
 		vkDestroyCommandPool(device, compute.commandPool, nullptr);
 		vkDestroySemaphore(device, compute.semaphore, nullptr);
@@ -127,6 +169,242 @@ public:
 		}
 	}
 
+	// The depth attachment is also sampled to build the depth pyramid, so it needs a separate depth only view
+	void setupDepthStencil()
+	{
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, depthFormat, &formatProperties);
+		assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = depthFormat;
+		imageCI.extent = { width, height, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &depthStencil.image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, depthStencil.image, &memReqs);
+		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &depthStencil.mem));
+		VK_CHECK_RESULT(vkBindImageMemory(device, depthStencil.image, depthStencil.mem, 0));
+
+		VkImageViewCreateInfo imageViewCI = vks::initializers::imageViewCreateInfo();
+		imageViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		imageViewCI.image = depthStencil.image;
+		imageViewCI.format = depthFormat;
+		imageViewCI.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+		if (vks::tools::formatHasStencil(depthFormat)) {
+			imageViewCI.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+		VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCI, nullptr, &depthStencil.view));
+
+		// Views used for sampling may only contain a single aspect
+		if (depthPyramid.depthView != VK_NULL_HANDLE) {
+			vkDestroyImageView(device, depthPyramid.depthView, nullptr);
+		}
+		imageViewCI.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCI, nullptr, &depthPyramid.depthView));
+
+		// The depth pyramid depends on the size of the depth attachment
+		// The base class clears prepared before recreating the depth attachment on a resize, so resized is checked instead
+		// This runs before the base class rebuilds the command buffers that record the reduction
+		if (resized) {
+			prepareDepthPyramid();
+			updateDepthPyramidDescriptor();
+			buildComputeCommandBuffer();
+		}
+	}
+
+	void setupRenderPass()
+	{
+		// The default render pass clears color and depth and is used for the objects drawn by the first culling pass
+		VulkanExampleBase::setupRenderPass();
+
+		// The second render pass keeps the results of the first one
+		std::array<VkAttachmentDescription, 2> attachments = {};
+		attachments[0].format = swapChain.colorFormat;
+		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[0].initialLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		attachments[1].format = depthFormat;
+		attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		// The final depth is reduced into the pyramid for the next frame
+		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+		VkSubpassDescription subpassDescription = {};
+		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescription.colorAttachmentCount = 1;
+		subpassDescription.pColorAttachments = &colorReference;
+		subpassDescription.pDepthStencilAttachment = &depthReference;
+
+		// Color writes of the first render pass need to finish before this one continues writing
+		// Depth is synchronized with an explicit barrier after building the depth pyramid
+		VkSubpassDependency dependency = {};
+		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependency.dstSubpass = 0;
+		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+		VkRenderPassCreateInfo renderPassInfo = vks::initializers::renderPassCreateInfo();
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		renderPassInfo.pAttachments = attachments.data();
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpassDescription;
+		renderPassInfo.dependencyCount = 1;
+		renderPassInfo.pDependencies = &dependency;
+		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPassLoad));
+	}
+
+	// Queue family ownership transfer barriers for the buffers written by both culling passes
+	std::vector<VkBufferMemoryBarrier> sharedBufferBarriers(uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask)
+	{
+		std::vector<VkBufferMemoryBarrier> barriers(2, vks::initializers::bufferMemoryBarrier());
+		barriers[0].buffer = indirectCommandsBuffer.buffer;
+		barriers[1].buffer = indirectDrawCountBuffer.buffer;
+		for (auto &barrier : barriers) {
+			barrier.srcAccessMask = srcAccessMask;
+			barrier.dstAccessMask = dstAccessMask;
+			barrier.srcQueueFamilyIndex = srcQueueFamilyIndex;
+			barrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
+			barrier.offset = 0;
+			barrier.size = VK_WHOLE_SIZE;
+		}
+		return barriers;
+	}
+
+	// Barrier for all levels of the depth pyramid, which always stays in the general layout
+	VkImageMemoryBarrier depthPyramidBarrier(uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask)
+	{
+		VkImageMemoryBarrier barrier = vks::initializers::imageMemoryBarrier();
+		barrier.image = depthPyramid.image;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.srcAccessMask = srcAccessMask;
+		barrier.dstAccessMask = dstAccessMask;
+		barrier.srcQueueFamilyIndex = srcQueueFamilyIndex;
+		barrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, depthPyramid.levelCount, 0, 1 };
+		return barrier;
+	}
+
+	// Draws the objects with the indirect commands of one of the culling passes
+	void drawObjects(VkCommandBuffer commandBuffer, uint32_t firstDraw)
+	{
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+
+		// Mesh containing the LODs
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.plants);
+		vkCmdBindVertexBuffers(commandBuffer, VERTEX_BUFFER_BIND_ID, 1, &lodModel.vertices.buffer, offsets);
+		vkCmdBindVertexBuffers(commandBuffer, INSTANCE_BUFFER_BIND_ID, 1, &instanceBuffer.buffer, offsets);
+
+		vkCmdBindIndexBuffer(commandBuffer, lodModel.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+		const VkDeviceSize firstDrawOffset = firstDraw * sizeof(VkDrawIndexedIndirectCommand);
+		if (vulkanDevice->features.multiDrawIndirect)
+		{
+			vkCmdDrawIndexedIndirect(commandBuffer, indirectCommandsBuffer.buffer, firstDrawOffset, objectCount, sizeof(VkDrawIndexedIndirectCommand));
+		}
+		else
+		{
+			// If multi draw is not available, we must issue separate draw commands
+			for (uint32_t j = 0; j < objectCount; j++)
+			{
+				vkCmdDrawIndexedIndirect(commandBuffer, indirectCommandsBuffer.buffer, firstDrawOffset + j * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+			}
+		}
+	}
+
+	// Reduces the depth attachment into the depth pyramid, one dispatch per mip level
+	void buildDepthPyramid(VkCommandBuffer commandBuffer)
+	{
+		VkImageMemoryBarrier depthBarrier = vks::initializers::imageMemoryBarrier();
+		depthBarrier.image = depthStencil.image;
+		depthBarrier.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+		if (vks::tools::formatHasStencil(depthFormat)) {
+			depthBarrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
+		depthBarrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		// Also waits for the second culling pass, which reads the levels overwritten by the second reduction
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_FLAGS_NONE,
+			0, nullptr,
+			0, nullptr,
+			1, &depthBarrier);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, depthPyramid.pipeline);
+		uint32_t levelWidth = depthPyramid.width;
+		uint32_t levelHeight = depthPyramid.height;
+		for (uint32_t i = 0; i < depthPyramid.levelCount; i++)
+		{
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, depthPyramid.pipelineLayout, 0, 1, &depthPyramid.descriptorSets[i], 0, nullptr);
+			vkCmdDispatch(commandBuffer, (levelWidth + 15) / 16, (levelHeight + 15) / 16, 1);
+
+			// The next level reads this one, the culling shader reads all of them
+			VkImageMemoryBarrier levelBarrier = depthPyramidBarrier(VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+			levelBarrier.subresourceRange.baseMipLevel = i;
+			levelBarrier.subresourceRange.levelCount = 1;
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_FLAGS_NONE,
+				0, nullptr,
+				0, nullptr,
+				1, &levelBarrier);
+
+			levelWidth = std::max(1u, levelWidth / 2);
+			levelHeight = std::max(1u, levelHeight / 2);
+		}
+
+		// Return the depth attachment to the layout the render passes expect
+		depthBarrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		depthBarrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		depthBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			VK_FLAGS_NONE,
+			0, nullptr,
+			0, nullptr,
+			1, &depthBarrier);
+	}
+
 	void buildCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
@@ -136,11 +414,10 @@ public:
 		clearValues[1].depthStencil = { 1.0f, 0 };
 
 		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-		renderPassBeginInfo.renderPass = renderPass;
 		renderPassBeginInfo.renderArea.extent.width = width;
 		renderPassBeginInfo.renderArea.extent.height = height;
-		renderPassBeginInfo.clearValueCount = 2;
-		renderPassBeginInfo.pClearValues = clearValues;
+
+		const bool separateQueueFamilies = vulkanDevice->queueFamilyIndices.graphics != vulkanDevice->queueFamilyIndices.compute;
 
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
@@ -150,90 +427,71 @@ public:
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
 			// Acquire barrier
-			if (vulkanDevice->queueFamilyIndices.graphics != vulkanDevice->queueFamilyIndices.compute)
+			if (separateQueueFamilies)
 			{
-				VkBufferMemoryBarrier buffer_barrier =
-				{
-					VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-					nullptr,
-					0,
-					VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
-					vulkanDevice->queueFamilyIndices.compute,
-					vulkanDevice->queueFamilyIndices.graphics,
-					indirectCommandsBuffer.buffer,
-					0,
-					indirectCommandsBuffer.descriptor.range
-				};
-
+				std::vector<VkBufferMemoryBarrier> bufferBarriers = sharedBufferBarriers(vulkanDevice->queueFamilyIndices.compute, vulkanDevice->queueFamilyIndices.graphics, 0, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+				VkImageMemoryBarrier imageBarrier = depthPyramidBarrier(vulkanDevice->queueFamilyIndices.compute, vulkanDevice->queueFamilyIndices.graphics, 0, VK_ACCESS_SHADER_WRITE_BIT);
 				vkCmdPipelineBarrier(
 					drawCmdBuffers[i],
 					VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-					VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+					VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 					0,
 					0, nullptr,
-					1, &buffer_barrier,
-					0, nullptr);
+					static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+					1, &imageBarrier);
 			}
 
+			// Objects that passed the occlusion test of the first culling pass against the depth pyramid of the last frame
+			renderPassBeginInfo.renderPass = renderPass;
+			renderPassBeginInfo.clearValueCount = 2;
+			renderPassBeginInfo.pClearValues = clearValues;
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			drawObjects(drawCmdBuffers[i], 0);
+			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
-			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-			VkDeviceSize offsets[1] = { 0 };
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
-
-			// Mesh containing the LODs
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.plants);
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], VERTEX_BUFFER_BIND_ID, 1, &lodModel.vertices.buffer, offsets);
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], INSTANCE_BUFFER_BIND_ID, 1, &instanceBuffer.buffer, offsets);
-
-			vkCmdBindIndexBuffer(drawCmdBuffers[i], lodModel.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+			buildDepthPyramid(drawCmdBuffers[i]);
 
-			if (vulkanDevice->features.multiDrawIndirect)
-			{
-				vkCmdDrawIndexedIndirect(drawCmdBuffers[i], indirectCommandsBuffer.buffer, 0, static_cast<uint32_t>(indirectCommands.size()), sizeof(VkDrawIndexedIndirectCommand));
-			}
-			else
-			{
-				// If multi draw is not available, we must issue separate draw commands
-				for (auto j = 0; j < indirectCommands.size(); j++)
-				{
-					vkCmdDrawIndexedIndirect(drawCmdBuffers[i], indirectCommandsBuffer.buffer, j * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
-				}
-			}
+			// Second culling pass, tests the objects rejected by the first one against the new depth pyramid
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineSecondPass);
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, nullptr);
+			vkCmdDispatch(drawCmdBuffers[i], objectCount / 16, 1, 1);
 
-			drawUI(drawCmdBuffers[i]);
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+			vkCmdPipelineBarrier(
+				drawCmdBuffers[i],
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+				VK_FLAGS_NONE,
+				1, &memoryBarrier,
+				0, nullptr,
+				0, nullptr);
 
+			// Disoccluded objects found by the second culling pass
+			renderPassBeginInfo.renderPass = renderPassLoad;
+			renderPassBeginInfo.clearValueCount = 0;
+			renderPassBeginInfo.pClearValues = nullptr;
+			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			drawObjects(drawCmdBuffers[i], objectCount);
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
+			// Reduce again, so the pyramid the next frame's first culling pass tests against also contains the disoccluded objects
+			buildDepthPyramid(drawCmdBuffers[i]);
+
 			// Release barrier
-			if (vulkanDevice->queueFamilyIndices.graphics != vulkanDevice->queueFamilyIndices.compute)
+			if (separateQueueFamilies)
 			{
-				VkBufferMemoryBarrier buffer_barrier =
-				{
-					VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-					nullptr,
-					VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
-					0,
-					vulkanDevice->queueFamilyIndices.graphics,
-					vulkanDevice->queueFamilyIndices.compute,
-					indirectCommandsBuffer.buffer,
-					0,
-					indirectCommandsBuffer.descriptor.range
-				};
-
+				std::vector<VkBufferMemoryBarrier> bufferBarriers = sharedBufferBarriers(vulkanDevice->queueFamilyIndices.graphics, vulkanDevice->queueFamilyIndices.compute, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, 0);
+				VkImageMemoryBarrier imageBarrier = depthPyramidBarrier(vulkanDevice->queueFamilyIndices.graphics, vulkanDevice->queueFamilyIndices.compute, VK_ACCESS_SHADER_WRITE_BIT, 0);
 				vkCmdPipelineBarrier(
 					drawCmdBuffers[i],
-					VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+					VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 					VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
 					0,
 					0, nullptr,
-					1, &buffer_barrier,
-					0, nullptr);
+					static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+					1, &imageBarrier);
 			}
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
@@ -246,49 +504,180 @@ public:
 		lodModel.loadFromFile(getAssetPath() + "models/suzanne_lods.gltf", vulkanDevice, queue, glTFLoadingFlags);
 	}
 
+	void destroyDepthPyramid()
+	{
+		if (depthPyramid.image == VK_NULL_HANDLE) {
+			return;
+		}
+		for (auto& levelView : depthPyramid.levelViews) {
+			vkDestroyImageView(device, levelView, nullptr);
+		}
+		depthPyramid.levelViews.clear();
+		vkDestroyImageView(device, depthPyramid.view, nullptr);
+		vkDestroyImage(device, depthPyramid.image, nullptr);
+		vkFreeMemory(device, depthPyramid.memory, nullptr);
+		vkDestroyDescriptorPool(device, depthPyramid.descriptorPool, nullptr);
+		depthPyramid.image = VK_NULL_HANDLE;
+	}
+
+	// Creates the depth pyramid and the per level descriptor sets for the reduction, called again if the window is resized
+	void prepareDepthPyramid()
+	{
+		destroyDepthPyramid();
+
+		// The first level is half the size of the depth attachment, all following levels are rounded down to at least one texel
+		depthPyramid.width = std::max(1u, width / 2);
+		depthPyramid.height = std::max(1u, height / 2);
+		depthPyramid.levelCount = static_cast<uint32_t>(floor(log2(std::max(depthPyramid.width, depthPyramid.height)))) + 1;
+
+		// The pyramid stays in the general layout, as levels are written as storage images and read as sampled images
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = VK_FORMAT_R32_SFLOAT;
+		imageCI.extent = { depthPyramid.width, depthPyramid.height, 1 };
+		imageCI.mipLevels = depthPyramid.levelCount;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &depthPyramid.image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, depthPyramid.image, &memReqs);
+		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
+		memAllocInfo.allocationSize = memReqs.size;
+		memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &depthPyramid.memory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, depthPyramid.image, depthPyramid.memory, 0));
+
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.format = VK_FORMAT_R32_SFLOAT;
+		viewCI.image = depthPyramid.image;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, depthPyramid.levelCount, 0, 1 };
+		VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &depthPyramid.view));
+		depthPyramid.levelViews.resize(depthPyramid.levelCount);
+		for (uint32_t i = 0; i < depthPyramid.levelCount; i++) {
+			viewCI.subresourceRange.baseMipLevel = i;
+			viewCI.subresourceRange.levelCount = 1;
+			VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &depthPyramid.levelViews[i]));
+		}
+
+		// Each level reads the level above it (or the depth attachment for the first level) and writes itself
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, depthPyramid.levelCount),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, depthPyramid.levelCount)
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, depthPyramid.levelCount);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &depthPyramid.descriptorPool));
+
+		depthPyramid.descriptorSets.resize(depthPyramid.levelCount);
+		for (uint32_t i = 0; i < depthPyramid.levelCount; i++) {
+			VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(depthPyramid.descriptorPool, &depthPyramid.descriptorSetLayout, 1);
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &depthPyramid.descriptorSets[i]));
+			VkDescriptorImageInfo inputDescriptor = (i == 0) ?
+				vks::initializers::descriptorImageInfo(depthPyramid.sampler, depthPyramid.depthView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) :
+				vks::initializers::descriptorImageInfo(depthPyramid.sampler, depthPyramid.levelViews[i - 1], VK_IMAGE_LAYOUT_GENERAL);
+			VkDescriptorImageInfo outputDescriptor = vks::initializers::descriptorImageInfo(VK_NULL_HANDLE, depthPyramid.levelViews[i], VK_IMAGE_LAYOUT_GENERAL);
+			std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+				// Binding 0: Input depth
+				vks::initializers::writeDescriptorSet(depthPyramid.descriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &inputDescriptor),
+				// Binding 1: Output level
+				vks::initializers::writeDescriptorSet(depthPyramid.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &outputDescriptor),
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
+
+		// Clear to the far plane, so nothing is occluded in the first frame
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, depthPyramid.levelCount, 0, 1 };
+		vks::tools::setImageLayout(copyCmd, depthPyramid.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, subresourceRange, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		VkClearColorValue clearColor = { { 1.0f, 1.0f, 1.0f, 1.0f } };
+		vkCmdClearColorImage(copyCmd, depthPyramid.image, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &subresourceRange);
+		// Like the buffers, the pyramid is initially released to the compute queue (see prepareBuffers)
+		VkImageMemoryBarrier imageBarrier = depthPyramidBarrier(VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+		if (vulkanDevice->queueFamilyIndices.graphics != vulkanDevice->queueFamilyIndices.compute)
+		{
+			imageBarrier = depthPyramidBarrier(vulkanDevice->queueFamilyIndices.graphics, vulkanDevice->queueFamilyIndices.compute, VK_ACCESS_TRANSFER_WRITE_BIT, 0);
+		}
+		vkCmdPipelineBarrier(
+			copyCmd,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &imageBarrier);
+		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+	}
+
+	// Sampler, layout and pipeline for the depth reduction, these don't depend on the window size
+	void prepareDepthReduction()
+	{
+		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+		samplerCI.magFilter = VK_FILTER_NEAREST;
+		samplerCI.minFilter = VK_FILTER_NEAREST;
+		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.minLod = 0.0f;
+		samplerCI.maxLod = VK_LOD_CLAMP_NONE;
+		samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device, &samplerCI, nullptr, &depthPyramid.sampler));
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0: Input depth (depth attachment or previous level)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Output level
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &depthPyramid.descriptorSetLayout));
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&depthPyramid.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &depthPyramid.pipelineLayout));
+
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(depthPyramid.pipelineLayout, 0);
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecullandlod/depthreduce.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &depthPyramid.pipeline));
+	}
+
 	void buildComputeCommandBuffer()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
 		VK_CHECK_RESULT(vkBeginCommandBuffer(compute.commandBuffer, &cmdBufInfo));
 
+		const bool separateQueueFamilies = vulkanDevice->queueFamilyIndices.graphics != vulkanDevice->queueFamilyIndices.compute;
+
 		// Acquire barrier
 		// Add memory barrier to ensure that the indirect commands have been consumed before the compute shader updates them
-		if (vulkanDevice->queueFamilyIndices.graphics != vulkanDevice->queueFamilyIndices.compute)
+		if (separateQueueFamilies)
 		{
-			VkBufferMemoryBarrier buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				0,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				vulkanDevice->queueFamilyIndices.graphics,
-				vulkanDevice->queueFamilyIndices.compute,
-				indirectCommandsBuffer.buffer,
-				0,
-				indirectCommandsBuffer.descriptor.range
-			};
-
+			std::vector<VkBufferMemoryBarrier> bufferBarriers = sharedBufferBarriers(vulkanDevice->queueFamilyIndices.graphics, vulkanDevice->queueFamilyIndices.compute, 0, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+			VkImageMemoryBarrier imageBarrier = depthPyramidBarrier(vulkanDevice->queueFamilyIndices.graphics, vulkanDevice->queueFamilyIndices.compute, 0, VK_ACCESS_SHADER_READ_BIT);
 			vkCmdPipelineBarrier(
 				compute.commandBuffer,
 				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
 				VK_FLAGS_NONE,
 				0, nullptr,
-				1, &buffer_barrier,
-				0, nullptr);
+				static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+				1, &imageBarrier);
 		}
 
 		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipeline);
 		vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
 
 		// Clear the buffer that the compute shader pass will write statistics and draw calls to
-		vkCmdFillBuffer(compute.commandBuffer, indirectDrawCountBuffer.buffer, 0, indirectCommandsBuffer.descriptor.range, 0);
+		vkCmdFillBuffer(compute.commandBuffer, indirectDrawCountBuffer.buffer, 0, indirectDrawCountBuffer.descriptor.range, 0);
 
 		// This barrier ensures that the fill command is finished before the compute shader can start writing to the buffer
 		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
 		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
 
 		vkCmdPipelineBarrier(
 			compute.commandBuffer,
@@ -300,39 +689,26 @@ public:
 			0, nullptr);
 
 		// Dispatch the compute job
-		// The compute shader will do the frustum culling and adjust the indirect draw calls depending on object visibility.
+		// The compute shader will do the frustum and occlusion culling and adjust the indirect draw calls depending on object visibility.
 		// It also determines the lod to use depending on distance to the viewer.
 		vkCmdDispatch(compute.commandBuffer, objectCount / 16, 1, 1);
 
 		// Release barrier
 		// Add memory barrier to ensure that the compute shader has finished writing the indirect command buffer before it's consumed
-		if (vulkanDevice->queueFamilyIndices.graphics != vulkanDevice->queueFamilyIndices.compute)
+		if (separateQueueFamilies)
 		{
-			VkBufferMemoryBarrier buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				VK_ACCESS_SHADER_WRITE_BIT,
-				0,
-				vulkanDevice->queueFamilyIndices.compute,
-				vulkanDevice->queueFamilyIndices.graphics,
-				indirectCommandsBuffer.buffer,
-				0,
-				indirectCommandsBuffer.descriptor.range
-			};
-
+			std::vector<VkBufferMemoryBarrier> bufferBarriers = sharedBufferBarriers(vulkanDevice->queueFamilyIndices.compute, vulkanDevice->queueFamilyIndices.graphics, VK_ACCESS_SHADER_WRITE_BIT, 0);
+			VkImageMemoryBarrier imageBarrier = depthPyramidBarrier(vulkanDevice->queueFamilyIndices.compute, vulkanDevice->queueFamilyIndices.graphics, 0, 0);
 			vkCmdPipelineBarrier(
 				compute.commandBuffer,
 				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
 				VK_FLAGS_NONE,
 				0, nullptr,
-				1, &buffer_barrier,
-				0, nullptr);
+				static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+				1, &imageBarrier);
 		}
 
-		// todo: barrier for indirect stats buffer?
-
 		vkEndCommandBuffer(compute.commandBuffer);
 	}
 
@@ -340,7 +716,8 @@ public:
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1)
 		};
 		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
@@ -440,7 +817,8 @@ public:
 		vks::Buffer stagingBuffer;
 
 		std::vector<InstanceData> instanceData(objectCount);
-		indirectCommands.resize(objectCount);
+		// The commands of the second culling pass follow the ones of the first pass
+		indirectCommands.resize(objectCount * 2);
 
 		// Indirect draw commands
 		for (uint32_t x = 0; x < OBJECT_COUNT; x++)
@@ -452,12 +830,14 @@ public:
 					uint32_t index = x + y * OBJECT_COUNT + z * OBJECT_COUNT * OBJECT_COUNT;
 					indirectCommands[index].instanceCount = 1;
 					indirectCommands[index].firstInstance = index;
+					indirectCommands[index + objectCount].instanceCount = 0;
+					indirectCommands[index + objectCount].firstInstance = index;
 					// firstIndex and indexCount are written by the compute shader
 				}
 			}
 		}
 
-		indirectStats.drawCount = static_cast<uint32_t>(indirectCommands.size());
+		indirectStats.drawCount = objectCount;
 
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
@@ -521,26 +901,15 @@ public:
 		// so that when the compute command buffer executes for the first time
 		// it doesn't complain about a lack of a corresponding "release" to its "acquire"
 		if (vulkanDevice->queueFamilyIndices.graphics != vulkanDevice->queueFamilyIndices.compute)
-		{			VkBufferMemoryBarrier buffer_barrier =
-			{
-				VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-				nullptr,
-				VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
-				0,
-				vulkanDevice->queueFamilyIndices.graphics,
-				vulkanDevice->queueFamilyIndices.compute,
-				indirectCommandsBuffer.buffer,
-				0,
-				indirectCommandsBuffer.descriptor.range
-			};
-
+		{
+			std::vector<VkBufferMemoryBarrier> bufferBarriers = sharedBufferBarriers(vulkanDevice->queueFamilyIndices.graphics, vulkanDevice->queueFamilyIndices.compute, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, 0);
 			vkCmdPipelineBarrier(
 				copyCmd,
 				VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
 				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
 				0,
 				0, nullptr,
-				1, &buffer_barrier,
+				static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
 				0, nullptr);
 		}
 		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
@@ -565,8 +934,12 @@ public:
 			lod.distance = 5.0f + n * 5.0f;							// Starting distance (to viewer) for this LOD
 			n++;
 			LODLevels.push_back(lod);
+			lodTriangleCounts.push_back(lod.indexCount / 3);
 		}
 
+		// All LODs share the same bounds, the bounding sphere is centered at the object's origin as the instances are positioned by it
+		uboScene.meshRadius = glm::length(glm::max(glm::abs(lodModel.dimensions.min), glm::abs(lodModel.dimensions.max)));
+
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
@@ -630,6 +1003,11 @@ public:
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				VK_SHADER_STAGE_COMPUTE_BIT,
 				4),
+			// Binding 5: Depth pyramid (input)
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				5),
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout =
@@ -690,28 +1068,35 @@ public:
 
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(computeWriteDescriptorSets.size()), computeWriteDescriptorSets.data(), 0, NULL);
 
+		updateDepthPyramidDescriptor();
+
 		// Create pipeline
 		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
 		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "computecullandlod/cull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
 
-		// Use specialization constants to pass max. level of detail (determined by no. of meshes)
-		VkSpecializationMapEntry specializationEntry{};
-		specializationEntry.constantID = 0;
-		specializationEntry.offset = 0;
-		specializationEntry.size = sizeof(uint32_t);
-
-		uint32_t specializationData = static_cast<uint32_t>(lodModel.nodes.size()) - 1;
+		// Use specialization constants to pass max. level of detail (determined by no. of meshes) and the culling pass
+		struct SpecializationData {
+			uint32_t maxLodLevel;
+			VkBool32 secondPass;
+		} specializationData;
+		specializationData.maxLodLevel = static_cast<uint32_t>(lodModel.nodes.size()) - 1;
+		specializationData.secondPass = VK_FALSE;
+
+		std::array<VkSpecializationMapEntry, 2> specializationEntries = {
+			vks::initializers::specializationMapEntry(0, offsetof(SpecializationData, maxLodLevel), sizeof(uint32_t)),
+			vks::initializers::specializationMapEntry(1, offsetof(SpecializationData, secondPass), sizeof(VkBool32))
+		};
 
-		VkSpecializationInfo specializationInfo;
-		specializationInfo.mapEntryCount = 1;
-		specializationInfo.pMapEntries = &specializationEntry;
-		specializationInfo.dataSize = sizeof(specializationData);
-		specializationInfo.pData = &specializationData;
+		VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(static_cast<uint32_t>(specializationEntries.size()), specializationEntries.data(), sizeof(specializationData), &specializationData);
 
 		computePipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
 
 		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipeline));
 
+		// The second pass is recorded into the graphics command buffers after the depth pyramid has been built
+		specializationData.secondPass = VK_TRUE;
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.pipelineSecondPass));
+
 		// Separate command pool as queue family for compute may be different than graphics
 		VkCommandPoolCreateInfo cmdPoolInfo = {};
 		cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -739,6 +1124,14 @@ public:
 		buildComputeCommandBuffer();
 	}
 
+	void updateDepthPyramidDescriptor()
+	{
+		// Binding 5: Depth pyramid
+		VkDescriptorImageInfo depthPyramidDescriptor = vks::initializers::descriptorImageInfo(depthPyramid.sampler, depthPyramid.view, VK_IMAGE_LAYOUT_GENERAL);
+		VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5, &depthPyramidDescriptor);
+		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+	}
+
 	void updateUniformBuffer(bool viewChanged)
 	{
 		if (viewChanged)
@@ -782,7 +1175,7 @@ public:
 		// Wait on present and compute semaphores
 		std::array<VkPipelineStageFlags,2> stageFlags = {
 			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 		};
 		std::array<VkSemaphore,2> waitSemaphores = {
 			semaphores.presentComplete,						// Wait for presentation to finished
@@ -811,6 +1204,8 @@ public:
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSet();
+		prepareDepthReduction();
+		prepareDepthPyramid();
 		prepareCompute();
 		buildCommandBuffers();
 		prepared = true;
@@ -840,9 +1235,21 @@ public:
 			if (overlay->checkBox("Freeze frustum", &fixedFrustum)) {
 				updateUniformBuffer(true);
 			}
+			bool occlusionCulling = (uboScene.occlusionCulling == 1);
+			if (overlay->checkBox("Occlusion culling", &occlusionCulling)) {
+				uboScene.occlusionCulling = occlusionCulling ? 1 : 0;
+				updateUniformBuffer(false);
+			}
 		}
 		if (overlay->header("Statistics")) {
 			overlay->text("Visible objects: %d", indirectStats.drawCount);
+			overlay->text("Disoccluded objects: %d", indirectStats.secondPassCount);
+			overlay->text("Occluded objects: %d", indirectStats.occludedCount);
+			uint64_t triangleCount = 0;
+			for (size_t i = 0; i < lodTriangleCounts.size() && i <= MAX_LOD_LEVEL; i++) {
+				triangleCount += static_cast<uint64_t>(indirectStats.lodCount[i]) * lodTriangleCounts[i];
+			}
+			overlay->text("Triangles: %llu", static_cast<unsigned long long>(triangleCount));
 			for (uint32_t i = 0; i < MAX_LOD_LEVEL + 1; i++) {
 				overlay->text("LOD %d: %d", i, indirectStats.lodCount[i]);
 			}
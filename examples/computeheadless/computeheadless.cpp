@@ -29,6 +29,7 @@
 #endif
 #include <vulkan/vulkan.h>
 #include "VulkanTools.h"
+#include "VulkanComputeBatch.hpp"
 #include "CommandLineParser.hpp"
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
@@ -38,6 +39,8 @@ android_app* androidapp;
 #define DEBUG (!NDEBUG)
 
 #define BUFFER_ELEMENTS 32
+// Local workgroup size of the batch compute shader
+#define BATCH_WORKGROUP_SIZE 256
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 #define LOG(...) ((void)__android_log_print(ANDROID_LOG_INFO, "vulkanExample", __VA_ARGS__))
@@ -68,17 +71,22 @@ public:
 	VkPhysicalDevice physicalDevice;
 	VkDevice device;
 	uint32_t queueFamilyIndex;
-	VkPipelineCache pipelineCache;
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;
 	VkQueue queue;
 	VkCommandPool commandPool;
 	VkCommandBuffer commandBuffer;
-	VkFence fence;
-	VkDescriptorPool descriptorPool;
-	VkDescriptorSetLayout descriptorSetLayout;
+	VkFence fence = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
 	VkDescriptorSet descriptorSet;
-	VkPipelineLayout pipelineLayout;
-	VkPipeline pipeline;
-	VkShaderModule shaderModule;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkShaderModule shaderModule = VK_NULL_HANDLE;
+
+	// Batch mode (--batch) streams a large dataset through the compute shader using vks::ComputeBatchRunner
+	bool batchMode = false;
+	uint32_t transferQueueFamilyIndex;
+	VkQueue transferQueue;
 
 	VkDebugReportCallbackEXT debugReportCallback{};
 
@@ -122,10 +130,134 @@ public:
 		return VK_SUCCESS;
 	}
 
+	VkPipelineShaderStageCreateInfo loadShader(const std::string& fileName, const VkSpecializationInfo* specializationInfo)
+	{
+		std::string shaderDir = "glsl";
+		if (commandLineParser.isSet("shaders")) {
+			shaderDir = commandLineParser.getValueAsString("shaders", "glsl");
+		}
+		const std::string shadersPath = getAssetPath() + "shaders/"+shaderDir+"/computeheadless/";
+
+		VkPipelineShaderStageCreateInfo shaderStage = {};
+		shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+#if defined(VK_USE_PLATFORM_ANDROID_KHR)
+		shaderStage.module = vks::tools::loadShader(androidapp->activity->assetManager, (shadersPath + fileName).c_str(), device);
+#else
+		shaderStage.module = vks::tools::loadShader((shadersPath + fileName).c_str(), device);
+#endif
+		shaderStage.pName = "main";
+		shaderStage.pSpecializationInfo = specializationInfo;
+		shaderModule = shaderStage.module;
+		assert(shaderStage.module != VK_NULL_HANDLE);
+		return shaderStage;
+	}
+
+	/*
+		Streams a dataset of the given size through the compute shader in chunks and reports the throughput
+		Input values are generated on the fly and the results are validated against a CPU reference while reading them back
+	*/
+	void runBatch(VkDeviceSize totalSize, VkDeviceSize chunkSize, uint32_t slotCount)
+	{
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+		// A chunk must fit into a single dispatch
+		const VkDeviceSize maxChunkSize = (VkDeviceSize)deviceProperties.limits.maxComputeWorkGroupCount[0] * BATCH_WORKGROUP_SIZE * sizeof(uint32_t);
+		chunkSize = std::min(chunkSize, maxChunkSize);
+		totalSize = totalSize / sizeof(uint32_t) * sizeof(uint32_t);
+
+		vks::ComputeBatchRunner::Queue computeQueueInfo = { queue, queueFamilyIndex };
+		vks::ComputeBatchRunner::Queue transferQueueInfo = { transferQueue, transferQueueFamilyIndex };
+		vks::ComputeBatchRunner runner(physicalDevice, device, computeQueueInfo, transferQueueInfo, chunkSize, slotCount);
+
+		// One descriptor set per slot pointing to that slot's device buffer
+		std::vector<VkDescriptorPoolSize> poolSizes = {
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, slotCount),
+		};
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), slotCount);
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
+
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
+
+		// The number of elements in a chunk is passed via push constant
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(uint32_t), 0);
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+		std::vector<VkDescriptorSet> descriptorSets(slotCount);
+		std::vector<VkDescriptorSetLayout> setLayouts(slotCount, descriptorSetLayout);
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, setLayouts.data(), slotCount);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()));
+		for (uint32_t i = 0; i < slotCount; i++) {
+			VkDescriptorBufferInfo bufferDescriptor = { runner.getDeviceBuffer(i), 0, VK_WHOLE_SIZE };
+			VkWriteDescriptorSet writeDescriptorSet = vks::initializers::writeDescriptorSet(descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &bufferDescriptor);
+			vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+		}
+
+		VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
+		pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		VK_CHECK_RESULT(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(pipelineLayout, 0);
+		computePipelineCreateInfo.stage = loadShader("batch.comp.spv", nullptr);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipeline));
+
+		// Input values are kept small so the fibonacci results can be checked against a lookup table
+		const uint32_t valueRange = 32;
+		std::vector<uint32_t> reference(valueRange);
+		for (uint32_t n = 0; n < valueRange; n++) {
+			uint32_t curr = 1, prev = 1;
+			for (uint32_t i = 2; i < n; ++i) {
+				uint32_t temp = curr;
+				curr += prev;
+				prev = temp;
+			}
+			reference[n] = (n <= 1) ? n : curr;
+		}
+
+		runner.writeInput = [valueRange](VkDeviceSize offset, VkDeviceSize size, void* dst) {
+			uint32_t* values = static_cast<uint32_t*>(dst);
+			const uint64_t first = offset / sizeof(uint32_t);
+			for (uint64_t i = 0; i < size / sizeof(uint32_t); i++) {
+				values[i] = static_cast<uint32_t>((first + i) % valueRange);
+			}
+		};
+		uint64_t mismatches = 0;
+		runner.readOutput = [&](VkDeviceSize offset, VkDeviceSize size, const void* src) {
+			const uint32_t* values = static_cast<const uint32_t*>(src);
+			const uint64_t first = offset / sizeof(uint32_t);
+			for (uint64_t i = 0; i < size / sizeof(uint32_t); i++) {
+				if (values[i] != reference[(first + i) % valueRange]) {
+					mismatches++;
+				}
+			}
+		};
+		runner.recordDispatch = [&](VkCommandBuffer cmdBuffer, uint32_t slot, VkDeviceSize size) {
+			const uint32_t elementCount = static_cast<uint32_t>(size / sizeof(uint32_t));
+			vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[slot], 0, nullptr);
+			vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &elementCount);
+			vkCmdDispatch(cmdBuffer, (elementCount + BATCH_WORKGROUP_SIZE - 1) / BATCH_WORKGROUP_SIZE, 1, 1);
+		};
+
+		LOG("Batch: %.1f MB in chunks of %.1f MB, %d slots, %s transfer queue\n", (double)totalSize / (1024.0 * 1024.0), (double)chunkSize / (1024.0 * 1024.0), slotCount,
+			(transferQueue == queue) ? "shared" : (transferQueueFamilyIndex == queueFamilyIndex ? "second" : "dedicated"));
+		vks::ComputeBatchRunner::Statistics statistics = runner.run(totalSize);
+		LOG("Processed %d chunks in %.3f s: %.2f GB/s (host waited %.3f s)\n", statistics.chunkCount, statistics.seconds, statistics.gigabytesPerSecond(), statistics.waitSeconds);
+		LOG("Validation: %s (%llu mismatches)\n", mismatches == 0 ? "passed" : "FAILED", (unsigned long long)mismatches);
+	}
+
 	VulkanExample()
 	{
 		LOG("Running headless compute example\n");
 
+		batchMode = commandLineParser.isSet("batch");
+
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 		LOG("loading vulkan lib");
 		vks::android::loadVulkanLibrary();
@@ -136,6 +268,17 @@ public:
 		appInfo.pApplicationName = "Vulkan headless example";
 		appInfo.pEngineName = "VulkanExample";
 		appInfo.apiVersion = VK_API_VERSION_1_0;
+		if (batchMode) {
+			// Timeline semaphores used by the batch runner are core in Vulkan 1.2
+			PFN_vkEnumerateInstanceVersion enumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+			uint32_t instanceVersion = VK_API_VERSION_1_0;
+			if (enumerateInstanceVersion) {
+				enumerateInstanceVersion(&instanceVersion);
+			}
+			if (instanceVersion >= VK_API_VERSION_1_2) {
+				appInfo.apiVersion = VK_API_VERSION_1_2;
+			}
+		}
 
 		/*
 			Vulkan instance creation (without surface extensions)
@@ -236,8 +379,24 @@ public:
 		vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
 		LOG("GPU: %s\n", deviceProperties.deviceName);
 
+		VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures{};
+		timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+		if (batchMode) {
+			if ((appInfo.apiVersion >= VK_API_VERSION_1_2) && (deviceProperties.apiVersion >= VK_API_VERSION_1_2)) {
+				VkPhysicalDeviceFeatures2 deviceFeatures2{};
+				deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+				deviceFeatures2.pNext = &timelineSemaphoreFeatures;
+				PFN_vkGetPhysicalDeviceFeatures2 getPhysicalDeviceFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2"));
+				getPhysicalDeviceFeatures2(physicalDevice, &deviceFeatures2);
+			}
+			if (!timelineSemaphoreFeatures.timelineSemaphore) {
+				LOG("Batch mode requires Vulkan 1.2 with timeline semaphore support, running the default example instead\n");
+				batchMode = false;
+			}
+		}
+
 		// Request a single compute queue
-		const float defaultQueuePriority(0.0f);
+		const float defaultQueuePriorities[2] = { 0.0f, 0.0f };
 		VkDeviceQueueCreateInfo queueCreateInfo = {};
 		uint32_t queueFamilyCount;
 		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
@@ -249,15 +408,39 @@ public:
 				queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
 				queueCreateInfo.queueFamilyIndex = i;
 				queueCreateInfo.queueCount = 1;
-				queueCreateInfo.pQueuePriorities = &defaultQueuePriority;
+				queueCreateInfo.pQueuePriorities = defaultQueuePriorities;
 				break;
 			}
 		}
+		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos = { queueCreateInfo };
+		// Batch mode moves uploads and readbacks to a separate queue if possible, preferably from a dedicated transfer family
+		// Otherwise (e.g. on software implementations with a single queue) everything is submitted to the compute queue
+		transferQueueFamilyIndex = queueFamilyIndex;
+		uint32_t transferQueueIndex = 0;
+		if (batchMode) {
+			for (uint32_t i = 0; i < static_cast<uint32_t>(queueFamilyProperties.size()); i++) {
+				if ((queueFamilyProperties[i].queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamilyProperties[i].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+					transferQueueFamilyIndex = i;
+					break;
+				}
+			}
+			if (transferQueueFamilyIndex != queueFamilyIndex) {
+				VkDeviceQueueCreateInfo transferQueueCreateInfo = queueCreateInfo;
+				transferQueueCreateInfo.queueFamilyIndex = transferQueueFamilyIndex;
+				queueCreateInfos.push_back(transferQueueCreateInfo);
+			} else if (queueFamilyProperties[queueFamilyIndex].queueCount > 1) {
+				queueCreateInfos[0].queueCount = 2;
+				transferQueueIndex = 1;
+			}
+		}
 		// Create logical device
 		VkDeviceCreateInfo deviceCreateInfo = {};
 		deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-		deviceCreateInfo.queueCreateInfoCount = 1;
-		deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
+		deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
+		deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
+		if (batchMode) {
+			deviceCreateInfo.pNext = &timelineSemaphoreFeatures;
+		}
 		std::vector<const char*> deviceExtensions = {};
 #if defined(VK_USE_PLATFORM_MACOS_MVK) && defined(VK_KHR_portability_subset)
 		// SRS - When running on macOS with MoltenVK and VK_KHR_portability_subset is defined and supported by the device, enable the extension
@@ -285,6 +468,7 @@ public:
 
 		// Get a compute queue
 		vkGetDeviceQueue(device, queueFamilyIndex, 0, &queue);
+		vkGetDeviceQueue(device, transferQueueFamilyIndex, transferQueueIndex, &transferQueue);
 
 		// Compute command pool
 		VkCommandPoolCreateInfo cmdPoolInfo = {};
@@ -293,6 +477,15 @@ public:
 		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 		VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &commandPool));
 
+		if (batchMode) {
+			const VkDeviceSize megabyte = 1024 * 1024;
+			runBatch(
+				(VkDeviceSize)std::max(commandLineParser.getValueAsInt("batch", 256), 1) * megabyte,
+				(VkDeviceSize)std::max(commandLineParser.getValueAsInt("chunksize", 16), 1) * megabyte,
+				static_cast<uint32_t>(std::max(commandLineParser.getValueAsInt("slots", 3), 2)));
+			return;
+		}
+
 		/*
 			Prepare storage buffers
 		*/
@@ -409,26 +602,7 @@ public:
 			VkSpecializationMapEntry specializationMapEntry = vks::initializers::specializationMapEntry(0, 0, sizeof(uint32_t));
 			VkSpecializationInfo specializationInfo = vks::initializers::specializationInfo(1, &specializationMapEntry, sizeof(SpecializationData), &specializationData);
 
-			std::string shaderDir = "glsl";
-			if (commandLineParser.isSet("shaders")) {
-				shaderDir = commandLineParser.getValueAsString("shaders", "glsl");
-			}
-			const std::string shadersPath = getAssetPath() + "shaders/"+shaderDir+"/computeheadless/";
-
-			VkPipelineShaderStageCreateInfo shaderStage = {};
-			shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-			shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-#if defined(VK_USE_PLATFORM_ANDROID_KHR)
-			shaderStage.module = vks::tools::loadShader(androidapp->activity->assetManager, (shadersPath + "headless.comp.spv").c_str(), device);
-#else
-			shaderStage.module = vks::tools::loadShader((shadersPath + "headless.comp.spv").c_str(), device);
-#endif
-			shaderStage.pName = "main";
-			shaderStage.pSpecializationInfo = &specializationInfo;
-			shaderModule = shaderStage.module;
-
-			assert(shaderStage.module != VK_NULL_HANDLE);
-			computePipelineCreateInfo.stage = shaderStage;
+			computePipelineCreateInfo.stage = loadShader("headless.comp.spv", &specializationInfo);
 			VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipeline));
 
 			// Create a command buffer for compute operations
@@ -607,6 +781,9 @@ void android_main(android_app* state) {
 int main(int argc, char* argv[]) {
 	commandLineParser.add("help", { "--help" }, 0, "Show help");
 	commandLineParser.add("shaders", { "-s", "--shaders" }, 1, "Select shader type to use (glsl or hlsl)");
+	commandLineParser.add("batch", { "--batch" }, 1, "Stream a dataset of the given size (in MB) through the compute shader in pipelined chunks");
+	commandLineParser.add("chunksize", { "--chunksize" }, 1, "Chunk size in MB for batch mode (default 16)");
+	commandLineParser.add("slots", { "--slots" }, 1, "Number of staging slots for batch mode, 2 = double, 3 = triple buffering (default 3)");
 	commandLineParser.parse(argc, argv);
 	if (commandLineParser.isSet("help")) {
 		commandLineParser.printHelp();
@@ -7,6 +7,7 @@
 */
 
 #include "vulkanexamplebase.h"
+#include "nbodyreference.h"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
@@ -16,11 +17,37 @@
 #else
 #define PARTICLES_PER_ATTRACTOR 4 * 1024
 #endif
+// Compute shader workgroup size, the particle count must be a multiple of this
+#define WORKGROUP_SIZE 256
+// Number of simulation steps the GPU runs before its results are compared against the CPU reference
+#define VALIDATION_STEPS 16
+// Number of steps per particle count run by the CPU reference benchmark
+#define BENCHMARK_STEPS 4
 
 class VulkanExample : public VulkanExampleBase
 {
 public:
 	uint32_t numParticles;
+	// Can be changed with --nbodyparticles, rounded up to a multiple of the workgroup size
+	uint32_t particlesPerAttractor = PARTICLES_PER_ATTRACTOR;
+	std::vector<glm::vec3> attractors;
+	NBodyParameters parameters;
+
+	// CPU reference implementation of the simulation, used for validation and benchmarking
+	vks::ThreadPool threadPool;
+
+	// Set with --nbodyvalidate, runs the GPU simulation with a fixed time step and compares it against the CPU reference
+	struct {
+		bool enabled = false;
+		bool finished = false;
+		float deltaT = 0.001f;
+		uint32_t submittedSteps = 0;
+		std::vector<Particle> initialParticles;
+		vks::Buffer readbackBuffer;				// Host visible copy of the storage buffer after the last validation step
+		VkCommandBuffer commandBuffer;			// Compute command buffer that also copies the results to the readback buffer
+		NBodyDrift gpuDrift;					// GPU vs. CPU direct solver
+		NBodyDrift barnesHutDrift;				// CPU Barnes-Hut vs. CPU direct solver
+	} validation;
 
 	struct {
 		vks::Texture2D particle;
@@ -73,12 +100,6 @@ public:
 		} ubo;
 	} compute;
 
-	// SSBO particle declaration
-	struct Particle {
-		glm::vec4 pos;								// xyz = position, w = mass
-		glm::vec4 vel;								// xyz = velocity, w = gradient texture position
-	};
-
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Compute shader N-body system";
@@ -87,6 +108,17 @@ public:
 		camera.setRotation(glm::vec3(-26.0f, 75.0f, 0.0f));
 		camera.setTranslation(glm::vec3(0.0f, 0.0f, -14.0f));
 		camera.movementSpeed = 2.5f;
+		attractors = getAttractors();
+		threadPool.setThreadCount(std::max(1u, std::thread::hardware_concurrency()));
+		for (size_t i = 0; i < args.size(); i++) {
+			if (strcmp(args[i], "--nbodyvalidate") == 0) {
+				validation.enabled = true;
+			}
+			if ((strcmp(args[i], "--nbodyparticles") == 0) && (i + 1 < args.size())) {
+				const uint32_t count = static_cast<uint32_t>(std::max(1, atoi(args[i + 1])));
+				particlesPerAttractor = (count + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE * WORKGROUP_SIZE;
+			}
+		}
 	}
 
 	~VulkanExample()
@@ -107,11 +139,31 @@ public:
 		vkDestroyPipeline(device, compute.pipelineIntegrate, nullptr);
 		vkDestroySemaphore(device, compute.semaphore, nullptr);
 		vkDestroyCommandPool(device, compute.commandPool, nullptr);
+		validation.readbackBuffer.destroy();
 
 		textures.particle.destroy();
 		textures.gradient.destroy();
 	}
 
+	static std::vector<glm::vec3> getAttractors()
+	{
+#if 0
+		return {
+			glm::vec3(2.5f, 1.5f, 0.0f),
+			glm::vec3(-2.5f, -1.5f, 0.0f),
+		};
+#else
+		return {
+			glm::vec3(5.0f, 0.0f, 0.0f),
+			glm::vec3(-5.0f, 0.0f, 0.0f),
+			glm::vec3(0.0f, 0.0f, 5.0f),
+			glm::vec3(0.0f, 0.0f, -5.0f),
+			glm::vec3(0.0f, 4.0f, 0.0f),
+			glm::vec3(0.0f, -8.0f, 0.0f),
+		};
+#endif
+	}
+
 	void loadAssets()
 	{
 		textures.particle.loadFromFile(getAssetPath() + "textures/particle01_rgba.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
@@ -184,8 +236,6 @@ public:
 			vkCmdBindVertexBuffers(drawCmdBuffers[i], VERTEX_BUFFER_BIND_ID, 1, &compute.storageBuffer.buffer, offsets);
 			vkCmdDraw(drawCmdBuffers[i], numParticles, 1, 0, 0);
 
-			drawUI(drawCmdBuffers[i]);
-
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
 			// Release barrier
@@ -219,11 +269,12 @@ public:
 
 	}
 
-	void buildComputeCommandBuffer()
+	// If readbackBuffer is set, the results are also copied to that buffer for host access
+	void buildComputeCommandBuffer(VkCommandBuffer commandBuffer, vks::Buffer *readbackBuffer = nullptr)
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
-		VK_CHECK_RESULT(vkBeginCommandBuffer(compute.commandBuffer, &cmdBufInfo));
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
 
 		// Acquire barrier
 		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
@@ -242,7 +293,7 @@ public:
 			};
 
 			vkCmdPipelineBarrier(
-				compute.commandBuffer,
+				commandBuffer,
 				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
 				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 				0,
@@ -253,9 +304,9 @@ public:
 
 		// First pass: Calculate particle movement
 		// -------------------------------------------------------------------------------------------------------
-		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineCalculate);
-		vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
-		vkCmdDispatch(compute.commandBuffer, numParticles / 256, 1, 1);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineCalculate);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
+		vkCmdDispatch(commandBuffer, numParticles / WORKGROUP_SIZE, 1, 1);
 
 		// Add memory barrier to ensure that the computer shader has finished writing to the buffer
 		VkBufferMemoryBarrier bufferBarrier = vks::initializers::bufferMemoryBarrier();
@@ -268,7 +319,7 @@ public:
 		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 
 		vkCmdPipelineBarrier(
-			compute.commandBuffer,
+			commandBuffer,
 			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 			VK_FLAGS_NONE,
@@ -278,8 +329,43 @@ public:
 
 		// Second pass: Integrate particles
 		// -------------------------------------------------------------------------------------------------------
-		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineIntegrate);
-		vkCmdDispatch(compute.commandBuffer, numParticles / 256, 1, 1);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineIntegrate);
+		vkCmdDispatch(commandBuffer, numParticles / WORKGROUP_SIZE, 1, 1);
+
+		if (readbackBuffer)
+		{
+			bufferBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_FLAGS_NONE,
+				0, nullptr,
+				1, &bufferBarrier,
+				0, nullptr);
+
+			VkBufferCopy copyRegion = {};
+			copyRegion.size = compute.storageBuffer.size;
+			vkCmdCopyBuffer(commandBuffer, compute.storageBuffer.buffer, readbackBuffer->buffer, 1, &copyRegion);
+
+			// Make the copy visible to the host
+			VkBufferMemoryBarrier hostBarrier = vks::initializers::bufferMemoryBarrier();
+			hostBarrier.buffer = readbackBuffer->buffer;
+			hostBarrier.size = VK_WHOLE_SIZE;
+			hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_HOST_BIT,
+				VK_FLAGS_NONE,
+				0, nullptr,
+				1, &hostBarrier,
+				0, nullptr);
+		}
 
 		// Release barrier
 		if (graphics.queueFamilyIndex != compute.queueFamilyIndex)
@@ -298,7 +384,7 @@ public:
 			};
 
 			vkCmdPipelineBarrier(
-				compute.commandBuffer,
+				commandBuffer,
 				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
 				0,
@@ -307,67 +393,19 @@ public:
 				0, nullptr);
 		}
 
-		vkEndCommandBuffer(compute.commandBuffer);
+		vkEndCommandBuffer(commandBuffer);
 	}
 
 	// Setup and fill the compute shader storage buffers containing the particles
 	void prepareStorageBuffers()
 	{
-#if 0
-		std::vector<glm::vec3> attractors = {
-			glm::vec3(2.5f, 1.5f, 0.0f),
-			glm::vec3(-2.5f, -1.5f, 0.0f),
-		};
-#else
-		std::vector<glm::vec3> attractors = {
-			glm::vec3(5.0f, 0.0f, 0.0f),
-			glm::vec3(-5.0f, 0.0f, 0.0f),
-			glm::vec3(0.0f, 0.0f, 5.0f),
-			glm::vec3(0.0f, 0.0f, -5.0f),
-			glm::vec3(0.0f, 4.0f, 0.0f),
-			glm::vec3(0.0f, -8.0f, 0.0f),
-		};
-#endif
-
-		numParticles = static_cast<uint32_t>(attractors.size()) * PARTICLES_PER_ATTRACTOR;
+		numParticles = static_cast<uint32_t>(attractors.size()) * particlesPerAttractor;
 
 		// Initial particle positions
-		std::vector<Particle> particleBuffer(numParticles);
-
-		std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
-		std::normal_distribution<float> rndDist(0.0f, 1.0f);
-
-		for (uint32_t i = 0; i < static_cast<uint32_t>(attractors.size()); i++)
+		std::vector<Particle> particleBuffer = generateParticles(attractors, particlesPerAttractor, (benchmark.active || validation.enabled) ? benchmark.seed : (unsigned)time(nullptr));
+		if (validation.enabled)
 		{
-			for (uint32_t j = 0; j < PARTICLES_PER_ATTRACTOR; j++)
-			{
-				Particle &particle = particleBuffer[i * PARTICLES_PER_ATTRACTOR + j];
-
-				// First particle in group as heavy center of gravity
-				if (j == 0)
-				{
-					particle.pos = glm::vec4(attractors[i] * 1.5f, 90000.0f);
-					particle.vel = glm::vec4(glm::vec4(0.0f));
-				}
-				else
-				{
-					// Position
-					glm::vec3 position(attractors[i] + glm::vec3(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine)) * 0.75f);
-					float len = glm::length(glm::normalize(position - attractors[i]));
-					position.y *= 2.0f - (len * len);
-
-					// Velocity
-					glm::vec3 angular = glm::vec3(0.5f, 1.5f, 0.5f) * (((i % 2) == 0) ? 1.0f : -1.0f);
-					glm::vec3 velocity = glm::cross((position - attractors[i]), angular) + glm::vec3(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine) * 0.025f);
-
-					float mass = (rndDist(rndEngine) * 0.5f + 0.5f) * 75.0f;
-					particle.pos = glm::vec4(position, mass);
-					particle.vel = glm::vec4(velocity, 0.0f);
-				}
-
-				// Color gradient offset
-				particle.vel.w = (float)i * 1.0f / static_cast<uint32_t>(attractors.size());
-			}
+			validation.initialParticles = particleBuffer;
 		}
 
 		compute.ubo.particleCount = numParticles;
@@ -388,7 +426,8 @@ public:
 
 		vulkanDevice->createBuffer(
 			// The SSBO will be used as a storage buffer for the compute pipeline and as a vertex buffer in the graphics pipeline
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			// It's also read back for validation against the CPU reference
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			&compute.storageBuffer,
 			storageBufferSize);
@@ -713,11 +752,14 @@ public:
 		specializationMapEntries.push_back(vks::initializers::specializationMapEntry(2, offsetof(SpecializationData, power), sizeof(float)));
 		specializationMapEntries.push_back(vks::initializers::specializationMapEntry(3, offsetof(SpecializationData, soften), sizeof(float)));
 
-		specializationData.sharedDataSize = std::min((uint32_t)1024, (uint32_t)(vulkanDevice->properties.limits.maxComputeSharedMemorySize / sizeof(glm::vec4)));
+		// The shader fills one shared memory element per invocation and advances by the shared data size,
+		// so this must match the workgroup size or particles in between the tiles would be skipped
+		specializationData.sharedDataSize = WORKGROUP_SIZE;
 
-		specializationData.gravity = 0.002f;
-		specializationData.power = 0.75f;
-		specializationData.soften = 0.05f;
+		// Same parameters as the CPU reference
+		specializationData.gravity = parameters.gravity;
+		specializationData.power = parameters.power;
+		specializationData.soften = parameters.soften;
 
 		VkSpecializationInfo specializationInfo =
 			vks::initializers::specializationInfo(static_cast<uint32_t>(specializationMapEntries.size()), specializationMapEntries.data(), sizeof(specializationData), &specializationData);
@@ -744,7 +786,20 @@ public:
 		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &compute.semaphore));
 
 		// Build a single command buffer containing the compute dispatch commands
-		buildComputeCommandBuffer();
+		buildComputeCommandBuffer(compute.commandBuffer);
+
+		if (validation.enabled)
+		{
+			vulkanDevice->createBuffer(
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				&validation.readbackBuffer,
+				compute.storageBuffer.size);
+			VK_CHECK_RESULT(validation.readbackBuffer.map());
+			// The copy is part of the compute command buffer, so the storage buffer is owned by the compute queue family at that point
+			validation.commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, compute.commandPool);
+			buildComputeCommandBuffer(validation.commandBuffer, &validation.readbackBuffer);
+		}
 
 		// SRS - By reordering compute and graphics within draw(), the following code is no longer needed:
 		// If graphics and compute queue family indices differ, acquire and immediately release the storage buffer, so that the initial acquire from the graphics command buffers are matched up properly
@@ -830,7 +885,15 @@ public:
 
 	void updateComputeUniformBuffers()
 	{
-		compute.ubo.deltaT = paused ? 0.0f : frameTimer * 0.05f;
+		if (validation.enabled && !validation.finished)
+		{
+			// Fixed time step so the CPU reference can run the exact same steps
+			compute.ubo.deltaT = validation.deltaT;
+		}
+		else
+		{
+			compute.ubo.deltaT = paused ? 0.0f : frameTimer * 0.05f;
+		}
 		memcpy(compute.uniformBuffer.mapped, &compute.ubo, sizeof(compute.ubo));
 	}
 
@@ -847,10 +910,13 @@ public:
 		// Wait for rendering finished
 		VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 
+		// The last validation step also copies the results for comparison with the CPU reference
+		const bool readback = validation.enabled && !validation.finished && (++validation.submittedSteps == VALIDATION_STEPS);
+
 		// Submit compute commands
 		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
 		computeSubmitInfo.commandBufferCount = 1;
-		computeSubmitInfo.pCommandBuffers = &compute.commandBuffer;
+		computeSubmitInfo.pCommandBuffers = readback ? &validation.commandBuffer : &compute.commandBuffer;
 		computeSubmitInfo.waitSemaphoreCount = 1;
 		computeSubmitInfo.pWaitSemaphores = &graphics.semaphore;
 		computeSubmitInfo.pWaitDstStageMask = &waitStageMask;
@@ -875,6 +941,100 @@ public:
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
+
+		if (readback)
+		{
+			validateSimulation();
+		}
+	}
+
+	// Runs the same steps as the GPU on the CPU, starting from the same initial particles, and compares the results
+	void validateSimulation()
+	{
+		VK_CHECK_RESULT(vkQueueWaitIdle(compute.queue));
+		std::vector<Particle> gpuParticles(numParticles);
+		memcpy(gpuParticles.data(), validation.readbackBuffer.mapped, numParticles * sizeof(Particle));
+
+		NBodyReference direct(threadPool);
+		NBodyReference barnesHut(threadPool);
+		direct.parameters = parameters;
+		barnesHut.parameters = parameters;
+		direct.setParticles(validation.initialParticles);
+		barnesHut.setParticles(validation.initialParticles);
+		for (uint32_t i = 0; i < VALIDATION_STEPS; i++)
+		{
+			direct.step(validation.deltaT, NBodyReference::Solver::Direct);
+			barnesHut.step(validation.deltaT, NBodyReference::Solver::BarnesHut);
+		}
+
+		validation.gpuDrift = compareParticles(gpuParticles, direct.getParticles());
+		validation.barnesHutDrift = compareParticles(barnesHut.getParticles(), direct.getParticles());
+		validation.finished = true;
+
+		std::cout << "N-body validation after " << VALIDATION_STEPS << " steps of " << numParticles << " particles" << std::endl;
+		std::cout << "GPU vs. CPU direct: max drift " << validation.gpuDrift.maxError << " (particle " << validation.gpuDrift.maxIndex << "), mean drift " << validation.gpuDrift.meanError << std::endl;
+		std::cout << "CPU Barnes-Hut vs. CPU direct: max drift " << validation.barnesHutDrift.maxError << " (particle " << validation.barnesHutDrift.maxIndex << "), mean drift " << validation.barnesHutDrift.meanError << std::endl;
+	}
+
+	// Measures the CPU reference solvers at increasing particle counts
+	static void benchmarkReference(uint32_t seed)
+	{
+		const std::vector<glm::vec3> attractors = getAttractors();
+		const NBodyParameters parameters;
+		vks::ThreadPool threadPool;
+		threadPool.setThreadCount(std::max(1u, std::thread::hardware_concurrency()));
+		std::cout << "N-body CPU reference benchmark, " << threadPool.threads.size() << " threads" << std::endl;
+		const uint32_t counts[] = { 256, 1024, 4096, 16384 };
+		const float deltaT = 0.001f;
+		for (uint32_t count : counts)
+		{
+			const std::vector<Particle> initialParticles = generateParticles(attractors, count, seed);
+			const size_t particleCount = initialParticles.size();
+
+			auto run = [&](NBodyReference &reference, NBodyReference::Solver solver, const char *name) {
+				reference.parameters = parameters;
+				reference.setParticles(initialParticles);
+				uint64_t interactions = 0;
+				auto tStart = std::chrono::high_resolution_clock::now();
+				for (uint32_t i = 0; i < BENCHMARK_STEPS; i++)
+				{
+					reference.step(deltaT, solver);
+					interactions += reference.interactions;
+				}
+				const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - tStart).count();
+				std::cout << particleCount << " particles " << name << ": " << seconds * 1000.0 / BENCHMARK_STEPS << "ms/step, " << (double)interactions / seconds / 1.0e6 << " M interactions/s" << std::endl;
+			};
+
+			NBodyReference barnesHut(threadPool);
+			run(barnesHut, NBodyReference::Solver::BarnesHut, "Barnes-Hut");
+			// The direct solver gets too slow for larger counts
+			if (particleCount <= 32768)
+			{
+				NBodyReference direct(threadPool);
+				run(direct, NBodyReference::Solver::Direct, "direct");
+				const NBodyDrift drift = compareParticles(barnesHut.getParticles(), direct.getParticles());
+				std::cout << particleCount << " particles Barnes-Hut vs. direct: max drift " << drift.maxError << ", mean drift " << drift.meanError << std::endl;
+			}
+		}
+	}
+
+	// Called before the example is created, --nbodybenchmark only runs the CPU reference benchmark so it also works on hosts without a Vulkan device
+	static bool runWithoutVulkan()
+	{
+		bool runBenchmark = false;
+		uint32_t seed = 0;
+		for (size_t i = 0; i < args.size(); i++) {
+			if (strcmp(args[i], "--nbodybenchmark") == 0) {
+				runBenchmark = true;
+			}
+			if (((strcmp(args[i], "-bsd") == 0) || (strcmp(args[i], "--benchseed") == 0)) && (i + 1 < args.size())) {
+				seed = static_cast<uint32_t>(atoi(args[i + 1]));
+			}
+		}
+		if (runBenchmark) {
+			benchmarkReference(seed);
+		}
+		return runBenchmark;
 	}
 
 	void prepare()
@@ -907,6 +1067,19 @@ public:
 	{
 		updateGraphicsUniformBuffers();
 	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (validation.enabled && overlay->header("Validation")) {
+			overlay->text("Particles: %d", numParticles);
+			if (!validation.finished) {
+				overlay->text("Step %d of %d", validation.submittedSteps, VALIDATION_STEPS);
+			} else {
+				overlay->text("GPU drift: max %.6f, mean %.6f", validation.gpuDrift.maxError, validation.gpuDrift.meanError);
+				overlay->text("Barnes-Hut drift: max %.6f, mean %.6f", validation.barnesHutDrift.maxError, validation.barnesHutDrift.meanError);
+			}
+		}
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
@@ -0,0 +1,550 @@
+/*
+* Vulkan Example - CPU reference implementation of the compute shader N-body simulation
+*
+* Used to cross-check the GPU results and to benchmark the simulation on hosts without a GPU
+* Contains a direct O(n^2) solver that mirrors the compute shaders and a Barnes-Hut octree solver
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <random>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "threadpool.hpp"
+
+// Number of particles processed side by side in the inner loops, written so the compiler can map them to SIMD registers
+#define NBODY_LANE_COUNT 8
+// Number of particles per job handed out to the thread pool
+#define NBODY_TASK_SIZE 128
+// Maximum depth of the Barnes-Hut octree, nodes at this depth become leaves regardless of their particle count
+#define NBODY_MAX_TREE_DEPTH 24
+
+// SSBO particle declaration
+struct Particle {
+	glm::vec4 pos;								// xyz = position, w = mass
+	glm::vec4 vel;								// xyz = velocity, w = gradient texture position
+};
+
+// Simulation parameters, passed to the compute shader as specialization constants
+struct NBodyParameters {
+	float gravity = 0.002f;
+	float power = 0.75f;
+	float soften = 0.05f;
+};
+
+// Deviation between two particle sets
+struct NBodyDrift {
+	float maxError = 0.0f;						// Largest position distance of a single particle
+	float meanError = 0.0f;						// Mean position distance over all particles
+	uint32_t maxIndex = 0;						// Particle with the largest distance
+};
+
+// Generates the initial particle distribution: A heavy center of gravity per attractor surrounded by a rotating cloud of particles
+inline std::vector<Particle> generateParticles(const std::vector<glm::vec3> &attractors, uint32_t particlesPerAttractor, unsigned seed)
+{
+	std::vector<Particle> particles(attractors.size() * particlesPerAttractor);
+
+	std::default_random_engine rndEngine(seed);
+	std::normal_distribution<float> rndDist(0.0f, 1.0f);
+
+	for (uint32_t i = 0; i < static_cast<uint32_t>(attractors.size()); i++)
+	{
+		for (uint32_t j = 0; j < particlesPerAttractor; j++)
+		{
+			Particle &particle = particles[i * particlesPerAttractor + j];
+
+			// First particle in group as heavy center of gravity
+			if (j == 0)
+			{
+				particle.pos = glm::vec4(attractors[i] * 1.5f, 90000.0f);
+				particle.vel = glm::vec4(glm::vec4(0.0f));
+			}
+			else
+			{
+				// Position
+				glm::vec3 position(attractors[i] + glm::vec3(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine)) * 0.75f);
+				float len = glm::length(glm::normalize(position - attractors[i]));
+				position.y *= 2.0f - (len * len);
+
+				// Velocity
+				glm::vec3 angular = glm::vec3(0.5f, 1.5f, 0.5f) * (((i % 2) == 0) ? 1.0f : -1.0f);
+				glm::vec3 velocity = glm::cross((position - attractors[i]), angular) + glm::vec3(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine) * 0.025f);
+
+				float mass = (rndDist(rndEngine) * 0.5f + 0.5f) * 75.0f;
+				particle.pos = glm::vec4(position, mass);
+				particle.vel = glm::vec4(velocity, 0.0f);
+			}
+
+			// Color gradient offset
+			particle.vel.w = (float)i * 1.0f / static_cast<uint32_t>(attractors.size());
+		}
+	}
+
+	return particles;
+}
+
+// Compares the positions of two particle sets of the same size
+inline NBodyDrift compareParticles(const std::vector<Particle> &a, const std::vector<Particle> &b)
+{
+	NBodyDrift drift;
+	double sum = 0.0;
+	const size_t count = std::min(a.size(), b.size());
+	for (size_t i = 0; i < count; i++)
+	{
+		const float error = glm::length(glm::vec3(a[i].pos) - glm::vec3(b[i].pos));
+		sum += error;
+		// Also catches NaNs, which would otherwise never compare greater
+		if (error > drift.maxError || error != error)
+		{
+			drift.maxError = error;
+			drift.maxIndex = static_cast<uint32_t>(i);
+		}
+	}
+	drift.meanError = count > 0 ? static_cast<float>(sum / (double)count) : 0.0f;
+	return drift;
+}
+
+class NBodyReference
+{
+public:
+	enum class Solver { Direct, BarnesHut };
+
+	NBodyParameters parameters;
+	// Barnes-Hut opening angle, nodes that appear smaller than this (size / distance) are approximated by their center of mass
+	float theta = 0.5f;
+	// Barnes-Hut nodes with this many particles or less are not subdivided any further
+	uint32_t leafSize = 16;
+	// Number of pairwise interactions evaluated by the last call to step()
+	uint64_t interactions = 0;
+
+	NBodyReference(vks::ThreadPool &threadPool) : threadPool(threadPool) {}
+
+	void setParticles(const std::vector<Particle> &particles)
+	{
+		this->particles = particles;
+	}
+
+	const std::vector<Particle> &getParticles() const
+	{
+		return particles;
+	}
+
+	// Returns the acceleration of a particle as calculated by the last call to step()
+	glm::vec3 getAcceleration(uint32_t index) const
+	{
+		return glm::vec3(acc.x[index], acc.y[index], acc.z[index]);
+	}
+
+	// Advances the simulation by deltaT, same as one submission of the two compute passes
+	void step(float deltaT, Solver solver)
+	{
+		loadPositions();
+		if (solver == Solver::Direct)
+		{
+			calculateDirect();
+		}
+		else
+		{
+			buildTree();
+			calculateBarnesHut();
+		}
+		integrate(deltaT);
+	}
+
+private:
+	// Structure of arrays, so consecutive particles can be loaded into SIMD lanes
+	struct Lanes {
+		std::vector<float> x, y, z, w;
+		void resize(size_t size)
+		{
+			x.assign(size, 0.0f);
+			y.assign(size, 0.0f);
+			z.assign(size, 0.0f);
+			w.assign(size, 0.0f);
+		}
+	};
+
+	// Octree nodes are stored in a flat array, children of a node are stored consecutively
+	struct Node {
+		float com[3];							// Center of the node's mass distribution
+		float mass;								// Total mass of all particles in this node
+		float center[3];						// Center of the node's cube
+		float size;								// Edge length of the node's cube
+		uint32_t first, count;					// Range of the node's particles in tree order
+		uint32_t firstChild, childCount;		// Children, childCount is zero for leaves
+	};
+
+	vks::ThreadPool &threadPool;
+	std::vector<Particle> particles;
+	// Positions and masses, in particle order for the direct solver and in tree order for Barnes-Hut
+	Lanes pos;
+	Lanes acc;
+	std::vector<Node> nodes;
+	// Maps tree order to particle index
+	std::vector<uint32_t> order;
+	std::vector<uint32_t> orderScratch;
+	std::vector<uint8_t> octants;
+
+	// Runs func(task) for all tasks on the threads of the pool, tasks are handed out via an atomic counter
+	template<typename Func>
+	void parallelFor(uint32_t taskCount, const Func &func)
+	{
+		std::atomic<uint32_t> nextTask(0);
+		for (auto &thread : threadPool.threads)
+		{
+			thread->addJob([&nextTask, taskCount, &func] {
+				uint32_t task;
+				while ((task = nextTask.fetch_add(1, std::memory_order_relaxed)) < taskCount)
+				{
+					func(task);
+				}
+			});
+		}
+		threadPool.wait();
+	}
+
+	// Copies positions and masses into the lane arrays, padded with massless particles to a multiple of the lane count
+	void loadPositions()
+	{
+		const size_t count = particles.size();
+		const size_t paddedCount = (count + NBODY_LANE_COUNT - 1) / NBODY_LANE_COUNT * NBODY_LANE_COUNT;
+		pos.resize(paddedCount);
+		acc.resize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			pos.x[i] = particles[i].pos.x;
+			pos.y[i] = particles[i].pos.y;
+			pos.z[i] = particles[i].pos.z;
+			pos.w[i] = particles[i].pos.w;
+		}
+	}
+
+	// Returns d^power, the default power of 0.75 can be calculated as sqrt(d) * sqrt(sqrt(d)), which is much cheaper than pow
+	template<bool FastPower>
+	static float denominator(float d, float power)
+	{
+		if (FastPower)
+		{
+			const float s = std::sqrt(d);
+			return s * std::sqrt(s);
+		}
+		return std::pow(d, power);
+	}
+
+	// Accumulates the acceleration that particles [first, first + count) of the lane arrays exert on a position
+	// Same formula as the compute shader: gravity * d * m / (|d|^2 + soften)^power
+	// The count must be a multiple of the lane count
+	template<bool FastPower>
+	void accumulateLanes(const float *x, const float *y, const float *z, const float *w, uint32_t count, float px, float py, float pz, float result[3]) const
+	{
+		const float gravity = parameters.gravity;
+		const float soften = parameters.soften;
+		const float power = parameters.power;
+		float ax[NBODY_LANE_COUNT] = {}, ay[NBODY_LANE_COUNT] = {}, az[NBODY_LANE_COUNT] = {};
+		for (uint32_t j = 0; j < count; j += NBODY_LANE_COUNT)
+		{
+			for (uint32_t l = 0; l < NBODY_LANE_COUNT; l++)
+			{
+				const float dx = x[j + l] - px;
+				const float dy = y[j + l] - py;
+				const float dz = z[j + l] - pz;
+				const float d = dx * dx + dy * dy + dz * dz + soften;
+				const float f = gravity * w[j + l] / denominator<FastPower>(d, power);
+				ax[l] += dx * f;
+				ay[l] += dy * f;
+				az[l] += dz * f;
+			}
+		}
+		for (uint32_t l = 0; l < NBODY_LANE_COUNT; l++)
+		{
+			result[0] += ax[l];
+			result[1] += ay[l];
+			result[2] += az[l];
+		}
+	}
+
+	bool fastPower() const
+	{
+		return parameters.power == 0.75f;
+	}
+
+	// O(n^2) solver, every particle interacts with every other particle like in the compute shader
+	void calculateDirect()
+	{
+		const uint32_t count = static_cast<uint32_t>(particles.size());
+		const uint32_t paddedCount = static_cast<uint32_t>(pos.x.size());
+		const uint32_t taskCount = (count + NBODY_TASK_SIZE - 1) / NBODY_TASK_SIZE;
+		const bool fast = fastPower();
+		parallelFor(taskCount, [&](uint32_t task) {
+			const uint32_t end = std::min(count, (task + 1) * NBODY_TASK_SIZE);
+			for (uint32_t i = task * NBODY_TASK_SIZE; i < end; i++)
+			{
+				float a[3] = { 0.0f, 0.0f, 0.0f };
+				if (fast)
+				{
+					accumulateLanes<true>(pos.x.data(), pos.y.data(), pos.z.data(), pos.w.data(), paddedCount, pos.x[i], pos.y[i], pos.z[i], a);
+				}
+				else
+				{
+					accumulateLanes<false>(pos.x.data(), pos.y.data(), pos.z.data(), pos.w.data(), paddedCount, pos.x[i], pos.y[i], pos.z[i], a);
+				}
+				acc.x[i] = a[0];
+				acc.y[i] = a[1];
+				acc.z[i] = a[2];
+			}
+		});
+		interactions = (uint64_t)count * count;
+	}
+
+	// Recursively subdivides the particles of a node into octants
+	void buildNode(uint32_t nodeIndex, uint32_t depth)
+	{
+		Node node = nodes[nodeIndex];
+		if (node.count > leafSize && depth < NBODY_MAX_TREE_DEPTH)
+		{
+			// Sort the node's particles by octant (counting sort)
+			uint32_t octantCount[8] = {};
+			for (uint32_t i = node.first; i < node.first + node.count; i++)
+			{
+				const Particle &particle = particles[order[i]];
+				const uint8_t octant =
+					(particle.pos.x >= node.center[0] ? 1 : 0) |
+					(particle.pos.y >= node.center[1] ? 2 : 0) |
+					(particle.pos.z >= node.center[2] ? 4 : 0);
+				octants[i] = octant;
+				octantCount[octant]++;
+			}
+			uint32_t octantStart[8];
+			uint32_t offset = node.first;
+			for (uint32_t o = 0; o < 8; o++)
+			{
+				octantStart[o] = offset;
+				offset += octantCount[o];
+			}
+			uint32_t octantOffset[8];
+			std::copy(octantStart, octantStart + 8, octantOffset);
+			for (uint32_t i = node.first; i < node.first + node.count; i++)
+			{
+				orderScratch[octantOffset[octants[i]]++] = order[i];
+			}
+			std::copy(orderScratch.begin() + node.first, orderScratch.begin() + node.first + node.count, order.begin() + node.first);
+
+			// Add children for all non-empty octants
+			node.firstChild = static_cast<uint32_t>(nodes.size());
+			node.childCount = 0;
+			const float childSize = node.size * 0.5f;
+			for (uint32_t o = 0; o < 8; o++)
+			{
+				if (octantCount[o] == 0)
+				{
+					continue;
+				}
+				Node child = {};
+				child.center[0] = node.center[0] + ((o & 1) ? 0.5f : -0.5f) * childSize;
+				child.center[1] = node.center[1] + ((o & 2) ? 0.5f : -0.5f) * childSize;
+				child.center[2] = node.center[2] + ((o & 4) ? 0.5f : -0.5f) * childSize;
+				child.size = childSize;
+				child.first = octantStart[o];
+				child.count = octantCount[o];
+				nodes.push_back(child);
+				node.childCount++;
+			}
+			nodes[nodeIndex] = node;
+			for (uint32_t c = 0; c < node.childCount; c++)
+			{
+				buildNode(node.firstChild + c, depth + 1);
+			}
+		}
+
+		// Mass distribution of the node
+		// Particle masses may be negative, so the center is weighted by absolute mass to keep it inside the node
+		double mass = 0.0, weight = 0.0;
+		double com[3] = { 0.0, 0.0, 0.0 };
+		for (uint32_t i = node.first; i < node.first + node.count; i++)
+		{
+			const Particle &particle = particles[order[i]];
+			const double m = particle.pos.w;
+			mass += m;
+			weight += std::abs(m);
+			com[0] += std::abs(m) * particle.pos.x;
+			com[1] += std::abs(m) * particle.pos.y;
+			com[2] += std::abs(m) * particle.pos.z;
+		}
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			nodes[nodeIndex].com[c] = weight > 0.0 ? static_cast<float>(com[c] / weight) : node.center[c];
+		}
+		nodes[nodeIndex].mass = static_cast<float>(mass);
+	}
+
+	// Builds the octree and stores the particle positions in tree order, so the particles of a leaf are contiguous
+	void buildTree()
+	{
+		const uint32_t count = static_cast<uint32_t>(particles.size());
+		order.resize(count);
+		orderScratch.resize(count);
+		octants.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			order[i] = i;
+		}
+
+		glm::vec3 minExtent(std::numeric_limits<float>::max());
+		glm::vec3 maxExtent(-std::numeric_limits<float>::max());
+		for (auto &particle : particles)
+		{
+			minExtent = glm::min(minExtent, glm::vec3(particle.pos));
+			maxExtent = glm::max(maxExtent, glm::vec3(particle.pos));
+		}
+		const glm::vec3 extent = maxExtent - minExtent;
+
+		Node root = {};
+		root.center[0] = (minExtent.x + maxExtent.x) * 0.5f;
+		root.center[1] = (minExtent.y + maxExtent.y) * 0.5f;
+		root.center[2] = (minExtent.z + maxExtent.z) * 0.5f;
+		root.size = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1.0e-6f));
+		root.count = count;
+		nodes.clear();
+		nodes.push_back(root);
+		if (count > 0)
+		{
+			buildNode(0, 0);
+		}
+
+		// Tree ordered copy of the positions, so the particles of each leaf can be loaded into lanes directly
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const Particle &particle = particles[order[i]];
+			pos.x[i] = particle.pos.x;
+			pos.y[i] = particle.pos.y;
+			pos.z[i] = particle.pos.z;
+			pos.w[i] = particle.pos.w;
+		}
+	}
+
+	// Barnes-Hut solver: Distant nodes are approximated by their total mass at their center of mass,
+	// leaves close to a particle are evaluated directly with the same kernel as the direct solver
+	void calculateBarnesHut()
+	{
+		const uint32_t count = static_cast<uint32_t>(particles.size());
+		const uint32_t taskCount = (count + NBODY_TASK_SIZE - 1) / NBODY_TASK_SIZE;
+		const float theta2 = theta * theta;
+		const float gravity = parameters.gravity;
+		const float soften = parameters.soften;
+		const float power = parameters.power;
+		const bool fast = fastPower();
+		std::atomic<uint64_t> interactionCount(0);
+
+		// Particles are processed in tree order, so neighbouring particles of a task take similar paths through the tree
+		parallelFor(taskCount, [&](uint32_t task) {
+			// Children of all nodes on the current path, bounded by 7 siblings per level plus the current node
+			uint32_t stack[NBODY_MAX_TREE_DEPTH * 7 + 8];
+			uint64_t taskInteractions = 0;
+			const uint32_t end = std::min(count, (task + 1) * NBODY_TASK_SIZE);
+			for (uint32_t i = task * NBODY_TASK_SIZE; i < end; i++)
+			{
+				const float px = pos.x[i], py = pos.y[i], pz = pos.z[i];
+				float a[3] = { 0.0f, 0.0f, 0.0f };
+				uint32_t stackSize = 0;
+				stack[stackSize++] = 0;
+				while (stackSize > 0)
+				{
+					const Node &node = nodes[stack[--stackSize]];
+					const float dx = node.com[0] - px;
+					const float dy = node.com[1] - py;
+					const float dz = node.com[2] - pz;
+					const float distance2 = dx * dx + dy * dy + dz * dz;
+					if (node.childCount == 0)
+					{
+						// Leaf particles are stored contiguously in tree order, full lane groups first and the remainder one at a time
+						const uint32_t laneCount = node.count / NBODY_LANE_COUNT * NBODY_LANE_COUNT;
+						const uint32_t first = node.first;
+						if (fast)
+						{
+							accumulateLanes<true>(&pos.x[first], &pos.y[first], &pos.z[first], &pos.w[first], laneCount, px, py, pz, a);
+							accumulateScalar<true>(first + laneCount, first + node.count, px, py, pz, a);
+						}
+						else
+						{
+							accumulateLanes<false>(&pos.x[first], &pos.y[first], &pos.z[first], &pos.w[first], laneCount, px, py, pz, a);
+							accumulateScalar<false>(first + laneCount, first + node.count, px, py, pz, a);
+						}
+						taskInteractions += node.count;
+					}
+					else if (node.size * node.size < theta2 * distance2)
+					{
+						// Far enough away to be treated as a single body
+						const float d = distance2 + soften;
+						const float f = gravity * node.mass / (fast ? denominator<true>(d, power) : denominator<false>(d, power));
+						a[0] += dx * f;
+						a[1] += dy * f;
+						a[2] += dz * f;
+						taskInteractions++;
+					}
+					else
+					{
+						for (uint32_t c = 0; c < node.childCount; c++)
+						{
+							stack[stackSize++] = node.firstChild + c;
+						}
+					}
+				}
+				const uint32_t index = order[i];
+				acc.x[index] = a[0];
+				acc.y[index] = a[1];
+				acc.z[index] = a[2];
+			}
+			interactionCount.fetch_add(taskInteractions, std::memory_order_relaxed);
+		});
+		interactions = interactionCount;
+	}
+
+	// Same as accumulateLanes for particles [first, last) of the lane arrays, one particle at a time
+	template<bool FastPower>
+	void accumulateScalar(uint32_t first, uint32_t last, float px, float py, float pz, float result[3]) const
+	{
+		for (uint32_t j = first; j < last; j++)
+		{
+			const float dx = pos.x[j] - px;
+			const float dy = pos.y[j] - py;
+			const float dz = pos.z[j] - pz;
+			const float d = dx * dx + dy * dy + dz * dz + parameters.soften;
+			const float f = parameters.gravity * pos.w[j] / denominator<FastPower>(d, parameters.power);
+			result[0] += dx * f;
+			result[1] += dy * f;
+			result[2] += dz * f;
+		}
+	}
+
+	// Same as the second compute pass, including the update of the gradient position stored in the velocity's w component
+	void integrate(float deltaT)
+	{
+		const uint32_t count = static_cast<uint32_t>(particles.size());
+		for (uint32_t i = 0; i < count; i++)
+		{
+			Particle &particle = particles[i];
+			particle.vel.x += deltaT * acc.x[i];
+			particle.vel.y += deltaT * acc.y[i];
+			particle.vel.z += deltaT * acc.z[i];
+			particle.vel.w += 0.1f * deltaT;
+			if (particle.vel.w > 1.0f)
+			{
+				particle.vel.w -= 1.0f;
+			}
+			// The shader integrates all four components, so the mass (pos.w) drifts along with the gradient position
+			particle.pos += deltaT * particle.vel;
+		}
+	}
+};
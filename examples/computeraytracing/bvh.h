@@ -0,0 +1,497 @@
+/*
+* Vulkan Example - Bounding volume hierarchy for the compute shader ray tracer
+*
+* Builds a binned SAH BVH over a triangle soup on the CPU using the thread pool and flattens it into compact 32 byte nodes
+* that are uploaded as-is to a shader storage buffer. Also contains a CPU traversal of the same layout as a reference.
+*
+* Copyright (C) by Sascha Willems - www.saschawillems.de
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "threadpool.hpp"
+
+// Number of bins used to evaluate the surface area heuristic per axis
+#define BVH_BIN_COUNT 16
+// Nodes with more triangles than this are always split if possible
+#define BVH_MAX_LEAF_SIZE 8
+// Must not exceed the traversal stack size of the compute shader
+#define BVH_MAX_DEPTH 64
+
+// Flattened BVH node (32 bytes, matches the std430 layout used by the compute shader)
+// Inner nodes: leftFirst is the index of the left child, the right child directly follows it
+// Leaves: leftFirst is the index of the first triangle, triangleCount is non-zero
+struct BVHNode {
+	glm::vec3 aabbMin;
+	uint32_t leftFirst;
+	glm::vec3 aabbMax;
+	uint32_t triangleCount;
+};
+
+// Triangle in the layout used for intersection: First vertex and the two edges starting at it
+struct BVHTriangle {
+	glm::vec4 v0;
+	glm::vec4 e1;
+	glm::vec4 e2;
+};
+
+struct BVHHit {
+	float t;
+	uint32_t triangle;							// Index in BVH order
+	glm::vec2 barycentrics;
+};
+
+class BVH
+{
+public:
+	std::vector<BVHNode> nodes;
+	// Triangles in BVH order, leaves reference consecutive ranges of this
+	std::vector<BVHTriangle> triangles;
+	// Maps BVH order to the index of the triangle passed to build()
+	std::vector<uint32_t> triangleIndices;
+
+	// Build statistics
+	uint32_t depth = 0;
+	uint32_t leafCount = 0;
+	double buildTime = 0.0;
+
+	/**
+	* Build the BVH
+	*
+	* @param vertices Triangle soup, three consecutive vertices per triangle
+	* @param threadPool Pool used to build independent subtrees in parallel
+	*/
+	void build(const std::vector<glm::vec3> &vertices, vks::ThreadPool &threadPool)
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		const uint32_t triangleCount = static_cast<uint32_t>(vertices.size() / 3);
+		triangleIndices.resize(triangleCount);
+		centroids.resize(triangleCount);
+		bounds.resize(triangleCount);
+		for (uint32_t i = 0; i < triangleCount; i++)
+		{
+			const glm::vec3 &a = vertices[i * 3 + 0];
+			const glm::vec3 &b = vertices[i * 3 + 1];
+			const glm::vec3 &c = vertices[i * 3 + 2];
+			triangleIndices[i] = i;
+			bounds[i].min = glm::min(glm::min(a, b), c);
+			bounds[i].max = glm::max(glm::max(a, b), c);
+			centroids[i] = (a + b + c) / 3.0f;
+		}
+
+		nodes.clear();
+		depth = 0;
+		leafCount = 0;
+		if (triangleCount > 0)
+		{
+			// Split the top of the tree on this thread until there are enough independent subtrees to keep all threads busy
+			const uint32_t targetTaskCount = static_cast<uint32_t>(threadPool.threads.size()) * 8;
+			std::vector<BuildTask> tasks;
+			nodes.push_back(createNode(0, triangleCount));
+			tasks.push_back({ 0, 0, triangleCount, 0 });
+			while (!tasks.empty() && tasks.size() < targetTaskCount)
+			{
+				// Always split the largest remaining subtree
+				auto largest = std::max_element(tasks.begin(), tasks.end(), [](const BuildTask &a, const BuildTask &b) { return a.count < b.count; });
+				if (largest->count <= BVH_MAX_LEAF_SIZE * 4)
+				{
+					break;
+				}
+				const BuildTask task = *largest;
+				tasks.erase(largest);
+				uint32_t leftCount;
+				if (!split(nodes[task.nodeIndex], task.first, task.count, task.depth, leftCount))
+				{
+					leafCount++;
+					depth = std::max(depth, task.depth);
+					continue;
+				}
+				const uint32_t left = static_cast<uint32_t>(nodes.size());
+				nodes[task.nodeIndex].leftFirst = left;
+				nodes[task.nodeIndex].triangleCount = 0;
+				nodes.push_back(createNode(task.first, leftCount));
+				nodes.push_back(createNode(task.first + leftCount, task.count - leftCount));
+				tasks.push_back({ left, task.first, leftCount, task.depth + 1 });
+				tasks.push_back({ left + 1, task.first + leftCount, task.count - leftCount, task.depth + 1 });
+			}
+
+			// Build the remaining subtrees in parallel, each into its own node list
+			// Subtrees work on disjoint ranges of the triangle index list, so they can partition it without synchronization
+			std::vector<SubtreeResult> subtrees(tasks.size());
+			std::atomic<uint32_t> nextTask(0);
+			for (auto &thread : threadPool.threads)
+			{
+				thread->addJob([&] {
+					uint32_t t;
+					while ((t = nextTask.fetch_add(1, std::memory_order_relaxed)) < tasks.size())
+					{
+						SubtreeResult &result = subtrees[t];
+						result.nodes.push_back(nodes[tasks[t].nodeIndex]);
+						buildRecursive(result, 0, tasks[t].first, tasks[t].count, tasks[t].depth);
+					}
+				});
+			}
+			threadPool.wait();
+
+			// Append the subtrees to the final node list, the subtree roots replace the nodes they were built for
+			for (size_t t = 0; t < tasks.size(); t++)
+			{
+				SubtreeResult &result = subtrees[t];
+				const uint32_t offset = static_cast<uint32_t>(nodes.size()) - 1;
+				for (auto &node : result.nodes)
+				{
+					if (node.triangleCount == 0)
+					{
+						node.leftFirst += offset;
+					}
+				}
+				nodes[tasks[t].nodeIndex] = result.nodes[0];
+				nodes.insert(nodes.end(), result.nodes.begin() + 1, result.nodes.end());
+				leafCount += result.leafCount;
+				depth = std::max(depth, result.depth);
+			}
+		}
+
+		// Store the triangles in BVH order, so leaves reference them directly
+		triangles.resize(triangleCount);
+		for (uint32_t i = 0; i < triangleCount; i++)
+		{
+			const uint32_t index = triangleIndices[i];
+			const glm::vec3 &v0 = vertices[index * 3 + 0];
+			triangles[i].v0 = glm::vec4(v0, 0.0f);
+			triangles[i].e1 = glm::vec4(vertices[index * 3 + 1] - v0, 0.0f);
+			triangles[i].e2 = glm::vec4(vertices[index * 3 + 2] - v0, 0.0f);
+		}
+
+		centroids.clear();
+		centroids.shrink_to_fit();
+		bounds.clear();
+		bounds.shrink_to_fit();
+
+		buildTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+	}
+
+	/**
+	* Find the closest intersection along a ray using the same stack based traversal as the compute shader
+	*
+	* @param anyHit Stop at the first intersection found (for shadow rays)
+	* @note hit.t needs to be initialized with the maximum ray length
+	*/
+	bool intersect(const glm::vec3 &origin, const glm::vec3 &direction, BVHHit &hit, bool anyHit = false) const
+	{
+		if (nodes.empty())
+		{
+			return false;
+		}
+		const glm::vec3 invDirection = 1.0f / direction;
+		if (intersectAABB(nodes[0], origin, invDirection, hit.t) == std::numeric_limits<float>::max())
+		{
+			return false;
+		}
+		bool found = false;
+		uint32_t stack[BVH_MAX_DEPTH];
+		uint32_t stackSize = 0;
+		uint32_t nodeIndex = 0;
+		while (true)
+		{
+			const BVHNode &node = nodes[nodeIndex];
+			if (node.triangleCount > 0)
+			{
+				for (uint32_t i = node.leftFirst; i < node.leftFirst + node.triangleCount; i++)
+				{
+					if (intersectTriangle(triangles[i], origin, direction, hit.t, hit.barycentrics))
+					{
+						hit.triangle = i;
+						found = true;
+						if (anyHit)
+						{
+							return true;
+						}
+					}
+				}
+				if (stackSize == 0)
+				{
+					break;
+				}
+				nodeIndex = stack[--stackSize];
+				continue;
+			}
+			// Visit the closer child first and only keep the other one if it's hit at all
+			uint32_t near = node.leftFirst;
+			uint32_t far = node.leftFirst + 1;
+			float nearDistance = intersectAABB(nodes[near], origin, invDirection, hit.t);
+			float farDistance = intersectAABB(nodes[far], origin, invDirection, hit.t);
+			if (nearDistance > farDistance)
+			{
+				std::swap(near, far);
+				std::swap(nearDistance, farDistance);
+			}
+			if (nearDistance == std::numeric_limits<float>::max())
+			{
+				if (stackSize == 0)
+				{
+					break;
+				}
+				nodeIndex = stack[--stackSize];
+			}
+			else
+			{
+				nodeIndex = near;
+				if (farDistance != std::numeric_limits<float>::max())
+				{
+					stack[stackSize++] = far;
+				}
+			}
+		}
+		return found;
+	}
+
+	// Tests the ray against all triangles, used to check the BVH traversal
+	bool intersectBruteForce(const glm::vec3 &origin, const glm::vec3 &direction, BVHHit &hit) const
+	{
+		bool found = false;
+		for (uint32_t i = 0; i < static_cast<uint32_t>(triangles.size()); i++)
+		{
+			if (intersectTriangle(triangles[i], origin, direction, hit.t, hit.barycentrics))
+			{
+				hit.triangle = i;
+				found = true;
+			}
+		}
+		return found;
+	}
+
+private:
+	struct AABB {
+		glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+		void grow(const AABB &other)
+		{
+			min = glm::min(min, other.min);
+			max = glm::max(max, other.max);
+		}
+		void grow(const glm::vec3 &point)
+		{
+			min = glm::min(min, point);
+			max = glm::max(max, point);
+		}
+		float area() const
+		{
+			const glm::vec3 extent = max - min;
+			return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+		}
+	};
+
+	struct BuildTask {
+		uint32_t nodeIndex;
+		uint32_t first;
+		uint32_t count;
+		uint32_t depth;
+	};
+
+	struct SubtreeResult {
+		std::vector<BVHNode> nodes;
+		uint32_t leafCount = 0;
+		uint32_t depth = 0;
+	};
+
+	// Per triangle data only needed during the build
+	std::vector<glm::vec3> centroids;
+	std::vector<AABB> bounds;
+
+	// Creates a leaf node for a range of the triangle index list
+	BVHNode createNode(uint32_t first, uint32_t count) const
+	{
+		AABB aabb;
+		for (uint32_t i = first; i < first + count; i++)
+		{
+			aabb.grow(bounds[triangleIndices[i]]);
+		}
+		BVHNode node;
+		node.aabbMin = aabb.min;
+		node.aabbMax = aabb.max;
+		node.leftFirst = first;
+		node.triangleCount = count;
+		return node;
+	}
+
+	/**
+	* Finds the split with the lowest SAH cost using binned centroids and partitions the triangle range accordingly
+	*
+	* @return False if the node should stay a leaf
+	*/
+	bool split(const BVHNode &node, uint32_t first, uint32_t count, uint32_t nodeDepth, uint32_t &leftCount)
+	{
+		if (count <= 2 || nodeDepth >= BVH_MAX_DEPTH - 1)
+		{
+			return false;
+		}
+
+		AABB centroidBounds;
+		for (uint32_t i = first; i < first + count; i++)
+		{
+			centroidBounds.grow(centroids[triangleIndices[i]]);
+		}
+
+		float bestCost = std::numeric_limits<float>::max();
+		int32_t bestAxis = -1;
+		uint32_t bestBin = 0;
+		for (int32_t axis = 0; axis < 3; axis++)
+		{
+			const float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+			if (extent <= 0.0f)
+			{
+				continue;
+			}
+			const float scale = BVH_BIN_COUNT / extent;
+			AABB binBounds[BVH_BIN_COUNT];
+			uint32_t binCount[BVH_BIN_COUNT] = {};
+			for (uint32_t i = first; i < first + count; i++)
+			{
+				const uint32_t triangle = triangleIndices[i];
+				const uint32_t bin = binIndex(centroids[triangle][axis], centroidBounds.min[axis], scale);
+				binBounds[bin].grow(bounds[triangle]);
+				binCount[bin]++;
+			}
+			// Sweep from both sides to get the cost of all split planes between the bins
+			float leftArea[BVH_BIN_COUNT - 1], rightArea[BVH_BIN_COUNT - 1];
+			uint32_t leftCounts[BVH_BIN_COUNT - 1], rightCounts[BVH_BIN_COUNT - 1];
+			AABB leftBox, rightBox;
+			uint32_t leftSum = 0, rightSum = 0;
+			for (uint32_t i = 0; i < BVH_BIN_COUNT - 1; i++)
+			{
+				leftSum += binCount[i];
+				leftCounts[i] = leftSum;
+				leftBox.grow(binBounds[i]);
+				leftArea[i] = leftBox.area();
+				rightSum += binCount[BVH_BIN_COUNT - 1 - i];
+				rightCounts[BVH_BIN_COUNT - 2 - i] = rightSum;
+				rightBox.grow(binBounds[BVH_BIN_COUNT - 1 - i]);
+				rightArea[BVH_BIN_COUNT - 2 - i] = rightBox.area();
+			}
+			for (uint32_t i = 0; i < BVH_BIN_COUNT - 1; i++)
+			{
+				if (leftCounts[i] == 0 || rightCounts[i] == 0)
+				{
+					continue;
+				}
+				const float cost = leftCounts[i] * leftArea[i] + rightCounts[i] * rightArea[i];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = i;
+				}
+			}
+		}
+
+		if (bestAxis < 0)
+		{
+			// All centroids are in the same spot
+			return false;
+		}
+
+		// Traversal and intersection cost are both assumed to be 1, relative to the parent's surface area
+		AABB parent;
+		parent.min = node.aabbMin;
+		parent.max = node.aabbMax;
+		const float splitCost = 1.0f + bestCost / parent.area();
+		if (splitCost >= (float)count && count <= BVH_MAX_LEAF_SIZE)
+		{
+			return false;
+		}
+
+		const float scale = BVH_BIN_COUNT / (centroidBounds.max[bestAxis] - centroidBounds.min[bestAxis]);
+		const float minCentroid = centroidBounds.min[bestAxis];
+		// Same bin calculation as above, so the partition matches the evaluated split exactly
+		auto middle = std::partition(triangleIndices.begin() + first, triangleIndices.begin() + first + count, [&](uint32_t triangle) {
+			return binIndex(centroids[triangle][bestAxis], minCentroid, scale) <= bestBin;
+		});
+		leftCount = static_cast<uint32_t>(middle - (triangleIndices.begin() + first));
+		return leftCount > 0 && leftCount < count;
+	}
+
+	static uint32_t binIndex(float centroid, float minCentroid, float scale)
+	{
+		return std::min(static_cast<uint32_t>((centroid - minCentroid) * scale), (uint32_t)BVH_BIN_COUNT - 1);
+	}
+
+	// Recursively splits a node of a subtree, children are appended to the subtree's node list
+	void buildRecursive(SubtreeResult &result, uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t nodeDepth)
+	{
+		uint32_t leftCount;
+		if (!split(result.nodes[nodeIndex], first, count, nodeDepth, leftCount))
+		{
+			result.leafCount++;
+			result.depth = std::max(result.depth, nodeDepth);
+			return;
+		}
+		const uint32_t left = static_cast<uint32_t>(result.nodes.size());
+		result.nodes[nodeIndex].leftFirst = left;
+		result.nodes[nodeIndex].triangleCount = 0;
+		result.nodes.push_back(createNode(first, leftCount));
+		result.nodes.push_back(createNode(first + leftCount, count - leftCount));
+		buildRecursive(result, left, first, leftCount, nodeDepth + 1);
+		buildRecursive(result, left + 1, first + leftCount, count - leftCount, nodeDepth + 1);
+	}
+
+	// Returns the entry distance of the ray into the node's box or float max if it misses or the box is beyond maxT
+	static float intersectAABB(const BVHNode &node, const glm::vec3 &origin, const glm::vec3 &invDirection, float maxT)
+	{
+		const glm::vec3 t0 = (node.aabbMin - origin) * invDirection;
+		const glm::vec3 t1 = (node.aabbMax - origin) * invDirection;
+		const glm::vec3 tMin = glm::min(t0, t1);
+		const glm::vec3 tMax = glm::max(t0, t1);
+		const float tEnter = std::max(std::max(tMin.x, tMin.y), std::max(tMin.z, 0.0f));
+		const float tExit = std::min(std::min(tMax.x, tMax.y), std::min(tMax.z, maxT));
+		return (tEnter <= tExit) ? tEnter : std::numeric_limits<float>::max();
+	}
+
+	// Moeller-Trumbore ray triangle intersection, updates t if the triangle is hit closer than t
+	static bool intersectTriangle(const BVHTriangle &triangle, const glm::vec3 &origin, const glm::vec3 &direction, float &t, glm::vec2 &barycentrics)
+	{
+		const glm::vec3 e1(triangle.e1);
+		const glm::vec3 e2(triangle.e2);
+		const glm::vec3 p = glm::cross(direction, e2);
+		const float determinant = glm::dot(e1, p);
+		if (std::abs(determinant) < 1.0e-9f)
+		{
+			return false;
+		}
+		const float invDeterminant = 1.0f / determinant;
+		const glm::vec3 s = origin - glm::vec3(triangle.v0);
+		const float u = glm::dot(s, p) * invDeterminant;
+		if (u < 0.0f || u > 1.0f)
+		{
+			return false;
+		}
+		const glm::vec3 q = glm::cross(s, e1);
+		const float v = glm::dot(direction, q) * invDeterminant;
+		if (v < 0.0f || u + v > 1.0f)
+		{
+			return false;
+		}
+		const float hitT = glm::dot(e2, q) * invDeterminant;
+		if (hitT > 1.0e-4f && hitT < t)
+		{
+			t = hitT;
+			barycentrics = glm::vec2(u, v);
+			return true;
+		}
+		return false;
+	}
+};
@@ -1,12 +1,17 @@
 /*
 * Vulkan Example - Compute shader ray tracing
 *
+* Ray traces a triangle mesh loaded from a glTF file inside a room made of planes
+* The mesh is accelerated by a BVH that is built on the CPU and traversed in the compute shader
+*
 * Copyright (C) 2016 by Sascha Willems - www.saschawillems.de
 *
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
 #include "vulkanexamplebase.h"
+#include "VulkanglTFModel.h"
+#include "bvh.h"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
@@ -17,6 +22,13 @@
 #define TEX_DIM 2048
 #endif
 
+// Size of the largest dimension of the mesh after it has been scaled to fit the room
+#define MESH_SIZE 2.5f
+// Resolution of the primary ray grid used to check the BVH against brute force on the CPU
+#define REFERENCE_CHECK_DIM 64
+// Resolution of the primary ray grid used to measure the CPU ray throughput
+#define REFERENCE_BENCHMARK_DIM 512
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
@@ -34,8 +46,11 @@ public:
 	// Resources for the compute part of the example
 	struct {
 		struct {
-			vks::Buffer spheres;						// (Shader) storage buffer object with scene spheres
+			vks::Buffer triangles;					// (Shader) storage buffer object with the mesh triangles in BVH order
 			vks::Buffer planes;						// (Shader) storage buffer object with scene planes
+			vks::Buffer nodes;						// (Shader) storage buffer object with the flattened BVH nodes
+			vks::Buffer shading;					// (Shader) storage buffer object with per triangle normals and colors
+			vks::Buffer rayCounter;					// Host visible storage buffer the shader counts the traced rays in
 		} storageBuffers;
 		vks::Buffer uniformBuffer;					// Uniform buffer object containing scene data
 		VkQueue queue;								// Separate queue for compute commands (queue family may differ from the one used for graphics)
@@ -46,6 +61,7 @@ public:
 		VkDescriptorSet descriptorSet;				// Compute shader bindings
 		VkPipelineLayout pipelineLayout;			// Layout of the compute pipeline
 		VkPipeline pipeline;						// Compute raytracing pipeline
+		bool submitted = false;						// Set once the command buffer has been submitted, so there are results to read
 		struct UBOCompute {							// Compute shader uniform block object
 			glm::vec3 lightPos;
 			float aspectRatio;						// Aspect ratio of the viewport
@@ -59,16 +75,6 @@ public:
 		} ubo;
 	} compute;
 
-	// SSBO sphere declaration
-	struct Sphere {									// Shader uses std140 layout (so we only use vec4 instead of vec3)
-		glm::vec3 pos;
-		float radius;
-		glm::vec3 diffuse;
-		float specular;
-		uint32_t id;								// Id used to identify sphere for raytracing
-		glm::ivec3 _pad;
-	};
-
 	// SSBO plane declaration
 	struct Plane {
 		glm::vec3 normal;
@@ -79,6 +85,34 @@ public:
 		glm::ivec3 _pad;
 	};
 
+	// SSBO per triangle shading data declaration (std430)
+	struct TriangleShading {
+		glm::vec4 normals[3];
+		glm::vec4 color;							// Diffuse color in rgb, specular exponent in w
+	};
+
+	// Mesh that is ray traced, can be changed with the --mesh command line argument
+	std::string meshFile;
+	std::vector<TriangleShading> triangleShading;
+	vks::ThreadPool threadPool;
+	BVH bvh;
+
+	// The compute dispatch is timed with a single timestamp query slot, as only one dispatch is in flight at a time
+	vks::QueryManager queryManager;
+	uint32_t timestampQuery = 0;
+	bool timestampsSupported = false;
+
+	// BVH and ray throughput statistics
+	struct {
+		uint32_t referenceMismatches = 0;
+		double cpuRaysPerSecond = 0.0;
+		uint32_t rayCount = 0;
+		double gpuTime = 0.0;
+		double gpuRaysPerSecond = 0.0;
+		double totalGpuTime = 0.0;
+		double totalRays = 0.0;
+	} stats;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Compute shader ray tracing";
@@ -91,6 +125,17 @@ public:
 		camera.setTranslation(glm::vec3(0.0f, 0.0f, -4.0f));
 		camera.rotationSpeed = 0.0f;
 		camera.movementSpeed = 2.5f;
+
+		meshFile = getAssetPath() + "buster_drone/busterDrone.gltf";
+		for (size_t i = 0; i < args.size(); i++) {
+			if ((strcmp(args[i], "--mesh") == 0) && (i + 1 < args.size())) {
+				meshFile = args[i + 1];
+			}
+		}
+
+		// The mesh buffers are read back to build the BVH on the host
+		vkglTF::memoryPropertyFlags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		threadPool.setThreadCount(std::max(1u, std::thread::hardware_concurrency()));
 		
 #if defined(VK_USE_PLATFORM_MACOS_MVK)
 		// SRS - on macOS set environment variable to ensure MoltenVK disables Metal argument buffers for this example
@@ -100,6 +145,10 @@ public:
 
 	~VulkanExample()
 	{
+		if (stats.totalGpuTime > 0.0) {
+			std::cout << "Average GPU ray throughput: " << stats.totalRays / stats.totalGpuTime / 1.0e6 << " Mrays/s" << std::endl;
+		}
+
 		// Graphics
 		vkDestroyPipeline(device, graphics.pipeline, nullptr);
 		vkDestroyPipelineLayout(device, graphics.pipelineLayout, nullptr);
@@ -112,8 +161,14 @@ public:
 		vkDestroyFence(device, compute.fence, nullptr);
 		vkDestroyCommandPool(device, compute.commandPool, nullptr);
 		compute.uniformBuffer.destroy();
-		compute.storageBuffers.spheres.destroy();
+		compute.storageBuffers.triangles.destroy();
 		compute.storageBuffers.planes.destroy();
+		compute.storageBuffers.nodes.destroy();
+		compute.storageBuffers.shading.destroy();
+		compute.storageBuffers.rayCounter.destroy();
+		if (timestampsSupported) {
+			queryManager.destroy();
+		}
 
 		textureComputeTarget.destroy();
 	}
@@ -275,8 +330,6 @@ public:
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics.pipeline);
 			vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 
-			drawUI(drawCmdBuffers[i]);
-
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
 			if (vulkanDevice->queueFamilyIndices.graphics != vulkanDevice->queueFamilyIndices.compute)
@@ -330,11 +383,52 @@ public:
 				1, &imageMemoryBarrier);
 		}
 
+		// Clear the ray counter before the shader starts adding to it
+		vkCmdFillBuffer(compute.commandBuffer, compute.storageBuffers.rayCounter.buffer, 0, sizeof(uint32_t), 0);
+		VkBufferMemoryBarrier bufferMemoryBarrier = vks::initializers::bufferMemoryBarrier();
+		bufferMemoryBarrier.buffer = compute.storageBuffers.rayCounter.buffer;
+		bufferMemoryBarrier.size = sizeof(uint32_t);
+		bufferMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		bufferMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		bufferMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		vkCmdPipelineBarrier(
+			compute.commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_FLAGS_NONE,
+			0, nullptr,
+			1, &bufferMemoryBarrier,
+			0, nullptr);
+
+		if (timestampsSupported)
+		{
+			queryManager.cmdReset(compute.commandBuffer, 0);
+			queryManager.cmdWriteTimestamp(compute.commandBuffer, timestampQuery, 0, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+		}
+
 		vkCmdBindPipeline(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipeline);
 		vkCmdBindDescriptorSets(compute.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, 0);
 
 		vkCmdDispatch(compute.commandBuffer, textureComputeTarget.width / 16, textureComputeTarget.height / 16, 1);
 
+		if (timestampsSupported)
+		{
+			queryManager.cmdWriteTimestamp(compute.commandBuffer, timestampQuery, 0, 1, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		}
+
+		// Make the ray count visible to the host once the fence has been signaled
+		bufferMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		bufferMemoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(
+			compute.commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_HOST_BIT,
+			VK_FLAGS_NONE,
+			0, nullptr,
+			1, &bufferMemoryBarrier,
+			0, nullptr);
+
 		if (vulkanDevice->queueFamilyIndices.graphics != vulkanDevice->queueFamilyIndices.compute)
 		{
 			// Release barrier from compute queue
@@ -357,17 +451,6 @@ public:
 
 	uint32_t currentId = 0;	// Id used to identify objects by the ray tracing shader
 
-	Sphere newSphere(glm::vec3 pos, float radius, glm::vec3 diffuse, float specular)
-	{
-		Sphere sphere;
-		sphere.id = currentId++;
-		sphere.pos = pos;
-		sphere.radius = radius;
-		sphere.diffuse = diffuse;
-		sphere.specular = specular;
-		return sphere;
-	}
-
 	Plane newPlane(glm::vec3 normal, float distance, glm::vec3 diffuse, float specular)
 	{
 		Plane plane;
@@ -379,41 +462,172 @@ public:
 		return plane;
 	}
 
-	// Setup and fill the compute shader storage buffers containing primitives for the raytraced scene
-	void prepareStorageBuffers()
+	// Copies the contents of a device local buffer into host memory
+	void readBuffer(VkBuffer buffer, void *data, VkDeviceSize size)
 	{
-		// Spheres
-		std::vector<Sphere> spheres;
-		spheres.push_back(newSphere(glm::vec3(1.75f, -0.5f, 0.0f), 1.0f, glm::vec3(0.0f, 1.0f, 0.0f), 32.0f));
-		spheres.push_back(newSphere(glm::vec3(0.0f, 1.0f, -0.5f), 1.0f, glm::vec3(0.65f, 0.77f, 0.97f), 32.0f));
-		spheres.push_back(newSphere(glm::vec3(-1.75f, -0.75f, -0.5f), 1.25f, glm::vec3(0.9f, 0.76f, 0.46f), 32.0f));
-		VkDeviceSize storageBufferSize = spheres.size() * sizeof(Sphere);
-
-		// Stage
 		vks::Buffer stagingBuffer;
-
-		vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 			&stagingBuffer,
-			storageBufferSize,
-			spheres.data());
-
-		vulkanDevice->createBuffer(
-			// The SSBO will be used as a storage buffer for the compute pipeline and as a vertex buffer in the graphics pipeline
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			&compute.storageBuffers.spheres,
-			storageBufferSize);
-
-		// Copy to staging buffer
+			size));
 		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 		VkBufferCopy copyRegion = {};
-		copyRegion.size = storageBufferSize;
-		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, compute.storageBuffers.spheres.buffer, 1, &copyRegion);
+		copyRegion.size = size;
+		vkCmdCopyBuffer(copyCmd, buffer, stagingBuffer.buffer, 1, &copyRegion);
 		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+		VK_CHECK_RESULT(stagingBuffer.map());
+		memcpy(data, stagingBuffer.mapped, size);
+		stagingBuffer.destroy();
+	}
 
+	// Creates a device local storage buffer and fills it with data through a staging buffer
+	void uploadStorageBuffer(vks::Buffer *buffer, const void *data, VkDeviceSize size)
+	{
+		vks::Buffer stagingBuffer;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&stagingBuffer,
+			size,
+			const_cast<void*>(data)));
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			buffer,
+			size));
+		VkBufferCopy copyRegion = {};
+		copyRegion.size = size;
+		vulkanDevice->copyBuffer(&stagingBuffer, buffer, queue, &copyRegion);
 		stagingBuffer.destroy();
+	}
+
+	// Loads the mesh, scales it to fit into the room and builds the BVH for it
+	void loadAssets()
+	{
+		const uint32_t glTFLoadingFlags = vkglTF::FileLoadingFlags::PreTransformVertices | vkglTF::FileLoadingFlags::PreMultiplyVertexColors | vkglTF::FileLoadingFlags::FlipY | vkglTF::FileLoadingFlags::DontLoadImages;
+		// The model is only needed to get the vertex and index data, so it's released at the end of this function
+		vkglTF::Model model;
+		model.loadFromFile(meshFile, vulkanDevice, queue, glTFLoadingFlags);
+
+		// vkglTF does not keep a host copy of the geometry, so read it back from the device
+		std::vector<vkglTF::Vertex> vertices(model.vertices.count);
+		std::vector<uint32_t> indices(model.indices.count);
+		readBuffer(model.vertices.buffer, vertices.data(), vertices.size() * sizeof(vkglTF::Vertex));
+		readBuffer(model.indices.buffer, indices.data(), indices.size() * sizeof(uint32_t));
+		const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+		// Derive a specular exponent per triangle from the roughness of its material
+		std::vector<float> specular(triangleCount, 32.0f);
+		for (auto node : model.linearNodes) {
+			if (!node->mesh) {
+				continue;
+			}
+			for (auto primitive : node->mesh->primitives) {
+				const float roughness = std::max(primitive->material.roughnessFactor, 0.1f);
+				const float exponent = std::min(2.0f / (roughness * roughness * roughness * roughness) - 2.0f, 256.0f);
+				for (uint32_t i = primitive->firstIndex / 3; i < (primitive->firstIndex + primitive->indexCount) / 3; i++) {
+					specular[i] = std::max(exponent, 1.0f);
+				}
+			}
+		}
+
+		// Center the mesh at the origin and scale it to a fixed size
+		glm::vec3 boundsMin(std::numeric_limits<float>::max());
+		glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+		for (auto index : indices) {
+			boundsMin = glm::min(boundsMin, vertices[index].pos);
+			boundsMax = glm::max(boundsMax, vertices[index].pos);
+		}
+		const glm::vec3 extent = boundsMax - boundsMin;
+		const float scale = MESH_SIZE / std::max(std::max(extent.x, extent.y), std::max(extent.z, 1.0e-6f));
+		const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+
+		std::vector<glm::vec3> positions(indices.size());
+		for (size_t i = 0; i < indices.size(); i++) {
+			positions[i] = (vertices[indices[i]].pos - center) * scale;
+		}
+		bvh.build(positions, threadPool);
+
+		// Shading data is stored in BVH order, so the shader can use the index of the hit triangle directly
+		triangleShading.resize(triangleCount);
+		for (uint32_t i = 0; i < triangleCount; i++) {
+			const uint32_t triangle = bvh.triangleIndices[i];
+			glm::vec3 color(0.0f);
+			for (uint32_t j = 0; j < 3; j++) {
+				const vkglTF::Vertex &vertex = vertices[indices[triangle * 3 + j]];
+				triangleShading[i].normals[j] = glm::vec4(vertex.normal, 0.0f);
+				color += glm::vec3(vertex.color) / 3.0f;
+			}
+			triangleShading[i].color = glm::vec4(color, specular[triangle]);
+		}
+
+		std::cout << "Mesh: " << meshFile << ", " << triangleCount << " triangles" << std::endl;
+		std::cout << "BVH: " << bvh.nodes.size() << " nodes, " << bvh.leafCount << " leaves, depth " << bvh.depth << ", built in " << bvh.buildTime << " ms using " << threadPool.threads.size() << " threads" << std::endl;
+
+		checkReference();
+	}
+
+	// Returns the primary ray direction for a pixel, matching the compute shader
+	glm::vec3 primaryRay(uint32_t x, uint32_t y, uint32_t dim)
+	{
+		const glm::vec2 uv = glm::vec2((float)x, (float)y) / (float)dim;
+		return glm::normalize(glm::vec3((-1.0f + 2.0f * uv) * glm::vec2(compute.ubo.aspectRatio, 1.0f), -1.0f));
+	}
+
+	// Checks the BVH traversal against brute force on the CPU and measures the CPU ray throughput for primary rays
+	void checkReference()
+	{
+		const glm::vec3 origin = compute.ubo.camera.pos;
+
+		stats.referenceMismatches = 0;
+		for (uint32_t y = 0; y < REFERENCE_CHECK_DIM; y++) {
+			for (uint32_t x = 0; x < REFERENCE_CHECK_DIM; x++) {
+				const glm::vec3 direction = primaryRay(x, y, REFERENCE_CHECK_DIM);
+				BVHHit hit, reference;
+				hit.t = reference.t = std::numeric_limits<float>::max();
+				const bool found = bvh.intersect(origin, direction, hit);
+				const bool referenceFound = bvh.intersectBruteForce(origin, direction, reference);
+				if ((found != referenceFound) || (found && std::abs(hit.t - reference.t) > 1.0e-4f * reference.t)) {
+					stats.referenceMismatches++;
+				}
+			}
+		}
+
+		// Rows are distributed over all threads of the pool
+		std::atomic<uint32_t> nextRow(0);
+		std::atomic<uint32_t> hits(0);
+		auto tStart = std::chrono::high_resolution_clock::now();
+		for (auto &thread : threadPool.threads) {
+			thread->addJob([&] {
+				uint32_t y;
+				uint32_t threadHits = 0;
+				while ((y = nextRow.fetch_add(1, std::memory_order_relaxed)) < REFERENCE_BENCHMARK_DIM) {
+					for (uint32_t x = 0; x < REFERENCE_BENCHMARK_DIM; x++) {
+						BVHHit hit;
+						hit.t = std::numeric_limits<float>::max();
+						if (bvh.intersect(origin, primaryRay(x, y, REFERENCE_BENCHMARK_DIM), hit)) {
+							threadHits++;
+						}
+					}
+				}
+				hits += threadHits;
+			});
+		}
+		threadPool.wait();
+		const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - tStart).count();
+		stats.cpuRaysPerSecond = (double)(REFERENCE_BENCHMARK_DIM * REFERENCE_BENCHMARK_DIM) / seconds;
+
+		std::cout << "CPU reference: " << stats.referenceMismatches << " of " << REFERENCE_CHECK_DIM * REFERENCE_CHECK_DIM << " primary rays differ from brute force, " << stats.cpuRaysPerSecond / 1.0e6 << " Mrays/s (" << hits << " hits)" << std::endl;
+	}
+
+	// Setup and fill the compute shader storage buffers containing primitives for the raytraced scene
+	void prepareStorageBuffers()
+	{
+		// Mesh
+		uploadStorageBuffer(&compute.storageBuffers.triangles, bvh.triangles.data(), bvh.triangles.size() * sizeof(BVHTriangle));
+		uploadStorageBuffer(&compute.storageBuffers.nodes, bvh.nodes.data(), bvh.nodes.size() * sizeof(BVHNode));
+		uploadStorageBuffer(&compute.storageBuffers.shading, triangleShading.data(), triangleShading.size() * sizeof(TriangleShading));
 
 		// Planes
 		std::vector<Plane> planes;
@@ -424,32 +638,22 @@ public:
 		planes.push_back(newPlane(glm::vec3(0.0f, 0.0f, -1.0f), roomDim, glm::vec3(0.0f), 32.0f));
 		planes.push_back(newPlane(glm::vec3(-1.0f, 0.0f, 0.0f), roomDim, glm::vec3(1.0f, 0.0f, 0.0f), 32.0f));
 		planes.push_back(newPlane(glm::vec3(1.0f, 0.0f, 0.0f), roomDim, glm::vec3(0.0f, 1.0f, 0.0f), 32.0f));
-		storageBufferSize = planes.size() * sizeof(Plane);
+		uploadStorageBuffer(&compute.storageBuffers.planes, planes.data(), planes.size() * sizeof(Plane));
 
-		// Stage
-		vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		// Ray counter, read by the host after each dispatch
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&stagingBuffer,
-			storageBufferSize,
-			planes.data());
+			&compute.storageBuffers.rayCounter,
+			sizeof(uint32_t)));
+		VK_CHECK_RESULT(compute.storageBuffers.rayCounter.map());
 
-		vulkanDevice->createBuffer(
-			// The SSBO will be used as a storage buffer for the compute pipeline and as a vertex buffer in the graphics pipeline
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			&compute.storageBuffers.planes,
-			storageBufferSize);
-
-		// Copy to staging buffer
-		copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		copyRegion.size = storageBufferSize;
-		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, compute.storageBuffers.planes.buffer, 1, &copyRegion);
 		// Add an initial release barrier to the graphics queue,
 		// so that when the compute command buffer executes for the first time
 		// it doesn't complain about a lack of a corresponding "release" to its "acquire"
 		if (vulkanDevice->queueFamilyIndices.graphics != vulkanDevice->queueFamilyIndices.compute)
 		{
+			VkCommandBuffer barrierCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 			VkImageMemoryBarrier imageMemoryBarrier = {};
 			imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 			imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
@@ -461,17 +665,15 @@ public:
 			imageMemoryBarrier.srcQueueFamilyIndex = vulkanDevice->queueFamilyIndices.graphics;
 			imageMemoryBarrier.dstQueueFamilyIndex = vulkanDevice->queueFamilyIndices.compute;
 			vkCmdPipelineBarrier(
-				copyCmd,
+				barrierCmd,
 				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
 				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
 				VK_FLAGS_NONE,
 				0, nullptr,
 				0, nullptr,
 				1, &imageMemoryBarrier);
+			vulkanDevice->flushCommandBuffer(barrierCmd, queue, true);
 		}
-		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
-
-		stagingBuffer.destroy();
 	}
 
 	void setupDescriptorPool()
@@ -481,7 +683,7 @@ public:
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),			// Compute UBO
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4),	// Graphics image samplers
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1),				// Storage image for ray traced image output
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2),			// Storage buffer for the scene primitives
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5),			// Storage buffers for the scene primitives, the BVH and the ray counter
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
@@ -650,16 +852,31 @@ public:
 				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 				VK_SHADER_STAGE_COMPUTE_BIT,
 				1),
-			// Binding 1: Shader storage buffer for the spheres
+			// Binding 2: Shader storage buffer for the mesh triangles
 			vks::initializers::descriptorSetLayoutBinding(
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				VK_SHADER_STAGE_COMPUTE_BIT,
 				2),
-			// Binding 1: Shader storage buffer for the planes
+			// Binding 3: Shader storage buffer for the planes
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				3),
+			// Binding 4: Shader storage buffer for the BVH nodes
 			vks::initializers::descriptorSetLayoutBinding(
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				VK_SHADER_STAGE_COMPUTE_BIT,
-				3)
+				4),
+			// Binding 5: Shader storage buffer for the per triangle shading data
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				5),
+			// Binding 6: Shader storage buffer for the ray counter
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_COMPUTE_BIT,
+				6)
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout =
@@ -698,18 +915,36 @@ public:
 				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 				1,
 				&compute.uniformBuffer.descriptor),
-			// Binding 2: Shader storage buffer for the spheres
+			// Binding 2: Shader storage buffer for the mesh triangles
 			vks::initializers::writeDescriptorSet(
 				compute.descriptorSet,
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				2,
-				&compute.storageBuffers.spheres.descriptor),
-			// Binding 2: Shader storage buffer for the planes
+				&compute.storageBuffers.triangles.descriptor),
+			// Binding 3: Shader storage buffer for the planes
 			vks::initializers::writeDescriptorSet(
 				compute.descriptorSet,
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				3,
-				&compute.storageBuffers.planes.descriptor)
+				&compute.storageBuffers.planes.descriptor),
+			// Binding 4: Shader storage buffer for the BVH nodes
+			vks::initializers::writeDescriptorSet(
+				compute.descriptorSet,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				4,
+				&compute.storageBuffers.nodes.descriptor),
+			// Binding 5: Shader storage buffer for the per triangle shading data
+			vks::initializers::writeDescriptorSet(
+				compute.descriptorSet,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				5,
+				&compute.storageBuffers.shading.descriptor),
+			// Binding 6: Shader storage buffer for the ray counter
+			vks::initializers::writeDescriptorSet(
+				compute.descriptorSet,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				6,
+				&compute.storageBuffers.rayCounter.descriptor)
 		};
 
 		vkUpdateDescriptorSets(device, computeWriteDescriptorSets.size(), computeWriteDescriptorSets.data(), 0, NULL);
@@ -743,6 +978,20 @@ public:
 		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
 		VK_CHECK_RESULT(vkCreateFence(device, &fenceCreateInfo, nullptr, &compute.fence));
 
+		// Time the dispatch if the compute queue family supports timestamps
+		timestampsSupported = vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.compute].timestampValidBits > 0;
+		if (timestampsSupported) {
+			queryManager.prepare(vulkanDevice, 1);
+			timestampQuery = queryManager.addQuerySet(VK_QUERY_TYPE_TIMESTAMP, 2, [this](const std::vector<uint64_t> &results, uint32_t frameIndex, uint32_t latency) {
+				stats.gpuTime = (double)(results[1] - results[0]) * vulkanDevice->properties.limits.timestampPeriod / 1.0e9;
+				if (stats.gpuTime > 0.0) {
+					stats.gpuRaysPerSecond = (double)stats.rayCount / stats.gpuTime;
+					stats.totalGpuTime += stats.gpuTime;
+					stats.totalRays += (double)stats.rayCount;
+				}
+			});
+		}
+
 		// Build a single command buffer containing the compute dispatch commands
 		buildComputeCommandBuffer();
 	}
@@ -778,11 +1027,20 @@ public:
 		vkWaitForFences(device, 1, &compute.fence, VK_TRUE, UINT64_MAX);
 		vkResetFences(device, 1, &compute.fence);
 
+		// The previous dispatch has finished, so its ray count and timestamps can be read
+		if (compute.submitted) {
+			stats.rayCount = *static_cast<uint32_t*>(compute.storageBuffers.rayCounter.mapped);
+		}
+		if (timestampsSupported) {
+			queryManager.update(0);
+		}
+
 		VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
 		computeSubmitInfo.commandBufferCount = 1;
 		computeSubmitInfo.pCommandBuffers = &compute.commandBuffer;
 
 		VK_CHECK_RESULT(vkQueueSubmit(compute.queue, 1, &computeSubmitInfo, compute.fence));
+		compute.submitted = true;
 		
 		VulkanExampleBase::prepareFrame();
 
@@ -798,6 +1056,7 @@ public:
 	{
 		VulkanExampleBase::prepare();
 		prepareTextureTarget(&textureComputeTarget, TEX_DIM, TEX_DIM, VK_FORMAT_R8G8B8A8_UNORM);
+		loadAssets();
 		prepareStorageBuffers();
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
@@ -825,6 +1084,20 @@ public:
 		compute.ubo.aspectRatio = (float)width / (float)height;
 		updateUniformBuffers();
 	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("BVH")) {
+			overlay->text("Triangles: %d", (int32_t)bvh.triangles.size());
+			overlay->text("Nodes: %d, leaves: %d, depth: %d", (int32_t)bvh.nodes.size(), (int32_t)bvh.leafCount, (int32_t)bvh.depth);
+			overlay->text("Build time: %.2f ms", bvh.buildTime);
+			overlay->text("CPU: %.2f Mrays/s, %d mismatches", stats.cpuRaysPerSecond / 1.0e6, (int32_t)stats.referenceMismatches);
+			if (timestampsSupported) {
+				overlay->text("GPU: %.2f ms, %.2f Mrays/s", stats.gpuTime * 1000.0, stats.gpuRaysPerSecond / 1.0e6);
+			}
+			overlay->text("Rays per frame: %d", (int32_t)stats.rayCount);
+		}
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
@@ -142,8 +142,6 @@ public:
 				renderNode(node, drawCmdBuffers[i]);
 			}
 
-			drawUI(drawCmdBuffers[i]);
-
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
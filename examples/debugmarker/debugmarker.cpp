@@ -573,8 +573,6 @@ public:
 					DebugMarker::endRegion(drawCmdBuffers[i]);
 				}
 
-				drawUI(drawCmdBuffers[i]);
-
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
 
 				// End current debug marker region
@@ -18,11 +18,32 @@
 // Offscreen frame buffer properties
 #define FB_DIM TEX_DIM
 
+// Light clustering properties
+// Number of view space clusters (froxels) in x, y and (exponentially sliced) z
+#define CLUSTER_GRID_X 16
+#define CLUSTER_GRID_Y 9
+#define CLUSTER_GRID_Z 24
+#define CLUSTER_COUNT (CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z)
+// Must match the MAX_LIGHTS_PER_CLUSTER define in the light culling and composition shaders
+// Clusters overlapped by more lights only shade the first ones, these are shown in magenta by the "Lights per cluster" debug display
+#define MAX_LIGHTS_PER_CLUSTER 256
+// Must match the BATCH_SIZE define (workgroup size) in the light culling compute shader
+#define CLUSTER_WORKGROUP_SIZE 64
+#define MAX_LIGHT_COUNT 16384
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
 	int32_t debugDisplayTarget = 0;
 
+	// Selectable number of point lights, in benchmark mode all light counts are measured one after another
+	const std::vector<uint32_t> lightCounts = { 64, 256, 1024, 4096, 16384 };
+	const std::vector<std::string> lightCountNames = { "64", "256", "1024", "4096", "16384" };
+	int32_t lightCountIndex = 0;
+	// Names of the GPU profiler scopes, suffixed with the light count in benchmark mode so every light count is reported separately
+	std::string cullingScope = "Light culling";
+	std::string compositionScope = "Composition";
+
 	struct {
 		struct {
 			vks::Texture2D colorMap;
@@ -46,29 +67,65 @@ public:
 		glm::vec4 instancePos[3];
 	} uboOffscreenVS;
 
+	// Point light, the position's w component stores the range beyond which the light doesn't contribute (used for culling)
 	struct Light {
 		glm::vec4 position;
 		glm::vec3 color;
 		float radius;
 	};
 
+	// Parameters for animating the randomly generated lights
+	struct LightAnimation {
+		float orbitRadius;
+		float orbitSpeed;
+		float phase;
+		float height;
+	};
+	std::vector<LightAnimation> lightAnimations;
+
 	struct {
-		Light lights[6];
 		glm::vec4 viewPos;
 		int debugDisplayTarget = 0;
 	} uboComposition;
 
+	// Shared by the light culling compute shader and the composition fragment shader
+	struct {
+		glm::mat4 view;
+		glm::mat4 inverseProjection;
+		// xy = screen size, z = near plane, w = far plane
+		glm::vec4 screen;
+		// xyz = number of clusters, w = number of lights
+		glm::uvec4 grid;
+	} uboClusters;
+
 	struct {
 		vks::Buffer offscreen;
 		vks::Buffer composition;
+		vks::Buffer clusters;
 	} uniformBuffers;
 
+	struct {
+		// Host visible, the light positions are animated on the CPU
+		vks::Buffer lights;
+		// Number of lights per cluster and the per cluster light index lists, written by the light culling compute shader
+		vks::Buffer clusterLightCounts;
+		vks::Buffer clusterLightIndices;
+	} storageBuffers;
+
 	struct {
 		VkPipeline offscreen;
 		VkPipeline composition;
 	} pipelines;
 	VkPipelineLayout pipelineLayout;
 
+	// Resources for the light culling compute pass
+	struct {
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorSet descriptorSet;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipeline;
+	} lightCulling;
+
 	struct {
 		VkDescriptorSet model;
 		VkDescriptorSet floor;
@@ -144,6 +201,9 @@ public:
 
 		vkDestroyPipeline(device, pipelines.composition, nullptr);
 		vkDestroyPipeline(device, pipelines.offscreen, nullptr);
+		vkDestroyPipeline(device, lightCulling.pipeline, nullptr);
+		vkDestroyPipelineLayout(device, lightCulling.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, lightCulling.descriptorSetLayout, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 
@@ -152,6 +212,12 @@ public:
 		// Uniform buffers
 		uniformBuffers.offscreen.destroy();
 		uniformBuffers.composition.destroy();
+		uniformBuffers.clusters.destroy();
+
+		// Storage buffers
+		storageBuffers.lights.destroy();
+		storageBuffers.clusterLightCounts.destroy();
+		storageBuffers.clusterLightIndices.destroy();
 
 		vkDestroyRenderPass(device, offScreenFrameBuf.renderPass, nullptr);
 
@@ -467,6 +533,42 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			gpuProfiler.cmdBeginFrame(drawCmdBuffers[i], i);
+
+			/*
+				Light culling: Build the light lists of all clusters
+			*/
+
+			gpuProfiler.cmdBeginScope(drawCmdBuffers[i], i, cullingScope);
+
+			// The light lists must not be overwritten while the previous frame's composition may still read them
+			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, lightCulling.pipeline);
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, lightCulling.pipelineLayout, 0, 1, &lightCulling.descriptorSet, 0, nullptr);
+			vkCmdDispatch(drawCmdBuffers[i], (CLUSTER_COUNT + CLUSTER_WORKGROUP_SIZE - 1) / CLUSTER_WORKGROUP_SIZE, 1, 1);
+
+			// Make the light lists visible to the composition fragment shader
+			std::array<VkBufferMemoryBarrier, 2> bufferBarriers;
+			bufferBarriers[0] = vks::initializers::bufferMemoryBarrier();
+			bufferBarriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			bufferBarriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarriers[0].buffer = storageBuffers.clusterLightCounts.buffer;
+			bufferBarriers[0].size = VK_WHOLE_SIZE;
+			bufferBarriers[1] = bufferBarriers[0];
+			bufferBarriers[1].buffer = storageBuffers.clusterLightIndices.buffer;
+			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(), 0, nullptr);
+
+			gpuProfiler.cmdEndScope(drawCmdBuffers[i], i, cullingScope);
+
+			/*
+				Composition: Shade every pixel using the lights of its cluster
+			*/
+
+			gpuProfiler.cmdBeginScope(drawCmdBuffers[i], i, compositionScope);
+
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -482,10 +584,12 @@ public:
 			// Note: Also used for debug display if debugDisplayTarget > 0
 			vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 
-			drawUI(drawCmdBuffers[i]);
-
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
+			gpuProfiler.cmdEndScope(drawCmdBuffers[i], i, compositionScope);
+
+			gpuProfiler.cmdEndFrame(drawCmdBuffers[i], i);
+
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
@@ -493,11 +597,12 @@ public:
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 8),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 9)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 9),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6)
 		};
 
-		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 3);
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 4);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
 
@@ -515,6 +620,14 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),
 			// Binding 4 : Fragment shader uniform buffer
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),
+			// Binding 5 : Lights
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 5),
+			// Binding 6 : Number of lights per cluster
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 6),
+			// Binding 7 : Light index lists per cluster
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 7),
+			// Binding 8 : Cluster parameters
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 8),
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
@@ -523,6 +636,22 @@ public:
 		// Shared pipeline layout used by all pipelines
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+		// Light culling layout
+		setLayoutBindings = {
+			// Binding 0 : Cluster parameters
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1 : Lights
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2 : Number of lights per cluster
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3 : Light index lists per cluster
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+		};
+		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &lightCulling.descriptorSetLayout));
+		pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&lightCulling.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &lightCulling.pipelineLayout));
 	}
 
 	void setupDescriptorSet()
@@ -560,6 +689,29 @@ public:
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &texDescriptorAlbedo),
 			// Binding 4 : Fragment shader uniform buffer
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &uniformBuffers.composition.descriptor),
+			// Binding 5 : Lights
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, &storageBuffers.lights.descriptor),
+			// Binding 6 : Number of lights per cluster
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6, &storageBuffers.clusterLightCounts.descriptor),
+			// Binding 7 : Light index lists per cluster
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 7, &storageBuffers.clusterLightIndices.descriptor),
+			// Binding 8 : Cluster parameters
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 8, &uniformBuffers.clusters.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		// Light culling
+		VkDescriptorSetAllocateInfo computeAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &lightCulling.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &computeAllocInfo, &lightCulling.descriptorSet));
+		writeDescriptorSets = {
+			// Binding 0 : Cluster parameters
+			vks::initializers::writeDescriptorSet(lightCulling.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.clusters.descriptor),
+			// Binding 1 : Lights
+			vks::initializers::writeDescriptorSet(lightCulling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &storageBuffers.lights.descriptor),
+			// Binding 2 : Number of lights per cluster
+			vks::initializers::writeDescriptorSet(lightCulling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &storageBuffers.clusterLightCounts.descriptor),
+			// Binding 3 : Light index lists per cluster
+			vks::initializers::writeDescriptorSet(lightCulling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &storageBuffers.clusterLightIndices.descriptor),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
 
@@ -647,6 +799,50 @@ public:
 		colorBlendState.pAttachments = blendAttachmentStates.data();
 
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.offscreen));
+
+		// Light culling compute pipeline
+		VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(lightCulling.pipelineLayout, 0);
+		computePipelineCI.stage = loadShader(getShadersPath() + "deferred/clusterlights.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &lightCulling.pipeline));
+	}
+
+	// Create the light buffers and randomly place the lights beyond the six main lights of the scene
+	void prepareLights()
+	{
+		// Lights are updated by the CPU every frame, so the buffer is host visible
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&storageBuffers.lights,
+			MAX_LIGHT_COUNT * sizeof(Light)));
+		VK_CHECK_RESULT(storageBuffers.lights.map());
+
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&storageBuffers.clusterLightCounts,
+			CLUSTER_COUNT * sizeof(uint32_t)));
+
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&storageBuffers.clusterLightIndices,
+			CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER * sizeof(uint32_t)));
+
+		std::default_random_engine rndEngine(benchmark.active ? benchmark.seed : (unsigned)time(nullptr));
+		std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
+		Light* lights = (Light*)storageBuffers.lights.mapped;
+		lightAnimations.resize(MAX_LIGHT_COUNT);
+		for (uint32_t i = 6; i < MAX_LIGHT_COUNT; i++) {
+			lightAnimations[i].orbitRadius = sqrt(rndDist(rndEngine)) * 12.0f;
+			// Full revolutions per timer cycle, so the animation stays continuous when the timer wraps around
+			lightAnimations[i].orbitSpeed = (rndDist(rndEngine) < 0.5f) ? -1.0f : 1.0f;
+			lightAnimations[i].phase = rndDist(rndEngine) * 360.0f;
+			lightAnimations[i].height = -0.1f - rndDist(rndEngine) * 2.0f;
+			lights[i].color = glm::vec3(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine));
+			lights[i].radius = 0.5f + rndDist(rndEngine) * 1.5f;
+			lights[i].position.w = 0.75f + rndDist(rndEngine) * 1.25f;
+		}
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -666,9 +862,17 @@ public:
 		    &uniformBuffers.composition,
 			sizeof(uboComposition)));
 
+		// Light culling compute shader and composition fragment shader
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&uniformBuffers.clusters,
+			sizeof(uboClusters)));
+
 		// Map persistent
 		VK_CHECK_RESULT(uniformBuffers.offscreen.map());
 		VK_CHECK_RESULT(uniformBuffers.composition.map());
+		VK_CHECK_RESULT(uniformBuffers.clusters.map());
 
 		// Setup instanced model positions
 		uboOffscreenVS.instancePos[0] = glm::vec4(0.0f);
@@ -678,6 +882,7 @@ public:
 		// Update
 		updateUniformBufferOffscreen();
 		updateUniformBufferComposition();
+		updateUniformBufferClusters();
 	}
 
 	// Update matrices used for the offscreen rendering of the scene
@@ -692,45 +897,57 @@ public:
 	// Update lights and parameters passed to the composition shaders
 	void updateUniformBufferComposition()
 	{
+		Light* lights = (Light*)storageBuffers.lights.mapped;
+
+		// The six main lights, the w component of the position is the range used for culling
 		// White
-		uboComposition.lights[0].position = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
-		uboComposition.lights[0].color = glm::vec3(1.5f);
-		uboComposition.lights[0].radius = 15.0f * 0.25f;
+		lights[0].position = glm::vec4(0.0f, 0.0f, 1.0f, 10.0f);
+		lights[0].color = glm::vec3(1.5f);
+		lights[0].radius = 15.0f * 0.25f;
 		// Red
-		uboComposition.lights[1].position = glm::vec4(-2.0f, 0.0f, 0.0f, 0.0f);
-		uboComposition.lights[1].color = glm::vec3(1.0f, 0.0f, 0.0f);
-		uboComposition.lights[1].radius = 15.0f;
+		lights[1].position = glm::vec4(-2.0f, 0.0f, 0.0f, 20.0f);
+		lights[1].color = glm::vec3(1.0f, 0.0f, 0.0f);
+		lights[1].radius = 15.0f;
 		// Blue
-		uboComposition.lights[2].position = glm::vec4(2.0f, -1.0f, 0.0f, 0.0f);
-		uboComposition.lights[2].color = glm::vec3(0.0f, 0.0f, 2.5f);
-		uboComposition.lights[2].radius = 5.0f;
+		lights[2].position = glm::vec4(2.0f, -1.0f, 0.0f, 12.0f);
+		lights[2].color = glm::vec3(0.0f, 0.0f, 2.5f);
+		lights[2].radius = 5.0f;
 		// Yellow
-		uboComposition.lights[3].position = glm::vec4(0.0f, -0.9f, 0.5f, 0.0f);
-		uboComposition.lights[3].color = glm::vec3(1.0f, 1.0f, 0.0f);
-		uboComposition.lights[3].radius = 2.0f;
+		lights[3].position = glm::vec4(0.0f, -0.9f, 0.5f, 8.0f);
+		lights[3].color = glm::vec3(1.0f, 1.0f, 0.0f);
+		lights[3].radius = 2.0f;
 		// Green
-		uboComposition.lights[4].position = glm::vec4(0.0f, -0.5f, 0.0f, 0.0f);
-		uboComposition.lights[4].color = glm::vec3(0.0f, 1.0f, 0.2f);
-		uboComposition.lights[4].radius = 5.0f;
+		lights[4].position = glm::vec4(0.0f, -0.5f, 0.0f, 12.0f);
+		lights[4].color = glm::vec3(0.0f, 1.0f, 0.2f);
+		lights[4].radius = 5.0f;
 		// Yellow
-		uboComposition.lights[5].position = glm::vec4(0.0f, -1.0f, 0.0f, 0.0f);
-		uboComposition.lights[5].color = glm::vec3(1.0f, 0.7f, 0.3f);
-		uboComposition.lights[5].radius = 25.0f;
+		lights[5].position = glm::vec4(0.0f, -1.0f, 0.0f, 25.0f);
+		lights[5].color = glm::vec3(1.0f, 0.7f, 0.3f);
+		lights[5].radius = 25.0f;
+
+		lights[0].position.x = sin(glm::radians(360.0f * timer)) * 5.0f;
+		lights[0].position.z = cos(glm::radians(360.0f * timer)) * 5.0f;
 
-		uboComposition.lights[0].position.x = sin(glm::radians(360.0f * timer)) * 5.0f;
-		uboComposition.lights[0].position.z = cos(glm::radians(360.0f * timer)) * 5.0f;
+		lights[1].position.x = -4.0f + sin(glm::radians(360.0f * timer) + 45.0f) * 2.0f;
+		lights[1].position.z =  0.0f + cos(glm::radians(360.0f * timer) + 45.0f) * 2.0f;
 
-		uboComposition.lights[1].position.x = -4.0f + sin(glm::radians(360.0f * timer) + 45.0f) * 2.0f;
-		uboComposition.lights[1].position.z =  0.0f + cos(glm::radians(360.0f * timer) + 45.0f) * 2.0f;
+		lights[2].position.x = 4.0f + sin(glm::radians(360.0f * timer)) * 2.0f;
+		lights[2].position.z = 0.0f + cos(glm::radians(360.0f * timer)) * 2.0f;
 
-		uboComposition.lights[2].position.x = 4.0f + sin(glm::radians(360.0f * timer)) * 2.0f;
-		uboComposition.lights[2].position.z = 0.0f + cos(glm::radians(360.0f * timer)) * 2.0f;
+		lights[4].position.x = 0.0f + sin(glm::radians(360.0f * timer + 90.0f)) * 5.0f;
+		lights[4].position.z = 0.0f - cos(glm::radians(360.0f * timer + 45.0f)) * 5.0f;
 
-		uboComposition.lights[4].position.x = 0.0f + sin(glm::radians(360.0f * timer + 90.0f)) * 5.0f;
-		uboComposition.lights[4].position.z = 0.0f - cos(glm::radians(360.0f * timer + 45.0f)) * 5.0f;
+		lights[5].position.x = 0.0f + sin(glm::radians(-360.0f * timer + 135.0f)) * 10.0f;
+		lights[5].position.z = 0.0f - cos(glm::radians(-360.0f * timer - 45.0f)) * 10.0f;
 
-		uboComposition.lights[5].position.x = 0.0f + sin(glm::radians(-360.0f * timer + 135.0f)) * 10.0f;
-		uboComposition.lights[5].position.z = 0.0f - cos(glm::radians(-360.0f * timer - 45.0f)) * 10.0f;
+		// Additional (randomly generated) lights orbit around the center of the scene
+		for (uint32_t i = 6; i < lightCounts[lightCountIndex]; i++) {
+			const LightAnimation &animation = lightAnimations[i];
+			const float angle = glm::radians(animation.phase + animation.orbitSpeed * 360.0f * timer);
+			lights[i].position.x = sin(angle) * animation.orbitRadius;
+			lights[i].position.y = animation.height;
+			lights[i].position.z = cos(angle) * animation.orbitRadius;
+		}
 
 		// Current view position
 		uboComposition.viewPos = glm::vec4(camera.position, 0.0f) * glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);
@@ -740,6 +957,41 @@ public:
 		memcpy(uniformBuffers.composition.mapped, &uboComposition, sizeof(uboComposition));
 	}
 
+	// Update the parameters for assigning lights to clusters
+	void updateUniformBufferClusters()
+	{
+		uboClusters.view = camera.matrices.view;
+		uboClusters.inverseProjection = glm::inverse(camera.matrices.perspective);
+		uboClusters.screen = glm::vec4((float)width, (float)height, camera.getNearClip(), camera.getFarClip());
+		uboClusters.grid = glm::uvec4(CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z, lightCounts[lightCountIndex]);
+		memcpy(uniformBuffers.clusters.mapped, &uboClusters, sizeof(uboClusters));
+	}
+
+	// In benchmark mode the light count is stepped through all selectable counts over the course of the measurement
+	void updateBenchmarkLightCount()
+	{
+		if (!benchmark.isMeasuring()) {
+			return;
+		}
+		const double progress = (benchmark.outputFrames != -1) ? (double)benchmark.frameCount / (double)benchmark.outputFrames : benchmark.runtime / (benchmark.duration * 1000.0);
+		const int32_t index = std::min(static_cast<int32_t>(progress * lightCounts.size()), static_cast<int32_t>(lightCounts.size()) - 1);
+		if (index != lightCountIndex) {
+			setLightCount(index);
+		}
+	}
+
+	void setLightCount(int32_t index)
+	{
+		lightCountIndex = index;
+		if (benchmark.active) {
+			cullingScope = "Light culling (" + lightCountNames[index] + " lights)";
+			compositionScope = "Composition (" + lightCountNames[index] + " lights)";
+			buildCommandBuffers();
+		}
+		updateUniformBufferComposition();
+		updateUniformBufferClusters();
+	}
+
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
@@ -786,11 +1038,15 @@ public:
 		VulkanExampleBase::prepare();
 		loadAssets();
 		prepareOffscreenFramebuffer();
+		prepareLights();
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSet();
+		if (benchmark.active) {
+			setLightCount(0);
+		}
 		buildCommandBuffers();
 		buildDeferredCommandBuffer();
 		prepared = true;
@@ -800,6 +1056,10 @@ public:
 	{
 		if (!prepared)
 			return;
+		if (benchmark.active)
+		{
+			updateBenchmarkLightCount();
+		}
 		draw();
 		if (!paused)
 		{
@@ -808,21 +1068,28 @@ public:
 		if (camera.updated)
 		{
 			updateUniformBufferOffscreen();	
+			updateUniformBufferClusters();
 		}
 	}
 
 	virtual void viewChanged()
 	{
 		updateUniformBufferOffscreen();
+		updateUniformBufferClusters();
 	}
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
-			if (overlay->comboBox("Display", &debugDisplayTarget, {"Final composition", "Position", "Normals", "Albedo", "Specular" }))
+			if (overlay->comboBox("Display", &debugDisplayTarget, {"Final composition", "Position", "Normals", "Albedo", "Specular", "Lights per cluster" }))
 			{
 				updateUniformBufferComposition();
 			}
+			int32_t index = lightCountIndex;
+			if (overlay->comboBox("Lights", &index, lightCountNames))
+			{
+				setLightCount(index);
+			}
 		}
 	}
 };
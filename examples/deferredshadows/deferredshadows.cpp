@@ -30,6 +30,19 @@
 // Must match the LIGHT_COUNT define in the shadow and deferred shaders
 #define LIGHT_COUNT 3
 
+// Light clustering properties for the (unshadowed) point lights
+// Number of view space clusters (froxels) in x, y and (exponentially sliced) z
+#define CLUSTER_GRID_X 16
+#define CLUSTER_GRID_Y 9
+#define CLUSTER_GRID_Z 24
+#define CLUSTER_COUNT (CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z)
+// Must match the MAX_LIGHTS_PER_CLUSTER define in the light culling and composition shaders
+// Clusters overlapped by more lights only shade the first ones, these are shown in magenta by the "Lights per cluster" debug display
+#define MAX_LIGHTS_PER_CLUSTER 256
+// Must match the BATCH_SIZE define (workgroup size) in the light culling compute shader
+#define CLUSTER_WORKGROUP_SIZE 64
+#define MAX_POINT_LIGHT_COUNT 16384
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
@@ -46,6 +59,14 @@ public:
 	float depthBiasConstant = 1.25f;
 	float depthBiasSlope = 1.75f;
 
+	// Selectable number of point lights, in benchmark mode all light counts are measured one after another
+	const std::vector<uint32_t> lightCounts = { 64, 256, 1024, 4096, 16384 };
+	const std::vector<std::string> lightCountNames = { "64", "256", "1024", "4096", "16384" };
+	int32_t lightCountIndex = 0;
+	// Names of the GPU profiler scopes, suffixed with the light count in benchmark mode so every light count is reported separately
+	std::string cullingScope = "Light culling";
+	std::string compositionScope = "Composition";
+
 	struct {
 		struct {
 			vks::Texture2D colorMap;
@@ -92,12 +113,47 @@ public:
 		int32_t debugDisplayTarget = 0;
 	} uboComposition;
 
+	// Point light, the position's w component stores the range beyond which the light doesn't contribute (used for culling)
+	struct PointLight {
+		glm::vec4 position;
+		glm::vec3 color;
+		float radius;
+	};
+
+	// Parameters for animating the randomly generated point lights
+	struct PointLightAnimation {
+		float orbitRadius;
+		float orbitSpeed;
+		float phase;
+		float height;
+	};
+	std::vector<PointLightAnimation> pointLightAnimations;
+
+	// Shared by the light culling compute shader and the composition fragment shader
+	struct {
+		glm::mat4 view;
+		glm::mat4 inverseProjection;
+		// xy = screen size, z = near plane, w = far plane
+		glm::vec4 screen;
+		// xyz = number of clusters, w = number of lights
+		glm::uvec4 grid;
+	} uboClusters;
+
 	struct {
 		vks::Buffer offscreen;
 		vks::Buffer composition;
 		vks::Buffer shadowGeometryShader;
+		vks::Buffer clusters;
 	} uniformBuffers;
 
+	struct {
+		// Host visible, the point light positions are animated on the CPU
+		vks::Buffer pointLights;
+		// Number of lights per cluster and the per cluster light index lists, written by the light culling compute shader
+		vks::Buffer clusterLightCounts;
+		vks::Buffer clusterLightIndices;
+	} storageBuffers;
+
 	struct {
 		VkPipeline deferred;
 		VkPipeline offscreen;
@@ -105,6 +161,14 @@ public:
 	} pipelines;
 	VkPipelineLayout pipelineLayout;
 
+	// Resources for the light culling compute pass
+	struct {
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorSet descriptorSet;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline pipeline;
+	} lightCulling;
+
 	struct {
 		VkDescriptorSet model;
 		VkDescriptorSet background;
@@ -161,6 +225,9 @@ public:
 		vkDestroyPipeline(device, pipelines.deferred, nullptr);
 		vkDestroyPipeline(device, pipelines.offscreen, nullptr);
 		vkDestroyPipeline(device, pipelines.shadowpass, nullptr);
+		vkDestroyPipeline(device, lightCulling.pipeline, nullptr);
+		vkDestroyPipelineLayout(device, lightCulling.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, lightCulling.descriptorSetLayout, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 
@@ -170,6 +237,12 @@ public:
 		uniformBuffers.composition.destroy();
 		uniformBuffers.offscreen.destroy();
 		uniformBuffers.shadowGeometryShader.destroy();
+		uniformBuffers.clusters.destroy();
+
+		// Storage buffers
+		storageBuffers.pointLights.destroy();
+		storageBuffers.clusterLightCounts.destroy();
+		storageBuffers.clusterLightIndices.destroy();
 
 		// Textures
 		textures.model.colorMap.destroy();
@@ -416,6 +489,42 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			gpuProfiler.cmdBeginFrame(drawCmdBuffers[i], i);
+
+			/*
+				Light culling: Build the point light lists of all clusters
+			*/
+
+			gpuProfiler.cmdBeginScope(drawCmdBuffers[i], i, cullingScope);
+
+			// The light lists must not be overwritten while the previous frame's composition may still read them
+			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, lightCulling.pipeline);
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_COMPUTE, lightCulling.pipelineLayout, 0, 1, &lightCulling.descriptorSet, 0, nullptr);
+			vkCmdDispatch(drawCmdBuffers[i], (CLUSTER_COUNT + CLUSTER_WORKGROUP_SIZE - 1) / CLUSTER_WORKGROUP_SIZE, 1, 1);
+
+			// Make the light lists visible to the composition fragment shader
+			std::array<VkBufferMemoryBarrier, 2> bufferBarriers;
+			bufferBarriers[0] = vks::initializers::bufferMemoryBarrier();
+			bufferBarriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			bufferBarriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			bufferBarriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarriers[0].buffer = storageBuffers.clusterLightCounts.buffer;
+			bufferBarriers[0].size = VK_WHOLE_SIZE;
+			bufferBarriers[1] = bufferBarriers[0];
+			bufferBarriers[1].buffer = storageBuffers.clusterLightIndices.buffer;
+			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(), 0, nullptr);
+
+			gpuProfiler.cmdEndScope(drawCmdBuffers[i], i, cullingScope);
+
+			/*
+				Composition: Shade every pixel using the shadowed spot lights and the point lights of its cluster
+			*/
+
+			gpuProfiler.cmdBeginScope(drawCmdBuffers[i], i, compositionScope);
+
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -431,10 +540,12 @@ public:
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.deferred);
 			vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 
-			drawUI(drawCmdBuffers[i]);
-
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
+			gpuProfiler.cmdEndScope(drawCmdBuffers[i], i, compositionScope);
+
+			gpuProfiler.cmdEndFrame(drawCmdBuffers[i], i);
+
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
@@ -443,15 +554,16 @@ public:
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 12), //todo: separate set layouts
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 16)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 14), //todo: separate set layouts
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 16),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6)
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
 			vks::initializers::descriptorPoolCreateInfo(
 				static_cast<uint32_t>(poolSizes.size()),
 				poolSizes.data(),
-				4);
+				5);
 
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
@@ -472,6 +584,14 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 4),
 			// Binding 5: Shadow map
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 5),
+			// Binding 6: Point lights
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 6),
+			// Binding 7: Number of lights per cluster
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 7),
+			// Binding 8: Light index lists per cluster
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 8),
+			// Binding 9: Cluster parameters
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 9),
 		};
 		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &descriptorSetLayout));
@@ -479,6 +599,22 @@ public:
 		// Shared pipeline layout used by all pipelines
 		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+		// Light culling layout
+		setLayoutBindings = {
+			// Binding 0: Cluster parameters
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Point lights
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2: Number of lights per cluster
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3: Light index lists per cluster
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+		};
+		descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &lightCulling.descriptorSetLayout));
+		pPipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&lightCulling.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &lightCulling.pipelineLayout));
 	}
 
 	void setupDescriptorSet()
@@ -524,9 +660,32 @@ public:
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &uniformBuffers.composition.descriptor),
 			// Binding 5: Shadow map
 			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5, &texDescriptorShadowMap),
+			// Binding 6: Point lights
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6, &storageBuffers.pointLights.descriptor),
+			// Binding 7: Number of lights per cluster
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 7, &storageBuffers.clusterLightCounts.descriptor),
+			// Binding 8: Light index lists per cluster
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 8, &storageBuffers.clusterLightIndices.descriptor),
+			// Binding 9: Cluster parameters
+			vks::initializers::writeDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 9, &uniformBuffers.clusters.descriptor),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
+		// Light culling
+		VkDescriptorSetAllocateInfo computeAllocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &lightCulling.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &computeAllocInfo, &lightCulling.descriptorSet));
+		writeDescriptorSets = {
+			// Binding 0: Cluster parameters
+			vks::initializers::writeDescriptorSet(lightCulling.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.clusters.descriptor),
+			// Binding 1: Point lights
+			vks::initializers::writeDescriptorSet(lightCulling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &storageBuffers.pointLights.descriptor),
+			// Binding 2: Number of lights per cluster
+			vks::initializers::writeDescriptorSet(lightCulling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &storageBuffers.clusterLightCounts.descriptor),
+			// Binding 3: Light index lists per cluster
+			vks::initializers::writeDescriptorSet(lightCulling.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &storageBuffers.clusterLightIndices.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
 		// Offscreen (scene)
 
 		// Model
@@ -643,6 +802,50 @@ public:
 		// Reset blend attachment state
 		pipelineCI.renderPass = frameBuffers.shadow->renderPass;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.shadowpass));
+
+		// Light culling compute pipeline
+		VkComputePipelineCreateInfo computePipelineCI = vks::initializers::computePipelineCreateInfo(lightCulling.pipelineLayout, 0);
+		computePipelineCI.stage = loadShader(getShadersPath() + "deferredshadows/clusterlights.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCI, nullptr, &lightCulling.pipeline));
+	}
+
+	// Create the point light buffers and randomly place the point lights in the scene
+	void preparePointLights()
+	{
+		// Point lights are updated by the CPU every frame, so the buffer is host visible
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&storageBuffers.pointLights,
+			MAX_POINT_LIGHT_COUNT * sizeof(PointLight)));
+		VK_CHECK_RESULT(storageBuffers.pointLights.map());
+
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&storageBuffers.clusterLightCounts,
+			CLUSTER_COUNT * sizeof(uint32_t)));
+
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&storageBuffers.clusterLightIndices,
+			CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER * sizeof(uint32_t)));
+
+		std::default_random_engine rndEngine(benchmark.active ? benchmark.seed : (unsigned)time(nullptr));
+		std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
+		PointLight* pointLights = (PointLight*)storageBuffers.pointLights.mapped;
+		pointLightAnimations.resize(MAX_POINT_LIGHT_COUNT);
+		for (uint32_t i = 0; i < MAX_POINT_LIGHT_COUNT; i++) {
+			pointLightAnimations[i].orbitRadius = sqrt(rndDist(rndEngine)) * 12.0f;
+			// Full revolutions per timer cycle, so the animation stays continuous when the timer wraps around
+			pointLightAnimations[i].orbitSpeed = (rndDist(rndEngine) < 0.5f) ? -1.0f : 1.0f;
+			pointLightAnimations[i].phase = rndDist(rndEngine) * 360.0f;
+			pointLightAnimations[i].height = -0.1f - rndDist(rndEngine) * 2.0f;
+			pointLights[i].color = glm::vec3(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine));
+			pointLights[i].radius = 0.25f + rndDist(rndEngine) * 0.75f;
+			pointLights[i].position.w = 0.75f + rndDist(rndEngine) * 1.25f;
+		}
 	}
 
 	// Prepare and initialize uniform buffer containing shader uniforms
@@ -669,10 +872,18 @@ public:
 			&uniformBuffers.shadowGeometryShader,
 			sizeof(uboShadowGeometryShader)));
 
+		// Light culling compute shader and composition fragment shader
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&uniformBuffers.clusters,
+			sizeof(uboClusters)));
+
 		// Map persistent
 		VK_CHECK_RESULT(uniformBuffers.offscreen.map());
 		VK_CHECK_RESULT(uniformBuffers.composition.map());
 		VK_CHECK_RESULT(uniformBuffers.shadowGeometryShader.map());
+		VK_CHECK_RESULT(uniformBuffers.clusters.map());
 
 		// Init some values
 		uboOffscreenVS.instancePos[0] = glm::vec4(0.0f);
@@ -685,6 +896,7 @@ public:
 		// Update
 		updateUniformBufferOffscreen();
 		updateUniformBufferDeferredLights();
+		updateUniformBufferClusters();
 	}
 
 	void updateUniformBufferOffscreen()
@@ -738,12 +950,57 @@ public:
 		memcpy(uboShadowGeometryShader.instancePos, uboOffscreenVS.instancePos, sizeof(uboOffscreenVS.instancePos));
 		memcpy(uniformBuffers.shadowGeometryShader.mapped, &uboShadowGeometryShader, sizeof(uboShadowGeometryShader));
 
+		// Point lights orbit around the center of the scene
+		PointLight* pointLights = (PointLight*)storageBuffers.pointLights.mapped;
+		for (uint32_t i = 0; i < lightCounts[lightCountIndex]; i++) {
+			const PointLightAnimation &animation = pointLightAnimations[i];
+			const float angle = glm::radians(animation.phase + animation.orbitSpeed * 360.0f * timer);
+			pointLights[i].position.x = sin(angle) * animation.orbitRadius;
+			pointLights[i].position.y = animation.height;
+			pointLights[i].position.z = cos(angle) * animation.orbitRadius;
+		}
+
 		uboComposition.viewPos = glm::vec4(camera.position, 0.0f) * glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);;
 		uboComposition.debugDisplayTarget = debugDisplayTarget;
 
 		memcpy(uniformBuffers.composition.mapped, &uboComposition, sizeof(uboComposition));
 	}
 
+	// Update the parameters for assigning point lights to clusters
+	void updateUniformBufferClusters()
+	{
+		uboClusters.view = camera.matrices.view;
+		uboClusters.inverseProjection = glm::inverse(camera.matrices.perspective);
+		uboClusters.screen = glm::vec4((float)width, (float)height, camera.getNearClip(), camera.getFarClip());
+		uboClusters.grid = glm::uvec4(CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z, lightCounts[lightCountIndex]);
+		memcpy(uniformBuffers.clusters.mapped, &uboClusters, sizeof(uboClusters));
+	}
+
+	// In benchmark mode the point light count is stepped through all selectable counts over the course of the measurement
+	void updateBenchmarkLightCount()
+	{
+		if (!benchmark.isMeasuring()) {
+			return;
+		}
+		const double progress = (benchmark.outputFrames != -1) ? (double)benchmark.frameCount / (double)benchmark.outputFrames : benchmark.runtime / (benchmark.duration * 1000.0);
+		const int32_t index = std::min(static_cast<int32_t>(progress * lightCounts.size()), static_cast<int32_t>(lightCounts.size()) - 1);
+		if (index != lightCountIndex) {
+			setLightCount(index);
+		}
+	}
+
+	void setLightCount(int32_t index)
+	{
+		lightCountIndex = index;
+		if (benchmark.active) {
+			cullingScope = "Light culling (" + lightCountNames[index] + " lights)";
+			compositionScope = "Composition (" + lightCountNames[index] + " lights)";
+			buildCommandBuffers();
+		}
+		updateUniformBufferDeferredLights();
+		updateUniformBufferClusters();
+	}
+
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
@@ -783,11 +1040,15 @@ public:
 		deferredSetup();
 		shadowSetup();
 		initLights();
+		preparePointLights();
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSet();
+		if (benchmark.active) {
+			setLightCount(0);
+		}
 		buildCommandBuffers();
 		buildDeferredCommandBuffer();
 		prepared = true;
@@ -797,26 +1058,37 @@ public:
 	{
 		if (!prepared)
 			return;
+		if (benchmark.active)
+		{
+			updateBenchmarkLightCount();
+		}
 		draw();
 		updateUniformBufferDeferredLights();
 		if (camera.updated) 
 		{
 			updateUniformBufferOffscreen();
+			updateUniformBufferClusters();
 		}
 	}
 
 	virtual void viewChanged()
 	{
 		updateUniformBufferOffscreen();
+		updateUniformBufferClusters();
 	}
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
-			if (overlay->comboBox("Display", &debugDisplayTarget, { "Final composition", "Shadows", "Position", "Normals", "Albedo", "Specular" }))
+			if (overlay->comboBox("Display", &debugDisplayTarget, { "Final composition", "Shadows", "Position", "Normals", "Albedo", "Specular", "Lights per cluster" }))
 			{
 				updateUniformBufferDeferredLights();
 			}
+			int32_t index = lightCountIndex;
+			if (overlay->comboBox("Point lights", &index, lightCountNames))
+			{
+				setLightCount(index);
+			}
 			bool shadows = (uboComposition.useShadows == 1);
 			if (overlay->checkBox("Shadows", &shadows)) {
 				uboComposition.useShadows = shadows;
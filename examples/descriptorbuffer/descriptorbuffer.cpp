@@ -338,9 +338,6 @@ public:
 				model.draw(drawCmdBuffers[i]);
 			}
 
-			// @todo: UI still uses descriptors, mix and match problematic
-			//drawUI(drawCmdBuffers[i]);
-
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
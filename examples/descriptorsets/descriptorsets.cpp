@@ -108,8 +108,6 @@ public:
 				model.draw(drawCmdBuffers[i]);
 			}
 
-			drawUI(drawCmdBuffers[i]);
-
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
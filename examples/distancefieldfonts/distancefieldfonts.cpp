@@ -10,39 +10,382 @@
 
 #include "vulkanexamplebase.h"
 
-#define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
 
-// Vertex layout for this example
-struct Vertex {
-	float pos[3];
-	float uv[2];
+// Limits of the text batch, each string and glyph occupies a fixed slot in every region of the instance buffer
+#define MAX_STRING_COUNT 64
+#define MAX_GLYPH_COUNT 4096
+
+// Glyph sizes in the .fnt are given in pixels of the font texture, 36 pixels map to one unit in the scene
+#define FONT_UNITS_PER_PIXEL (1.0f / 36.0f)
+
+// One instance per glyph, the vertex shader expands it to a quad using the glyph table
+struct GlyphInstance {
+	// Pen position of the glyph in string space
+	float pos[2];
+	// Index into the glyph table
+	uint16_t glyph;
+	// Index of the string whose transform is applied
+	uint16_t string;
+	// RGBA8 color
+	uint32_t color;
 };
+static_assert(sizeof(GlyphInstance) == 16, "Glyph instances are expected to be 16 bytes");
 
-// AngelCode .fnt format structs and classes
-struct bmchar {
-	uint32_t x, y;
-	uint32_t width;
-	uint32_t height;
-	int32_t xoffset;
-	int32_t yoffset;
-	int32_t xadvance;
-	uint32_t page;
-};
+// AngelCode .fnt format
+class BitmapFont
+{
+public:
+	struct Char {
+		uint32_t x, y;
+		uint32_t width;
+		uint32_t height;
+		int32_t xoffset;
+		int32_t yoffset;
+		int32_t xadvance;
+		uint32_t page;
+	};
+
+	// Glyph table as read by the vertex shader (std140)
+	struct GlyphData {
+		// Font texture coordinates (s0, t0, s1, t1)
+		glm::vec4 uv;
+		// Offset from the pen position (xy) and size (zw) of the quad in scene units
+		glm::vec4 quad;
+	};
+
+	// Complete ASCII table, only chars present in the .fnt are filled with data
+	std::array<Char, 256> chars{};
+
+	// Single pass parser for AngelCode bitmap font format files working on the file contents in memory
+	// See http://www.angelcode.com/products/bmfont/doc/file_format.html for details
+	void parse(const char* data, size_t size)
+	{
+		const char* end = data + size;
+		const char* line = data;
+		while (line < end) {
+			const char* lineEnd = (const char*)memchr(line, '\n', end - line);
+			if (!lineEnd) {
+				lineEnd = end;
+			}
+			// Only "char" lines are of interest, "chars" (the char count) is skipped by requiring a separator after the tag
+			if ((lineEnd - line > 5) && (memcmp(line, "char", 4) == 0) && (line[4] == ' ' || line[4] == '\t')) {
+				parseChar(line + 5, lineEnd);
+			}
+			line = lineEnd + 1;
+		}
+	}
 
-// Quick and dirty : complete ASCII table
-// Only chars present in the .fnt are filled with data!
-std::array<bmchar, 255> fontChars;
+	bool loadFromFile(const std::string& fileName
+#if defined(__ANDROID__)
+		, AAssetManager* assetManager
+#endif
+	)
+	{
+		std::vector<char> data;
+#if defined(__ANDROID__)
+		// Font description file is stored inside the apk
+		// So we need to load it using the asset manager
+		AAsset* asset = AAssetManager_open(assetManager, fileName.c_str(), AASSET_MODE_STREAMING);
+		if (!asset) {
+			return false;
+		}
+		data.resize(AAsset_getLength(asset));
+		AAsset_read(asset, data.data(), data.size());
+		AAsset_close(asset);
+#else
+		std::ifstream file(fileName, std::ios::in | std::ios::binary | std::ios::ate);
+		if (!file.is_open()) {
+			return false;
+		}
+		data.resize((size_t)file.tellg());
+		file.seekg(0, std::ios::beg);
+		file.read(data.data(), data.size());
+#endif
+		// Terminated, so number parsing can't read past the end of the file contents
+		const size_t size = data.size();
+		data.push_back('\0');
+		parse(data.data(), size);
+		return true;
+	}
 
-int32_t nextValuePair(std::stringstream *stream)
+	// Converts the char metrics into the glyph table used by the shaders
+	std::vector<GlyphData> getGlyphTable(float textureSize) const
+	{
+		std::vector<GlyphData> glyphs(chars.size());
+		for (size_t i = 0; i < chars.size(); i++) {
+			const Char& c = chars[i];
+			glyphs[i].uv = glm::vec4((float)c.x, (float)c.y, (float)(c.x + c.width), (float)(c.y + c.height)) / textureSize;
+			glyphs[i].quad = glm::vec4((float)c.xoffset, (float)c.yoffset, (float)c.width, (float)c.height) * FONT_UNITS_PER_PIXEL;
+		}
+		return glyphs;
+	}
+
+private:
+	void parseChar(const char* pos, const char* end)
+	{
+		uint32_t id = UINT32_MAX;
+		Char c{};
+		while (pos < end) {
+			// Key=value pairs separated by whitespace
+			while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\r')) {
+				pos++;
+			}
+			const char* key = pos;
+			while (pos < end && *pos != '=' && *pos != ' ') {
+				pos++;
+			}
+			if (pos >= end || *pos != '=') {
+				continue;
+			}
+			const size_t keyLength = pos - key;
+			pos++;
+			char* valueEnd;
+			const int32_t value = (int32_t)strtol(pos, &valueEnd, 10);
+			pos = (valueEnd > pos) ? valueEnd : pos + 1;
+			// Skip the remainder of values that aren't numbers (e.g. letter="a")
+			while (pos < end && *pos != ' ' && *pos != '\t') {
+				pos++;
+			}
+			switch (keyLength) {
+			case 1:
+				if (key[0] == 'x') c.x = value;
+				if (key[0] == 'y') c.y = value;
+				break;
+			case 2:
+				if (memcmp(key, "id", 2) == 0) id = value;
+				break;
+			case 4:
+				if (memcmp(key, "page", 4) == 0) c.page = value;
+				break;
+			case 5:
+				if (memcmp(key, "width", 5) == 0) c.width = value;
+				break;
+			case 6:
+				if (memcmp(key, "height", 6) == 0) c.height = value;
+				break;
+			case 7:
+				if (memcmp(key, "xoffset", 7) == 0) c.xoffset = value;
+				if (memcmp(key, "yoffset", 7) == 0) c.yoffset = value;
+				break;
+			case 8:
+				if (memcmp(key, "xadvance", 8) == 0) c.xadvance = value;
+				break;
+			}
+		}
+		if (id < chars.size()) {
+			chars[id] = c;
+		}
+	}
+};
+
+// Batches any number of independent strings into a single instanced draw
+// The instance buffer is persistently mapped and split into one region per command buffer, each region contains
+// the indirect draw command, the string transforms (bound as a dynamic storage buffer) and the glyph instances
+// Command buffers therefore don't need to be rebuilt when strings are added or changed
+class TextBatch
 {
-	std::string pair;
-	*stream >> pair;
-	uint32_t spos = pair.find("=");
-	std::string value = pair.substr(spos + 1);
-	int32_t val = std::stoi(value);
-	return val;
-}
+public:
+	struct String {
+		std::string text;
+		glm::mat4 transform;
+		uint32_t color;
+		bool visible = true;
+		std::vector<GlyphInstance> glyphs;
+	};
+
+	vks::Buffer buffer;
+	VkDeviceSize regionSize = 0;
+	VkDeviceSize stringsOffset = 0;
+	VkDeviceSize instancesOffset = 0;
+
+	void prepare(vks::VulkanDevice* vulkanDevice, const BitmapFont* font, uint32_t regionCount)
+	{
+		this->vulkanDevice = vulkanDevice;
+		this->font = font;
+		createBuffer(regionCount);
+	}
+
+	// The number of command buffers may change when the swap chain is recreated, all regions are written again on their next update
+	void setRegionCount(uint32_t regionCount)
+	{
+		buffer.destroy();
+		createBuffer(regionCount);
+	}
+
+	uint32_t getRegionCount() const
+	{
+		return static_cast<uint32_t>(regionVersions.size());
+	}
+
+	void destroy()
+	{
+		buffer.destroy();
+	}
+
+	// Adds a string, transform maps string space (one unit per 36 font texture pixels, centered on the origin) to the scene
+	uint32_t add(const std::string& text, const glm::mat4& transform, const glm::vec4& color)
+	{
+		assert(strings.size() < MAX_STRING_COUNT);
+		String string;
+		string.transform = transform;
+		string.color = packColor(color);
+		strings.push_back(string);
+		const uint32_t index = static_cast<uint32_t>(strings.size() - 1);
+		setText(index, text);
+		return index;
+	}
+
+	// Only lays out the glyphs again if the text has changed
+	void setText(uint32_t index, const std::string& text)
+	{
+		String& string = strings[index];
+		if ((string.text == text) && !string.glyphs.empty()) {
+			return;
+		}
+		string.text = text;
+		layout(string, index);
+		version++;
+	}
+
+	// Changing transforms is cheap, as they're written for all strings on every update
+	void setTransform(uint32_t index, const glm::mat4& transform)
+	{
+		strings[index].transform = transform;
+	}
+
+	void setVisible(uint32_t index, bool visible)
+	{
+		if (strings[index].visible != visible) {
+			strings[index].visible = visible;
+			version++;
+		}
+	}
+
+	// Counted from the strings, as the flattened instances are only rebuilt on the next update
+	uint32_t getGlyphCount() const
+	{
+		size_t count = 0;
+		for (auto& string : strings) {
+			if (string.visible) {
+				count += string.glyphs.size();
+			}
+		}
+		return static_cast<uint32_t>(std::min(count, (size_t)MAX_GLYPH_COUNT));
+	}
+
+	uint32_t getStringCount() const
+	{
+		return static_cast<uint32_t>(strings.size());
+	}
+
+	// Writes the current state into the region of the given command buffer, glyphs are only copied if they changed since the region was last written
+	void update(uint32_t regionIndex)
+	{
+		uint8_t* region = (uint8_t*)buffer.mapped + regionIndex * regionSize;
+		glm::mat4* transforms = (glm::mat4*)(region + stringsOffset);
+		for (size_t i = 0; i < strings.size(); i++) {
+			transforms[i] = strings[i].transform;
+		}
+		if (regionVersions[regionIndex] == version) {
+			return;
+		}
+		if (instancesVersion != version) {
+			instances.clear();
+			for (auto& string : strings) {
+				if (string.visible) {
+					instances.insert(instances.end(), string.glyphs.begin(), string.glyphs.end());
+				}
+			}
+			if (instances.size() > MAX_GLYPH_COUNT) {
+				instances.resize(MAX_GLYPH_COUNT);
+			}
+			instancesVersion = version;
+		}
+		memcpy(region + instancesOffset, instances.data(), instances.size() * sizeof(GlyphInstance));
+		VkDrawIndirectCommand drawCommand{};
+		drawCommand.vertexCount = 4;
+		drawCommand.instanceCount = static_cast<uint32_t>(instances.size());
+		memcpy(region, &drawCommand, sizeof(drawCommand));
+		regionVersions[regionIndex] = version;
+	}
+
+	// Offset into the buffer to be passed as the dynamic offset of the string transform binding
+	uint32_t getStringsDynamicOffset(uint32_t regionIndex) const
+	{
+		return static_cast<uint32_t>(regionIndex * regionSize + stringsOffset);
+	}
+
+	void draw(VkCommandBuffer commandBuffer, uint32_t regionIndex)
+	{
+		VkDeviceSize offset = regionIndex * regionSize + instancesOffset;
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &buffer.buffer, &offset);
+		vkCmdDrawIndirect(commandBuffer, buffer.buffer, regionIndex * regionSize, 1, sizeof(VkDrawIndirectCommand));
+	}
+
+private:
+	vks::VulkanDevice* vulkanDevice = nullptr;
+	const BitmapFont* font = nullptr;
+	std::vector<String> strings;
+	// Flattened glyphs of all visible strings
+	std::vector<GlyphInstance> instances;
+	// Incremented whenever the glyphs of a string change
+	uint32_t version = 0;
+	uint32_t instancesVersion = UINT32_MAX;
+	std::vector<uint32_t> regionVersions;
+
+	static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	static uint32_t packColor(const glm::vec4& color)
+	{
+		const glm::vec4 c = glm::clamp(color, glm::vec4(0.0f), glm::vec4(1.0f)) * 255.0f + 0.5f;
+		return (uint32_t)c.r | ((uint32_t)c.g << 8) | ((uint32_t)c.b << 16) | ((uint32_t)c.a << 24);
+	}
+
+	void createBuffer(uint32_t regionCount)
+	{
+		const VkDeviceSize alignment = std::max({ VkDeviceSize(16), vulkanDevice->properties.limits.minStorageBufferOffsetAlignment, vulkanDevice->properties.limits.nonCoherentAtomSize });
+		stringsOffset = alignUp(sizeof(VkDrawIndirectCommand), alignment);
+		instancesOffset = stringsOffset + MAX_STRING_COUNT * sizeof(glm::mat4);
+		regionSize = alignUp(instancesOffset + MAX_GLYPH_COUNT * sizeof(GlyphInstance), alignment);
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&buffer,
+			regionSize * regionCount));
+		VK_CHECK_RESULT(buffer.map());
+		regionVersions.assign(regionCount, UINT32_MAX);
+	}
+
+	// Generates the glyph instances of a string centered on its origin
+	void layout(String& string, uint32_t index)
+	{
+		string.glyphs.clear();
+		float posx = 0.0f;
+		for (unsigned char c : string.text) {
+			const BitmapFont::Char& charInfo = font->chars[c];
+			// Glyphs without an area (e.g. spaces) only advance the pen position
+			if (charInfo.width > 0 && charInfo.height > 0) {
+				GlyphInstance glyph;
+				glyph.pos[0] = posx;
+				glyph.pos[1] = 0.0f;
+				glyph.glyph = c;
+				glyph.string = (uint16_t)index;
+				glyph.color = string.color;
+				string.glyphs.push_back(glyph);
+			}
+			posx += (float)charInfo.xadvance * FONT_UNITS_PER_PIXEL;
+		}
+		// Center
+		for (auto& glyph : string.glyphs) {
+			glyph.pos[0] -= posx / 2.0f;
+			glyph.pos[1] -= 0.5f;
+		}
+	}
+};
 
 class VulkanExample : public VulkanExampleBase
 {
@@ -54,19 +397,21 @@ public:
 		vks::Texture2D fontBitmap;
 	} textures;
 
-	struct {
-		VkPipelineVertexInputStateCreateInfo inputState;
-		std::vector<VkVertexInputBindingDescription> bindingDescriptions;
-		std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
-	} vertices;
+	BitmapFont font;
+	TextBatch textBatch;
 
-	vks::Buffer vertexBuffer;
-	vks::Buffer indexBuffer;
-	uint32_t indexCount;
+	// Strings placed on a ring around the title that are only animated through their transforms
+	bool animateRing = true;
+	float ringAngle = 0.0f;
+	const uint32_t ringCount = 24;
+	std::vector<uint32_t> ringStrings;
+	uint32_t statsString;
+	uint32_t displayedFPS = UINT32_MAX;
 
 	struct {
 		vks::Buffer vs;
 		vks::Buffer fs;
+		vks::Buffer glyphs;
 	} uniformBuffers;
 
 	struct UBOVS {
@@ -117,68 +462,23 @@ public:
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
-		vertexBuffer.destroy();
-		indexBuffer.destroy();
+		textBatch.destroy();
 
 		uniformBuffers.vs.destroy();
 		uniformBuffers.fs.destroy();
+		uniformBuffers.glyphs.destroy();
 	}
 
-	// Basic parser for AngelCode bitmap font format files
-	// See http://www.angelcode.com/products/bmfont/doc/file_format.html for details
-	void parsebmFont()
+	void loadFont()
 	{
-		std::string fileName = getAssetPath() + "font.fnt";
-
 #if defined(__ANDROID__)
-		// Font description file is stored inside the apk
-		// So we need to load it using the asset manager
-		AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, fileName.c_str(), AASSET_MODE_STREAMING);
-		assert(asset);
-		size_t size = AAsset_getLength(asset);
-
-		assert(size > 0);
-
-		void *fileData = malloc(size);
-		AAsset_read(asset, fileData, size);
-		AAsset_close(asset);
-
-		std::stringbuf sbuf((const char*)fileData);
-		std::istream istream(&sbuf);
+		const bool loaded = font.loadFromFile(getAssetPath() + "font.fnt", androidApp->activity->assetManager);
 #else
-		std::filebuf fileBuffer;
-		fileBuffer.open(fileName, std::ios::in);
-		std::istream istream(&fileBuffer);
+		const bool loaded = font.loadFromFile(getAssetPath() + "font.fnt");
 #endif
-
-		assert(istream.good());
-
-		while (!istream.eof())
-		{
-			std::string line;
-			std::stringstream lineStream;
-			std::getline(istream, line);
-			lineStream << line;
-
-			std::string info;
-			lineStream >> info;
-
-			if (info == "char")
-			{
-				// char id
-				uint32_t charid = nextValuePair(&lineStream);
-				// Char properties
-				fontChars[charid].x = nextValuePair(&lineStream);
-				fontChars[charid].y = nextValuePair(&lineStream);
-				fontChars[charid].width = nextValuePair(&lineStream);
-				fontChars[charid].height = nextValuePair(&lineStream);
-				fontChars[charid].xoffset = nextValuePair(&lineStream);
-				fontChars[charid].yoffset = nextValuePair(&lineStream);
-				fontChars[charid].xadvance = nextValuePair(&lineStream);
-				fontChars[charid].page = nextValuePair(&lineStream);
-			}
+		if (!loaded) {
+			vks::tools::exitFatal("Could not load font description file " + getAssetPath() + "font.fnt", -1);
 		}
-
 	}
 
 	void loadAssets()
@@ -204,6 +504,11 @@ public:
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
 
+		if (textBatch.getRegionCount() != drawCmdBuffers.size()) {
+			textBatch.setRegionCount(static_cast<uint32_t>(drawCmdBuffers.size()));
+			updateStringsDescriptors();
+		}
+
 		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
 			renderPassBeginInfo.framebuffer = frameBuffers[i];
@@ -218,149 +523,85 @@ public:
 			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
 
-			VkDeviceSize offsets[1] = { 0 };
+			// Each command buffer draws from its own region of the text batch, selected by the dynamic offset of the string transforms
+			const uint32_t dynamicOffset = textBatch.getStringsDynamicOffset(i);
 
 			// Signed distance field font
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.sdf, 0, NULL);
+			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.sdf, 1, &dynamicOffset);
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.sdf);
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], VERTEX_BUFFER_BIND_ID, 1, &vertexBuffer.buffer, offsets);
-			vkCmdBindIndexBuffer(drawCmdBuffers[i], indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-			vkCmdDrawIndexed(drawCmdBuffers[i], indexCount, 1, 0, 0, 0);
+			textBatch.draw(drawCmdBuffers[i], i);
 
 			// Linear filtered bitmap font
 			if (splitScreen)
 			{
 				viewport.y = (float)height / 2.0f;
 				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.bitmap, 0, NULL);
+				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.bitmap, 1, &dynamicOffset);
 				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.bitmap);
-				vkCmdDrawIndexed(drawCmdBuffers[i], indexCount, 1, 0, 0, 0);
+				textBatch.draw(drawCmdBuffers[i], i);
 			}
 
-			drawUI(drawCmdBuffers[i]);
-
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
 
-	// Creates a vertex buffer containing quads for the passed text
-	void generateText(std:: string text)
+	// Adds all strings to the batch, they share one instance buffer and are drawn with a single draw call
+	void prepareText()
 	{
-		std::vector<Vertex> vertices;
-		std::vector<uint32_t> indices;
-		uint32_t indexOffset = 0;
-
-		float w = textures.fontSDF.width;
-
-		float posx = 0.0f;
-		float posy = 0.0f;
-
-		for (uint32_t i = 0; i < text.size(); i++)
-		{
-			bmchar *charInfo = &fontChars[(int)text[i]];
-
-			if (charInfo->width == 0)
-				charInfo->width = 36;
-
-			float charw = ((float)(charInfo->width) / 36.0f);
-			float dimx = 1.0f * charw;
-			float charh = ((float)(charInfo->height) / 36.0f);
-			float dimy = 1.0f * charh;
-
-			float us = charInfo->x / w;
-			float ue = (charInfo->x + charInfo->width) / w;
-			float ts = charInfo->y / w;
-			float te = (charInfo->y + charInfo->height) / w;
-
-			float xo = charInfo->xoffset / 36.0f;
-			float yo = charInfo->yoffset / 36.0f;
-
-			posy = yo;
+		textBatch.prepare(vulkanDevice, &font, static_cast<uint32_t>(drawCmdBuffers.size()));
+		textBatch.add("Vulkan", glm::mat4(1.0f), glm::vec4(1.0f));
+		const std::vector<std::string> labels = { "Signed", "distance", "field", "font", "rendering" };
+		for (uint32_t i = 0; i < ringCount; i++) {
+			// Rainbow colors along the ring
+			const float hue = glm::radians(360.0f * i / ringCount);
+			const glm::vec4 color = glm::vec4(0.6f + 0.4f * glm::cos(glm::vec3(hue, hue - glm::radians(120.0f), hue + glm::radians(120.0f))), 1.0f);
+			ringStrings.push_back(textBatch.add(labels[i % labels.size()], getRingTransform(i), color));
+		}
+		statsString = textBatch.add("", glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 1.1f, 0.0f)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.15f)), glm::vec4(0.8f, 0.8f, 0.8f, 1.0f));
+	}
 
-			vertices.push_back({ { posx + dimx + xo,  posy + dimy, 0.0f }, { ue, te } });
-			vertices.push_back({ { posx + xo,         posy + dimy, 0.0f }, { us, te } });
-			vertices.push_back({ { posx + xo,         posy,        0.0f }, { us, ts } });
-			vertices.push_back({ { posx + dimx + xo,  posy,        0.0f }, { ue, ts } });
+	glm::mat4 getRingTransform(uint32_t index)
+	{
+		const float angle = ringAngle + glm::radians(360.0f * index / ringCount);
+		glm::mat4 transform = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 0.0f, 1.0f));
+		transform = glm::translate(transform, glm::vec3(1.6f, 0.0f, 0.0f));
+		return glm::scale(transform, glm::vec3(0.12f));
+	}
 
-			std::array<uint32_t, 6> letterIndices = { 0,1,2, 2,3,0 };
-			for (auto& index : letterIndices)
-			{
-				indices.push_back(indexOffset + index);
+	void updateText()
+	{
+		if (animateRing && !paused) {
+			ringAngle += frameTimer * glm::radians(15.0f);
+			for (uint32_t i = 0; i < ringStrings.size(); i++) {
+				textBatch.setTransform(ringStrings[i], getRingTransform(i));
 			}
-			indexOffset += 4;
-
-			float advance = ((float)(charInfo->xadvance) / 36.0f);
-			posx += advance;
 		}
-		indexCount = indices.size();
-
-		// Center
-		for (auto& v : vertices)
-		{
-			v.pos[0] -= posx / 2.0f;
-			v.pos[1] -= 0.5f;
+		// Glyphs of the stats string are only laid out again when the displayed value changes
+		if (lastFPS != displayedFPS) {
+			displayedFPS = lastFPS;
+			// The stats string is part of the glyph count, so it's laid out again if its new text changed the count
+			char text[64];
+			for (uint32_t i = 0; i < 2; i++) {
+				const uint32_t glyphCount = textBatch.getGlyphCount();
+				snprintf(text, sizeof(text), "%u strings, %u glyphs, %u fps", textBatch.getStringCount(), glyphCount, displayedFPS);
+				textBatch.setText(statsString, text);
+				if (textBatch.getGlyphCount() == glyphCount) {
+					break;
+				}
+			}
 		}
-
-		// Generate host accessible buffers for the text vertices and indices and upload the data
-
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&vertexBuffer,
-			vertices.size() * sizeof(Vertex),
-			vertices.data()));
-
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&indexBuffer,
-			indices.size() * sizeof(uint32_t),
-			indices.data()));
-	}
-
-	void setupVertexDescriptions()
-	{
-		// Binding description
-		vertices.bindingDescriptions.resize(1);
-		vertices.bindingDescriptions[0] =
-			vks::initializers::vertexInputBindingDescription(
-				VERTEX_BUFFER_BIND_ID,
-				sizeof(Vertex),
-				VK_VERTEX_INPUT_RATE_VERTEX);
-
-		// Attribute descriptions
-		// Describes memory layout and shader positions
-		vertices.attributeDescriptions.resize(2);
-		// Location 0 : Position
-		vertices.attributeDescriptions[0] =
-			vks::initializers::vertexInputAttributeDescription(
-				VERTEX_BUFFER_BIND_ID,
-				0,
-				VK_FORMAT_R32G32B32_SFLOAT,
-				0);
-		// Location 1 : Texture coordinates
-		vertices.attributeDescriptions[1] =
-			vks::initializers::vertexInputAttributeDescription(
-				VERTEX_BUFFER_BIND_ID,
-				1,
-				VK_FORMAT_R32G32_SFLOAT,
-				sizeof(float) * 3);
-
-		vertices.inputState = vks::initializers::pipelineVertexInputStateCreateInfo();
-		vertices.inputState.vertexBindingDescriptionCount = vertices.bindingDescriptions.size();
-		vertices.inputState.pVertexBindingDescriptions = vertices.bindingDescriptions.data();
-		vertices.inputState.vertexAttributeDescriptionCount = vertices.attributeDescriptions.size();
-		vertices.inputState.pVertexAttributeDescriptions = vertices.attributeDescriptions.data();
+		textBatch.update(currentBuffer);
 	}
 
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes =
 		{
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 6),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 2)
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
@@ -391,7 +632,17 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(
 				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 				VK_SHADER_STAGE_FRAGMENT_BIT,
-				2)
+				2),
+			// Binding 3 : Vertex shader glyph table
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				VK_SHADER_STAGE_VERTEX_BIT,
+				3),
+			// Binding 4 : Vertex shader string transforms (offset selects the region of the text batch)
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+				VK_SHADER_STAGE_VERTEX_BIT,
+				4)
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayout =
@@ -427,6 +678,9 @@ public:
 				textures.fontSDF.view,
 				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
+		// The range covers the transforms of a single region
+		VkDescriptorBufferInfo stringsDescriptor = { textBatch.buffer.buffer, 0, MAX_STRING_COUNT * sizeof(glm::mat4) };
+
 		std::vector<VkWriteDescriptorSet> writeDescriptorSets =
 		{
 			// Binding 0 : Vertex shader uniform buffer
@@ -446,7 +700,19 @@ public:
 				descriptorSets.sdf,
 				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 				2,
-				&uniformBuffers.fs.descriptor)
+				&uniformBuffers.fs.descriptor),
+			// Binding 3 : Vertex shader glyph table
+			vks::initializers::writeDescriptorSet(
+				descriptorSets.sdf,
+				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				3,
+				&uniformBuffers.glyphs.descriptor),
+			// Binding 4 : Vertex shader string transforms
+			vks::initializers::writeDescriptorSet(
+				descriptorSets.sdf,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+				4,
+				&stringsDescriptor)
 		};
 
 		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
@@ -471,17 +737,40 @@ public:
 				descriptorSets.bitmap,
 				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
 				1,
-				&texDescriptor)
+				&texDescriptor),
+			// Binding 3 : Vertex shader glyph table
+			vks::initializers::writeDescriptorSet(
+				descriptorSets.bitmap,
+				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				3,
+				&uniformBuffers.glyphs.descriptor),
+			// Binding 4 : Vertex shader string transforms
+			vks::initializers::writeDescriptorSet(
+				descriptorSets.bitmap,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+				4,
+				&stringsDescriptor)
 		};
 
 		vkUpdateDescriptorSets(device, writeDescriptorSets.size(), writeDescriptorSets.data(), 0, NULL);
 	}
 
+	// Points the string transform bindings to the (recreated) text batch buffer
+	void updateStringsDescriptors()
+	{
+		VkDescriptorBufferInfo stringsDescriptor = { textBatch.buffer.buffer, 0, MAX_STRING_COUNT * sizeof(glm::mat4) };
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSets.sdf, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 4, &stringsDescriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.bitmap, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 4, &stringsDescriptor)
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+	}
+
 	void preparePipelines()
 	{
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState =
 			vks::initializers::pipelineInputAssemblyStateCreateInfo(
-				VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+				VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
 				0,
 				VK_FALSE);
 
@@ -535,6 +824,22 @@ public:
 				dynamicStateEnables.size(),
 				0);
 
+		// One instance per glyph, the quad's corners are generated in the vertex shader
+		VkVertexInputBindingDescription vertexInputBinding = vks::initializers::vertexInputBindingDescription(0, sizeof(GlyphInstance), VK_VERTEX_INPUT_RATE_INSTANCE);
+		std::vector<VkVertexInputAttributeDescription> vertexInputAttributes = {
+			// Location 0 : Pen position
+			vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(GlyphInstance, pos)),
+			// Location 1 : Glyph and string index
+			vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R16G16_UINT, offsetof(GlyphInstance, glyph)),
+			// Location 2 : Color
+			vks::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R8G8B8A8_UNORM, offsetof(GlyphInstance, color)),
+		};
+		VkPipelineVertexInputStateCreateInfo vertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+		vertexInputState.vertexBindingDescriptionCount = 1;
+		vertexInputState.pVertexBindingDescriptions = &vertexInputBinding;
+		vertexInputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInputAttributes.size());
+		vertexInputState.pVertexAttributeDescriptions = vertexInputAttributes.data();
+
 		// Load shaders
 		std::array<VkPipelineShaderStageCreateInfo,2> shaderStages;
 
@@ -547,7 +852,7 @@ public:
 				renderPass,
 				0);
 
-		pipelineCreateInfo.pVertexInputState = &vertices.inputState;
+		pipelineCreateInfo.pVertexInputState = &vertexInputState;
 		pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
 		pipelineCreateInfo.pRasterizationState = &rasterizationState;
 		pipelineCreateInfo.pColorBlendState = &colorBlendState;
@@ -583,6 +888,15 @@ public:
 			&uniformBuffers.fs,
 			sizeof(uboFS)));
 
+		// Glyph table read by the vertex shader to expand the glyph instances
+		const std::vector<BitmapFont::GlyphData> glyphTable = font.getGlyphTable((float)textures.fontSDF.width);
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&uniformBuffers.glyphs,
+			glyphTable.size() * sizeof(BitmapFont::GlyphData),
+			(void*)glyphTable.data()));
+
 		// Map persistent
 		VK_CHECK_RESULT(uniformBuffers.vs.map());
 		VK_CHECK_RESULT(uniformBuffers.fs.map());
@@ -608,6 +922,8 @@ public:
 	{
 		VulkanExampleBase::prepareFrame();
 
+		updateText();
+
 		// Command buffer to be submitted to the queue
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
@@ -621,10 +937,9 @@ public:
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
-		parsebmFont();
+		loadFont();
 		loadAssets();
-		generateText("Vulkan");
-		setupVertexDescriptions();
+		prepareText();
 		prepareUniformBuffers();
 		setupDescriptorSetLayout();
 		preparePipelines();
@@ -660,6 +975,11 @@ public:
 				buildCommandBuffers();
 				updateUniformBuffers();
 			}
+			overlay->checkBox("Animate ring", &animateRing);
+		}
+		if (overlay->header("Statistics")) {
+			overlay->text("Strings: %u", textBatch.getStringCount());
+			overlay->text("Glyph instances: %u (%u bytes)", textBatch.getGlyphCount(), textBatch.getGlyphCount() * (uint32_t)sizeof(GlyphInstance));
 		}
 	}
 };
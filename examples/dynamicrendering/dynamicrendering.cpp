@@ -166,8 +166,6 @@ public:
 
 			model.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages, pipelineLayout);
 			
-			drawUI(drawCmdBuffers[i]);
-
 			// End dynamic rendering
 			vkCmdEndRenderingKHR(drawCmdBuffers[i]);
 
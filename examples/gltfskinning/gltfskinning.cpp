@@ -517,6 +517,7 @@ void VulkanglTFModel::updateJoints(VulkanglTFModel::Node *node)
 // POI: Update the current animation
 void VulkanglTFModel::updateAnimation(float deltaTime)
 {
+	VKS_PROFILE_FUNCTION();
 	if (activeAnimation > static_cast<uint32_t>(animations.size()) - 1)
 	{
 		std::cout << "No animation with index " << activeAnimation << std::endl;
@@ -705,7 +706,6 @@ void VulkanExample::buildCommandBuffers()
 		vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
 		vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wireframe : pipelines.solid);
 		glTFModel.draw(drawCmdBuffers[i], pipelineLayout);
-		drawUI(drawCmdBuffers[i]);
 		vkCmdEndRenderPass(drawCmdBuffers[i]);
 		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 	}
@@ -10,6 +10,8 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanBloom.hpp"
+#include "VulkanAutoExposure.hpp"
 
 #define ENABLE_VALIDATION false
 
@@ -17,6 +19,7 @@ class VulkanExample : public VulkanExampleBase
 {
 public:
 	bool bloom = true;
+	bool autoExposure = true;
 	bool displaySkybox = true;
 
 	struct {
@@ -42,32 +45,31 @@ public:
 
 	struct UBOParams {
 		float exposure = 1.0f;
+		// Use the exposure adapted on the GPU instead of the manual one
+		int32_t autoExposure = 1;
 	} uboParams;
 
 	struct {
 		VkPipeline skybox;
 		VkPipeline reflect;
 		VkPipeline composition;
-		VkPipeline bloom[2];
+		VkPipeline bloom;
 	} pipelines;
 
 	struct {
 		VkPipelineLayout models;
 		VkPipelineLayout composition;
-		VkPipelineLayout bloomFilter;
 	} pipelineLayouts;
 
 	struct {
 		VkDescriptorSet object;
 		VkDescriptorSet skybox;
 		VkDescriptorSet composition;
-		VkDescriptorSet bloomFilter;
 	} descriptorSets;
 
 	struct {
 		VkDescriptorSetLayout models;
 		VkDescriptorSetLayout composition;
-		VkDescriptorSetLayout bloomFilter;
 	} descriptorSetLayouts;
 
 	// Framebuffer for offscreen rendering
@@ -92,13 +94,11 @@ public:
 		VkSampler sampler;
 	} offscreen;
 
-	struct {
-		int32_t width, height;
-		VkFramebuffer frameBuffer;
-		FrameBufferAttachment color[1];
-		VkRenderPass renderPass;
-		VkSampler sampler;
-	} filterPass;
+	// Progressive downsample/upsample bloom applied to the bright parts of the scene
+	vks::Bloom bloomPass;
+
+	// Luminance histogram based exposure adaptation, the tone mapping passes read the exposure directly from its buffer
+	vks::AutoExposure autoExposurePass;
 
 	std::vector<std::string> objectNames;
 
@@ -116,31 +116,26 @@ public:
 		vkDestroyPipeline(device, pipelines.skybox, nullptr);
 		vkDestroyPipeline(device, pipelines.reflect, nullptr);
 		vkDestroyPipeline(device, pipelines.composition, nullptr);
-		vkDestroyPipeline(device, pipelines.bloom[0], nullptr);
-		vkDestroyPipeline(device, pipelines.bloom[1], nullptr);
+		vkDestroyPipeline(device, pipelines.bloom, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayouts.models, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.composition, nullptr);
-		vkDestroyPipelineLayout(device, pipelineLayouts.bloomFilter, nullptr);
 
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.models, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.composition, nullptr);
-		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.bloomFilter, nullptr);
 
 		vkDestroyRenderPass(device, offscreen.renderPass, nullptr);
-		vkDestroyRenderPass(device, filterPass.renderPass, nullptr);
 
 		vkDestroyFramebuffer(device, offscreen.frameBuffer, nullptr);
-		vkDestroyFramebuffer(device, filterPass.frameBuffer, nullptr);
 
 		vkDestroySampler(device, offscreen.sampler, nullptr);
-		vkDestroySampler(device, filterPass.sampler, nullptr);
 
 		offscreen.depth.destroy(device);
 		offscreen.color[0].destroy(device);
 		offscreen.color[1].destroy(device);
 
-		filterPass.color[0].destroy(device);
+		bloomPass.destroy();
+		autoExposurePass.destroy();
 
 		uniformBuffers.matrices.destroy();
 		uniformBuffers.params.destroy();
@@ -218,36 +213,17 @@ public:
 			}
 
 			/*
-				Second render pass: First bloom pass
+				Measure the luminance of the scene and adapt the exposure
 			*/
-			if (bloom) {
-				VkClearValue clearValues[2];
-				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
-				clearValues[1].depthStencil = { 1.0f, 0 };
-
-				// Bloom filter
-				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-				renderPassBeginInfo.framebuffer = filterPass.frameBuffer;
-				renderPassBeginInfo.renderPass = filterPass.renderPass;
-				renderPassBeginInfo.clearValueCount = 1;
-				renderPassBeginInfo.renderArea.extent.width = filterPass.width;
-				renderPassBeginInfo.renderArea.extent.height = filterPass.height;
-				renderPassBeginInfo.pClearValues = clearValues;
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				VkViewport viewport = vks::initializers::viewport((float)filterPass.width, (float)filterPass.height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-				VkRect2D scissor = vks::initializers::rect2D(filterPass.width, filterPass.height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.bloomFilter, 0, 1, &descriptorSets.bloomFilter, 0, NULL);
-
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.bloom[1]);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+			if (autoExposure) {
+				autoExposurePass.cmdDispatch(drawCmdBuffers[i]);
+			}
 
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
+			/*
+				Second pass: Downsample and upsample the bright parts of the scene through the bloom mip chain
+			*/
+			if (bloom) {
+				bloomPass.cmdDraw(drawCmdBuffers[i]);
 			}
 
 			/*
@@ -255,7 +231,7 @@ public:
 			*/
 
 			/*
-				Third render pass: Scene rendering with applied second bloom pass (when enabled)
+				Third render pass: Scene rendering with the bloom result added on top (when enabled)
 			*/
 			{
 				VkClearValue clearValues[2];
@@ -287,12 +263,10 @@ public:
 
 				// Bloom
 				if (bloom) {
-					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.bloom[0]);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.bloom);
 					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 				}
 
-				drawUI(drawCmdBuffers[i]);
-
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
 			}
 
@@ -476,95 +450,25 @@ public:
 			VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &offscreen.sampler));
 		}
 
-		// Bloom separable filter pass
+		// Bloom mip chain filtering the bright parts of the scene
 		{
-			filterPass.width = width;
-			filterPass.height = height;
-
-			// Color attachments
-
-			// Two floating point color buffers
-			createAttachment(VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &filterPass.color[0]);
-
-			// Set up separate renderpass with references to the color and depth attachments
-			std::array<VkAttachmentDescription, 1> attachmentDescs = {};
-
-			// Init attachment properties
-			attachmentDescs[0].samples = VK_SAMPLE_COUNT_1_BIT;
-			attachmentDescs[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-			attachmentDescs[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-			attachmentDescs[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-			attachmentDescs[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-			attachmentDescs[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			attachmentDescs[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			attachmentDescs[0].format = filterPass.color[0].format;
-
-			std::vector<VkAttachmentReference> colorReferences;
-			colorReferences.push_back({ 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
-
-			VkSubpassDescription subpass = {};
-			subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-			subpass.pColorAttachments = colorReferences.data();
-			subpass.colorAttachmentCount = 1;
-
-			// Use subpass dependencies for attachment layout transitions
-			std::array<VkSubpassDependency, 2> dependencies;
-
-			dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-			dependencies[0].dstSubpass = 0;
-			dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-			dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-			dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-			dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-			dependencies[1].srcSubpass = 0;
-			dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-			dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-			dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-			dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-			dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-			dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-			VkRenderPassCreateInfo renderPassInfo = {};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-			renderPassInfo.pAttachments = attachmentDescs.data();
-			renderPassInfo.attachmentCount = static_cast<uint32_t>(attachmentDescs.size());
-			renderPassInfo.subpassCount = 1;
-			renderPassInfo.pSubpasses = &subpass;
-			renderPassInfo.dependencyCount = 2;
-			renderPassInfo.pDependencies = dependencies.data();
-
-			VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &filterPass.renderPass));
-
-			std::array<VkImageView, 1> attachments;
-			attachments[0] = filterPass.color[0].view;
-
-			VkFramebufferCreateInfo fbufCreateInfo = {};
-			fbufCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-			fbufCreateInfo.pNext = NULL;
-			fbufCreateInfo.renderPass = filterPass.renderPass;
-			fbufCreateInfo.pAttachments = attachments.data();
-			fbufCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-			fbufCreateInfo.width = filterPass.width;
-			fbufCreateInfo.height = filterPass.height;
-			fbufCreateInfo.layers = 1;
-			VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &filterPass.frameBuffer));
+			bloomPass.shaders = {
+				loadShader(getShadersPath() + "base/bloom.vert.spv", VK_SHADER_STAGE_VERTEX_BIT),
+				loadShader(getShadersPath() + "base/bloomdownsample.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT),
+				loadShader(getShadersPath() + "base/bloomupsample.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT),
+			};
+			bloomPass.prepare(vulkanDevice, pipelineCache, offscreen.width, offscreen.height);
+			bloomPass.setInput(offscreen.color[1].view);
+		}
 
-			// Create sampler to sample from the color attachments
-			VkSamplerCreateInfo sampler = vks::initializers::samplerCreateInfo();
-			sampler.magFilter = VK_FILTER_NEAREST;
-			sampler.minFilter = VK_FILTER_NEAREST;
-			sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-			sampler.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-			sampler.addressModeV = sampler.addressModeU;
-			sampler.addressModeW = sampler.addressModeU;
-			sampler.mipLodBias = 0.0f;
-			sampler.maxAnisotropy = 1.0f;
-			sampler.minLod = 0.0f;
-			sampler.maxLod = 1.0f;
-			sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-			VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &filterPass.sampler));
+		// Auto exposure measuring the high dynamic range scene color
+		{
+			autoExposurePass.shaders = {
+				loadShader(getShadersPath() + "base/autoexposurehistogram.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT),
+				loadShader(getShadersPath() + "base/autoexposureaverage.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT),
+			};
+			autoExposurePass.prepare(vulkanDevice, queue, pipelineCache, offscreen.width, offscreen.height);
+			autoExposurePass.setInput(offscreen.color[0].view);
 		}
 	}
 
@@ -586,10 +490,11 @@ public:
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3)
 		};
-		uint32_t numDescriptorSets = 4;
+		uint32_t numDescriptorSets = 3;
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
 			vks::initializers::descriptorPoolCreateInfo(static_cast<uint32_t>(poolSizes.size()), poolSizes.data(), numDescriptorSets);
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
@@ -601,6 +506,7 @@ public:
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayoutInfo =
@@ -615,22 +521,12 @@ public:
 
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.models));
 
-		// Bloom filter
-		setLayoutBindings = {
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),
-			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
-		};
-
-		descriptorLayoutInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayoutInfo, nullptr, &descriptorSetLayouts.bloomFilter));
-
-		pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&descriptorSetLayouts.bloomFilter, 1);
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.bloomFilter));
-
 		// G-Buffer composition
 		setLayoutBindings = {
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),
 			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),
 		};
 
 		descriptorLayoutInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
@@ -655,6 +551,7 @@ public:
 			vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, &uniformBuffers.matrices.descriptor),
 			vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &textures.envmap.descriptor),
 			vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &uniformBuffers.params.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &autoExposurePass.descriptor),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
@@ -665,21 +562,7 @@ public:
 			vks::initializers::writeDescriptorSet(descriptorSets.skybox, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0,&uniformBuffers.matrices.descriptor),
 			vks::initializers::writeDescriptorSet(descriptorSets.skybox, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &textures.envmap.descriptor),
 			vks::initializers::writeDescriptorSet(descriptorSets.skybox, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &uniformBuffers.params.descriptor),
-		};
-		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
-
-		// Bloom filter
-		allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.bloomFilter, 1);
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.bloomFilter));
-
-		std::vector<VkDescriptorImageInfo> colorDescriptors = {
-			vks::initializers::descriptorImageInfo(offscreen.sampler, offscreen.color[0].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-			vks::initializers::descriptorImageInfo(offscreen.sampler, offscreen.color[1].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-		};
-
-		writeDescriptorSets = {
-			vks::initializers::writeDescriptorSet(descriptorSets.bloomFilter, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &colorDescriptors[0]),
-			vks::initializers::writeDescriptorSet(descriptorSets.bloomFilter, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &colorDescriptors[1]),
+			vks::initializers::writeDescriptorSet(descriptorSets.skybox, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &autoExposurePass.descriptor),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 
@@ -687,14 +570,16 @@ public:
 		allocInfo =	vks::initializers::descriptorSetAllocateInfo(descriptorPool, &descriptorSetLayouts.composition, 1);
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.composition));
 
-		colorDescriptors = {
+		std::vector<VkDescriptorImageInfo> colorDescriptors = {
 			vks::initializers::descriptorImageInfo(offscreen.sampler, offscreen.color[0].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-			vks::initializers::descriptorImageInfo(offscreen.sampler, filterPass.color[0].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			bloomPass.descriptor,
 		};
 
 		writeDescriptorSets = {
 			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &colorDescriptors[0]),
 			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &colorDescriptors[1]),
+			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2, &uniformBuffers.params.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &autoExposurePass.descriptor),
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 	}
@@ -759,17 +644,12 @@ public:
 		blendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
 		blendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_DST_ALPHA;
 
-		// Set constant parameters via specialization constants
-		specializationMapEntries[0] = vks::initializers::specializationMapEntry(0, 0, sizeof(uint32_t));
-		uint32_t dir = 1;
-		specializationInfo = vks::initializers::specializationInfo(1, specializationMapEntries.data(), sizeof(dir), &dir);
+		// The bloom chain returns the sum of all its levels, so it's normalized via a specialization constant
+		specializationMapEntries[0] = vks::initializers::specializationMapEntry(0, 0, sizeof(float));
+		float bloomStrength = 1.0f / (float)bloomPass.mipCount();
+		specializationInfo = vks::initializers::specializationInfo(1, specializationMapEntries.data(), sizeof(bloomStrength), &bloomStrength);
 		shaderStages[1].pSpecializationInfo = &specializationInfo;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.bloom[0]));
-
-		// Second blur pass (into separate framebuffer)
-		pipelineCI.renderPass = filterPass.renderPass;
-		dir = 0;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.bloom[1]));
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.bloom));
 
 		// Object rendering pipelines
 		// Use vertex input state from glTF model setup
@@ -867,6 +747,7 @@ public:
 	{
 		if (!prepared)
 			return;
+		autoExposurePass.update(frameTimer);
 		draw();
 		if (camera.updated)
 			updateUniformBuffers();
@@ -884,7 +765,15 @@ public:
 				updateUniformBuffers();
 				buildCommandBuffers();
 			}
-			if (overlay->inputFloat("Exposure", &uboParams.exposure, 0.025f, 3)) {
+			if (overlay->checkBox("Auto exposure", &autoExposure)) {
+				uboParams.autoExposure = autoExposure ? 1 : 0;
+				updateParams();
+				buildCommandBuffers();
+			}
+			if (autoExposure) {
+				overlay->sliderFloat("Key value", &autoExposurePass.keyValue, 0.05f, 2.0f);
+				overlay->sliderFloat("Adaptation rate", &autoExposurePass.adaptationRate, 0.1f, 10.0f);
+			} else if (overlay->inputFloat("Exposure", &uboParams.exposure, 0.025f, 3)) {
 				updateParams();
 			}
 			if (overlay->checkBox("Bloom", &bloom)) {
@@ -15,12 +15,18 @@
 * The example shows how to setup and fill such a buffer on the CPU side, stages it to the device and
 * shows how to render it using only one draw command.
 *
+* The instances are frustum culled on the GPU: A compute pass writes the visible instances of each object
+* into a compacted instance buffer, and a second pass compacts the draw commands of all objects with at least
+* one visible instance. The number of draws is read from a buffer with vkCmdDrawIndexedIndirectCount if
+* VK_KHR_draw_indirect_count is supported, otherwise all commands are drawn and culled ones have no instances.
+*
 * See readme.md for details
 *
 */
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "frustum.hpp"
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define INSTANCE_BUFFER_BIND_ID 1
@@ -37,6 +43,9 @@
 #define PLANT_RADIUS 25.0f
 #endif
 
+// Workgroup size of the culling compute shader
+#define CULL_WORKGROUP_SIZE 64
+
 class VulkanExample : public VulkanExampleBase
 {
 public:
@@ -59,21 +68,63 @@ public:
 		uint32_t texIndex;
 	};
 
-	// Contains the instanced data
+	// Contains the instanced data of all objects
 	vks::Buffer instanceBuffer;
-	// Contains the indirect drawing commands
+	// Contains the visible instances of all objects, compacted per object by the culling pass
+	vks::Buffer visibleInstanceBuffer;
+	// Contains one draw command per object, written once on the CPU
+	vks::Buffer objectCommandsBuffer;
+	// Contains the compacted indirect drawing commands, written by the compaction pass
 	vks::Buffer indirectCommandsBuffer;
+	// Contains the number of compacted draws, the total number of visible instances and the number of visible instances per object
+	vks::Buffer drawCountBuffer;
+	// Host visible copy of the draw and visible instance counts of the last frame
+	vks::Buffer statisticsBuffer;
 	uint32_t indirectDrawCount;
 
+	// Number of instances per object, can be changed with the --instances command line argument (total instance count)
+	uint32_t instancesPerObject = OBJECT_INSTANCE_COUNT;
+	uint32_t requestedInstanceCount = 0;
+
 	struct {
 		glm::mat4 projection;
 		glm::mat4 view;
 	} uboVS;
 
+	struct {
+		glm::vec4 frustumPlanes[6];
+		float meshRadius;						// Radius of the bounding sphere of an unscaled plant
+		uint32_t instanceCount;
+		uint32_t instancesPerObject;
+		uint32_t cullingEnabled = 1;
+	} uboCull;
+
 	struct {
 		vks::Buffer scene;
+		vks::Buffer cull;
 	} uniformData;
 
+	// Resources for the GPU culling and draw compaction passes
+	struct {
+		VkDescriptorSetLayout descriptorSetLayout;
+		VkDescriptorSet descriptorSet;
+		VkPipelineLayout pipelineLayout;
+		VkPipeline cull;
+		VkPipeline compact;
+	} compute;
+
+	bool fixedFrustum = false;
+	vks::Frustum frustum;
+
+	// vkCmdDrawIndexedIndirectCount reads the number of draws from a buffer, otherwise all draws are issued and culled ones have no instances
+	bool drawIndirectCountSupported = false;
+	PFN_vkCmdDrawIndexedIndirectCountKHR vkCmdDrawIndexedIndirectCountKHR = nullptr;
+
+	struct {
+		uint32_t drawCount = 0;
+		uint32_t visibleCount = 0;
+	} statistics;
+
 	struct {
 		VkPipeline plants;
 		VkPipeline ground;
@@ -99,6 +150,11 @@ public:
 		camera.setRotation(glm::vec3(-12.0f, 159.0f, 0.0f));
 		camera.setTranslation(glm::vec3(0.4f, 1.25f, 0.0f));
 		camera.movementSpeed = 5.0f;
+		for (size_t i = 0; i < args.size(); i++) {
+			if ((strcmp(args[i], "--instances") == 0) && (i + 1 < args.size())) {
+				requestedInstanceCount = static_cast<uint32_t>(strtoul(args[i + 1], nullptr, 10));
+			}
+		}
 	}
 
 	~VulkanExample()
@@ -111,8 +167,17 @@ public:
 		textures.plants.destroy();
 		textures.ground.destroy();
 		instanceBuffer.destroy();
+		visibleInstanceBuffer.destroy();
+		objectCommandsBuffer.destroy();
 		indirectCommandsBuffer.destroy();
+		drawCountBuffer.destroy();
+		statisticsBuffer.destroy();
 		uniformData.scene.destroy();
+		uniformData.cull.destroy();
+		vkDestroyPipeline(device, compute.cull, nullptr);
+		vkDestroyPipeline(device, compute.compact, nullptr);
+		vkDestroyPipelineLayout(device, compute.pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, compute.descriptorSetLayout, nullptr);
 	}
 
 	// Enable physical device features required for this example
@@ -128,6 +193,94 @@ public:
 		}
 	};
 
+	// Enable the draw indirect count extension if supported, this function is called after physical and before logical device creation
+	virtual void getEnabledExtensions()
+	{
+		// Issuing more than one draw from the count buffer also requires the multi draw indirect feature
+		drawIndirectCountSupported = vulkanDevice->extensionSupported(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) && deviceFeatures.multiDrawIndirect;
+		if (drawIndirectCountSupported) {
+			enabledDeviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+		}
+	}
+
+	// Records the culling and compaction passes, these need to be outside of the render pass
+	void buildCullCommands(VkCommandBuffer commandBuffer)
+	{
+		// The previous frame's draws need to have consumed the draw commands and visible instances before they're rewritten
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = 0;
+		memoryBarrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_FLAGS_NONE,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr);
+
+		// Reset the draw and instance counters
+		vkCmdFillBuffer(commandBuffer, drawCountBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_FLAGS_NONE,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.pipelineLayout, 0, 1, &compute.descriptorSet, 0, nullptr);
+
+		// Write the visible instances of each object into its range of the visible instance buffer
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.cull);
+		vkCmdDispatch(commandBuffer, (objectCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_FLAGS_NONE,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr);
+
+		// Compact the draw commands of objects with visible instances, this runs in a single workgroup
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute.compact);
+		vkCmdDispatch(commandBuffer, 1, 1, 1);
+
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_FLAGS_NONE,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr);
+
+		// Copy the draw and visible instance counts for display
+		VkBufferCopy copyRegion = { 0, 0, statisticsBuffer.size };
+		vkCmdCopyBuffer(commandBuffer, drawCountBuffer.buffer, statisticsBuffer.buffer, 1, &copyRegion);
+
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(
+			commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_HOST_BIT,
+			VK_FLAGS_NONE,
+			1, &memoryBarrier,
+			0, nullptr,
+			0, nullptr);
+	}
+
 	void buildCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
@@ -150,6 +303,14 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			gpuProfiler.cmdBeginFrame(drawCmdBuffers[i], i);
+
+			// [POI] GPU culling and draw compaction
+			gpuProfiler.cmdBeginScope(drawCmdBuffers[i], i, "Culling");
+			buildCullCommands(drawCmdBuffers[i]);
+			gpuProfiler.cmdEndScope(drawCmdBuffers[i], i, "Culling");
+
+			gpuProfiler.cmdBeginScope(drawCmdBuffers[i], i, "Scene");
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -172,16 +333,21 @@ public:
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.plants);
 			// Binding point 0 : Mesh vertex buffer
 			vkCmdBindVertexBuffers(drawCmdBuffers[i], VERTEX_BUFFER_BIND_ID, 1, &models.plants.vertices.buffer, offsets);
-			// Binding point 1 : Instance data buffer
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], INSTANCE_BUFFER_BIND_ID, 1, &instanceBuffer.buffer, offsets);
+			// Binding point 1 : Visible instances written by the culling pass
+			vkCmdBindVertexBuffers(drawCmdBuffers[i], INSTANCE_BUFFER_BIND_ID, 1, &visibleInstanceBuffer.buffer, offsets);
 
 			vkCmdBindIndexBuffer(drawCmdBuffers[i], models.plants.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
 
-			// If the multi draw feature is supported:
-			// One draw call for an arbitrary number of objects
-			// Index offsets and instance count are taken from the indirect buffer
-			if (vulkanDevice->features.multiDrawIndirect)
+			if (drawIndirectCountSupported)
+			{
+				// The number of draws is taken from the first value of the draw count buffer written by the compaction pass
+				vkCmdDrawIndexedIndirectCountKHR(drawCmdBuffers[i], indirectCommandsBuffer.buffer, 0, drawCountBuffer.buffer, 0, indirectDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+			}
+			else if (vulkanDevice->features.multiDrawIndirect)
 			{
+				// If the multi draw feature is supported:
+				// One draw call for an arbitrary number of objects
+				// Index offsets and instance count are taken from the indirect buffer, draws after the compacted ones have no instances
 				vkCmdDrawIndexedIndirect(drawCmdBuffers[i], indirectCommandsBuffer.buffer, 0, indirectDrawCount, sizeof(VkDrawIndexedIndirectCommand));
 			}
 			else
@@ -193,9 +359,10 @@ public:
 				}
 			}
 
-			drawUI(drawCmdBuffers[i]);
-
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
+			gpuProfiler.cmdEndScope(drawCmdBuffers[i], i, "Scene");
+
+			gpuProfiler.cmdEndFrame(drawCmdBuffers[i], i);
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
@@ -214,8 +381,9 @@ public:
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5),
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, 2);
@@ -349,15 +517,31 @@ public:
 	{
 		indirectCommands.clear();
 
+		// The requested total instance count is distributed evenly over all objects, rounded down to a multiple of the object count
+		// (the culling shader maps instances to their object using a single per object instance count)
+		if (requestedInstanceCount > 0)
+		{
+			uint32_t meshCount = 0;
+			for (auto &node : models.plants.nodes)
+			{
+				if (node->mesh)
+				{
+					meshCount++;
+				}
+			}
+			instancesPerObject = std::max(1u, requestedInstanceCount / std::max(1u, meshCount));
+		}
+
 		// Create on indirect command for node in the scene with a mesh attached to it
+		// The instance count of each command is replaced with the number of visible instances by the culling pass
 		uint32_t m = 0;
 		for (auto &node : models.plants.nodes)
 		{
 			if (node->mesh)
 			{
 				VkDrawIndexedIndirectCommand indirectCmd{};
-				indirectCmd.instanceCount = OBJECT_INSTANCE_COUNT;
-				indirectCmd.firstInstance = m * OBJECT_INSTANCE_COUNT;
+				indirectCmd.instanceCount = instancesPerObject;
+				indirectCmd.firstInstance = m * instancesPerObject;
 				// @todo: Multiple primitives
 				// A glTF node may consist of multiple primitives, so we may have to do multiple commands per mesh
 				indirectCmd.firstIndex = node->mesh->primitives[0]->firstIndex;
@@ -386,14 +570,36 @@ public:
 			indirectCommands.data()));
 
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			&indirectCommandsBuffer,
+			&objectCommandsBuffer,
 			stagingBuffer.size));
 
-		vulkanDevice->copyBuffer(&stagingBuffer, &indirectCommandsBuffer, queue);
+		vulkanDevice->copyBuffer(&stagingBuffer, &objectCommandsBuffer, queue);
 
 		stagingBuffer.destroy();
+
+		// The commands that are drawn are only written on the GPU
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&indirectCommandsBuffer,
+			indirectCommands.size() * sizeof(VkDrawIndexedIndirectCommand)));
+
+		// Draw count, visible instance count and visible instances per object
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&drawCountBuffer,
+			(2 + indirectCommands.size()) * sizeof(uint32_t)));
+
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&statisticsBuffer,
+			sizeof(statistics)));
+		VK_CHECK_RESULT(statisticsBuffer.map());
+		memset(statisticsBuffer.mapped, 0, sizeof(statistics));
 	}
 
 	// Prepare (and stage) a buffer containing instanced data for the mesh draws
@@ -402,7 +608,7 @@ public:
 		std::vector<InstanceData> instanceData;
 		instanceData.resize(objectCount);
 
-		std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
+		std::default_random_engine rndEngine(benchmark.active ? benchmark.seed : (unsigned)time(nullptr));
 		std::uniform_real_distribution<float> uniformDist(0.0f, 1.0f);
 
 		for (uint32_t i = 0; i < objectCount; i++) {
@@ -411,7 +617,7 @@ public:
 			instanceData[i].rot = glm::vec3(0.0f, float(M_PI) * uniformDist(rndEngine), 0.0f);
 			instanceData[i].pos = glm::vec3(sin(phi) * cos(theta), 0.0f, cos(phi)) * PLANT_RADIUS;
 			instanceData[i].scale = 1.0f + uniformDist(rndEngine) * 2.0f;
-			instanceData[i].texIndex = i / OBJECT_INSTANCE_COUNT;
+			instanceData[i].texIndex = i / instancesPerObject;
 		}
 
 		vks::Buffer stagingBuffer;
@@ -422,14 +628,21 @@ public:
 			instanceData.size() * sizeof(InstanceData),
 			instanceData.data()));
 
+		// The instance data is only read by the culling pass, which copies the visible instances to the buffer that is drawn
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 			&instanceBuffer,
 			stagingBuffer.size));
 
 		vulkanDevice->copyBuffer(&stagingBuffer, &instanceBuffer, queue);
 
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&visibleInstanceBuffer,
+			stagingBuffer.size));
+
 		stagingBuffer.destroy();
 	}
 
@@ -443,6 +656,19 @@ public:
 
 		VK_CHECK_RESULT(uniformData.scene.map());
 
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&uniformData.cull,
+			sizeof(uboCull)));
+
+		VK_CHECK_RESULT(uniformData.cull.map());
+
+		// All plants are modelled around the origin, rotation and scale are applied per instance
+		uboCull.meshRadius = glm::length(glm::max(glm::abs(models.plants.dimensions.min), glm::abs(models.plants.dimensions.max)));
+		uboCull.instanceCount = objectCount;
+		uboCull.instancesPerObject = instancesPerObject;
+
 		updateUniformBuffer(true);
 	}
 
@@ -452,9 +678,62 @@ public:
 		{
 			uboVS.projection = camera.matrices.perspective;
 			uboVS.view = camera.matrices.view;
+			if (!fixedFrustum)
+			{
+				frustum.update(uboVS.projection * uboVS.view);
+				memcpy(uboCull.frustumPlanes, frustum.planes.data(), sizeof(glm::vec4) * 6);
+			}
 		}
 
 		memcpy(uniformData.scene.mapped, &uboVS, sizeof(uboVS));
+		memcpy(uniformData.cull.mapped, &uboCull, sizeof(uboCull));
+	}
+
+	void prepareCompute()
+	{
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			// Binding 0: Instance data of all objects (input)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			// Binding 1: Visible instances (output)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+			// Binding 2: Draw command per object (input)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),
+			// Binding 3: Compacted draw commands (output)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3),
+			// Binding 4: Draw and instance counters
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4),
+			// Binding 5: Culling parameters
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5),
+		};
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &compute.descriptorSetLayout));
+
+		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vks::initializers::pipelineLayoutCreateInfo(&compute.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &compute.pipelineLayout));
+
+		VkDescriptorSetAllocateInfo allocInfo = vks::initializers::descriptorSetAllocateInfo(descriptorPool, &compute.descriptorSetLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &compute.descriptorSet));
+
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &instanceBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, &visibleInstanceBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2, &objectCommandsBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3, &indirectCommandsBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, &drawCountBuffer.descriptor),
+			vks::initializers::writeDescriptorSet(compute.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5, &uniformData.cull.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+
+		VkComputePipelineCreateInfo computePipelineCreateInfo = vks::initializers::computePipelineCreateInfo(compute.pipelineLayout, 0);
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "indirectdraw/cull.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.cull));
+
+		computePipelineCreateInfo.stage = loadShader(getShadersPath() + "indirectdraw/compact.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &compute.compact));
+
+		if (drawIndirectCountSupported) {
+			vkCmdDrawIndexedIndirectCountKHR = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
+		}
 	}
 
 	void draw()
@@ -469,6 +748,9 @@ public:
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
+
+		// The queue is idle after submitting the frame, so the counts written by the GPU can be read
+		memcpy(&statistics, statisticsBuffer.mapped, sizeof(statistics));
 	}
 
 	void prepare()
@@ -482,6 +764,7 @@ public:
 		preparePipelines();
 		setupDescriptorPool();
 		setupDescriptorSet();
+		prepareCompute();
 		buildCommandBuffers();
 		prepared = true;
 	}
@@ -511,8 +794,20 @@ public:
 				overlay->text("multiDrawIndirect not supported");
 			}
 		}
+		if (overlay->header("Settings")) {
+			bool cullingEnabled = (uboCull.cullingEnabled == 1);
+			if (overlay->checkBox("Frustum culling", &cullingEnabled)) {
+				uboCull.cullingEnabled = cullingEnabled ? 1 : 0;
+				updateUniformBuffer(false);
+			}
+			if (overlay->checkBox("Freeze frustum", &fixedFrustum)) {
+				updateUniformBuffer(true);
+			}
+		}
 		if (overlay->header("Statistics")) {
-			overlay->text("Objects: %d", objectCount);
+			overlay->text("Instances: %d", objectCount);
+			overlay->text("Visible instances: %d", statistics.visibleCount);
+			overlay->text("Draws: %d / %d (%s)", statistics.drawCount, indirectDrawCount, drawIndirectCountSupported ? "draw indirect count" : "fixed count");
 		}
 	}
 };
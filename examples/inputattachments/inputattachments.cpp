@@ -79,7 +79,6 @@ public:
 		camera.setPosition(glm::vec3(1.65f, 1.75f, -6.15f));
 		camera.setRotation(glm::vec3(-12.75f, 380.0f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
-		UIOverlay.subpass = 1;
 	}
 
 	~VulkanExample()
@@ -404,8 +403,6 @@ public:
 				vks::debugmarker::endRegion(drawCmdBuffers[i]);
 			}
 
-			drawUI(drawCmdBuffers[i]);
-
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
@@ -159,8 +159,6 @@ public:
 			// Render instances
 			vkCmdDrawIndexed(drawCmdBuffers[i], models.rock.indices.count, INSTANCE_COUNT, 0, 0, 0);
 
-			drawUI(drawCmdBuffers[i]);
-
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
@@ -331,7 +329,7 @@ public:
 		std::vector<InstanceData> instanceData;
 		instanceData.resize(INSTANCE_COUNT);
 
-		std::default_random_engine rndGenerator(benchmark.active ? 0 : (unsigned)time(nullptr));
+		std::default_random_engine rndGenerator(benchmark.active ? benchmark.seed : (unsigned)time(nullptr));
 		std::uniform_real_distribution<float> uniformDist(0.0, 1.0);
 		std::uniform_int_distribution<uint32_t> rndTextureIndex(0, textures.rocks.layerCount);
 
@@ -40,10 +40,9 @@ public:
 
 	VkCommandBuffer primaryCommandBuffer;
 
-	// Secondary scene command buffers used to store backdrop and user interface
+	// Secondary scene command buffers used to store backdrop
 	struct SecondaryCommandBuffers {
 		VkCommandBuffer background;
-		VkCommandBuffer ui;
 	} secondaryCommandBuffers;
 
 	// Number of animated objects to be renderer
@@ -113,7 +112,7 @@ public:
 #endif
 		threadPool.setThreadCount(numThreads);
 		numObjectsPerThread = 512 / numThreads;
-		rndEngine.seed(benchmark.active ? 0 : (unsigned)time(nullptr));
+		rndEngine.seed(benchmark.active ? benchmark.seed : (unsigned)time(nullptr));
 	}
 
 	~VulkanExample()
@@ -152,10 +151,9 @@ public:
 				1);
 		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &primaryCommandBuffer));
 
-		// Create additional secondary CBs for background and ui
+		// Create additional secondary CB for background
 		cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
 		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &secondaryCommandBuffers.background));
-		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &secondaryCommandBuffers.ui));
 
 		threadData.resize(numThreads);
 
@@ -205,6 +203,7 @@ public:
 	// Builds the secondary command buffer for each thread
 	void threadRenderCode(uint32_t threadIndex, uint32_t cmdBufferIndex, VkCommandBufferInheritanceInfo inheritanceInfo)
 	{
+		VKS_PROFILE_FUNCTION();
 		ThreadData *thread = &threadData[threadIndex];
 		ObjectData *objectData = &thread->objectData[cmdBufferIndex];
 
@@ -306,24 +305,6 @@ public:
 		models.starSphere.draw(secondaryCommandBuffers.background);
 		
 		VK_CHECK_RESULT(vkEndCommandBuffer(secondaryCommandBuffers.background));
-
-		/*
-			User interface
-
-			With VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, the primary command buffer's content has to be defined
-			by secondary command buffers, which also applies to the UI overlay command buffer
-		*/
-
-		VK_CHECK_RESULT(vkBeginCommandBuffer(secondaryCommandBuffers.ui, &commandBufferBeginInfo));
-
-		vkCmdSetViewport(secondaryCommandBuffers.ui, 0, 1, &viewport);
-		vkCmdSetScissor(secondaryCommandBuffers.ui, 0, 1, &scissor);
-
-		vkCmdBindPipeline(secondaryCommandBuffers.ui, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.starsphere);
-
-		drawUI(secondaryCommandBuffers.ui);
-
-		VK_CHECK_RESULT(vkEndCommandBuffer(secondaryCommandBuffers.ui));
 	}
 
 	// Updates the secondary command buffers using a thread pool
@@ -331,6 +312,7 @@ public:
 	// lat submitted to the queue for rendering
 	void updateCommandBuffers(VkFramebuffer frameBuffer)
 	{
+		VKS_PROFILE_FUNCTION();
 		// Contains the list of secondary command buffers to be submitted
 		std::vector<VkCommandBuffer> commandBuffers;
 
@@ -394,11 +376,6 @@ public:
 			}
 		}
 
-		// Render ui last
-		if (UIOverlay.visible) {
-			commandBuffers.push_back(secondaryCommandBuffers.ui);
-		}
-
 		// Execute render commands from the secondary command buffer
 		vkCmdExecuteCommands(primaryCommandBuffer, commandBuffers.size(), commandBuffers.data());
 
@@ -482,9 +459,12 @@ public:
 	{
 		// Wait for fence to signal that all command buffers are ready
 		VkResult fenceRes;
-		do {
-			fenceRes = vkWaitForFences(device, 1, &renderFence, VK_TRUE, 100000000);
-		} while (fenceRes == VK_TIMEOUT);
+		{
+			VKS_PROFILE_ZONE("vkWaitForFences");
+			do {
+				fenceRes = vkWaitForFences(device, 1, &renderFence, VK_TRUE, 100000000);
+			} while (fenceRes == VK_TIMEOUT);
+		}
 		VK_CHECK_RESULT(fenceRes);
 		vkResetFences(device, 1, &renderFence);
 
@@ -495,7 +475,10 @@ public:
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &primaryCommandBuffer;
 
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, renderFence));
+		{
+			VKS_PROFILE_ZONE("vkQueueSubmit");
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, renderFence));
+		}
 
 		VulkanExampleBase::submitFrame();
 	}
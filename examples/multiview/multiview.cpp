@@ -387,8 +387,6 @@ public:
 				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, viewDisplayPipelines[1]);
 				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 
-				drawUI(drawCmdBuffers[i]);
-
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
 				VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 			}
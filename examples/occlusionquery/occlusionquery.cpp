@@ -53,8 +53,9 @@ public:
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
-	// Pool that stores all occlusion queries
-	VkQueryPool queryPool;
+	// Ring-buffered occlusion queries, results are read back without stalling
+	vks::QueryManager queryManager;
+	uint32_t occlusionQueries;
 
 	// Passed query samples
 	uint64_t passedSamples[2] = { 1,1 };
@@ -80,39 +81,22 @@ public:
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
-		vkDestroyQueryPool(device, queryPool, nullptr);
+		queryManager.destroy();
 
 		uniformBuffers.occluder.destroy();
 		uniformBuffers.sphere.destroy();
 		uniformBuffers.teapot.destroy();
 	}
 
-	// Create a query pool for storing the occlusion query result
+	// Setup the query manager for storing the occlusion query results
 	void setupQueryPool()
 	{
-		VkQueryPoolCreateInfo queryPoolInfo = {};
-		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
-		queryPoolInfo.queryType = VK_QUERY_TYPE_OCCLUSION;
-		queryPoolInfo.queryCount = 2;
-		VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, NULL, &queryPool));
-	}
-
-	// Retrieves the results of the occlusion queries submitted to the command buffer
-	void getQueryResults()
-	{
-		// We use vkGetQueryResults to copy the results into a host visible buffer
-		vkGetQueryPoolResults(
-			device,
-			queryPool,
-			0,
-			2,
-			sizeof(passedSamples),
-			passedSamples,
-			sizeof(uint64_t),
-			// Store results a 64 bit values and wait until the results have been finished
-			// If you don't want to wait, you can use VK_QUERY_RESULT_WITH_AVAILABILITY_BIT
-			// which also returns the state of the result (ready) in the result
-			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+		// One ring slot per command buffer so the results of a frame are read once available instead of waiting for them
+		queryManager.prepare(vulkanDevice, static_cast<uint32_t>(drawCmdBuffers.size()));
+		occlusionQueries = queryManager.addQuerySet(VK_QUERY_TYPE_OCCLUSION, 2, [this](const std::vector<uint64_t> &results, uint32_t frameIndex, uint32_t latency) {
+			passedSamples[0] = results[0];
+			passedSamples[1] = results[1];
+		});
 	}
 
 	void buildCommandBuffers()
@@ -139,9 +123,9 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
-			// Reset query pool
+			// Reset this command buffer's queries
 			// Must be done outside of render pass
-			vkCmdResetQueryPool(drawCmdBuffers[i], queryPool, 0, 2);
+			queryManager.cmdReset(drawCmdBuffers[i], i);
 
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
@@ -169,16 +153,16 @@ public:
 			models.plane.draw(drawCmdBuffers[i]);
 
 			// Teapot
-			vkCmdBeginQuery(drawCmdBuffers[i], queryPool, 0, VK_FLAGS_NONE);
+			queryManager.cmdBeginQuery(drawCmdBuffers[i], occlusionQueries, i, 0);
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.teapot, 0, NULL);
 			models.teapot.draw(drawCmdBuffers[i]);
-			vkCmdEndQuery(drawCmdBuffers[i], queryPool, 0);
+			queryManager.cmdEndQuery(drawCmdBuffers[i], occlusionQueries, i, 0);
 
 			// Sphere
-			vkCmdBeginQuery(drawCmdBuffers[i], queryPool, 1, VK_FLAGS_NONE);
+			queryManager.cmdBeginQuery(drawCmdBuffers[i], occlusionQueries, i, 1);
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.sphere, 0, NULL);
 			models.sphere.draw(drawCmdBuffers[i]);
-			vkCmdEndQuery(drawCmdBuffers[i], queryPool, 1);
+			queryManager.cmdEndQuery(drawCmdBuffers[i], occlusionQueries, i, 1);
 
 			// Visible pass
 			// Clear color and depth attachments
@@ -218,8 +202,6 @@ public:
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
 			models.plane.draw(drawCmdBuffers[i]);
 
-			drawUI(drawCmdBuffers[i]);
-
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
@@ -231,13 +213,13 @@ public:
 		updateUniformBuffers();
 		VulkanExampleBase::prepareFrame();
 
+		// Fetch query results of previous frames that have become available (used for display in this frame)
+		queryManager.update(currentBuffer);
+
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
-		// Read query results for displaying in next frame
-		getQueryResults();
-
 		VulkanExampleBase::submitFrame();
 	}
 
@@ -388,8 +388,6 @@ public:
 					models.example.draw(drawCmdBuffers[i]);
 				}
 
-				drawUI(drawCmdBuffers[i]);
-
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
 			}
 
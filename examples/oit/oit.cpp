@@ -11,13 +11,29 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanFrameBuffer.hpp"
 
 #define ENABLE_VALIDATION false
-#define NODE_COUNT 20
+// Initial number of linked list nodes per pixel, the node buffer is sized to the measured fragment count at runtime
+#define NODE_COUNT 2
+// Number of nearest fragments per pixel that are stored and sorted by the fixed k-buffer mode
+#define KBUFFER_LAYER_COUNT 8
 
 class VulkanExample : public VulkanExampleBase
 {
 public:
+	enum OITMode { LinkedList = 0, WeightedBlended = 1, FixedK = 2 };
+	int32_t oitMode = LinkedList;
+	const std::vector<std::string> oitModeNames = { "Linked lists", "Weighted blended", "Fixed k-buffer" };
+
+	// Fragments written by the last linked list pass, including those that didn't fit into the node buffer
+	uint32_t fragmentCount = 0;
+	uint32_t droppedFragmentCount = 0;
+
+	// Image error (RMSE) of each mode against the linked list result with all fragments, negative if not measured
+	std::array<float, 3> modeErrors = { -1.0f, -1.0f, -1.0f };
+	bool measureErrors = false;
+
 	struct {
 		vkglTF::Model sphere;
 		vkglTF::Model cube;
@@ -31,6 +47,8 @@ public:
 		glm::vec4 color;
 		float depth;
 		uint32_t next;
+		// The std430 array stride of the shader's node struct is rounded up to its 16 byte alignment
+		uint32_t padding[2];
 	};
 
 	struct {
@@ -44,11 +62,19 @@ public:
 		vks::Buffer geometry;
 		vks::Texture headIndex;
 		vks::Buffer linkedList;
+		// Host visible copy of the fragment counter used to size the node buffer
+		vks::Buffer readback;
+		// Sorted depths of the nearest fragments per pixel followed by their packed colors
+		vks::Buffer kBuffer;
+		// Weighted blended accumulation and revealage targets, also used for the tail of the k-buffer mode
+		vks::Framebuffer* accumulation = nullptr;
 	} geometryPass;
 
 	struct {
 		glm::mat4 projection;
 		glm::mat4 view;
+		// xy = framebuffer size
+		glm::uvec4 screen;
 	} renderPassUBO;
 
 	struct ObjectData {
@@ -69,6 +95,11 @@ public:
 	struct {
 		VkPipeline geometry;
 		VkPipeline color;
+		VkPipeline geometryWeightedBlended;
+		VkPipeline colorWeightedBlended;
+		VkPipeline geometryKBufferDepth;
+		VkPipeline geometryKBufferColor;
+		VkPipeline colorKBuffer;
 	} pipelines;
 
 	struct {
@@ -89,6 +120,11 @@ public:
 	{
 		vkDestroyPipeline(device, pipelines.geometry, nullptr);
 		vkDestroyPipeline(device, pipelines.color, nullptr);
+		vkDestroyPipeline(device, pipelines.geometryWeightedBlended, nullptr);
+		vkDestroyPipeline(device, pipelines.colorWeightedBlended, nullptr);
+		vkDestroyPipeline(device, pipelines.geometryKBufferDepth, nullptr);
+		vkDestroyPipeline(device, pipelines.geometryKBufferColor, nullptr);
+		vkDestroyPipeline(device, pipelines.colorKBuffer, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayouts.geometry, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.color, nullptr);
@@ -130,6 +166,13 @@ public:
 		if (!prepared)
 			return;
 		draw();
+		if (oitMode == LinkedList) {
+			updateLinkedListSize();
+		}
+		if (measureErrors) {
+			measureModeErrors();
+			measureErrors = false;
+		}
 	}
 
 	void windowResized() override
@@ -138,6 +181,8 @@ public:
 		prepareGeometryPass();
 		vkResetDescriptorPool(device, descriptorPool, 0);
 		setupDescriptorSets();
+		updateUniformBuffers();
+		modeErrors = { -1.0f, -1.0f, -1.0f };
 
 		resized = false;
 		buildCommandBuffers();
@@ -192,35 +237,52 @@ private:
 		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &geometryPass.framebuffer));
 
 		// Create a buffer for GeometrySBO
-		vks::Buffer stagingBuffer;
-	
+		// The counter and node limit are written at the start of each frame, the counter is copied back to the host afterwards
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&stagingBuffer,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&geometryPass.geometry,
 			sizeof(geometrySBO)));
-		VK_CHECK_RESULT(stagingBuffer.map());
 
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&geometryPass.readback,
+			sizeof(uint32_t)));
+		VK_CHECK_RESULT(geometryPass.readback.map());
+		memset(geometryPass.readback.mapped, 0, sizeof(uint32_t));
+		fragmentCount = 0;
+		droppedFragmentCount = 0;
+
+		// Create a buffer for the k-buffer depths and colors
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			&geometryPass.geometry,
-			sizeof(geometrySBO)));
+			&geometryPass.kBuffer,
+			sizeof(uint32_t) * 2 * KBUFFER_LAYER_COUNT * width * height));
+
+		// Create the weighted blended accumulation targets
+		geometryPass.accumulation = new vks::Framebuffer(vulkanDevice);
+		geometryPass.accumulation->width = width;
+		geometryPass.accumulation->height = height;
+
+		vks::AttachmentCreateInfo attachmentInfo = {};
+		attachmentInfo.width = width;
+		attachmentInfo.height = height;
+		attachmentInfo.layerCount = 1;
+		attachmentInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 
-		// Set up GeometrySBO data.
-		geometrySBO.count = 0;
-		geometrySBO.maxNodeCount = NODE_COUNT * width * height;
-		memcpy(stagingBuffer.mapped, &geometrySBO, sizeof(geometrySBO));
+		// Attachment 0: Sum of weighted premultiplied colors (rgb) and weighted alphas (a)
+		attachmentInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+		geometryPass.accumulation->addAttachment(attachmentInfo);
 
-		// Copy data to device
-		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-		VkBufferCopy copyRegion = {};
-		copyRegion.size = sizeof(geometrySBO);
-		vkCmdCopyBuffer(copyCmd, stagingBuffer.buffer, geometryPass.geometry.buffer, 1, &copyRegion);
-		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+		// Attachment 1: Revealage, product of (1 - alpha) of all fragments
+		attachmentInfo.format = VK_FORMAT_R16_SFLOAT;
+		geometryPass.accumulation->addAttachment(attachmentInfo);
+
+		VK_CHECK_RESULT(geometryPass.accumulation->createSampler(VK_FILTER_NEAREST, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE));
+		VK_CHECK_RESULT(geometryPass.accumulation->createRenderPass());
 
-		stagingBuffer.destroy();
-		
 		// Create a texture for HeadIndex.
 		// This image will track the head index of each fragment.
 		geometryPass.headIndex.device = vulkanDevice;
@@ -277,12 +339,7 @@ private:
 		geometryPass.headIndex.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
 		geometryPass.headIndex.sampler = VK_NULL_HANDLE;
 
-		// Create a buffer for LinkedListSBO
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			&geometryPass.linkedList,
-			sizeof(Node) * geometrySBO.maxNodeCount));
+		prepareLinkedList(NODE_COUNT * width * height);
 
 		// Change HeadIndex image's layout from UNDEFINED to GENERAL
 		VkCommandBufferAllocateInfo cmdBufAllocInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
@@ -314,6 +371,43 @@ private:
 		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
 	}
 
+	void prepareLinkedList(uint32_t nodeCount)
+	{
+		// Create a buffer for LinkedListSBO
+		geometrySBO.maxNodeCount = nodeCount;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			&geometryPass.linkedList,
+			sizeof(Node) * geometrySBO.maxNodeCount));
+	}
+
+	void resizeLinkedList(uint32_t nodeCount)
+	{
+		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+		geometryPass.linkedList.destroy();
+		prepareLinkedList(nodeCount);
+		vkResetDescriptorPool(device, descriptorPool, 0);
+		setupDescriptorSets();
+		buildCommandBuffers();
+	}
+
+	// Sizes the node buffer to the number of fragments written by the last linked list pass, returns true if it was resized
+	bool updateLinkedListSize()
+	{
+		fragmentCount = *static_cast<uint32_t*>(geometryPass.readback.mapped);
+		droppedFragmentCount = (fragmentCount > geometrySBO.maxNodeCount) ? fragmentCount - geometrySBO.maxNodeCount : 0;
+		// Leave some headroom so small changes of the fragment count don't require a new buffer
+		const uint64_t maxNodeCount = vulkanDevice->properties.limits.maxStorageBufferRange / sizeof(Node);
+		const uint64_t nodeCount = std::min(std::max((uint64_t)fragmentCount + fragmentCount / 4, (uint64_t)width * height), maxNodeCount);
+		// Grow as soon as fragments have been dropped, but only shrink if the buffer is far too large
+		if ((nodeCount != geometrySBO.maxNodeCount) && ((fragmentCount > geometrySBO.maxNodeCount) || (nodeCount < geometrySBO.maxNodeCount / 2))) {
+			resizeLinkedList(static_cast<uint32_t>(nodeCount));
+			return true;
+		}
+		return false;
+	}
+
 	void setupDescriptorSetLayout()
 	{
 		// Create a geometry descriptor set layout.
@@ -338,6 +432,11 @@ private:
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				VK_SHADER_STAGE_FRAGMENT_BIT,
 				3),
+			// KBufferSBO
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_FRAGMENT_BIT,
+				4),
 		};
 
 		VkDescriptorSetLayoutCreateInfo descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
@@ -363,6 +462,26 @@ private:
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				VK_SHADER_STAGE_FRAGMENT_BIT,
 				1),
+			// Accumulation
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				VK_SHADER_STAGE_FRAGMENT_BIT,
+				2),
+			// Revealage
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				VK_SHADER_STAGE_FRAGMENT_BIT,
+				3),
+			// KBufferSBO
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				VK_SHADER_STAGE_FRAGMENT_BIT,
+				4),
+			// RenderPassUBO
+			vks::initializers::descriptorSetLayoutBinding(
+				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				VK_SHADER_STAGE_FRAGMENT_BIT,
+				5),
 		};
 
 		descriptorLayoutCI = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
@@ -403,6 +522,38 @@ private:
 
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.geometry));
 
+		// Create a k-buffer depth pipeline, inserts the fragment depths into the per-pixel k-buffer
+		shaderStages[1] = loadShader(getShadersPath() + "oit/kbufferdepth.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.geometryKBufferDepth));
+
+		// Create weighted blended accumulation pipelines
+		std::array<VkPipelineColorBlendAttachmentState, 2> accumulationBlendStates;
+		// Sum of weighted colors and alphas
+		accumulationBlendStates[0] = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_TRUE);
+		accumulationBlendStates[0].srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		accumulationBlendStates[0].dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		accumulationBlendStates[0].colorBlendOp = VK_BLEND_OP_ADD;
+		accumulationBlendStates[0].srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		accumulationBlendStates[0].dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		accumulationBlendStates[0].alphaBlendOp = VK_BLEND_OP_ADD;
+		// Revealage is multiplied by (1 - alpha) of each fragment
+		accumulationBlendStates[1] = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_TRUE);
+		accumulationBlendStates[1].srcColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+		accumulationBlendStates[1].dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_COLOR;
+		accumulationBlendStates[1].colorBlendOp = VK_BLEND_OP_ADD;
+		accumulationBlendStates[1].srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+		accumulationBlendStates[1].dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		accumulationBlendStates[1].alphaBlendOp = VK_BLEND_OP_ADD;
+		colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(static_cast<uint32_t>(accumulationBlendStates.size()), accumulationBlendStates.data());
+		pipelineCI.renderPass = geometryPass.accumulation->renderPass;
+
+		shaderStages[1] = loadShader(getShadersPath() + "oit/wboitaccumulate.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.geometryWeightedBlended));
+
+		// The k-buffer color pass stores the colors of the k nearest fragments and accumulates the others
+		shaderStages[1] = loadShader(getShadersPath() + "oit/kbuffercolor.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.geometryKBufferColor));
+
 		// Create a color pipeline.
 		VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
 		colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
@@ -428,15 +579,23 @@ private:
 		rasterizationState.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
 
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.color));
+
+		// Create the resolve pipelines of the weighted blended and k-buffer modes
+		shaderStages[1] = loadShader(getShadersPath() + "oit/wboitresolve.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.colorWeightedBlended));
+
+		shaderStages[1] = loadShader(getShadersPath() + "oit/kbufferresolve.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.colorKBuffer));
 	}
 
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5),
 			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2),
 		};
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo =
@@ -463,24 +622,30 @@ private:
 				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
 				0,
 				&uniformBuffers.renderPass.descriptor),
-			// Binding 2: GeometrySBO
+			// Binding 1: GeometrySBO
 			vks::initializers::writeDescriptorSet(
 				descriptorSets.geometry,
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				1,
 				&geometryPass.geometry.descriptor),
-			// Binding 3: headIndexImage
+			// Binding 2: headIndexImage
 			vks::initializers::writeDescriptorSet(
 				descriptorSets.geometry,
 				VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
 				2,
 				&geometryPass.headIndex.descriptor),
-			// Binding 4: LinkedListSBO
+			// Binding 3: LinkedListSBO
 			vks::initializers::writeDescriptorSet(
 				descriptorSets.geometry,
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				3,
-				&geometryPass.linkedList.descriptor)
+				&geometryPass.linkedList.descriptor),
+			// Binding 4: KBufferSBO
+			vks::initializers::writeDescriptorSet(
+				descriptorSets.geometry,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				4,
+				&geometryPass.kBuffer.descriptor)
 		};
 
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
@@ -494,6 +659,9 @@ private:
 
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSets.color));
 
+		VkDescriptorImageInfo accumulationDescriptor = vks::initializers::descriptorImageInfo(geometryPass.accumulation->sampler, geometryPass.accumulation->attachments[0].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		VkDescriptorImageInfo revealageDescriptor = vks::initializers::descriptorImageInfo(geometryPass.accumulation->sampler, geometryPass.accumulation->attachments[1].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
 		writeDescriptorSets = {
 			// Binding 0: headIndexImage
 			vks::initializers::writeDescriptorSet(
@@ -506,18 +674,76 @@ private:
 				descriptorSets.color,
 				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 				1,
-				&geometryPass.linkedList.descriptor)
+				&geometryPass.linkedList.descriptor),
+			// Binding 2: Accumulation
+			vks::initializers::writeDescriptorSet(
+				descriptorSets.color,
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				2,
+				&accumulationDescriptor),
+			// Binding 3: Revealage
+			vks::initializers::writeDescriptorSet(
+				descriptorSets.color,
+				VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				3,
+				&revealageDescriptor),
+			// Binding 4: KBufferSBO
+			vks::initializers::writeDescriptorSet(
+				descriptorSets.color,
+				VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				4,
+				&geometryPass.kBuffer.descriptor),
+			// Binding 5: RenderPassUBO
+			vks::initializers::writeDescriptorSet(
+				descriptorSets.color,
+				VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+				5,
+				&uniformBuffers.renderPass.descriptor)
 		};
 
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
 	}
 
-	void buildCommandBuffers() override
+	// Draws the transparent scene objects with the currently bound geometry pass pipeline
+	void drawScene(VkCommandBuffer commandBuffer)
 	{
-		if (resized)
-			return;
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.geometry, 0, 1, &descriptorSets.geometry, 0, nullptr);
 
-		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		ObjectData objectData;
+
+		models.sphere.bindBuffers(commandBuffer);
+		objectData.color = glm::vec4(1.0f, 0.0f, 0.0f, 0.5f);
+		for (int32_t x = 0; x < 5; x++)
+		{
+			for (int32_t y = 0; y < 5; y++)
+			{
+				for (int32_t z = 0; z < 5; z++)
+				{
+					glm::mat4 T = glm::translate(glm::mat4(1.0f), glm::vec3(x - 2, y - 2, z - 2));
+					glm::mat4 S = glm::scale(glm::mat4(1.0f), glm::vec3(0.3f));
+					objectData.model = T * S;
+					vkCmdPushConstants(commandBuffer, pipelineLayouts.geometry, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectData), &objectData);
+					models.sphere.draw(commandBuffer);
+				}
+			}
+		}
+
+		models.cube.bindBuffers(commandBuffer);
+		objectData.color = glm::vec4(0.0f, 0.0f, 1.0f, 0.5f);
+		for (uint32_t x = 0; x < 2; x++)
+		{
+			glm::mat4 T = glm::translate(glm::mat4(1.0f), glm::vec3(3.0f * x - 1.5f, 0.0f, 0.0f));
+			glm::mat4 S = glm::scale(glm::mat4(1.0f), glm::vec3(0.2f));
+			objectData.model = T * S;
+			vkCmdPushConstants(commandBuffer, pipelineLayouts.geometry, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectData), &objectData);
+			models.cube.draw(commandBuffer);
+		}
+	}
+
+	// Records the geometry and resolve passes of the given transparency mode, the resolve pass renders to the given framebuffer of the example's render pass
+	void recordCommandBuffer(VkCommandBuffer commandBuffer, VkFramebuffer framebuffer, int32_t mode, uint32_t profilerFrame)
+	{
+		const std::string &modeName = oitModeNames[mode];
 
 		VkClearValue clearValues[2];
 		clearValues[0].color = defaultClearColor;
@@ -528,20 +754,22 @@ private:
 		renderPassBeginInfo.renderArea.offset.y = 0;
 		renderPassBeginInfo.renderArea.extent.width = width;
 		renderPassBeginInfo.renderArea.extent.height = height;
-		
+
 		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
 		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
-		{
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		// Update dynamic viewport state
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-			// Update dynamic viewport state
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+		// Update dynamic scissor state
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-			// Update dynamic scissor state
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+		VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
 
+		switch (mode)
+		{
+		case LinkedList:
+		{
 			VkClearColorValue clearColor;
 			clearColor.uint32[0] = 0xffffffff;
 
@@ -551,91 +779,290 @@ private:
 			subresRange.levelCount = 1;
 			subresRange.layerCount = 1;
 
-			vkCmdClearColorImage(drawCmdBuffers[i], geometryPass.headIndex.image, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &subresRange);
+			vkCmdClearColorImage(commandBuffer, geometryPass.headIndex.image, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &subresRange);
 
-			// Clear previous geometry pass data
-			vkCmdFillBuffer(drawCmdBuffers[i], geometryPass.geometry.buffer, 0, sizeof(uint32_t), 0);
+			// Clear previous geometry pass data and set the current node limit
+			geometrySBO.count = 0;
+			vkCmdUpdateBuffer(commandBuffer, geometryPass.geometry.buffer, 0, sizeof(geometrySBO), &geometrySBO);
 
 			// We need a barrier to make sure all writes are finished before starting to write again
-			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
 			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
-			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 
 			// Begin the geometry render pass
+			gpuProfiler.cmdBeginScope(commandBuffer, profilerFrame, modeName + " geometry");
 			renderPassBeginInfo.renderPass = geometryPass.renderPass;
 			renderPassBeginInfo.framebuffer = geometryPass.framebuffer;
 			renderPassBeginInfo.clearValueCount = 0;
 			renderPassBeginInfo.pClearValues = nullptr;
 
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.geometry);
-			uint32_t dynamicOffset = 0;
-			models.sphere.bindBuffers(drawCmdBuffers[i]);
+			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.geometry);
+			drawScene(commandBuffer);
+			vkCmdEndRenderPass(commandBuffer);
+			gpuProfiler.cmdEndScope(commandBuffer, profilerFrame, modeName + " geometry");
 
-			// Render the scene
-			ObjectData objectData;
+			// Make a pipeline barrier to guarantee the geometry pass is done
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
 
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.geometry, 0, 1, &descriptorSets.geometry, 0, nullptr);
-			objectData.color = glm::vec4(1.0f, 0.0f, 0.0f, 0.5f);
-			for (int32_t x = 0; x < 5; x++)
-			{
-				for (int32_t y = 0; y < 5; y++)
-				{
-					for (int32_t z = 0; z < 5; z++)
-					{
-						glm::mat4 T = glm::translate(glm::mat4(1.0f), glm::vec3(x - 2, y - 2, z - 2));
-						glm::mat4 S = glm::scale(glm::mat4(1.0f), glm::vec3(0.3f));
-						objectData.model = T * S;
-						vkCmdPushConstants(drawCmdBuffers[i], pipelineLayouts.geometry, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectData), &objectData);
-						models.sphere.draw(drawCmdBuffers[i]);
-					}
-				}
-			}
+			// We need a barrier to make sure all writes are finished before they are read by the resolve pass and the counter copy
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 
-			models.cube.bindBuffers(drawCmdBuffers[i]);
-			objectData.color = glm::vec4(0.0f, 0.0f, 1.0f, 0.5f);
-			for (uint32_t x = 0; x < 2; x++)
-			{
-				glm::mat4 T = glm::translate(glm::mat4(1.0f), glm::vec3(3.0f * x - 1.5f, 0.0f, 0.0f));
-				glm::mat4 S = glm::scale(glm::mat4(1.0f), glm::vec3(0.2f));
-				objectData.model = T * S;
-				vkCmdPushConstants(drawCmdBuffers[i], pipelineLayouts.geometry, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ObjectData), &objectData);
-				models.cube.draw(drawCmdBuffers[i]);
-			}
+			// Copy the number of written fragments to the host for sizing the node buffer
+			VkBufferCopy copyRegion = {};
+			copyRegion.size = sizeof(uint32_t);
+			vkCmdCopyBuffer(commandBuffer, geometryPass.geometry.buffer, geometryPass.readback.buffer, 1, &copyRegion);
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			break;
+		}
+		case WeightedBlended:
+		{
+			// Accumulate the weighted colors and the revealage of all fragments in a single unordered pass
+			std::array<VkClearValue, 2> accumulationClearValues;
+			accumulationClearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+			accumulationClearValues[1].color = { { 1.0f, 0.0f, 0.0f, 0.0f } };
+
+			gpuProfiler.cmdBeginScope(commandBuffer, profilerFrame, modeName + " geometry");
+			renderPassBeginInfo.renderPass = geometryPass.accumulation->renderPass;
+			renderPassBeginInfo.framebuffer = geometryPass.accumulation->framebuffer;
+			renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(accumulationClearValues.size());
+			renderPassBeginInfo.pClearValues = accumulationClearValues.data();
+
+			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.geometryWeightedBlended);
+			drawScene(commandBuffer);
+			vkCmdEndRenderPass(commandBuffer);
+			gpuProfiler.cmdEndScope(commandBuffer, profilerFrame, modeName + " geometry");
+
+			// Make sure the accumulation targets are written before the resolve pass samples them
+			memoryBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			break;
+		}
+		case FixedK:
+		{
+			// Mark all k-buffer depth slots as empty
+			vkCmdFillBuffer(commandBuffer, geometryPass.kBuffer.buffer, 0, sizeof(uint32_t) * KBUFFER_LAYER_COUNT * width * height, 0xffffffff);
 
-			vkCmdEndRenderPass(drawCmdBuffers[i]);
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
 
-			// Make a pipeline barrier to guarantee the geometry pass is done
-			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+			// First pass: Find the depths of the k nearest fragments per pixel
+			gpuProfiler.cmdBeginScope(commandBuffer, profilerFrame, modeName + " depth");
+			renderPassBeginInfo.renderPass = geometryPass.renderPass;
+			renderPassBeginInfo.framebuffer = geometryPass.framebuffer;
+			renderPassBeginInfo.clearValueCount = 0;
+			renderPassBeginInfo.pClearValues = nullptr;
 
-			// We need a barrier to make sure all writes are finished before starting to write again
-			memoryBarrier = vks::initializers::memoryBarrier();
-			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.geometryKBufferDepth);
+			drawScene(commandBuffer);
+			vkCmdEndRenderPass(commandBuffer);
+			gpuProfiler.cmdEndScope(commandBuffer, profilerFrame, modeName + " depth");
+
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
 			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
-			vkCmdPipelineBarrier(drawCmdBuffers[i], VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+			// Second pass: Store the colors of the k nearest fragments, accumulate the tail behind them
+			std::array<VkClearValue, 2> accumulationClearValues;
+			accumulationClearValues[0].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+			accumulationClearValues[1].color = { { 1.0f, 0.0f, 0.0f, 0.0f } };
+
+			gpuProfiler.cmdBeginScope(commandBuffer, profilerFrame, modeName + " geometry");
+			renderPassBeginInfo.renderPass = geometryPass.accumulation->renderPass;
+			renderPassBeginInfo.framebuffer = geometryPass.accumulation->framebuffer;
+			renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(accumulationClearValues.size());
+			renderPassBeginInfo.pClearValues = accumulationClearValues.data();
+
+			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.geometryKBufferColor);
+			drawScene(commandBuffer);
+			vkCmdEndRenderPass(commandBuffer);
+			gpuProfiler.cmdEndScope(commandBuffer, profilerFrame, modeName + " geometry");
+
+			memoryBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+			break;
+		}
+		}
 
-			// Begin the color render pass
-			renderPassBeginInfo.renderPass = renderPass;
-			renderPassBeginInfo.framebuffer = frameBuffers[i];
-			renderPassBeginInfo.clearValueCount = 2;
-			renderPassBeginInfo.pClearValues = clearValues;
+		// Begin the color render pass
+		const VkPipeline resolvePipelines[] = { pipelines.color, pipelines.colorWeightedBlended, pipelines.colorKBuffer };
+
+		gpuProfiler.cmdBeginScope(commandBuffer, profilerFrame, modeName + " resolve");
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.framebuffer = framebuffer;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, resolvePipelines[mode]);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.color, 0, 1, &descriptorSets.color, 0, nullptr);
+		vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+		gpuProfiler.cmdEndScope(commandBuffer, profilerFrame, modeName + " resolve");
+		vkCmdEndRenderPass(commandBuffer);
+	}
 
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.color);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.color, 0, 1, &descriptorSets.color, 0, nullptr);
-			vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-			drawUI(drawCmdBuffers[i]);
-			vkCmdEndRenderPass(drawCmdBuffers[i]);
+	void buildCommandBuffers() override
+	{
+		if (resized)
+			return;
 
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+
+		for (uint32_t i = 0; i < drawCmdBuffers.size(); ++i)
+		{
+			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+			gpuProfiler.cmdBeginFrame(drawCmdBuffers[i], i);
+			recordCommandBuffer(drawCmdBuffers[i], frameBuffers[i], oitMode, i);
+			gpuProfiler.cmdEndFrame(drawCmdBuffers[i], i);
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
 
+	// Renders all modes offscreen and compares them to the linked list result, which is exact as long as no fragments are dropped
+	void measureModeErrors()
+	{
+		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+
+		// Color target that is compatible with the example's render pass and can be copied to the host
+		VkImage image;
+		VkDeviceMemory memory;
+		VkImageView view;
+		VkFramebuffer framebuffer;
+
+		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = swapChain.colorFormat;
+		imageCI.extent = { width, height, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &image));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, image, &memReqs);
+		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &memory));
+		VK_CHECK_RESULT(vkBindImageMemory(device, image, memory, 0));
+
+		VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
+		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewCI.format = swapChain.colorFormat;
+		viewCI.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		viewCI.image = image;
+		VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &view));
+
+		std::array<VkImageView, 2> attachments = { view, depthStencil.view };
+		VkFramebufferCreateInfo framebufferCI = vks::initializers::framebufferCreateInfo();
+		framebufferCI.renderPass = renderPass;
+		framebufferCI.attachmentCount = static_cast<uint32_t>(attachments.size());
+		framebufferCI.pAttachments = attachments.data();
+		framebufferCI.width = width;
+		framebufferCI.height = height;
+		framebufferCI.layers = 1;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferCI, nullptr, &framebuffer));
+
+		// Swapchain color formats use four 8 bit components
+		vks::Buffer imageData;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&imageData,
+			width * height * 4));
+		VK_CHECK_RESULT(imageData.map());
+
+		std::array<std::vector<uint8_t>, 3> images;
+		for (int32_t mode = 0; mode < static_cast<int32_t>(images.size()); mode++)
+		{
+			bool complete = false;
+			while (!complete)
+			{
+				VkCommandBuffer commandBuffer = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+				recordCommandBuffer(commandBuffer, framebuffer, mode, UINT32_MAX);
+				// The example's render pass leaves the color attachment in present layout
+				vks::tools::setImageLayout(commandBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+				VkBufferImageCopy copyRegion = {};
+				copyRegion.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+				copyRegion.imageExtent = { width, height, 1 };
+				vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, imageData.buffer, 1, &copyRegion);
+				vulkanDevice->flushCommandBuffer(commandBuffer, queue, true);
+				// The reference must contain all fragments, render it again if the node buffer was too small
+				complete = (mode != LinkedList) || !updateLinkedListSize();
+			}
+			const uint8_t* data = static_cast<uint8_t*>(imageData.mapped);
+			images[mode].assign(data, data + width * height * 4);
+		}
+
+		for (int32_t mode = 0; mode < static_cast<int32_t>(images.size()); mode++)
+		{
+			double sum = 0.0;
+			for (size_t i = 0; i < images[mode].size(); i++)
+			{
+				// Skip alpha
+				if ((i % 4) == 3) {
+					continue;
+				}
+				const double diff = (static_cast<double>(images[mode][i]) - static_cast<double>(images[LinkedList][i])) / 255.0;
+				sum += diff * diff;
+			}
+			modeErrors[mode] = static_cast<float>(sqrt(sum / (width * height * 3.0)));
+		}
+
+		imageData.destroy();
+		vkDestroyFramebuffer(device, framebuffer, nullptr);
+		vkDestroyImageView(device, view, nullptr);
+		vkDestroyImage(device, image, nullptr);
+		vkFreeMemory(device, memory, nullptr);
+	}
+
+	// Memory used by the per-pixel data of a mode in bytes
+	VkDeviceSize getModeMemorySize(int32_t mode)
+	{
+		// RGBA16F accumulation and R16F revealage targets
+		const VkDeviceSize accumulationSize = (VkDeviceSize)width * height * (8 + 2);
+		switch (mode)
+		{
+		case LinkedList:
+			return (VkDeviceSize)width * height * sizeof(uint32_t) + geometryPass.linkedList.size;
+		case WeightedBlended:
+			return accumulationSize;
+		case FixedK:
+			return geometryPass.kBuffer.size + accumulationSize;
+		}
+		return 0;
+	}
+
+	// Sum of the averaged GPU times of all profiler scopes of a mode
+	double getModeGpuTime(int32_t mode)
+	{
+		double time = 0.0;
+		for (auto &scope : gpuProfiler.getScopes()) {
+			if (scope.name.compare(0, oitModeNames[mode].size(), oitModeNames[mode]) == 0) {
+				time += scope.average;
+			}
+		}
+		return time;
+	}
+
 	void updateUniformBuffers()
 	{
 		renderPassUBO.projection = camera.matrices.perspective;
 		renderPassUBO.view = camera.matrices.view;
+		renderPassUBO.screen = glm::uvec4(width, height, 0, 0);
 		memcpy(uniformBuffers.renderPass.mapped, &renderPassUBO, sizeof(renderPassUBO));
 	}
 
@@ -655,6 +1082,40 @@ private:
 		geometryPass.geometry.destroy();
 		geometryPass.headIndex.destroy();
 		geometryPass.linkedList.destroy();
+		geometryPass.readback.destroy();
+		geometryPass.kBuffer.destroy();
+		delete geometryPass.accumulation;
+	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			overlay->comboBox("Mode", &oitMode, oitModeNames);
+			if (oitMode == LinkedList) {
+				overlay->text("Fragments: %u (nodes: %u)", fragmentCount, geometrySBO.maxNodeCount);
+				overlay->text("Dropped fragments: %u", droppedFragmentCount);
+			}
+			if (overlay->button("Measure error")) {
+				measureErrors = true;
+			}
+		}
+		if (overlay->header("Comparison")) {
+			for (int32_t mode = 0; mode < static_cast<int32_t>(oitModeNames.size()); mode++) {
+				overlay->text("%s:", oitModeNames[mode].c_str());
+				overlay->text("  Memory: %.1f MB", getModeMemorySize(mode) / (1024.0 * 1024.0));
+				const double gpuTime = getModeGpuTime(mode);
+				if (gpuTime > 0.0) {
+					overlay->text("  GPU: %.3f ms", gpuTime);
+				} else {
+					overlay->text("  GPU: not measured");
+				}
+				if (modeErrors[mode] >= 0.0f) {
+					overlay->text("  Error (RMSE): %.4f", modeErrors[mode]);
+				} else {
+					overlay->text("  Error (RMSE): not measured");
+				}
+			}
+		}
 	}
 
 private:
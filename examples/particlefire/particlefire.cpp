@@ -8,6 +8,7 @@
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "threadpool.hpp"
 
 #define ENABLE_VALIDATION false
 #define PARTICLE_COUNT 512
@@ -18,6 +19,12 @@
 #define PARTICLE_TYPE_FLAME 0
 #define PARTICLE_TYPE_SMOKE 1
 
+// Number of particles processed by a single job of the thread pool
+#define PARTICLE_CHUNK_SIZE 8192
+#define RADIX_BITS 8
+#define RADIX_SIZE (1 << RADIX_BITS)
+
+// Vertex layout of a particle as read by the particle shaders
 struct Particle {
 	glm::vec4 pos;
 	glm::vec4 color;
@@ -25,9 +32,28 @@ struct Particle {
 	float size;
 	float rotation;
 	uint32_t type;
-	// Attributes not used in shader
-	glm::vec4 vel;
-	float rotationSpeed;
+};
+
+// Particle state of a single emitter stored as a structure of arrays
+// Each attribute is a separate tightly packed array, so the integration loop is free of type branches and gets vectorized by the compiler
+struct ParticleEmitter {
+	glm::vec3 position;
+	uint32_t count = 0;
+	std::vector<float> posX, posY, posZ;
+	std::vector<float> velX, velY, velZ;
+	std::vector<float> alpha, size, color, rotation, rotationSpeed;
+	// Rates depend on the particle type and are set on (re)spawn instead of being selected during integration
+	std::vector<float> velocityScale, alphaRate, sizeRate, colorRate;
+	std::vector<uint32_t> type;
+
+	void resize(uint32_t particleCount)
+	{
+		count = particleCount;
+		for (auto attribute : { &posX, &posY, &posZ, &velX, &velY, &velZ, &alpha, &size, &color, &rotation, &rotationSpeed, &velocityScale, &alphaRate, &sizeRate, &colorRate }) {
+			attribute->resize(count);
+		}
+		type.resize(count);
+	}
 };
 
 class VulkanExample : public VulkanExampleBase
@@ -52,14 +78,34 @@ public:
 	glm::vec3 minVel = glm::vec3(-3.0f, 0.5f, -3.0f);
 	glm::vec3 maxVel = glm::vec3(3.0f, 7.0f, 3.0f);
 
+	// Host visible vertex buffer, the particle update writes the (sorted) particles directly into its mapped memory
+	vks::Buffer particleBuffer;
+
+	ParticleEmitter emitter;
+	int32_t particleCountIndex = 0;
+	std::vector<uint32_t> particleCounts = { PARTICLE_COUNT, 16384, 65536, 262144, 524288 };
+	std::vector<std::string> particleCountNames;
+
+	// Sort particles back to front by view depth for correct blending
+	bool sortParticles = true;
 	struct {
-		VkBuffer buffer;
-		VkDeviceMemory memory;
-		// Store the mapped address of the particle data for reuse
-		void *mappedMemory;
-		// Size of the particle buffer in bytes
-		size_t size;
-	} particles;
+		std::vector<uint32_t> keys[2];
+		std::vector<uint32_t> indices[2];
+		// One digit histogram per chunk, turned into scatter offsets by the prefix sum
+		std::vector<std::array<uint32_t, RADIX_SIZE>> histograms;
+		// Index into keys/indices holding the sorted result
+		uint32_t result = 0;
+	} sortData;
+
+	vks::ThreadPool threadPool;
+	// Random engines are kept per chunk (not per thread) so results don't depend on the job distribution
+	std::vector<std::default_random_engine> chunkRndEngines;
+
+	struct {
+		double update = 0.0;
+		double sort = 0.0;
+		double write = 0.0;
+	} cpuTimings;
 
 	struct {
 		vks::Buffer fire;
@@ -93,8 +139,6 @@ public:
 		VkDescriptorSet environment;
 	} descriptorSets;
 
-	std::vector<Particle> particleBuffer;
-
 	std::default_random_engine rndEngine;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
@@ -105,7 +149,11 @@ public:
 		camera.setRotation(glm::vec3(-15.0f, 45.0f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, 1.0f, 256.0f);
 		timerSpeed *= 8.0f;
-		rndEngine.seed(benchmark.active ? 0 : (unsigned)time(nullptr));
+		rndEngine.seed(benchmark.active ? benchmark.seed : (unsigned)time(nullptr));
+		threadPool.setThreadCount(std::max(1u, std::thread::hardware_concurrency()));
+		for (auto count : particleCounts) {
+			particleCountNames.push_back(std::to_string(count));
+		}
 	}
 
 	~VulkanExample()
@@ -124,9 +172,7 @@ public:
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
-		vkUnmapMemory(device, particles.memory);
-		vkDestroyBuffer(device, particles.buffer, nullptr);
-		vkFreeMemory(device, particles.memory, nullptr);
+		particleBuffer.destroy();
 
 		uniformBuffers.environment.destroy();
 		uniformBuffers.fire.destroy();
@@ -184,10 +230,8 @@ public:
 			// Particle system (no index buffer)
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets.particles, 0, nullptr);
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.particles);
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &particles.buffer, offsets);
-			vkCmdDraw(drawCmdBuffers[i], PARTICLE_COUNT, 1, 0, 0);
-
-			drawUI(drawCmdBuffers[i]);
+			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &particleBuffer.buffer, offsets);
+			vkCmdDraw(drawCmdBuffers[i], emitter.count, 1, 0, 0);
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
@@ -195,114 +239,287 @@ public:
 		}
 	}
 
-	float rnd(float range)
+	float rnd(std::default_random_engine& engine, float range)
 	{
 		std::uniform_real_distribution<float> rndDist(0.0f, range);
-		return rndDist(rndEngine);
+		return rndDist(engine);
+	}
+
+	float rnd(float range)
+	{
+		return rnd(rndEngine, range);
 	}
 
-	void initParticle(Particle *particle, glm::vec3 emitterPos)
+	void initParticle(uint32_t index, std::default_random_engine& engine)
 	{
-		particle->vel = glm::vec4(0.0f, minVel.y + rnd(maxVel.y - minVel.y), 0.0f, 0.0f);
-		particle->alpha = rnd(0.75f);
-		particle->size = 1.0f + rnd(0.5f);
-		particle->color = glm::vec4(1.0f);
-		particle->type = PARTICLE_TYPE_FLAME;
-		particle->rotation = rnd(2.0f * float(M_PI));
-		particle->rotationSpeed = rnd(2.0f) - rnd(2.0f);
+		const float timeScale = 0.45f;
+		emitter.velX[index] = 0.0f;
+		emitter.velY[index] = minVel.y + rnd(engine, maxVel.y - minVel.y);
+		emitter.velZ[index] = 0.0f;
+		emitter.alpha[index] = rnd(engine, 0.75f);
+		emitter.size[index] = 1.0f + rnd(engine, 0.5f);
+		emitter.color[index] = 1.0f;
+		emitter.type[index] = PARTICLE_TYPE_FLAME;
+		emitter.rotation[index] = rnd(engine, 2.0f * float(M_PI));
+		emitter.rotationSpeed[index] = rnd(engine, 2.0f) - rnd(engine, 2.0f);
+		// Flames rise fast, fade in and shrink
+		emitter.velocityScale[index] = timeScale * 3.5f;
+		emitter.alphaRate[index] = timeScale * 2.5f;
+		emitter.sizeRate[index] = timeScale * -0.5f;
+		emitter.colorRate[index] = 0.0f;
 
 		// Get random sphere point
-		float theta = rnd(2.0f * float(M_PI));
-		float phi = rnd(float(M_PI)) - float(M_PI) / 2.0f;
-		float r = rnd(FLAME_RADIUS);
+		float theta = rnd(engine, 2.0f * float(M_PI));
+		float phi = rnd(engine, float(M_PI)) - float(M_PI) / 2.0f;
+		float r = rnd(engine, FLAME_RADIUS);
 
-		particle->pos.x = r * cos(theta) * cos(phi);
-		particle->pos.y = r * sin(phi);
-		particle->pos.z = r * sin(theta) * cos(phi);
-
-		particle->pos += glm::vec4(emitterPos, 0.0f);
+		emitter.posX[index] = emitter.position.x + r * cos(theta) * cos(phi);
+		emitter.posY[index] = emitter.position.y + r * sin(phi);
+		emitter.posZ[index] = emitter.position.z + r * sin(theta) * cos(phi);
 	}
 
-	void transitionParticle(Particle *particle)
+	void transitionParticle(uint32_t index, std::default_random_engine& engine)
 	{
-		switch (particle->type)
+		const float timeScale = 0.45f;
+		switch (emitter.type[index])
 		{
 		case PARTICLE_TYPE_FLAME:
 			// Flame particles have a chance of turning into smoke
-			if (rnd(1.0f) < 0.05f)
+			if (rnd(engine, 1.0f) < 0.05f)
 			{
-				particle->alpha = 0.0f;
-				particle->color = glm::vec4(0.25f + rnd(0.25f));
-				particle->pos.x *= 0.5f;
-				particle->pos.z *= 0.5f;
-				particle->vel = glm::vec4(rnd(1.0f) - rnd(1.0f), (minVel.y * 2) + rnd(maxVel.y - minVel.y), rnd(1.0f) - rnd(1.0f), 0.0f);
-				particle->size = 1.0f + rnd(0.5f);
-				particle->rotationSpeed = rnd(1.0f) - rnd(1.0f);
-				particle->type = PARTICLE_TYPE_SMOKE;
+				emitter.alpha[index] = 0.0f;
+				emitter.color[index] = 0.25f + rnd(engine, 0.25f);
+				emitter.posX[index] *= 0.5f;
+				emitter.posZ[index] *= 0.5f;
+				emitter.velX[index] = rnd(engine, 1.0f) - rnd(engine, 1.0f);
+				emitter.velY[index] = (minVel.y * 2) + rnd(engine, maxVel.y - minVel.y);
+				emitter.velZ[index] = rnd(engine, 1.0f) - rnd(engine, 1.0f);
+				emitter.size[index] = 1.0f + rnd(engine, 0.5f);
+				emitter.rotationSpeed[index] = rnd(engine, 1.0f) - rnd(engine, 1.0f);
+				emitter.type[index] = PARTICLE_TYPE_SMOKE;
+				// Smoke drifts slowly, grows and darkens
+				emitter.velocityScale[index] = 1.0f;
+				emitter.alphaRate[index] = timeScale * 1.25f;
+				emitter.sizeRate[index] = timeScale * 0.125f;
+				emitter.colorRate[index] = timeScale * 0.05f;
 			}
 			else
 			{
-				initParticle(particle, emitterPos);
+				initParticle(index, engine);
 			}
 			break;
 		case PARTICLE_TYPE_SMOKE:
 			// Respawn at end of life
-			initParticle(particle, emitterPos);
+			initParticle(index, engine);
 			break;
 		}
 	}
 
 	void prepareParticles()
 	{
-		particleBuffer.resize(PARTICLE_COUNT);
-		for (auto& particle : particleBuffer)
+		const uint32_t particleCount = particleCounts[particleCountIndex];
+		emitter.position = emitterPos;
+		emitter.resize(particleCount);
+		for (uint32_t i = 0; i < particleCount; i++)
 		{
-			initParticle(&particle, emitterPos);
-			particle.alpha = 1.0f - (abs(particle.pos.y) / (FLAME_RADIUS * 2.0f));
+			initParticle(i, rndEngine);
+			emitter.alpha[i] = 1.0f - (abs(emitter.posY[i] - emitterPos.y) / (FLAME_RADIUS * 2.0f));
 		}
 
-		particles.size = particleBuffer.size() * sizeof(Particle);
+		const uint32_t chunkCount = (particleCount + PARTICLE_CHUNK_SIZE - 1) / PARTICLE_CHUNK_SIZE;
+		chunkRndEngines.resize(chunkCount);
+		for (auto& engine : chunkRndEngines) {
+			engine.seed(static_cast<unsigned>(rndEngine()));
+		}
+		for (uint32_t i = 0; i < 2; i++) {
+			sortData.keys[i].resize(particleCount);
+			sortData.indices[i].resize(particleCount);
+		}
+		sortData.histograms.resize(chunkCount);
 
+		if (particleBuffer.buffer != VK_NULL_HANDLE) {
+			particleBuffer.destroy();
+		}
 		VK_CHECK_RESULT(vulkanDevice->createBuffer(
 			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			particles.size,
-			&particles.buffer,
-			&particles.memory,
-			particleBuffer.data()));
-
+			&particleBuffer,
+			particleCount * sizeof(Particle)));
 		// Map the memory and store the pointer for reuse
-		VK_CHECK_RESULT(vkMapMemory(device, particles.memory, 0, particles.size, 0, &particles.mappedMemory));
+		VK_CHECK_RESULT(particleBuffer.map());
+		writeParticles(false);
 	}
 
-	void updateParticles()
+	// Runs job(chunk) for all particle chunks on the thread pool and waits for them to finish
+	void forEachChunk(const std::function<void(uint32_t, uint32_t, uint32_t)>& job)
 	{
-		float particleTimer = frameTimer * 0.45f;
-		for (auto& particle : particleBuffer)
-		{
-			switch (particle.type)
-			{
-			case PARTICLE_TYPE_FLAME:
-				particle.pos.y -= particle.vel.y * particleTimer * 3.5f;
-				particle.alpha += particleTimer * 2.5f;
-				particle.size -= particleTimer * 0.5f;
-				break;
-			case PARTICLE_TYPE_SMOKE:
-				particle.pos -= particle.vel * frameTimer * 1.0f;
-				particle.alpha += particleTimer * 1.25f;
-				particle.size += particleTimer * 0.125f;
-				particle.color -= particleTimer * 0.05f;
-				break;
+		const uint32_t chunkCount = static_cast<uint32_t>(sortData.histograms.size());
+		for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+			const uint32_t begin = chunk * PARTICLE_CHUNK_SIZE;
+			const uint32_t end = std::min(begin + PARTICLE_CHUNK_SIZE, emitter.count);
+			threadPool.threads[chunk % threadPool.threads.size()]->addJob([=, &job] { job(chunk, begin, end); });
+		}
+		threadPool.wait();
+	}
+
+	// Maps a float to an unsigned integer with the same ordering
+	static uint32_t floatToSortKey(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(float));
+		return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+	}
+
+	void integrateParticles(uint32_t chunk, uint32_t begin, uint32_t end, float dt, const glm::mat4& view)
+	{
+		float* posX = emitter.posX.data();
+		float* posY = emitter.posY.data();
+		float* posZ = emitter.posZ.data();
+		const float* velX = emitter.velX.data();
+		const float* velY = emitter.velY.data();
+		const float* velZ = emitter.velZ.data();
+		const float* velocityScale = emitter.velocityScale.data();
+		float* alpha = emitter.alpha.data();
+		const float* alphaRate = emitter.alphaRate.data();
+		float* size = emitter.size.data();
+		const float* sizeRate = emitter.sizeRate.data();
+		float* color = emitter.color.data();
+		const float* colorRate = emitter.colorRate.data();
+		float* rotation = emitter.rotation.data();
+		const float* rotationSpeed = emitter.rotationSpeed.data();
+		const float rotationDt = dt * 0.45f;
+
+		// Branch free, so the compiler can turn this into SIMD code
+		for (uint32_t i = begin; i < end; i++) {
+			const float step = velocityScale[i] * dt;
+			posX[i] -= velX[i] * step;
+			posY[i] -= velY[i] * step;
+			posZ[i] -= velZ[i] * step;
+			alpha[i] += alphaRate[i] * dt;
+			size[i] += sizeRate[i] * dt;
+			color[i] -= colorRate[i] * dt;
+			rotation[i] += rotationSpeed[i] * rotationDt;
+		}
+
+		// Transition particle state
+		for (uint32_t i = begin; i < end; i++) {
+			if (alpha[i] > 2.0f) {
+				transitionParticle(i, chunkRndEngines[chunk]);
 			}
-			particle.rotation += particleTimer * particle.rotationSpeed;
-			// Transition particle state
-			if (particle.alpha > 2.0f)
-			{
-				transitionParticle(&particle);
+		}
+
+		// View space depth as sort key, the camera looks down negative z so ascending keys are back to front
+		if (sortParticles) {
+			uint32_t* keys = sortData.keys[0].data();
+			uint32_t* indices = sortData.indices[0].data();
+			for (uint32_t i = begin; i < end; i++) {
+				const float depth = view[0][2] * posX[i] + view[1][2] * posY[i] + view[2][2] * posZ[i] + view[3][2];
+				keys[i] = floatToSortKey(depth);
+				indices[i] = i;
+			}
+		}
+	}
+
+	// Parallel least significant digit radix sort of the depth keys
+	// Each chunk builds a digit histogram, a serial prefix sum over all chunks turns these into stable scatter offsets
+	void sortParticlesByDepth()
+	{
+		uint32_t src = 0;
+		for (uint32_t shift = 0; shift < 32; shift += RADIX_BITS) {
+			const uint32_t* keysIn = sortData.keys[src].data();
+			forEachChunk([&](uint32_t chunk, uint32_t begin, uint32_t end) {
+				auto& histogram = sortData.histograms[chunk];
+				histogram.fill(0);
+				for (uint32_t i = begin; i < end; i++) {
+					histogram[(keysIn[i] >> shift) & (RADIX_SIZE - 1)]++;
+				}
+			});
+
+			// Passes where all keys share the same digit don't change the order
+			bool skipPass = false;
+			for (uint32_t digit = 0; digit < RADIX_SIZE; digit++) {
+				uint32_t digitCount = 0;
+				for (auto& histogram : sortData.histograms) {
+					digitCount += histogram[digit];
+				}
+				if (digitCount == emitter.count) {
+					skipPass = true;
+					break;
+				}
+				if (digitCount > 0) {
+					break;
+				}
+			}
+			if (skipPass) {
+				continue;
+			}
+
+			uint32_t offset = 0;
+			for (uint32_t digit = 0; digit < RADIX_SIZE; digit++) {
+				for (auto& histogram : sortData.histograms) {
+					const uint32_t digitCount = histogram[digit];
+					histogram[digit] = offset;
+					offset += digitCount;
+				}
+			}
+
+			const uint32_t* indicesIn = sortData.indices[src].data();
+			uint32_t* keysOut = sortData.keys[1 - src].data();
+			uint32_t* indicesOut = sortData.indices[1 - src].data();
+			forEachChunk([&](uint32_t chunk, uint32_t begin, uint32_t end) {
+				auto& histogram = sortData.histograms[chunk];
+				for (uint32_t i = begin; i < end; i++) {
+					const uint32_t dst = histogram[(keysIn[i] >> shift) & (RADIX_SIZE - 1)]++;
+					keysOut[dst] = keysIn[i];
+					indicesOut[dst] = indicesIn[i];
+				}
+			});
+			src = 1 - src;
+		}
+		sortData.result = src;
+	}
+
+	// Write the particles from the emitter's arrays into the mapped vertex buffer, optionally in sorted order
+	void writeParticles(bool sorted)
+	{
+		Particle* vertices = static_cast<Particle*>(particleBuffer.mapped);
+		const uint32_t* order = sortData.indices[sortData.result].data();
+		auto writeRange = [=](uint32_t chunk, uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; i++) {
+				const uint32_t index = sorted ? order[i] : i;
+				Particle& vertex = vertices[i];
+				vertex.pos = glm::vec4(emitter.posX[index], emitter.posY[index], emitter.posZ[index], 1.0f);
+				vertex.color = glm::vec4(emitter.color[index]);
+				vertex.alpha = emitter.alpha[index];
+				vertex.size = emitter.size[index];
+				vertex.rotation = emitter.rotation[index];
+				vertex.type = emitter.type[index];
 			}
+		};
+		forEachChunk(writeRange);
+	}
+
+	void updateParticles()
+	{
+		VKS_PROFILE_FUNCTION();
+		const glm::mat4 view = camera.matrices.view;
+		const float dt = frameTimer;
+
+		auto tStart = std::chrono::high_resolution_clock::now();
+		forEachChunk([&](uint32_t chunk, uint32_t begin, uint32_t end) {
+			integrateParticles(chunk, begin, end, dt, view);
+		});
+		auto tUpdate = std::chrono::high_resolution_clock::now();
+		if (sortParticles) {
+			sortParticlesByDepth();
 		}
-		size_t size = particleBuffer.size() * sizeof(Particle);
-		memcpy(particles.mappedMemory, particleBuffer.data(), size);
+		auto tSort = std::chrono::high_resolution_clock::now();
+		writeParticles(sortParticles);
+		auto tEnd = std::chrono::high_resolution_clock::now();
+
+		cpuTimings.update = std::chrono::duration<double, std::milli>(tUpdate - tStart).count();
+		cpuTimings.sort = std::chrono::duration<double, std::milli>(tSort - tUpdate).count();
+		cpuTimings.write = std::chrono::duration<double, std::milli>(tEnd - tSort).count();
 	}
 
 	void loadAssets()
@@ -594,6 +811,24 @@ public:
 	{
 		updateUniformBuffers();
 	}
+
+	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
+	{
+		if (overlay->header("Settings")) {
+			if (overlay->comboBox("Particle count", &particleCountIndex, particleCountNames)) {
+				vkDeviceWaitIdle(device);
+				prepareParticles();
+				buildCommandBuffers();
+			}
+			overlay->checkBox("Depth sort", &sortParticles);
+		}
+		if (overlay->header("CPU timings")) {
+			overlay->text("Threads: %d", static_cast<int32_t>(threadPool.threads.size()));
+			overlay->text("Update: %.3f ms", cpuTimings.update);
+			overlay->text("Sort: %.3f ms", cpuTimings.sort);
+			overlay->text("Vertex write: %.3f ms", cpuTimings.write);
+		}
+	}
 };
 
 VULKAN_EXAMPLE_MAIN()
@@ -177,7 +177,6 @@ public:
 				}
 			}
 #endif
-			drawUI(drawCmdBuffers[i]);
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
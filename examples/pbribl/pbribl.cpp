@@ -10,8 +10,15 @@
 
 // For reference see http://blog.selfshadow.com/publications/s2013-shading-course/karis/s2013_pbs_epic_notes_v2.pdf
 
+#include <fstream>
+#include <iomanip>
+#include <sstream>
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include <ktx.h>
+#if defined(_WIN32)
+#include <direct.h>
+#endif
 
 #define ENABLE_VALIDATION false
 #define GRID_DIM 7
@@ -91,6 +98,34 @@ public:
 	std::vector<std::string> materialNames;
 	std::vector<std::string> objectNames;
 
+	// Parameters for the generated image based lighting maps, also part of the cache key
+	struct IBLSettings {
+		VkFormat lutFormat = VK_FORMAT_R16G16_SFLOAT;	// R16G16 is supported pretty much everywhere
+		uint32_t lutDim = 512;
+		VkFormat irradianceFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
+		uint32_t irradianceDim = 64;
+		float irradianceDeltaPhi = (2.0f * float(M_PI)) / 180.0f;
+		float irradianceDeltaTheta = (0.5f * float(M_PI)) / 64.0f;
+		VkFormat prefilteredFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+		uint32_t prefilteredDim = 512;
+		uint32_t prefilteredSamples = 32;
+	} iblSettings;
+
+	// The generated maps are stored as KTX files keyed by a hash of their inputs and loaded from there on later runs
+	struct IBLCache {
+#if defined(__ANDROID__)
+		// Assets are read from the apk, which can't be hashed or written to in place
+		bool enabled = false;
+#else
+		bool enabled = true;
+#endif
+		std::string directory = "cache/";
+		uint32_t hits = 0;
+		// Time for the last preparation of all three maps, negative if not measured yet
+		double generateTime = -1.0;
+		double loadTime = -1.0;
+	} iblCache;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "PBR with image based lighting";
@@ -124,6 +159,12 @@ public:
 		objectNames = { "Sphere", "Teapot", "Torusknot", "Venus" };
 
 		materialIndex = 9;
+
+		for (auto arg : args) {
+			if (strcmp(arg, "--noiblcache") == 0) {
+				iblCache.enabled = false;
+			}
+		}
 	}
 
 	~VulkanExample()
@@ -218,7 +259,6 @@ public:
 				}
 			}
 #endif
-			drawUI(drawCmdBuffers[i]);
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
@@ -356,13 +396,273 @@ public:
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.pbr));
 	}
 
+	// Sampler shared by all generated (or cached) image based lighting maps
+	VkSampler createIBLSampler(uint32_t mipLevels)
+	{
+		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
+		samplerCI.magFilter = VK_FILTER_LINEAR;
+		samplerCI.minFilter = VK_FILTER_LINEAR;
+		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerCI.minLod = 0.0f;
+		samplerCI.maxLod = static_cast<float>(mipLevels);
+		samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VkSampler sampler;
+		VK_CHECK_RESULT(vkCreateSampler(device, &samplerCI, nullptr, &sampler));
+		return sampler;
+	}
+
+	// FNV-1a hash used to build the cache keys
+	uint64_t hashData(const void* data, size_t size, uint64_t hash)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	uint64_t hashFile(const std::string& filename, uint64_t hash)
+	{
+		std::ifstream is(filename, std::ios::binary);
+		if (!is.is_open()) {
+			return hashData(filename.data(), filename.size(), hash);
+		}
+		std::vector<char> chunk(64 * 1024);
+		while (is) {
+			is.read(chunk.data(), chunk.size());
+			hash = hashData(chunk.data(), static_cast<size_t>(is.gcount()), hash);
+		}
+		return hash;
+	}
+
+	std::string getCacheFilename(const std::string& name, uint64_t key)
+	{
+		std::stringstream ss;
+		ss << iblCache.directory << "pbribl_" << name << "_" << std::hex << std::setw(16) << std::setfill('0') << key << ".ktx";
+		return ss.str();
+	}
+
+	// OpenGL internal formats matching the Vulkan formats used for the generated maps, as required by KTX 1
+	uint32_t getGLInternalFormat(VkFormat format)
+	{
+		switch (format) {
+		case VK_FORMAT_R16G16_SFLOAT:
+			return 0x822F;	// GL_RG16F
+		case VK_FORMAT_R16G16B16A16_SFLOAT:
+			return 0x881A;	// GL_RGBA16F
+		case VK_FORMAT_R32G32B32A32_SFLOAT:
+			return 0x8814;	// GL_RGBA32F
+		default:
+			return 0;
+		}
+	}
+
+	uint32_t getTexelSize(VkFormat format)
+	{
+		switch (format) {
+		case VK_FORMAT_R16G16_SFLOAT:
+			return 4;
+		case VK_FORMAT_R16G16B16A16_SFLOAT:
+			return 8;
+		case VK_FORMAT_R32G32B32A32_SFLOAT:
+			return 16;
+		default:
+			return 0;
+		}
+	}
+
+	// Read back all mip levels and faces of a generated map and store them as a KTX file
+	void writeToCache(vks::Texture& texture, VkFormat format, uint32_t dim, uint32_t mipLevels, uint32_t faceCount, const std::string& filename)
+	{
+		const uint32_t glInternalFormat = getGLInternalFormat(format);
+		const uint32_t texelSize = getTexelSize(format);
+		if (glInternalFormat == 0) {
+			std::cerr << "Format not supported by the IBL cache, skipping " << filename << std::endl;
+			return;
+		}
+
+		// Faces of a mip level are stored next to each other
+		std::vector<VkBufferImageCopy> regions(mipLevels);
+		VkDeviceSize size = 0;
+		for (uint32_t m = 0; m < mipLevels; m++) {
+			const uint32_t mipDim = std::max(dim >> m, 1u);
+			regions[m] = {};
+			regions[m].bufferOffset = size;
+			regions[m].imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, m, 0, faceCount };
+			regions[m].imageExtent = { mipDim, mipDim, 1 };
+			size += VkDeviceSize(mipDim) * mipDim * texelSize * faceCount;
+		}
+
+		vks::Buffer readback;
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &readback, size));
+
+		VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, faceCount };
+		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, subresourceRange);
+		vkCmdCopyImageToBuffer(copyCmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer, static_cast<uint32_t>(regions.size()), regions.data());
+		vks::tools::setImageLayout(copyCmd, texture.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+
+		ktxTextureCreateInfo createInfo = {};
+		createInfo.glInternalformat = glInternalFormat;
+		createInfo.baseWidth = dim;
+		createInfo.baseHeight = dim;
+		createInfo.baseDepth = 1;
+		createInfo.numDimensions = 2;
+		createInfo.numLevels = mipLevels;
+		createInfo.numLayers = 1;
+		createInfo.numFaces = faceCount;
+		createInfo.isArray = KTX_FALSE;
+		createInfo.generateMipmaps = KTX_FALSE;
+		ktxTexture* ktxTexture;
+		if (ktxTexture_Create(&createInfo, KTX_TEXTURE_CREATE_ALLOC_STORAGE, &ktxTexture) != KTX_SUCCESS) {
+			std::cerr << "Could not create KTX texture for " << filename << std::endl;
+			readback.destroy();
+			return;
+		}
+
+		VK_CHECK_RESULT(readback.map());
+		const uint8_t* data = static_cast<const uint8_t*>(readback.mapped);
+		for (uint32_t m = 0; m < mipLevels; m++) {
+			const uint32_t mipDim = std::max(dim >> m, 1u);
+			const size_t faceSize = size_t(mipDim) * mipDim * texelSize;
+			for (uint32_t f = 0; f < faceCount; f++) {
+				ktxTexture_SetImageFromMemory(ktxTexture, m, 0, f, data + regions[m].bufferOffset + f * faceSize, faceSize);
+			}
+		}
+		readback.destroy();
+
+#if defined(_WIN32)
+		_mkdir(iblCache.directory.c_str());
+#else
+		mkdir(iblCache.directory.c_str(), 0755);
+#endif
+		// Write to a temporary file first so an interrupted run never leaves a truncated cache entry behind
+		const std::string tempFilename = filename + ".tmp";
+		if (ktxTexture_WriteToNamedFile(ktxTexture, tempFilename.c_str()) == KTX_SUCCESS) {
+			std::remove(filename.c_str());
+			std::rename(tempFilename.c_str(), filename.c_str());
+		} else {
+			std::cerr << "Could not write IBL cache file " << filename << std::endl;
+		}
+		ktxTexture_Destroy(ktxTexture);
+	}
+
+	// Load the image based lighting maps from the cache if present, generate (and store) them otherwise
+	void prepareIBL(bool readCache)
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+
+		iblCache.hits = 0;
+		const bool useCache = iblCache.enabled;
+		std::string lutFile, irradianceFile, prefilteredFile;
+		if (useCache) {
+			const std::string shadersPath = getShadersPath() + "pbribl/";
+			const uint64_t fnvOffsetBasis = 14695981039346656037ull;
+			const uint64_t environmentHash = hashFile(getAssetPath() + "textures/hdr/pisa_cube.ktx", fnvOffsetBasis);
+			uint64_t key = hashData(&iblSettings.lutFormat, sizeof(VkFormat), fnvOffsetBasis);
+			key = hashData(&iblSettings.lutDim, sizeof(uint32_t), key);
+			key = hashFile(shadersPath + "genbrdflut.vert.spv", key);
+			key = hashFile(shadersPath + "genbrdflut.frag.spv", key);
+			lutFile = getCacheFilename("brdflut", key);
+			key = hashData(&iblSettings.irradianceFormat, sizeof(VkFormat), environmentHash);
+			key = hashData(&iblSettings.irradianceDim, sizeof(uint32_t), key);
+			key = hashData(&iblSettings.irradianceDeltaPhi, sizeof(float), key);
+			key = hashData(&iblSettings.irradianceDeltaTheta, sizeof(float), key);
+			key = hashFile(shadersPath + "filtercube.vert.spv", key);
+			key = hashFile(shadersPath + "irradiancecube.frag.spv", key);
+			irradianceFile = getCacheFilename("irradiance", key);
+			key = hashData(&iblSettings.prefilteredFormat, sizeof(VkFormat), environmentHash);
+			key = hashData(&iblSettings.prefilteredDim, sizeof(uint32_t), key);
+			key = hashData(&iblSettings.prefilteredSamples, sizeof(uint32_t), key);
+			key = hashFile(shadersPath + "filtercube.vert.spv", key);
+			key = hashFile(shadersPath + "prefilterenvmap.frag.spv", key);
+			prefilteredFile = getCacheFilename("prefiltered", key);
+		}
+
+		// BRDF look-up table
+		if (useCache && readCache && vks::tools::fileExists(lutFile)) {
+			textures.lutBrdf.loadFromFile(lutFile, iblSettings.lutFormat, vulkanDevice, queue);
+			// The default texture sampler repeats, the look-up table needs to be clamped
+			vkDestroySampler(device, textures.lutBrdf.sampler, nullptr);
+			textures.lutBrdf.sampler = createIBLSampler(1);
+			textures.lutBrdf.updateDescriptor();
+			iblCache.hits++;
+		} else {
+			generateBRDFLUT();
+			if (useCache) {
+				writeToCache(textures.lutBrdf, iblSettings.lutFormat, iblSettings.lutDim, 1, 1, lutFile);
+			}
+		}
+
+		// Irradiance cube map
+		const uint32_t irradianceMips = static_cast<uint32_t>(floor(log2(iblSettings.irradianceDim))) + 1;
+		if (useCache && readCache && vks::tools::fileExists(irradianceFile)) {
+			textures.irradianceCube.loadFromFile(irradianceFile, iblSettings.irradianceFormat, vulkanDevice, queue);
+			vkDestroySampler(device, textures.irradianceCube.sampler, nullptr);
+			textures.irradianceCube.sampler = createIBLSampler(irradianceMips);
+			textures.irradianceCube.updateDescriptor();
+			iblCache.hits++;
+		} else {
+			generateIrradianceCube();
+			if (useCache) {
+				writeToCache(textures.irradianceCube, iblSettings.irradianceFormat, iblSettings.irradianceDim, irradianceMips, 6, irradianceFile);
+			}
+		}
+
+		// Pre-filtered environment cube map
+		const uint32_t prefilteredMips = static_cast<uint32_t>(floor(log2(iblSettings.prefilteredDim))) + 1;
+		if (useCache && readCache && vks::tools::fileExists(prefilteredFile)) {
+			textures.prefilteredCube.loadFromFile(prefilteredFile, iblSettings.prefilteredFormat, vulkanDevice, queue);
+			vkDestroySampler(device, textures.prefilteredCube.sampler, nullptr);
+			textures.prefilteredCube.sampler = createIBLSampler(prefilteredMips);
+			textures.prefilteredCube.updateDescriptor();
+			iblCache.hits++;
+		} else {
+			generatePrefilteredCube();
+			if (useCache) {
+				writeToCache(textures.prefilteredCube, iblSettings.prefilteredFormat, iblSettings.prefilteredDim, prefilteredMips, 6, prefilteredFile);
+			}
+		}
+
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+		if (iblCache.hits == 3) {
+			iblCache.loadTime = tDiff;
+		} else {
+			iblCache.generateTime = tDiff;
+		}
+		std::cout << "Preparing IBL maps took " << tDiff << " ms (" << iblCache.hits << " of 3 loaded from cache)" << std::endl;
+	}
+
+	// Regenerate the maps bypassing the cache (which gets refreshed), e.g. to compare against the cached startup time
+	void regenerateIBL()
+	{
+		vkDeviceWaitIdle(device);
+		textures.lutBrdf.destroy();
+		textures.irradianceCube.destroy();
+		textures.prefilteredCube.destroy();
+		prepareIBL(false);
+		std::vector<VkWriteDescriptorSet> writeDescriptorSets = {
+			vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &textures.irradianceCube.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, &textures.lutBrdf.descriptor),
+			vks::initializers::writeDescriptorSet(descriptorSets.object, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, &textures.prefilteredCube.descriptor),
+		};
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		buildCommandBuffers();
+	}
+
 	// Generate a BRDF integration map used as a look-up-table (stores roughness / NdotV)
 	void generateBRDFLUT()
 	{
 		auto tStart = std::chrono::high_resolution_clock::now();
 
-		const VkFormat format = VK_FORMAT_R16G16_SFLOAT;	// R16G16 is supported pretty much everywhere
-		const int32_t dim = 512;
+		const VkFormat format = iblSettings.lutFormat;
+		const int32_t dim = iblSettings.lutDim;
 
 		// Image
 		VkImageCreateInfo imageCI = vks::initializers::imageCreateInfo();
@@ -375,7 +675,8 @@ public:
 		imageCI.arrayLayers = 1;
 		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		// Transfer source is required for writing the result to the cache
+		imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &textures.lutBrdf.image));
 		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
 		VkMemoryRequirements memReqs;
@@ -395,17 +696,7 @@ public:
 		viewCI.image = textures.lutBrdf.image;
 		VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &textures.lutBrdf.view));
 		// Sampler
-		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
-		samplerCI.magFilter = VK_FILTER_LINEAR;
-		samplerCI.minFilter = VK_FILTER_LINEAR;
-		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-		samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-		samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-		samplerCI.minLod = 0.0f;
-		samplerCI.maxLod = 1.0f;
-		samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(device, &samplerCI, nullptr, &textures.lutBrdf.sampler));
+		textures.lutBrdf.sampler = createIBLSampler(1);
 
 		textures.lutBrdf.descriptor.imageView = textures.lutBrdf.view;
 		textures.lutBrdf.descriptor.sampler = textures.lutBrdf.sampler;
@@ -566,8 +857,8 @@ public:
 	{
 		auto tStart = std::chrono::high_resolution_clock::now();
 
-		const VkFormat format = VK_FORMAT_R32G32B32A32_SFLOAT;
-		const int32_t dim = 64;
+		const VkFormat format = iblSettings.irradianceFormat;
+		const int32_t dim = iblSettings.irradianceDim;
 		const uint32_t numMips = static_cast<uint32_t>(floor(log2(dim))) + 1;
 
 		// Pre-filtered cube map
@@ -582,7 +873,7 @@ public:
 		imageCI.arrayLayers = 6;
 		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 		imageCI.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
 		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &textures.irradianceCube.image));
 		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
@@ -603,17 +894,7 @@ public:
 		viewCI.image = textures.irradianceCube.image;
 		VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &textures.irradianceCube.view));
 		// Sampler
-		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
-		samplerCI.magFilter = VK_FILTER_LINEAR;
-		samplerCI.minFilter = VK_FILTER_LINEAR;
-		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-		samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-		samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-		samplerCI.minLod = 0.0f;
-		samplerCI.maxLod = static_cast<float>(numMips);
-		samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(device, &samplerCI, nullptr, &textures.irradianceCube.sampler));
+		textures.irradianceCube.sampler = createIBLSampler(numMips);
 
 		textures.irradianceCube.descriptor.imageView = textures.irradianceCube.view;
 		textures.irradianceCube.descriptor.sampler = textures.irradianceCube.sampler;
@@ -756,9 +1037,11 @@ public:
 		struct PushBlock {
 			glm::mat4 mvp;
 			// Sampling deltas
-			float deltaPhi = (2.0f * float(M_PI)) / 180.0f;
-			float deltaTheta = (0.5f * float(M_PI)) / 64.0f;
+			float deltaPhi;
+			float deltaTheta;
 		} pushBlock;
+		pushBlock.deltaPhi = iblSettings.irradianceDeltaPhi;
+		pushBlock.deltaTheta = iblSettings.irradianceDeltaTheta;
 
 		VkPipelineLayout pipelinelayout;
 		std::vector<VkPushConstantRange> pushConstantRanges = {
@@ -946,8 +1229,8 @@ public:
 	{
 		auto tStart = std::chrono::high_resolution_clock::now();
 
-		const VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT;
-		const int32_t dim = 512;
+		const VkFormat format = iblSettings.prefilteredFormat;
+		const int32_t dim = iblSettings.prefilteredDim;
 		const uint32_t numMips = static_cast<uint32_t>(floor(log2(dim))) + 1;
 
 		// Pre-filtered cube map
@@ -962,7 +1245,7 @@ public:
 		imageCI.arrayLayers = 6;
 		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 		imageCI.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
 		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &textures.prefilteredCube.image));
 		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
@@ -983,17 +1266,7 @@ public:
 		viewCI.image = textures.prefilteredCube.image;
 		VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &textures.prefilteredCube.view));
 		// Sampler
-		VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
-		samplerCI.magFilter = VK_FILTER_LINEAR;
-		samplerCI.minFilter = VK_FILTER_LINEAR;
-		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-		samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-		samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-		samplerCI.minLod = 0.0f;
-		samplerCI.maxLod = static_cast<float>(numMips);
-		samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(device, &samplerCI, nullptr, &textures.prefilteredCube.sampler));
+		textures.prefilteredCube.sampler = createIBLSampler(numMips);
 
 		textures.prefilteredCube.descriptor.imageView = textures.prefilteredCube.view;
 		textures.prefilteredCube.descriptor.sampler = textures.prefilteredCube.sampler;
@@ -1136,8 +1409,9 @@ public:
 		struct PushBlock {
 			glm::mat4 mvp;
 			float roughness;
-			uint32_t numSamples = 32u;
+			uint32_t numSamples;
 		} pushBlock;
+		pushBlock.numSamples = iblSettings.prefilteredSamples;
 
 		VkPipelineLayout pipelinelayout;
 		std::vector<VkPushConstantRange> pushConstantRanges = {
@@ -1393,9 +1667,7 @@ public:
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
-		generateBRDFLUT();
-		generateIrradianceCube();
-		generatePrefilteredCube();
+		prepareIBL(true);
 		prepareUniformBuffers();
 		setupDescriptors();
 		preparePipelines();
@@ -1435,6 +1707,22 @@ public:
 				buildCommandBuffers();
 			}
 		}
+		if (overlay->header("IBL maps")) {
+			if (iblCache.enabled) {
+				overlay->text("Loaded from cache: %d of 3", iblCache.hits);
+			} else {
+				overlay->text("Cache disabled (--noiblcache)");
+			}
+			if (iblCache.generateTime >= 0.0) {
+				overlay->text("Generated: %.2f ms", iblCache.generateTime);
+			}
+			if (iblCache.loadTime >= 0.0) {
+				overlay->text("From cache: %.2f ms", iblCache.loadTime);
+			}
+			if (overlay->button("Regenerate")) {
+				regenerateIBL();
+			}
+		}
 	}
 
 };
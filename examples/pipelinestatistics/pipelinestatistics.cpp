@@ -43,7 +43,9 @@ public:
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
-	VkQueryPool queryPool;
+	// Ring-buffered pipeline statistics query, results are read back without stalling
+	vks::QueryManager queryManager;
+	uint32_t statisticsQuery;
 
 	// Vector for storing pipeline statistics results
 	std::vector<uint64_t> pipelineStats;
@@ -67,7 +69,7 @@ public:
 		vkDestroyPipeline(device, pipeline, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
-		vkDestroyQueryPool(device, queryPool, nullptr);
+		queryManager.destroy();
 		uniformBuffers.VS.destroy();
 	}
 
@@ -105,12 +107,8 @@ public:
 		}
 		pipelineStats.resize(pipelineStatNames.size());
 
-		VkQueryPoolCreateInfo queryPoolInfo = {};
-		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
-		// This query pool will store pipeline statistics
-		queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
-		// Pipeline counters to be returned for this pool
-		queryPoolInfo.pipelineStatistics =
+		// Pipeline counters to be returned for this query
+		VkQueryPipelineStatisticFlags pipelineStatistics =
 			VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
 			VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
 			VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
@@ -118,27 +116,15 @@ public:
 			VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
 			VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
 		if (deviceFeatures.tessellationShader) {
-			queryPoolInfo.pipelineStatistics |=
+			pipelineStatistics |=
 				VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_CONTROL_SHADER_PATCHES_BIT |
 				VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_EVALUATION_SHADER_INVOCATIONS_BIT;
 		}
-		queryPoolInfo.queryCount = deviceFeatures.tessellationShader ? 8 : 6;
-		VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, NULL, &queryPool));
-	}
-
-	// Retrieves the results of the pipeline statistics query submitted to the command buffer
-	void getQueryResults()
-	{
-		uint32_t count = static_cast<uint32_t>(pipelineStats.size());
-		vkGetQueryPoolResults(
-			device,
-			queryPool,
-			0,
-			1,
-			count * sizeof(uint64_t),
-			pipelineStats.data(),
-			sizeof(uint64_t),
-			VK_QUERY_RESULT_64_BIT);
+		// A single pipeline statistics query with one ring slot per command buffer
+		queryManager.prepare(vulkanDevice, static_cast<uint32_t>(drawCmdBuffers.size()));
+		statisticsQuery = queryManager.addQuerySet(VK_QUERY_TYPE_PIPELINE_STATISTICS, 1, [this](const std::vector<uint64_t> &results, uint32_t frameIndex, uint32_t latency) {
+			pipelineStats = results;
+		}, pipelineStatistics);
 	}
 
 	void buildCommandBuffers()
@@ -163,8 +149,8 @@ public:
 
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
-			// Reset timestamp query pool
-			vkCmdResetQueryPool(drawCmdBuffers[i], queryPool, 0, static_cast<uint32_t>(pipelineStats.size()));
+			// Reset this command buffer's queries
+			queryManager.cmdReset(drawCmdBuffers[i], i);
 
 			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
@@ -177,7 +163,7 @@ public:
 			VkDeviceSize offsets[1] = { 0 };
 
 			// Start capture of pipeline statistics
-			vkCmdBeginQuery(drawCmdBuffers[i], queryPool, 0, 0);
+			queryManager.cmdBeginQuery(drawCmdBuffers[i], statisticsQuery, i, 0);
 
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
@@ -193,9 +179,7 @@ public:
 			}
 
 			// End capture of pipeline statistics
-			vkCmdEndQuery(drawCmdBuffers[i], queryPool, 0);
-
-			drawUI(drawCmdBuffers[i]);
+			queryManager.cmdEndQuery(drawCmdBuffers[i], statisticsQuery, i, 0);
 
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
@@ -207,13 +191,13 @@ public:
 	{
 		VulkanExampleBase::prepareFrame();
 
+		// Fetch query results of previous frames that have become available
+		queryManager.update(currentBuffer);
+
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
-		// Read query results for displaying in next frame
-		getQueryResults();
-
 		VulkanExampleBase::submitFrame();
 	}
 
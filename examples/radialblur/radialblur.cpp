@@ -378,8 +378,6 @@ public:
 					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 				}
 
-				drawUI(drawCmdBuffers[i]);
-
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
 			}
 
@@ -36,6 +36,7 @@
 #include <vulkan/vulkan.h>
 #include "VulkanTools.h"
 #include "CommandLineParser.hpp"
+#include "imageencoder.hpp"
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 android_app* androidapp;
@@ -841,35 +842,20 @@ public:
 #else
 			const char* filename = "headless.ppm";
 #endif
-			std::ofstream file(filename, std::ios::out | std::ios::binary);
-
-			// ppm header
-			file << "P6\n" << width << "\n" << height << "\n" << 255 << "\n";
-
 			// If source is BGR (destination is always RGB) and we can't use blit (which does automatic conversion), we'll have to manually swizzle color components
 			// Check if source is BGR and needs swizzle
 			std::vector<VkFormat> formatsBGR = { VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_B8G8R8A8_SNORM };
 			const bool colorSwizzle = (std::find(formatsBGR.begin(), formatsBGR.end(), VK_FORMAT_R8G8B8A8_UNORM) != formatsBGR.end());
 
-			// ppm binary pixel data
-			for (int32_t y = 0; y < height; y++) {
-				unsigned int *row = (unsigned int*)imagedata;
-				for (int32_t x = 0; x < width; x++) {
-					if (colorSwizzle) {
-						file.write((char*)row + 2, 1);
-						file.write((char*)row + 1, 1);
-						file.write((char*)row, 1);
-					}
-					else {
-						file.write((char*)row, 3);
-					}
-					row++;
-				}
-				imagedata += subResourceLayout.rowPitch;
+			// Pack the rows into a single buffer that is written with one call instead of writing every texel to the stream on its own
+			std::vector<uint8_t> rgb, ppm;
+			vks::imageencoder::packRGB((const uint8_t*)imagedata, subResourceLayout.rowPitch, width, height, colorSwizzle, rgb);
+			vks::imageencoder::encodePPM(rgb.data(), width, height, ppm);
+			if (!vks::imageencoder::writeFile(filename, ppm)) {
+				LOG("Could not write framebuffer image to %s\n", filename);
+			} else {
+				LOG("Framebuffer image saved to %s\n", filename);
 			}
-			file.close();
-
-			LOG("Framebuffer image saved to %s\n", filename);
 
 			// Clean up resources
 			vkUnmapMemory(device, dstImageMemory);
@@ -29,7 +29,10 @@ public:
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkDescriptorSet descriptorSet;
 
-	bool screenshotSaved = false;
+	const std::vector<vks::imageencoder::Format> screenshotFormats = { vks::imageencoder::Format::PNG, vks::imageencoder::Format::QOI, vks::imageencoder::Format::PPM };
+	int32_t screenshotFormatIndex = 0;
+	std::string screenshotFilename;
+	uint32_t screenshotsRequested = 0;
 
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
@@ -89,8 +92,6 @@ public:
 			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 			model.draw(drawCmdBuffers[i]);
 
-			drawUI(drawCmdBuffers[i]);
-
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
@@ -180,216 +181,16 @@ public:
 	}
 
 	// Take a screenshot from the current swapchain image
-	// This is done using a blit from the swapchain image to a linear image whose memory content is then saved as a ppm image
+	// This is done by the frame capture of the example base, which copies the next presented swapchain image into a host visible buffer
 	// Getting the image date directly from a swapchain image wouldn't work as they're usually stored in an implementation dependent optimal tiling format
+	// The copy is retired by a fence on one of the following frames and the image is swizzled (BGR to RGB) and encoded on a worker thread, so the render thread never waits for the GPU or the disk
 	// Note: This requires the swapchain images to be created with the VK_IMAGE_USAGE_TRANSFER_SRC_BIT flag (see VulkanSwapChain::create)
-	void saveScreenshot(const char *filename)
+	void saveScreenshot()
 	{
-		screenshotSaved = false;
-		bool supportsBlit = true;
-
-		// Check blit support for source and destination
-		VkFormatProperties formatProps;
-
-		// Check if the device supports blitting from optimal images (the swapchain images are in optimal format)
-		vkGetPhysicalDeviceFormatProperties(physicalDevice, swapChain.colorFormat, &formatProps);
-		if (!(formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT)) {
-			std::cerr << "Device does not support blitting from optimal tiled images, using copy instead of blit!" << std::endl;
-			supportsBlit = false;
-		}
-
-		// Check if the device supports blitting to linear images
-		vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_R8G8B8A8_UNORM, &formatProps);
-		if (!(formatProps.linearTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT)) {
-			std::cerr << "Device does not support blitting to linear tiled images, using copy instead of blit!" << std::endl;
-			supportsBlit = false;
-		}
-
-		// Source for the copy is the last rendered swapchain image
-		VkImage srcImage = swapChain.images[currentBuffer];
-
-		// Create the linear tiled destination image to copy to and to read the memory from
-		VkImageCreateInfo imageCreateCI(vks::initializers::imageCreateInfo());
-		imageCreateCI.imageType = VK_IMAGE_TYPE_2D;
-		// Note that vkCmdBlitImage (if supported) will also do format conversions if the swapchain color format would differ
-		imageCreateCI.format = VK_FORMAT_R8G8B8A8_UNORM;
-		imageCreateCI.extent.width = width;
-		imageCreateCI.extent.height = height;
-		imageCreateCI.extent.depth = 1;
-		imageCreateCI.arrayLayers = 1;
-		imageCreateCI.mipLevels = 1;
-		imageCreateCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageCreateCI.samples = VK_SAMPLE_COUNT_1_BIT;
-		imageCreateCI.tiling = VK_IMAGE_TILING_LINEAR;
-		imageCreateCI.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-		// Create the image
-		VkImage dstImage;
-		VK_CHECK_RESULT(vkCreateImage(device, &imageCreateCI, nullptr, &dstImage));
-		// Create memory to back up the image
-		VkMemoryRequirements memRequirements;
-		VkMemoryAllocateInfo memAllocInfo(vks::initializers::memoryAllocateInfo());
-		VkDeviceMemory dstImageMemory;
-		vkGetImageMemoryRequirements(device, dstImage, &memRequirements);
-		memAllocInfo.allocationSize = memRequirements.size;
-		// Memory must be host visible to copy from
-		memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &dstImageMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device, dstImage, dstImageMemory, 0));
-
-		// Do the actual blit from the swapchain image to our host visible destination image
-		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-		// Transition destination image to transfer destination layout
-		vks::tools::insertImageMemoryBarrier(
-			copyCmd,
-			dstImage,
-			0,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_IMAGE_LAYOUT_UNDEFINED,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
-
-		// Transition swapchain image from present to transfer source layout
-		vks::tools::insertImageMemoryBarrier(
-			copyCmd,
-			srcImage,
-			VK_ACCESS_MEMORY_READ_BIT,
-			VK_ACCESS_TRANSFER_READ_BIT,
-			VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
-
-		// If source and destination support blit we'll blit as this also does automatic format conversion (e.g. from BGR to RGB)
-		if (supportsBlit)
-		{
-			// Define the region to blit (we will blit the whole swapchain image)
-			VkOffset3D blitSize;
-			blitSize.x = width;
-			blitSize.y = height;
-			blitSize.z = 1;
-			VkImageBlit imageBlitRegion{};
-			imageBlitRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlitRegion.srcSubresource.layerCount = 1;
-			imageBlitRegion.srcOffsets[1] = blitSize;
-			imageBlitRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageBlitRegion.dstSubresource.layerCount = 1;
-			imageBlitRegion.dstOffsets[1] = blitSize;
-
-			// Issue the blit command
-			vkCmdBlitImage(
-				copyCmd,
-				srcImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				1,
-				&imageBlitRegion,
-				VK_FILTER_NEAREST);
-		}
-		else
-		{
-			// Otherwise use image copy (requires us to manually flip components)
-			VkImageCopy imageCopyRegion{};
-			imageCopyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageCopyRegion.srcSubresource.layerCount = 1;
-			imageCopyRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			imageCopyRegion.dstSubresource.layerCount = 1;
-			imageCopyRegion.extent.width = width;
-			imageCopyRegion.extent.height = height;
-			imageCopyRegion.extent.depth = 1;
-
-			// Issue the copy command
-			vkCmdCopyImage(
-				copyCmd,
-				srcImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				1,
-				&imageCopyRegion);
-		}
-
-		// Transition destination image to general layout, which is the required layout for mapping the image memory later on
-		vks::tools::insertImageMemoryBarrier(
-			copyCmd,
-			dstImage,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_ACCESS_MEMORY_READ_BIT,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			VK_IMAGE_LAYOUT_GENERAL,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
-
-		// Transition back the swap chain image after the blit is done
-		vks::tools::insertImageMemoryBarrier(
-			copyCmd,
-			srcImage,
-			VK_ACCESS_TRANSFER_READ_BIT,
-			VK_ACCESS_MEMORY_READ_BIT,
-			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-			VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
-
-		vulkanDevice->flushCommandBuffer(copyCmd, queue);
-
-		// Get layout of the image (including row pitch)
-		VkImageSubresource subResource { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0 };
-		VkSubresourceLayout subResourceLayout;
-		vkGetImageSubresourceLayout(device, dstImage, &subResource, &subResourceLayout);
-
-		// Map image memory so we can start copying from it
-		const char* data;
-		vkMapMemory(device, dstImageMemory, 0, VK_WHOLE_SIZE, 0, (void**)&data);
-		data += subResourceLayout.offset;
-
-		std::ofstream file(filename, std::ios::out | std::ios::binary);
-
-		// ppm header
-		file << "P6\n" << width << "\n" << height << "\n" << 255 << "\n";
-
-		// If source is BGR (destination is always RGB) and we can't use blit (which does automatic conversion), we'll have to manually swizzle color components
-		bool colorSwizzle = false;
-		// Check if source is BGR
-		// Note: Not complete, only contains most common and basic BGR surface formats for demonstration purposes
-		if (!supportsBlit)
-		{
-			std::vector<VkFormat> formatsBGR = { VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_B8G8R8A8_SNORM };
-			colorSwizzle = (std::find(formatsBGR.begin(), formatsBGR.end(), swapChain.colorFormat) != formatsBGR.end());
-		}
-
-		// ppm binary pixel data
-		for (uint32_t y = 0; y < height; y++)
-		{
-			unsigned int *row = (unsigned int*)data;
-			for (uint32_t x = 0; x < width; x++)
-			{
-				if (colorSwizzle)
-				{
-					file.write((char*)row+2, 1);
-					file.write((char*)row+1, 1);
-					file.write((char*)row, 1);
-				}
-				else
-				{
-					file.write((char*)row, 3);
-				}
-				row++;
-			}
-			data += subResourceLayout.rowPitch;
-		}
-		file.close();
-
-		std::cout << "Screenshot saved to disk" << std::endl;
-
-		// Clean up resources
-		vkUnmapMemory(device, dstImageMemory);
-		vkFreeMemory(device, dstImageMemory, nullptr);
-		vkDestroyImage(device, dstImage, nullptr);
-
-		screenshotSaved = true;
+		const vks::imageencoder::Format format = screenshotFormats[screenshotFormatIndex];
+		screenshotFilename = std::string("screenshot.") + vks::imageencoder::extension(format);
+		frameCapture.request(screenshotFilename, format);
+		screenshotsRequested = frameCapture.savedCount() + 1;
 	}
 
 	void draw()
@@ -431,11 +232,16 @@ public:
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Functions")) {
+			overlay->comboBox("Format", &screenshotFormatIndex, { "PNG", "QOI", "PPM" });
 			if (overlay->button("Take screenshot")) {
-				saveScreenshot("screenshot.ppm");
+				saveScreenshot();
 			}
-			if (screenshotSaved) {
-				overlay->text("Screenshot saved as screenshot.ppm");
+			if (screenshotsRequested > 0) {
+				if (frameCapture.savedCount() >= screenshotsRequested) {
+					overlay->text("Screenshot saved as %s", screenshotFilename.c_str());
+				} else {
+					overlay->text("Saving screenshot...");
+				}
 			}
 		}
 	}
@@ -277,6 +277,8 @@ public:
 		{
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			gpuProfiler.cmdBeginFrame(drawCmdBuffers[i], i);
+
 			/*
 				First render pass: Generate shadow map by rendering the scene from light's POV
 			*/
@@ -291,6 +293,7 @@ public:
 				renderPassBeginInfo.clearValueCount = 1;
 				renderPassBeginInfo.pClearValues = clearValues;
 
+				gpuProfiler.cmdBeginScope(drawCmdBuffers[i], i, "Shadow map");
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 				viewport = vks::initializers::viewport((float)offscreenPass.width, (float)offscreenPass.height, 0.0f, 1.0f);
@@ -312,6 +315,7 @@ public:
 				scenes[sceneIndex].draw(drawCmdBuffers[i]);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				gpuProfiler.cmdEndScope(drawCmdBuffers[i], i, "Shadow map");
 			}
 
 			/*
@@ -334,6 +338,7 @@ public:
 				renderPassBeginInfo.clearValueCount = 2;
 				renderPassBeginInfo.pClearValues = clearValues;
 
+				gpuProfiler.cmdBeginScope(drawCmdBuffers[i], i, "Scene");
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 				viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -354,11 +359,12 @@ public:
 					scenes[sceneIndex].draw(drawCmdBuffers[i]);
 				}
 
-				drawUI(drawCmdBuffers[i]);
-
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				gpuProfiler.cmdEndScope(drawCmdBuffers[i], i, "Scene");
 			}
 
+			gpuProfiler.cmdEndFrame(drawCmdBuffers[i], i);
+
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
@@ -545,6 +551,7 @@ public:
 
 	void updateUniformBuffers()
 	{
+		VKS_PROFILE_FUNCTION();
 		uboVSscene.projection = camera.matrices.perspective;
 		uboVSscene.view = camera.matrices.view;
 		uboVSscene.model = glm::mat4(1.0f);
@@ -576,7 +583,10 @@ public:
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 
 		// Submit to queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		{
+			VKS_PROFILE_ZONE("vkQueueSubmit");
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		}
 
 		VulkanExampleBase::submitFrame();
 	}
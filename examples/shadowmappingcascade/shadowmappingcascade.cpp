@@ -15,10 +15,19 @@
 
 	A further optimization could be done using a geometry shader to do a single-pass render for the depth map
 	cascades instead of multiple passes (geometry shaders are not supported on all target devices).
+
+	The cascade projections are fitted to a bounding sphere of each frustum split and snapped to shadow map texels,
+	so they're stable under camera rotation and don't shimmer when the camera moves. As long as a split's sphere stays
+	inside the (slightly padded) area its cascade was last rendered with and the light doesn't move, the cascade's
+	depth layer is reused instead of being rendered again. If the light moves, the first cascade is updated every
+	frame while the farther cascades are refreshed in turns. The cascades that need rendering are culled against their
+	own light frustum and recorded into secondary command buffers in parallel.
 */
 
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "threadpool.hpp"
+#include "frustum.hpp"
 
 #define ENABLE_VALIDATION false
 
@@ -37,14 +46,31 @@ public:
 	int32_t displayDepthMapCascadeIndex = 0;
 	bool colorCascades = false;
 	bool filterPCF = false;
+	bool cacheCascades = true;
+	int32_t cascadesRendered = 0;
 
 	float cascadeSplitLambda = 0.95f;
+	// Fraction of a cascade's radius by which its area is enlarged, so the camera can move a bit before the cascade needs to be rendered again
+	float cascadePadding = 0.1f;
+	// Max. angle (in radians) the light can rotate before a cached cascade is updated, even if it's not its turn
+	float cascadeMaxLightAngle = glm::radians(2.0f);
+	// Selects the far cascade that's refreshed next if the light moves
+	uint32_t cascadeRefreshSlot = 0;
 
 	float zNear = 0.5f;
 	float zFar = 48.0f;
 
 	glm::vec3 lightPos = glm::vec3();
 
+	// Positions the tree model is rendered at
+	const std::vector<glm::vec3> treePositions = {
+		glm::vec3(0.0f, 0.0f, 0.0f),
+		glm::vec3(1.25f, 0.25f, 1.25f),
+		glm::vec3(-1.25f, -0.2f, 1.25f),
+		glm::vec3(1.25f, 0.1f, -1.25f),
+		glm::vec3(-1.25f, -0.25f, -1.25f),
+	};
+
 	struct Models {
 		vkglTF::Model terrain;
 		vkglTF::Model tree;
@@ -121,17 +147,34 @@ public:
 		VkFramebuffer frameBuffer;
 		VkDescriptorSet descriptorSet;
 		VkImageView view;
+		// Each cascade is recorded by a single thread at a time, so it gets its own command pool
+		VkCommandPool commandPool;
+		VkCommandBuffer commandBuffer;
 
 		float splitDepth;
 		glm::mat4 viewProjMatrix;
 
+		// Light and light space bounds the cascade's depth layer was last rendered with
+		glm::vec3 lightDir;
+		glm::mat4 lightViewMatrix;
+		glm::vec3 center;
+		float radius = 0.0f;
+		float extent = 0.0f;
+		// Set if the cascade's depth layer needs to be rendered again
+		bool refresh = true;
+		// Tree positions inside the cascade's light frustum
+		std::vector<glm::vec3> visibleTrees;
+
 		void destroy(VkDevice device) {
 			vkDestroyImageView(device, view, nullptr);
 			vkDestroyFramebuffer(device, frameBuffer, nullptr);
+			vkDestroyCommandPool(device, commandPool, nullptr);
 		}
 	};
 	std::array<Cascade, SHADOW_MAP_CASCADE_COUNT> cascades;
 
+	vks::ThreadPool threadPool;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "Cascaded shadow mapping";
@@ -142,10 +185,13 @@ public:
 		camera.setPosition(glm::vec3(-0.12f, 1.14f, -2.25f));
 		camera.setRotation(glm::vec3(-17.0f, 7.0f, 0.0f));
 		timer = 0.2f;
+		// Cascades are recorded in parallel, there is no use for more threads than cascades
+		threadPool.setThreadCount(std::max(1u, std::min(std::thread::hardware_concurrency(), (uint32_t)SHADOW_MAP_CASCADE_COUNT)));
 	}
 
 	~VulkanExample()
 	{
+		threadPool.wait();
 		for (auto cascade : cascades) {
 			cascade.destroy(device);
 		}
@@ -179,7 +225,7 @@ public:
 		Render the example scene with given command buffer, pipeline layout and descriptor set
 		Used by the scene rendering and depth pass generation command buffer
 	*/
-	void renderScene(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet, uint32_t cascadeIndex = 0) {
+	void renderScene(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet, const std::vector<glm::vec3> &trees, uint32_t cascadeIndex = 0) {
 		// We use push constants for passing shadow cascade info to the shaders
 		PushConstBlock pushConstBlock = { glm::vec4(0.0f), cascadeIndex };
 
@@ -191,15 +237,7 @@ public:
 		models.terrain.draw(commandBuffer, vkglTF::RenderFlags::BindImages, pipelineLayout);
 
 		// Trees
-		const std::vector<glm::vec3> positions = {
-			glm::vec3(0.0f, 0.0f, 0.0f),
-			glm::vec3(1.25f, 0.25f, 1.25f),
-			glm::vec3(-1.25f, -0.2f, 1.25f),
-			glm::vec3(1.25f, 0.1f, -1.25f),
-			glm::vec3(-1.25f, -0.25f, -1.25f),
-		};
-
-		for (auto position : positions) {
+		for (auto position : trees) {
 			pushConstBlock.position = glm::vec4(position, 0.0f);
 			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
 			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
@@ -327,6 +365,13 @@ public:
 			framebufferInfo.height = SHADOWMAP_DIM;
 			framebufferInfo.layers = 1;
 			VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferInfo, nullptr, &cascades[i].frameBuffer));
+			// Command pool and secondary command buffer the cascade's depth pass is recorded into
+			VkCommandPoolCreateInfo cmdPoolInfo = vks::initializers::commandPoolCreateInfo();
+			cmdPoolInfo.queueFamilyIndex = swapChain.queueNodeIndex;
+			cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &cascades[i].commandPool));
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cascades[i].commandPool, VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &cascades[i].commandBuffer));
 		}
 
 		// Shared sampler for cascade depth reads
@@ -345,102 +390,173 @@ public:
 		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &depth.sampler));
 	}
 
-	void buildCommandBuffers()
+	/*
+		Checks if a shadow caster is (partially) inside a cascade's light frustum
+		The near plane is not tested, as casters between the light and the cascade still cast shadows into it (with depth clamp enabled)
+	*/
+	bool casterVisible(const vks::Frustum &frustum, glm::vec3 pos, float radius)
 	{
-		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		for (uint32_t i = 0; i < frustum.planes.size(); i++) {
+			if (i == vks::Frustum::BACK) {
+				continue;
+			}
+			if (glm::dot(glm::vec3(frustum.planes[i]), pos) + frustum.planes[i].w <= -radius) {
+				return false;
+			}
+		}
+		return true;
+	}
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); i++) {
+	/*
+		Records the depth pass of a single cascade into the cascade's secondary command buffer
+		Called from the thread pool, so this must only touch the cascade's own resources
+	*/
+	void recordCascade(uint32_t cascadeIndex, VkCommandBufferInheritanceInfo inheritanceInfo)
+	{
+		VKS_PROFILE_FUNCTION();
+		Cascade &cascade = cascades[cascadeIndex];
+
+		// Cull the trees against the cascade's light frustum using a sphere around the model's origin that contains its bounds
+		vks::Frustum frustum;
+		frustum.update(cascade.viewProjMatrix);
+		const float treeRadius = glm::length(models.tree.dimensions.center) + models.tree.dimensions.radius;
+		cascade.visibleTrees.clear();
+		for (auto position : treePositions) {
+			if (casterVisible(frustum, position, treeRadius)) {
+				cascade.visibleTrees.push_back(position);
+			}
+		}
 
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		VkCommandBufferBeginInfo commandBufferBeginInfo = vks::initializers::commandBufferBeginInfo();
+		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		commandBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(cascade.commandBuffer, &commandBufferBeginInfo));
 
-			/*
-				Generate depth map cascades
+		VkViewport viewport = vks::initializers::viewport((float)SHADOWMAP_DIM, (float)SHADOWMAP_DIM, 0.0f, 1.0f);
+		vkCmdSetViewport(cascade.commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(SHADOWMAP_DIM, SHADOWMAP_DIM, 0, 0);
+		vkCmdSetScissor(cascade.commandBuffer, 0, 1, &scissor);
 
-				Uses multiple passes with each pass rendering the scene to the cascade's depth image layer
-				Could be optimized using a geometry shader (and layered frame buffer) on devices that support geometry shaders
-			*/
-			{
-				VkClearValue clearValues[1];
-				clearValues[0].depthStencil = { 1.0f, 0 };
-
-				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-				renderPassBeginInfo.renderPass = depthPass.renderPass;
-				renderPassBeginInfo.renderArea.offset.x = 0;
-				renderPassBeginInfo.renderArea.offset.y = 0;
-				renderPassBeginInfo.renderArea.extent.width = SHADOWMAP_DIM;
-				renderPassBeginInfo.renderArea.extent.height = SHADOWMAP_DIM;
-				renderPassBeginInfo.clearValueCount = 1;
-				renderPassBeginInfo.pClearValues = clearValues;
-
-				VkViewport viewport = vks::initializers::viewport((float)SHADOWMAP_DIM, (float)SHADOWMAP_DIM, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-				VkRect2D scissor = vks::initializers::rect2D(SHADOWMAP_DIM, SHADOWMAP_DIM, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				// One pass per cascade
-				// The layer that this pass renders to is defined by the cascade's image view (selected via the cascade's descriptor set)
-				for (uint32_t j = 0; j < SHADOW_MAP_CASCADE_COUNT; j++) {
-					renderPassBeginInfo.framebuffer = cascades[j].frameBuffer;
-					vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, depthPass.pipeline);
-					renderScene(drawCmdBuffers[i], depthPass.pipelineLayout, cascades[j].descriptorSet, j);
-					vkCmdEndRenderPass(drawCmdBuffers[i]);
-				}
-			}
+		vkCmdBindPipeline(cascade.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPass.pipeline);
+		renderScene(cascade.commandBuffer, depthPass.pipelineLayout, cascade.descriptorSet, cascade.visibleTrees, cascadeIndex);
 
-			/*
-				Note: Explicit synchronization is not required between the render pass, as this is done implicit via sub pass dependencies
-			*/
+		VK_CHECK_RESULT(vkEndCommandBuffer(cascade.commandBuffer));
+	}
 
-			/*
-				Scene rendering using depth cascades for shadow mapping
-			*/
+	/*
+		The command buffer is recorded every frame, as the set of cascades that need to be rendered changes from frame to frame
+	*/
+	void buildCommandBuffer(uint32_t index)
+	{
+		VKS_PROFILE_FUNCTION();
+		VkCommandBuffer commandBuffer = drawCmdBuffers[index];
+
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+
+		gpuProfiler.cmdBeginFrame(commandBuffer, index);
 
-			{
-				VkClearValue clearValues[2];
-				clearValues[0].color = { { 0.0f, 0.0f, 0.2f, 1.0f } };
-				clearValues[1].depthStencil = { 1.0f, 0 };
-
-				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-				renderPassBeginInfo.renderPass = renderPass;
-				renderPassBeginInfo.framebuffer = frameBuffers[i];
-				renderPassBeginInfo.renderArea.offset.x = 0;
-				renderPassBeginInfo.renderArea.offset.y = 0;
-				renderPassBeginInfo.renderArea.extent.width = width;
-				renderPassBeginInfo.renderArea.extent.height = height;
-				renderPassBeginInfo.clearValueCount = 2;
-				renderPassBeginInfo.pClearValues = clearValues;
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-				VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				// Visualize shadow map cascade
-				if (displayDepthMap) {
-					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
-					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.debugShadowMap);
-					PushConstBlock pushConstBlock = {};
-					pushConstBlock.cascadeIndex = displayDepthMapCascadeIndex;
-					vkCmdPushConstants(drawCmdBuffers[i], pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
-					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+		/*
+			Generate depth map cascades
+
+			Uses multiple passes with each pass rendering the scene to the cascade's depth image layer
+			Could be optimized using a geometry shader (and layered frame buffer) on devices that support geometry shaders
+			Cascades that are still valid keep the contents of their layer from an earlier frame and are skipped
+		*/
+		{
+			// Record the depth passes of all cascades that need to be updated in parallel
+			std::vector<uint32_t> cascadeIndices;
+			for (uint32_t j = 0; j < SHADOW_MAP_CASCADE_COUNT; j++) {
+				if (cascades[j].refresh || !cacheCascades) {
+					VkCommandBufferInheritanceInfo inheritanceInfo = vks::initializers::commandBufferInheritanceInfo();
+					inheritanceInfo.renderPass = depthPass.renderPass;
+					inheritanceInfo.framebuffer = cascades[j].frameBuffer;
+					const uint32_t threadIndex = static_cast<uint32_t>(cascadeIndices.size() % threadPool.threads.size());
+					threadPool.threads[threadIndex]->addJob([=] { recordCascade(j, inheritanceInfo); });
+					cascadeIndices.push_back(j);
 				}
+			}
+			threadPool.wait();
+			cascadesRendered = static_cast<int32_t>(cascadeIndices.size());
+
+			VkClearValue clearValues[1];
+			clearValues[0].depthStencil = { 1.0f, 0 };
+
+			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+			renderPassBeginInfo.renderPass = depthPass.renderPass;
+			renderPassBeginInfo.renderArea.offset.x = 0;
+			renderPassBeginInfo.renderArea.offset.y = 0;
+			renderPassBeginInfo.renderArea.extent.width = SHADOWMAP_DIM;
+			renderPassBeginInfo.renderArea.extent.height = SHADOWMAP_DIM;
+			renderPassBeginInfo.clearValueCount = 1;
+			renderPassBeginInfo.pClearValues = clearValues;
+
+			// One pass per cascade
+			// The layer that this pass renders to is defined by the cascade's image view (selected via the cascade's descriptor set)
+			gpuProfiler.cmdBeginScope(commandBuffer, index, "Shadow cascades");
+			for (auto j : cascadeIndices) {
+				renderPassBeginInfo.framebuffer = cascades[j].frameBuffer;
+				vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+				vkCmdExecuteCommands(commandBuffer, 1, &cascades[j].commandBuffer);
+				vkCmdEndRenderPass(commandBuffer);
+				cascades[j].refresh = false;
+			}
+			gpuProfiler.cmdEndScope(commandBuffer, index, "Shadow cascades");
+		}
 
-				// Render shadowed scene
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, (filterPCF) ? pipelines.sceneShadowPCF : pipelines.sceneShadow);
-				renderScene(drawCmdBuffers[i], pipelineLayout, descriptorSet);
+		/*
+			Note: Explicit synchronization is not required between the render pass, as this is done implicit via sub pass dependencies
+		*/
 
-				drawUI(drawCmdBuffers[i]);
+		/*
+			Scene rendering using depth cascades for shadow mapping
+		*/
 
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
+		{
+			VkClearValue clearValues[2];
+			clearValues[0].color = { { 0.0f, 0.0f, 0.2f, 1.0f } };
+			clearValues[1].depthStencil = { 1.0f, 0 };
+
+			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+			renderPassBeginInfo.renderPass = renderPass;
+			renderPassBeginInfo.framebuffer = frameBuffers[index];
+			renderPassBeginInfo.renderArea.offset.x = 0;
+			renderPassBeginInfo.renderArea.offset.y = 0;
+			renderPassBeginInfo.renderArea.extent.width = width;
+			renderPassBeginInfo.renderArea.extent.height = height;
+			renderPassBeginInfo.clearValueCount = 2;
+			renderPassBeginInfo.pClearValues = clearValues;
+
+			gpuProfiler.cmdBeginScope(commandBuffer, index, "Scene");
+			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+			// Visualize shadow map cascade
+			if (displayDepthMap) {
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.debugShadowMap);
+				PushConstBlock pushConstBlock = {};
+				pushConstBlock.cascadeIndex = displayDepthMapCascadeIndex;
+				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushConstBlock), &pushConstBlock);
+				vkCmdDraw(commandBuffer, 3, 1, 0, 0);
 			}
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+			// Render shadowed scene
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, (filterPCF) ? pipelines.sceneShadowPCF : pipelines.sceneShadow);
+			renderScene(commandBuffer, pipelineLayout, descriptorSet, treePositions);
+
+			vkCmdEndRenderPass(commandBuffer);
+			gpuProfiler.cmdEndScope(commandBuffer, index, "Scene");
 		}
+
+		gpuProfiler.cmdEndFrame(commandBuffer, index);
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 	}
 
 	void loadAssets()
@@ -658,6 +774,8 @@ public:
 		}
 
 		// Calculate orthographic projection matrix for each cascade
+		const glm::vec3 lightDir = normalize(-lightPos);
+		const uint32_t refreshSlot = 1 + (cascadeRefreshSlot++ % (SHADOW_MAP_CASCADE_COUNT - 1));
 		float lastSplitDist = 0.0;
 		for (uint32_t i = 0; i < SHADOW_MAP_CASCADE_COUNT; i++) {
 			float splitDist = cascadeSplits[i];
@@ -698,18 +816,54 @@ public:
 				float distance = glm::length(frustumCorners[i] - frustumCenter);
 				radius = glm::max(radius, distance);
 			}
+			// The sphere's radius only depends on the camera's projection and the split distances, rounding it keeps it constant against floating point noise
 			radius = std::ceil(radius * 16.0f) / 16.0f;
 
-			glm::vec3 maxExtents = glm::vec3(radius);
-			glm::vec3 minExtents = -maxExtents;
+			Cascade &cascade = cascades[i];
+			cascade.splitDepth = (camera.getNearClip() + splitDist * clipRange) * -1.0f;
 
-			glm::vec3 lightDir = normalize(-lightPos);
-			glm::mat4 lightViewMatrix = glm::lookAt(frustumCenter - lightDir * -minExtents.z, frustumCenter, glm::vec3(0.0f, 1.0f, 0.0f));
-			glm::mat4 lightOrthoMatrix = glm::ortho(minExtents.x, maxExtents.x, minExtents.y, maxExtents.y, 0.0f, maxExtents.z - minExtents.z);
+			/*
+				Check if the depth layer rendered with the cascade's current projection can be reused
+				This is the case if the split's bounding sphere still fits into the cascade's light space bounds and the light hasn't moved
+				If the light moved, the first cascade is always updated while the other cascades are refreshed in turns (or if the light moved too far)
+			*/
+			cascade.refresh |= !cacheCascades;
+			if (!cascade.refresh) {
+				const glm::vec3 offset = glm::abs(glm::vec3(cascade.lightViewMatrix * glm::vec4(frustumCenter, 1.0f)) - cascade.center);
+				// The dot product of two equal normalized vectors isn't necessarily one, so the angle is only used for the threshold
+				const bool lightMoved = (cascade.lightDir != lightDir);
+				const float lightAngle = std::acos(glm::clamp(glm::dot(cascade.lightDir, lightDir), -1.0f, 1.0f));
+				cascade.refresh =
+					(radius != cascade.radius) ||
+					(glm::max(offset.x, glm::max(offset.y, offset.z)) + radius > cascade.extent) ||
+					(lightMoved && ((i == 0) || (i == refreshSlot) || (lightAngle > cascadeMaxLightAngle)));
+			}
+			if (!cascade.refresh) {
+				lastSplitDist = cascadeSplits[i];
+				continue;
+			}
 
-			// Store split distance and matrix in cascade
-			cascades[i].splitDepth = (camera.getNearClip() + splitDist * clipRange) * -1.0f;
-			cascades[i].viewProjMatrix = lightOrthoMatrix * lightViewMatrix;
+			/*
+				Fit the cascade's orthographic projection to the split's bounding sphere (enlarged by the padding)
+				The light space center is snapped to shadow map texels, so the shadow map's texels don't move relative to the scene
+				and edges don't shimmer when the camera moves
+			*/
+			const float extent = radius * (1.0f + cascadePadding);
+			const float texelSize = (2.0f * extent) / (float)SHADOWMAP_DIM;
+			glm::mat4 lightViewMatrix = glm::lookAt(glm::vec3(0.0f), lightDir, glm::vec3(0.0f, 1.0f, 0.0f));
+			glm::vec3 center = glm::vec3(lightViewMatrix * glm::vec4(frustumCenter, 1.0f));
+			center.x = std::floor(center.x / texelSize) * texelSize;
+			center.y = std::floor(center.y / texelSize) * texelSize;
+			// The light looks down the negative z axis
+			glm::mat4 lightOrthoMatrix = glm::ortho(center.x - extent, center.x + extent, center.y - extent, center.y + extent, -center.z - extent, -center.z + extent);
+
+			// Store matrix and light space bounds in cascade
+			cascade.viewProjMatrix = lightOrthoMatrix * lightViewMatrix;
+			cascade.lightDir = lightDir;
+			cascade.lightViewMatrix = lightViewMatrix;
+			cascade.center = center;
+			cascade.radius = radius;
+			cascade.extent = extent;
 
 			lastSplitDist = cascadeSplits[i];
 		}
@@ -756,6 +910,7 @@ public:
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
+		buildCommandBuffer(currentBuffer);
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
@@ -772,7 +927,6 @@ public:
 		prepareUniformBuffers();
 		setupLayoutsAndDescriptors();
 		preparePipelines();
-		buildCommandBuffers();
 		prepared = true;
 	}
 
@@ -780,12 +934,13 @@ public:
 	{
 		if (!prepared)
 			return;
-		draw();
+		// Cascades need to be updated before the frame's command buffer is recorded, as that depends on which cascades are outdated
 		if (!paused || camera.updated) {
 			updateLight();
 			updateCascades();
 			updateUniformBuffers();
 		}
+		draw();
 	}
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
@@ -798,17 +953,13 @@ public:
 			if (overlay->checkBox("Color cascades", &colorCascades)) {
 				updateUniformBuffers();
 			}
-			if (overlay->checkBox("Display depth map", &displayDepthMap)) {
-				buildCommandBuffers();
-			}
+			overlay->checkBox("Display depth map", &displayDepthMap);
 			if (displayDepthMap) {
-				if (overlay->sliderInt("Cascade", &displayDepthMapCascadeIndex, 0, SHADOW_MAP_CASCADE_COUNT - 1)) {
-					buildCommandBuffers();
-				}
-			}
-			if (overlay->checkBox("PCF filtering", &filterPCF)) {
-				buildCommandBuffers();
+				overlay->sliderInt("Cascade", &displayDepthMapCascadeIndex, 0, SHADOW_MAP_CASCADE_COUNT - 1);
 			}
+			overlay->checkBox("PCF filtering", &filterPCF);
+			overlay->checkBox("Cache cascades", &cacheCascades);
+			overlay->text("Cascades rendered: %d", cascadesRendered);
 		}
 	}
 };
@@ -6,8 +6,16 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+/*
+* The shadow cube map can be generated in two ways:
+*  - One render pass per cube map face, with the scene's primitives culled against each face's frustum
+*  - A single layered render pass for all faces (requires VK_EXT_shader_viewport_index_layer), where each primitive is
+*    drawn with one instance per cube map face it intersects and the vertex shader selects the face (layer) to render to
+*/
+
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "frustum.hpp"
 
 #define ENABLE_VALIDATION false
 
@@ -24,6 +32,24 @@ class VulkanExample : public VulkanExampleBase
 public:
 	bool displayCubeMap = false;
 
+	enum ShadowPass { PerFacePasses = 0, SinglePassLayered = 1 };
+	int32_t shadowPass = PerFacePasses;
+	// Set if the device can write the render target layer from the vertex shader
+	bool layeredSupported = false;
+	// Number of draws (instances for the layered pass) that went into the shadow cube map in the last frame
+	int32_t shadowDrawCount = 0;
+
+	// Index range and world space bounding sphere of a single primitive of the scene, used to cull shadow casters against the cube map faces
+	struct ShadowCaster {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		glm::vec3 center;
+		float radius;
+	};
+	std::vector<ShadowCaster> shadowCasters;
+	// Per-instance cube map face indices for the layered pass
+	vks::Buffer faceIndexBuffer;
+
 	float zNear = 0.1f;
 	float zFar = 1024.0f;
 
@@ -51,11 +77,21 @@ public:
 		glm::vec4 lightPos;
 	};
 
-	UBO uboVSscene, uboOffscreenVS;
+	UBO uboVSscene;
+
+	struct UBOOffscreen {
+		glm::mat4 projection;
+		glm::mat4 view;
+		glm::mat4 model;
+		glm::vec4 lightPos;
+		// View matrices of all cube map faces, used by the layered pass
+		glm::mat4 faceViews[6];
+	} uboOffscreenVS;
 
 	struct {
 		VkPipeline scene;
 		VkPipeline offscreen;
+		VkPipeline offscreenLayered;
 		VkPipeline cubemapDisplay;
 	} pipelines;
 
@@ -73,6 +109,8 @@ public:
 
 	vks::Texture shadowCubeMap;
 	std::array<VkImageView, 6> shadowCubeMapFaceImageViews;
+	// View of all cube map faces as an array, used as the color attachment of the layered pass
+	VkImageView shadowCubeMapLayeredView;
 
 	// Framebuffer for offscreen rendering
 	struct FrameBufferAttachment {
@@ -83,7 +121,10 @@ public:
 	struct OffscreenPass {
 		int32_t width, height;
 		std::array<VkFramebuffer, 6> frameBuffers;
+		VkFramebuffer frameBufferLayered;
+		// The depth attachment has one layer per cube map face, the per face passes only use the first layer
 		FrameBufferAttachment depth;
+		VkImageView depthLayeredView;
 		VkRenderPass renderPass;
 		VkSampler sampler;
 		VkDescriptorImageInfo descriptor;
@@ -101,6 +142,16 @@ public:
 		timerSpeed *= 0.5f;
 	}
 
+	void getEnabledExtensions()
+	{
+		// Writing the layer from the vertex shader allows rendering all cube map faces in a single pass
+		layeredSupported = vulkanDevice->extensionSupported(VK_EXT_SHADER_VIEWPORT_INDEX_LAYER_EXTENSION_NAME);
+		if (layeredSupported) {
+			enabledDeviceExtensions.push_back(VK_EXT_SHADER_VIEWPORT_INDEX_LAYER_EXTENSION_NAME);
+			shadowPass = SinglePassLayered;
+		}
+	}
+
 	~VulkanExample()
 	{
 		// Clean up used Vulkan resources
@@ -111,6 +162,7 @@ public:
 		{
 			vkDestroyImageView(device, shadowCubeMapFaceImageViews[i], nullptr);
 		}
+		vkDestroyImageView(device, shadowCubeMapLayeredView, nullptr);
 
 		vkDestroyImageView(device, shadowCubeMap.view, nullptr);
 		vkDestroyImage(device, shadowCubeMap.image, nullptr);
@@ -119,6 +171,7 @@ public:
 
 		// Depth attachment
 		vkDestroyImageView(device, offscreenPass.depth.view, nullptr);
+		vkDestroyImageView(device, offscreenPass.depthLayeredView, nullptr);
 		vkDestroyImage(device, offscreenPass.depth.image, nullptr);
 		vkFreeMemory(device, offscreenPass.depth.mem, nullptr);
 
@@ -126,12 +179,16 @@ public:
 		{
 			vkDestroyFramebuffer(device, offscreenPass.frameBuffers[i], nullptr);
 		}
+		vkDestroyFramebuffer(device, offscreenPass.frameBufferLayered, nullptr);
 
 		vkDestroyRenderPass(device, offscreenPass.renderPass, nullptr);
 
 		// Pipelines
 		vkDestroyPipeline(device, pipelines.scene, nullptr);
 		vkDestroyPipeline(device, pipelines.offscreen, nullptr);
+		if (layeredSupported) {
+			vkDestroyPipeline(device, pipelines.offscreenLayered, nullptr);
+		}
 		vkDestroyPipeline(device, pipelines.cubemapDisplay, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayouts.scene, nullptr);
@@ -142,6 +199,7 @@ public:
 		// Uniform buffers
 		uniformBuffers.offscreen.destroy();
 		uniformBuffers.scene.destroy();
+		faceIndexBuffer.destroy();
 	}
 
 	void prepareCubeMap()
@@ -232,11 +290,15 @@ public:
 			view.subresourceRange.baseArrayLayer = i;
 			VK_CHECK_RESULT(vkCreateImageView(device, &view, nullptr, &shadowCubeMapFaceImageViews[i]));
 		}
+
+		view.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		view.subresourceRange.baseArrayLayer = 0;
+		view.subresourceRange.layerCount = 6;
+		VK_CHECK_RESULT(vkCreateImageView(device, &view, nullptr, &shadowCubeMapLayeredView));
 	}
 
-	// Prepare a new framebuffer for offscreen rendering
-	// The contents of this framebuffer are then
-	// copied to the different cube map faces
+	// Prepare the framebuffers for offscreen rendering
+	// These render directly to the cube map faces
 	void prepareOffscreenFramebuffer()
 	{
 		offscreenPass.width = FB_DIM;
@@ -276,6 +338,7 @@ public:
 		// Depth stencil attachment
 		imageCreateInfo.format = fbDepthFormat;
 		imageCreateInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		imageCreateInfo.arrayLayers = 6;
 
 		VkImageViewCreateInfo depthStencilView = vks::initializers::imageViewCreateInfo();
 		depthStencilView.viewType = VK_IMAGE_VIEW_TYPE_2D;
@@ -301,18 +364,24 @@ public:
 		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &offscreenPass.depth.mem));
 		VK_CHECK_RESULT(vkBindImageMemory(device, offscreenPass.depth.image, offscreenPass.depth.mem, 0));
 
+		VkImageSubresourceRange depthSubresourceRange = depthStencilView.subresourceRange;
+		depthSubresourceRange.layerCount = 6;
 		vks::tools::setImageLayout(
 			layoutCmd,
 			offscreenPass.depth.image,
-			VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT,
 			VK_IMAGE_LAYOUT_UNDEFINED,
-			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			depthSubresourceRange);
 
 		vulkanDevice->flushCommandBuffer(layoutCmd, queue, true);
 
 		depthStencilView.image = offscreenPass.depth.image;
 		VK_CHECK_RESULT(vkCreateImageView(device, &depthStencilView, nullptr, &offscreenPass.depth.view));
 
+		depthStencilView.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		depthStencilView.subresourceRange.layerCount = 6;
+		VK_CHECK_RESULT(vkCreateImageView(device, &depthStencilView, nullptr, &offscreenPass.depthLayeredView));
+
 		VkImageView attachments[2];
 		attachments[1] = offscreenPass.depth.view;
 
@@ -329,28 +398,17 @@ public:
 			attachments[0] = shadowCubeMapFaceImageViews[i];
 			VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &offscreenPass.frameBuffers[i]));
 		}
+
+		// The layered pass renders to all faces (and depth layers) using a single framebuffer
+		attachments[0] = shadowCubeMapLayeredView;
+		attachments[1] = offscreenPass.depthLayeredView;
+		fbufCreateInfo.layers = 6;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &offscreenPass.frameBufferLayered));
 	}
 
-	// Updates a single cube map face
-	// Renders the scene with face's view directly to the cubemap layer `faceIndex`
-	// Uses push constants for quick update of view matrix for the current cube map face
-	void updateCubeFace(uint32_t faceIndex, VkCommandBuffer commandBuffer)
+	// Returns the view matrix for the given cube map face
+	glm::mat4 getCubeFaceViewMatrix(uint32_t faceIndex)
 	{
-		VkClearValue clearValues[2];
-		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
-		clearValues[1].depthStencil = { 1.0f, 0 };
-
-		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-		// Reuse render pass from example pass
-		renderPassBeginInfo.renderPass = offscreenPass.renderPass;
-		renderPassBeginInfo.framebuffer = offscreenPass.frameBuffers[faceIndex];
-		renderPassBeginInfo.renderArea.extent.width = offscreenPass.width;
-		renderPassBeginInfo.renderArea.extent.height = offscreenPass.height;
-		renderPassBeginInfo.clearValueCount = 2;
-		renderPassBeginInfo.pClearValues = clearValues;
-
-		// Update view matrix via push constant
-
 		glm::mat4 viewMatrix = glm::mat4(1.0f);
 		switch (faceIndex)
 		{
@@ -375,6 +433,29 @@ public:
 			viewMatrix = glm::rotate(viewMatrix, glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 			break;
 		}
+		return viewMatrix;
+	}
+
+	// Updates a single cube map face
+	// Renders the scene's primitives that intersect the face's frustum with face's view directly to the cubemap layer `faceIndex`
+	// Uses push constants for quick update of view matrix for the current cube map face
+	void updateCubeFace(uint32_t faceIndex, VkCommandBuffer commandBuffer, vks::Frustum &frustum)
+	{
+		VkClearValue clearValues[2];
+		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		// Reuse render pass from example pass
+		renderPassBeginInfo.renderPass = offscreenPass.renderPass;
+		renderPassBeginInfo.framebuffer = offscreenPass.frameBuffers[faceIndex];
+		renderPassBeginInfo.renderArea.extent.width = offscreenPass.width;
+		renderPassBeginInfo.renderArea.extent.height = offscreenPass.height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+
+		// Update view matrix via push constant
+		glm::mat4 viewMatrix = uboOffscreenVS.faceViews[faceIndex];
 
 		// Render scene from cube face's point of view
 		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
@@ -391,84 +472,152 @@ public:
 
 		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreen);
 		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.offscreen, 0, 1, &descriptorSets.offscreen, 0, NULL);
-		models.scene.draw(commandBuffer);
+		const VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &models.scene.vertices.buffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, models.scene.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+		for (auto &caster : shadowCasters) {
+			if (frustum.checkSphere(caster.center, caster.radius)) {
+				vkCmdDrawIndexed(commandBuffer, caster.indexCount, 1, caster.firstIndex, 0, 0);
+				shadowDrawCount++;
+			}
+		}
+
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
+	// Updates all cube map faces in a single pass
+	// Each primitive is drawn with one instance per face whose frustum it intersects, the instance's face index selects the view matrix and the layer to render to
+	void updateCubeFacesLayered(VkCommandBuffer commandBuffer, std::array<vks::Frustum, 6> &frustums)
+	{
+		VkClearValue clearValues[2];
+		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+		clearValues[1].depthStencil = { 1.0f, 0 };
+
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = offscreenPass.renderPass;
+		renderPassBeginInfo.framebuffer = offscreenPass.frameBufferLayered;
+		renderPassBeginInfo.renderArea.extent.width = offscreenPass.width;
+		renderPassBeginInfo.renderArea.extent.height = offscreenPass.height;
+		renderPassBeginInfo.clearValueCount = 2;
+		renderPassBeginInfo.pClearValues = clearValues;
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.offscreenLayered);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.offscreen, 0, 1, &descriptorSets.offscreen, 0, NULL);
+		const VkDeviceSize offsets[1] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &models.scene.vertices.buffer, offsets);
+		vkCmdBindVertexBuffers(commandBuffer, 1, 1, &faceIndexBuffer.buffer, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, models.scene.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+
+		// The face indices of all instances of a primitive are stored consecutively, starting at the draw's first instance
+		uint32_t* faceIndices = (uint32_t*)faceIndexBuffer.mapped;
+		uint32_t instanceCount = 0;
+		for (auto &caster : shadowCasters) {
+			const uint32_t firstInstance = instanceCount;
+			for (uint32_t face = 0; face < 6; face++) {
+				if (frustums[face].checkSphere(caster.center, caster.radius)) {
+					faceIndices[instanceCount++] = face;
+				}
+			}
+			if (instanceCount > firstInstance) {
+				vkCmdDrawIndexed(commandBuffer, caster.indexCount, instanceCount - firstInstance, caster.firstIndex, 0, firstInstance);
+			}
+		}
+		shadowDrawCount = instanceCount;
 
 		vkCmdEndRenderPass(commandBuffer);
 	}
 
-	void buildCommandBuffers()
+	// The command buffer is recorded every frame, as the primitives rendered to the cube map faces depend on the light's position
+	void buildCommandBuffer(uint32_t index)
 	{
+		VkCommandBuffer commandBuffer = drawCmdBuffers[index];
+
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+
+		gpuProfiler.cmdBeginFrame(commandBuffer, index);
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
+		/*
+			Generate shadow cube map
+		*/
 		{
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+			VkViewport viewport = vks::initializers::viewport((float)offscreenPass.width, (float)offscreenPass.height, 0.0f, 1.0f);
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-			/*
-				Generate shadow cube maps using one render pass per face
-			*/
-			{
-				VkViewport viewport = vks::initializers::viewport((float)offscreenPass.width, (float)offscreenPass.height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+			VkRect2D scissor = vks::initializers::rect2D(offscreenPass.width, offscreenPass.height, 0, 0);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-				VkRect2D scissor = vks::initializers::rect2D(offscreenPass.width, offscreenPass.height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+			// Frustums of the cube map faces, matching the transformation done in the offscreen vertex shaders
+			std::array<vks::Frustum, 6> frustums;
+			for (uint32_t face = 0; face < 6; face++) {
+				frustums[face].update(uboOffscreenVS.projection * uboOffscreenVS.faceViews[face] * uboOffscreenVS.model);
+			}
 
+			shadowDrawCount = 0;
+			gpuProfiler.cmdBeginScope(commandBuffer, index, "Shadow cube map");
+			if (shadowPass == SinglePassLayered) {
+				updateCubeFacesLayered(commandBuffer, frustums);
+			} else {
 				for (uint32_t face = 0; face < 6; face++) {
-					updateCubeFace(face, drawCmdBuffers[i]);
+					updateCubeFace(face, commandBuffer, frustums[face]);
 				}
 			}
+			gpuProfiler.cmdEndScope(commandBuffer, index, "Shadow cube map");
+		}
 
-			/*
-				Note: Explicit synchronization is not required between the render pass, as this is done implicit via sub pass dependencies
-			*/
+		/*
+			Note: Explicit synchronization is not required between the render pass, as this is done implicit via sub pass dependencies
+		*/
 
-			/*
-				Scene rendering with applied shadow map
-			*/
-			{
-				VkClearValue clearValues[2];
-				clearValues[0].color = defaultClearColor;
-				clearValues[1].depthStencil = { 1.0f, 0 };
-
-				VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-				renderPassBeginInfo.renderPass = renderPass;
-				renderPassBeginInfo.framebuffer = frameBuffers[i];
-				renderPassBeginInfo.renderArea.extent.width = width;
-				renderPassBeginInfo.renderArea.extent.height = height;
-				renderPassBeginInfo.clearValueCount = 2;
-				renderPassBeginInfo.pClearValues = clearValues;
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-
-				VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.scene, 0, NULL);
-
-				if (displayCubeMap)
-				{
-					// Display all six sides of the shadow cube map
-					// Note: Visualization of the different faces is done in the fragment shader, see cubemapdisplay.frag
-					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.cubemapDisplay);
-					models.debugcube.draw(drawCmdBuffers[i]);
-				}
-				else
-				{
-					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.scene);
-					models.scene.draw(drawCmdBuffers[i]);
-				}
+		/*
+			Scene rendering with applied shadow map
+		*/
+		{
+			VkClearValue clearValues[2];
+			clearValues[0].color = defaultClearColor;
+			clearValues[1].depthStencil = { 1.0f, 0 };
+
+			VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+			renderPassBeginInfo.renderPass = renderPass;
+			renderPassBeginInfo.framebuffer = frameBuffers[index];
+			renderPassBeginInfo.renderArea.extent.width = width;
+			renderPassBeginInfo.renderArea.extent.height = height;
+			renderPassBeginInfo.clearValueCount = 2;
+			renderPassBeginInfo.pClearValues = clearValues;
+
+			gpuProfiler.cmdBeginScope(commandBuffer, index, "Scene");
+			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-				drawUI(drawCmdBuffers[i]);
+			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.scene, 0, 1, &descriptorSets.scene, 0, NULL);
+
+			if (displayCubeMap)
+			{
+				// Display all six sides of the shadow cube map
+				// Note: Visualization of the different faces is done in the fragment shader, see cubemapdisplay.frag
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.cubemapDisplay);
+				models.debugcube.draw(commandBuffer);
+			}
+			else
+			{
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.scene);
+				models.scene.draw(commandBuffer);
 			}
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+			vkCmdEndRenderPass(commandBuffer);
+			gpuProfiler.cmdEndScope(commandBuffer, index, "Scene");
 		}
+
+		gpuProfiler.cmdEndFrame(commandBuffer, index);
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 	}
 
 	void loadAssets()
@@ -478,6 +627,41 @@ public:
 		models.scene.loadFromFile(getAssetPath() + "models/shadowscene_fire.gltf", vulkanDevice, queue, glTFLoadingFlags);
 	}
 
+	// Gathers the primitives of the scene along with their world space bounding spheres for culling them against the cube map faces
+	void prepareShadowCasters()
+	{
+		for (auto node : models.scene.linearNodes) {
+			if (!node->mesh) {
+				continue;
+			}
+			// The primitive's dimensions are in mesh space, while the vertices have been pre-transformed and flipped at load time
+			const glm::mat4 localMatrix = node->getMatrix();
+			for (auto primitive : node->mesh->primitives) {
+				glm::vec3 min = glm::vec3(FLT_MAX);
+				glm::vec3 max = glm::vec3(-FLT_MAX);
+				for (uint32_t i = 0; i < 8; i++) {
+					const glm::vec3 corner = glm::vec3(
+						(i & 1) ? primitive->dimensions.max.x : primitive->dimensions.min.x,
+						(i & 2) ? primitive->dimensions.max.y : primitive->dimensions.min.y,
+						(i & 4) ? primitive->dimensions.max.z : primitive->dimensions.min.z);
+					glm::vec3 pos = glm::vec3(localMatrix * glm::vec4(corner, 1.0f));
+					pos.y *= -1.0f;
+					min = glm::min(min, pos);
+					max = glm::max(max, pos);
+				}
+				shadowCasters.push_back({ primitive->firstIndex, primitive->indexCount, (min + max) * 0.5f, glm::distance(min, max) * 0.5f });
+			}
+		}
+
+		// Per-instance face indices of the layered pass, sized for the worst case of every primitive being rendered to all faces
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&faceIndexBuffer,
+			std::max<size_t>(shadowCasters.size(), 1) * 6 * sizeof(uint32_t)));
+		VK_CHECK_RESULT(faceIndexBuffer.map());
+	}
+
 	void setupDescriptorPool()
 	{
 		// Example uses three ubos and two image samplers
@@ -638,6 +822,27 @@ public:
 		pipelineCI.renderPass = offscreenPass.renderPass;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.offscreen));
 
+		// Layered offscreen pipeline
+		// The cube map face of each instance is passed as a per-instance vertex attribute
+		if (layeredSupported) {
+			std::array<VkVertexInputBindingDescription, 2> vertexInputBindings = {
+				vkglTF::Vertex::inputBindingDescription(0),
+				vks::initializers::vertexInputBindingDescription(1, sizeof(uint32_t), VK_VERTEX_INPUT_RATE_INSTANCE),
+			};
+			std::array<VkVertexInputAttributeDescription, 2> vertexInputAttributes = {
+				vkglTF::Vertex::inputAttributeDescription(0, 0, vkglTF::VertexComponent::Position),
+				vks::initializers::vertexInputAttributeDescription(1, 1, VK_FORMAT_R32_UINT, 0),
+			};
+			VkPipelineVertexInputStateCreateInfo layeredInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+			layeredInputState.vertexBindingDescriptionCount = static_cast<uint32_t>(vertexInputBindings.size());
+			layeredInputState.pVertexBindingDescriptions = vertexInputBindings.data();
+			layeredInputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInputAttributes.size());
+			layeredInputState.pVertexAttributeDescriptions = vertexInputAttributes.data();
+			pipelineCI.pVertexInputState = &layeredInputState;
+			shaderStages[0] = loadShader(getShadersPath() + "shadowmappingomni/offscreenlayered.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.offscreenLayered));
+		}
+
 		// Cube map display pipeline
 		shaderStages[0] = loadShader(getShadersPath() + "shadowmappingomni/cubemapdisplay.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "shadowmappingomni/cubemapdisplay.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
@@ -691,12 +896,16 @@ public:
 		uboOffscreenVS.view = glm::mat4(1.0f);
 		uboOffscreenVS.model = glm::translate(glm::mat4(1.0f), glm::vec3(-lightPos.x, -lightPos.y, -lightPos.z));
 		uboOffscreenVS.lightPos = lightPos;
+		for (uint32_t i = 0; i < 6; i++) {
+			uboOffscreenVS.faceViews[i] = getCubeFaceViewMatrix(i);
+		}
 		memcpy(uniformBuffers.offscreen.mapped, &uboOffscreenVS, sizeof(uboOffscreenVS));
 	}
 
 	void draw()
 	{
 		VulkanExampleBase::prepareFrame();
+		buildCommandBuffer(currentBuffer);
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
@@ -707,6 +916,7 @@ public:
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
+		prepareShadowCasters();
 		prepareUniformBuffers();
 		prepareCubeMap();
 		setupDescriptorSetLayout();
@@ -715,7 +925,6 @@ public:
 		setupDescriptorPool();
 		setupDescriptorSets();
 		prepareOffscreenFramebuffer();
-		buildCommandBuffers();
 		prepared = true;
 	}
 
@@ -723,20 +932,23 @@ public:
 	{
 		if (!prepared)
 			return;
-		draw();
+		// The light position needs to be updated before recording the command buffer, as the cube map faces are culled against it
 		if (!paused || camera.updated)
 		{
 			updateUniformBufferOffscreen();
 			updateUniformBuffers();
 		}
+		draw();
 	}
 
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
-			if (overlay->checkBox("Display shadow cube render target", &displayCubeMap)) {
-				buildCommandBuffers();
+			overlay->checkBox("Display shadow cube render target", &displayCubeMap);
+			if (layeredSupported) {
+				overlay->comboBox("Shadow pass", &shadowPass, { "Per face passes", "Single pass (layered)" });
 			}
+			overlay->text("Shadow draws: %d", shadowDrawCount);
 		}
 	}
 };
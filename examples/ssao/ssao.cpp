@@ -13,6 +13,9 @@
 
 #define SSAO_KERNEL_SIZE 64
 #define SSAO_RADIUS 0.3f
+// Samples per pixel and frame for the reduced resolution modes, must be a divisor of SSAO_KERNEL_SIZE
+// Each frame uses a different subset of the kernel, so all samples are covered by the temporal accumulation
+#define SSAO_REDUCED_SAMPLE_COUNT 16
 
 #if defined(__ANDROID__)
 #define SSAO_NOISE_DIM 8
@@ -42,13 +45,33 @@ public:
 		int32_t ssao = true;
 		int32_t ssaoOnly = false;
 		int32_t ssaoBlur = true;
+		// Used to rotate the noise and select the kernel subset per frame when accumulating temporally
+		uint32_t frameIndex = 0;
 	} uboSSAOParams;
 
+	struct UBOTemporalParams {
+		// Transforms current view space positions into the previous frame's clip space
+		glm::mat4 reprojection;
+		float blendFactor = 0.1f;
+		int32_t historyValid = false;
+	} uboTemporalParams;
+
+	// Performance modes compute the occlusion at reduced resolution with fewer samples, accumulate it over time and upsample it to full resolution
+	enum SSAOMode { SSAO_MODE_FULL = 0, SSAO_MODE_HALF = 1, SSAO_MODE_QUARTER = 2 };
+	int32_t ssaoMode = SSAO_MODE_FULL;
+	bool temporalAccumulation = true;
+	bool historyValid = false;
+	glm::mat4 previousView;
+
 	struct {
 		VkPipeline offscreen;
 		VkPipeline composition;
 		VkPipeline ssao;
 		VkPipeline ssaoBlur;
+		VkPipeline ssaoReduced;
+		VkPipeline downsample;
+		VkPipeline temporal;
+		VkPipeline upsample;
 	} pipelines;
 
 	struct {
@@ -56,6 +79,8 @@ public:
 		VkPipelineLayout ssao;
 		VkPipelineLayout ssaoBlur;
 		VkPipelineLayout composition;
+		VkPipelineLayout resample;
+		VkPipelineLayout temporal;
 	} pipelineLayouts;
 
 	struct {
@@ -72,12 +97,16 @@ public:
 		VkDescriptorSetLayout ssao;
 		VkDescriptorSetLayout ssaoBlur;
 		VkDescriptorSetLayout composition;
+		// Two input images, shared by the downsample and upsample passes
+		VkDescriptorSetLayout resample;
+		VkDescriptorSetLayout temporal;
 	} descriptorSetLayouts;
 
 	struct {
 		vks::Buffer sceneParams;
 		vks::Buffer ssaoKernel;
 		vks::Buffer ssaoParams;
+		vks::Buffer temporalParams;
 	} uniformBuffers;
 
 	// Framebuffer for offscreen rendering
@@ -118,6 +147,26 @@ public:
 		} ssao, ssaoBlur;
 	} frameBuffers;
 
+	// Targets for the reduced resolution modes, the first level is at half and the second at quarter resolution
+	struct ReducedResolutionLevel {
+		// Downsampled G-Buffer (positions+depth and normals), each level is created from the previous one
+		struct DepthNormal : public FrameBuffer {
+			FrameBufferAttachment position, normal;
+		} depthNormal;
+		struct ColorTarget : public FrameBuffer {
+			FrameBufferAttachment color;
+		} ssao, temporal;
+		// Accumulated occlusion of the previous frame, copied from the temporal target
+		FrameBufferAttachment history;
+		struct {
+			VkDescriptorSet downsample;
+			VkDescriptorSet ssao;
+			VkDescriptorSet temporal;
+			VkDescriptorSet upsample;
+		} descriptorSets;
+	};
+	std::array<ReducedResolutionLevel, 2> reducedLevels;
+
 	// One sampler for the frame buffer color attachments
 	VkSampler colorSampler;
 
@@ -150,25 +199,45 @@ public:
 		frameBuffers.ssao.destroy(device);
 		frameBuffers.ssaoBlur.destroy(device);
 
+		for (auto &level : reducedLevels) {
+			level.depthNormal.position.destroy(device);
+			level.depthNormal.normal.destroy(device);
+			level.ssao.color.destroy(device);
+			level.temporal.color.destroy(device);
+			level.history.destroy(device);
+			level.depthNormal.destroy(device);
+			level.ssao.destroy(device);
+			level.temporal.destroy(device);
+		}
+
 		vkDestroyPipeline(device, pipelines.offscreen, nullptr);
 		vkDestroyPipeline(device, pipelines.composition, nullptr);
 		vkDestroyPipeline(device, pipelines.ssao, nullptr);
 		vkDestroyPipeline(device, pipelines.ssaoBlur, nullptr);
+		vkDestroyPipeline(device, pipelines.ssaoReduced, nullptr);
+		vkDestroyPipeline(device, pipelines.downsample, nullptr);
+		vkDestroyPipeline(device, pipelines.temporal, nullptr);
+		vkDestroyPipeline(device, pipelines.upsample, nullptr);
 
 		vkDestroyPipelineLayout(device, pipelineLayouts.gBuffer, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.ssao, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.ssaoBlur, nullptr);
 		vkDestroyPipelineLayout(device, pipelineLayouts.composition, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.resample, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayouts.temporal, nullptr);
 
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.gBuffer, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.ssao, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.ssaoBlur, nullptr);
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.composition, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.resample, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorSetLayouts.temporal, nullptr);
 
 		// Uniform buffers
 		uniformBuffers.sceneParams.destroy();
 		uniformBuffers.ssaoKernel.destroy();
 		uniformBuffers.ssaoParams.destroy();
+		uniformBuffers.temporalParams.destroy();
 
 		textures.ssaoNoise.destroy();
 	}
@@ -483,6 +552,100 @@ public:
 		VK_CHECK_RESULT(vkCreateSampler(device, &sampler, nullptr, &colorSampler));
 	}
 
+	// Create a render pass and frame buffer for a fullscreen pass writing to the given color attachments
+	// The attachments are sampled by later passes or copied after the render pass
+	void prepareColorFramebuffer(FrameBuffer &frameBuffer, const std::vector<FrameBufferAttachment*> &colorAttachments)
+	{
+		std::vector<VkAttachmentDescription> attachmentDescs(colorAttachments.size());
+		std::vector<VkAttachmentReference> colorReferences;
+		std::vector<VkImageView> attachments;
+		for (uint32_t i = 0; i < static_cast<uint32_t>(colorAttachments.size()); i++)
+		{
+			attachmentDescs[i].format = colorAttachments[i]->format;
+			attachmentDescs[i].samples = VK_SAMPLE_COUNT_1_BIT;
+			attachmentDescs[i].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachmentDescs[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+			attachmentDescs[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+			attachmentDescs[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			attachmentDescs[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			attachmentDescs[i].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			colorReferences.push_back({ i, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
+			attachments.push_back(colorAttachments[i]->view);
+		}
+
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.pColorAttachments = colorReferences.data();
+		subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+
+		std::array<VkSubpassDependency, 2> dependencies;
+
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].srcAccessMask = 0;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		VkRenderPassCreateInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.pAttachments = attachmentDescs.data();
+		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachmentDescs.size());
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+		renderPassInfo.pDependencies = dependencies.data();
+		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &frameBuffer.renderPass));
+
+		VkFramebufferCreateInfo fbufCreateInfo = vks::initializers::framebufferCreateInfo();
+		fbufCreateInfo.renderPass = frameBuffer.renderPass;
+		fbufCreateInfo.pAttachments = attachments.data();
+		fbufCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		fbufCreateInfo.width = frameBuffer.width;
+		fbufCreateInfo.height = frameBuffer.height;
+		fbufCreateInfo.layers = 1;
+		VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &frameBuffer.frameBuffer));
+	}
+
+	// Targets for computing the occlusion at half and quarter resolution
+	void prepareReducedResolutionFramebuffers()
+	{
+		VkCommandBuffer layoutCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		for (uint32_t i = 0; i < static_cast<uint32_t>(reducedLevels.size()); i++)
+		{
+			ReducedResolutionLevel &level = reducedLevels[i];
+			const uint32_t levelWidth = std::max(width >> (i + 1), 1u);
+			const uint32_t levelHeight = std::max(height >> (i + 1), 1u);
+			level.depthNormal.setSize(levelWidth, levelHeight);
+			level.ssao.setSize(levelWidth, levelHeight);
+			level.temporal.setSize(levelWidth, levelHeight);
+
+			createAttachment(VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &level.depthNormal.position, levelWidth, levelHeight);	// Position + Depth
+			createAttachment(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &level.depthNormal.normal, levelWidth, levelHeight);		// Normals
+			createAttachment(VK_FORMAT_R8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, &level.ssao.color, levelWidth, levelHeight);						// Occlusion
+			// Accumulated occlusion + view space depth
+			createAttachment(VK_FORMAT_R16G16_SFLOAT, (VkImageUsageFlagBits)(VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT), &level.temporal.color, levelWidth, levelHeight);
+			createAttachment(VK_FORMAT_R16G16_SFLOAT, (VkImageUsageFlagBits)(VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT), &level.history, levelWidth, levelHeight);
+
+			prepareColorFramebuffer(level.depthNormal, { &level.depthNormal.position, &level.depthNormal.normal });
+			prepareColorFramebuffer(level.ssao, { &level.ssao.color });
+			prepareColorFramebuffer(level.temporal, { &level.temporal.color });
+
+			// The history is only ever sampled or copied to, so it's kept in shader read layout between frames
+			vks::tools::setImageLayout(layoutCmd, level.history.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		}
+		vulkanDevice->flushCommandBuffer(layoutCmd, queue, true);
+	}
+
 	void loadAssets()
 	{
 		vkglTF::descriptorBindingFlags  = vkglTF::DescriptorBindingFlags::ImageBaseColor;
@@ -490,6 +653,69 @@ public:
 		scene.loadFromFile(getAssetPath() + "models/sponza/sponza.gltf", vulkanDevice, queue, gltfLoadingFlags);
 	}
 
+	// Record a fullscreen pass into the given frame buffer
+	void drawFullscreenPass(VkCommandBuffer commandBuffer, FrameBuffer &frameBuffer, VkPipeline pipeline, VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet)
+	{
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = frameBuffer.renderPass;
+		renderPassBeginInfo.framebuffer = frameBuffer.frameBuffer;
+		renderPassBeginInfo.renderArea.extent.width = frameBuffer.width;
+		renderPassBeginInfo.renderArea.extent.height = frameBuffer.height;
+		// Only used by render passes that clear their attachments (e.g. the blur target)
+		std::array<VkClearValue, 2> clearValues;
+		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+		clearValues[1].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+		renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+		renderPassBeginInfo.pClearValues = clearValues.data();
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		VkViewport viewport = vks::initializers::viewport((float)frameBuffer.width, (float)frameBuffer.height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		VkRect2D scissor = vks::initializers::rect2D(frameBuffer.width, frameBuffer.height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
+	/*
+		Reduced resolution SSAO: Downsample the G-Buffer, compute the occlusion with fewer samples, accumulate it with
+		the reprojected result of the previous frame and upsample it into the (full resolution) blur target
+	*/
+	void buildReducedResolutionCommands(VkCommandBuffer commandBuffer, uint32_t frameIndex)
+	{
+		const uint32_t levelIndex = (ssaoMode == SSAO_MODE_HALF) ? 0 : 1;
+		ReducedResolutionLevel &level = reducedLevels[levelIndex];
+
+		gpuProfiler.cmdBeginScope(commandBuffer, frameIndex, "SSAO downsample");
+		for (uint32_t i = 0; i <= levelIndex; i++) {
+			drawFullscreenPass(commandBuffer, reducedLevels[i].depthNormal, pipelines.downsample, pipelineLayouts.resample, reducedLevels[i].descriptorSets.downsample);
+		}
+		gpuProfiler.cmdEndScope(commandBuffer, frameIndex, "SSAO downsample");
+
+		gpuProfiler.cmdBeginScope(commandBuffer, frameIndex, "SSAO");
+		drawFullscreenPass(commandBuffer, level.ssao, pipelines.ssaoReduced, pipelineLayouts.ssao, level.descriptorSets.ssao);
+		gpuProfiler.cmdEndScope(commandBuffer, frameIndex, "SSAO");
+
+		gpuProfiler.cmdBeginScope(commandBuffer, frameIndex, "SSAO temporal");
+		drawFullscreenPass(commandBuffer, level.temporal, pipelines.temporal, pipelineLayouts.temporal, level.descriptorSets.temporal);
+		// Keep the accumulated result as the history for the next frame
+		vks::tools::setImageLayout(commandBuffer, level.temporal.color.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		vks::tools::setImageLayout(commandBuffer, level.history.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		VkImageCopy copyRegion = {};
+		copyRegion.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		copyRegion.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		copyRegion.extent = { (uint32_t)level.temporal.width, (uint32_t)level.temporal.height, 1 };
+		vkCmdCopyImage(commandBuffer, level.temporal.color.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, level.history.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+		vks::tools::setImageLayout(commandBuffer, level.temporal.color.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+		vks::tools::setImageLayout(commandBuffer, level.history.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+		gpuProfiler.cmdEndScope(commandBuffer, frameIndex, "SSAO temporal");
+
+		gpuProfiler.cmdBeginScope(commandBuffer, frameIndex, "SSAO upsample");
+		drawFullscreenPass(commandBuffer, frameBuffers.ssaoBlur, pipelines.upsample, pipelineLayouts.resample, level.descriptorSets.upsample);
+		gpuProfiler.cmdEndScope(commandBuffer, frameIndex, "SSAO upsample");
+	}
+
 	void buildCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
@@ -498,6 +724,8 @@ public:
 		{
 			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
 
+			gpuProfiler.cmdBeginFrame(drawCmdBuffers[i], i);
+
 			/*
 				Offscreen SSAO generation
 			*/
@@ -521,6 +749,7 @@ public:
 					First pass: Fill G-Buffer components (positions+depth, normals, albedo) using MRT
 				*/
 
+				gpuProfiler.cmdBeginScope(drawCmdBuffers[i], i, "G-Buffer");
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 				VkViewport viewport = vks::initializers::viewport((float)frameBuffers.offscreen.width, (float)frameBuffers.offscreen.height, 0.0f, 1.0f);
@@ -535,55 +764,67 @@ public:
 				scene.draw(drawCmdBuffers[i], vkglTF::RenderFlags::BindImages, pipelineLayouts.gBuffer);
 
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-				/*
-					Second pass: SSAO generation
-				*/
-
-				clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
-				clearValues[1].depthStencil = { 1.0f, 0 };
-
-				renderPassBeginInfo.framebuffer = frameBuffers.ssao.frameBuffer;
-				renderPassBeginInfo.renderPass = frameBuffers.ssao.renderPass;
-				renderPassBeginInfo.renderArea.extent.width = frameBuffers.ssao.width;
-				renderPassBeginInfo.renderArea.extent.height = frameBuffers.ssao.height;
-				renderPassBeginInfo.clearValueCount = 2;
-				renderPassBeginInfo.pClearValues = clearValues.data();
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				viewport = vks::initializers::viewport((float)frameBuffers.ssao.width, (float)frameBuffers.ssao.height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-				scissor = vks::initializers::rect2D(frameBuffers.ssao.width, frameBuffers.ssao.height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssao, 0, 1, &descriptorSets.ssao, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssao);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
-
-				/*
-					Third pass: SSAO blur
-				*/
-
-				renderPassBeginInfo.framebuffer = frameBuffers.ssaoBlur.frameBuffer;
-				renderPassBeginInfo.renderPass = frameBuffers.ssaoBlur.renderPass;
-				renderPassBeginInfo.renderArea.extent.width = frameBuffers.ssaoBlur.width;
-				renderPassBeginInfo.renderArea.extent.height = frameBuffers.ssaoBlur.height;
-
-				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				viewport = vks::initializers::viewport((float)frameBuffers.ssaoBlur.width, (float)frameBuffers.ssaoBlur.height, 0.0f, 1.0f);
-				vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
-				scissor = vks::initializers::rect2D(frameBuffers.ssaoBlur.width, frameBuffers.ssaoBlur.height, 0, 0);
-				vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-				vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssaoBlur, 0, 1, &descriptorSets.ssaoBlur, 0, NULL);
-				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssaoBlur);
-				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
-
-				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				gpuProfiler.cmdEndScope(drawCmdBuffers[i], i, "G-Buffer");
+
+				if (ssaoMode == SSAO_MODE_FULL)
+				{
+					/*
+						Second pass: SSAO generation
+					*/
+
+					clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+					clearValues[1].depthStencil = { 1.0f, 0 };
+
+					renderPassBeginInfo.framebuffer = frameBuffers.ssao.frameBuffer;
+					renderPassBeginInfo.renderPass = frameBuffers.ssao.renderPass;
+					renderPassBeginInfo.renderArea.extent.width = frameBuffers.ssao.width;
+					renderPassBeginInfo.renderArea.extent.height = frameBuffers.ssao.height;
+					renderPassBeginInfo.clearValueCount = 2;
+					renderPassBeginInfo.pClearValues = clearValues.data();
+
+					gpuProfiler.cmdBeginScope(drawCmdBuffers[i], i, "SSAO");
+					vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+					viewport = vks::initializers::viewport((float)frameBuffers.ssao.width, (float)frameBuffers.ssao.height, 0.0f, 1.0f);
+					vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+					scissor = vks::initializers::rect2D(frameBuffers.ssao.width, frameBuffers.ssao.height, 0, 0);
+					vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssao, 0, 1, &descriptorSets.ssao, 0, NULL);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssao);
+					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+
+					vkCmdEndRenderPass(drawCmdBuffers[i]);
+					gpuProfiler.cmdEndScope(drawCmdBuffers[i], i, "SSAO");
+
+					/*
+						Third pass: SSAO blur
+					*/
+
+					renderPassBeginInfo.framebuffer = frameBuffers.ssaoBlur.frameBuffer;
+					renderPassBeginInfo.renderPass = frameBuffers.ssaoBlur.renderPass;
+					renderPassBeginInfo.renderArea.extent.width = frameBuffers.ssaoBlur.width;
+					renderPassBeginInfo.renderArea.extent.height = frameBuffers.ssaoBlur.height;
+
+					gpuProfiler.cmdBeginScope(drawCmdBuffers[i], i, "SSAO blur");
+					vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+					viewport = vks::initializers::viewport((float)frameBuffers.ssaoBlur.width, (float)frameBuffers.ssaoBlur.height, 0.0f, 1.0f);
+					vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+					scissor = vks::initializers::rect2D(frameBuffers.ssaoBlur.width, frameBuffers.ssaoBlur.height, 0, 0);
+					vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
+
+					vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.ssaoBlur, 0, 1, &descriptorSets.ssaoBlur, 0, NULL);
+					vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.ssaoBlur);
+					vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
+
+					vkCmdEndRenderPass(drawCmdBuffers[i]);
+					gpuProfiler.cmdEndScope(drawCmdBuffers[i], i, "SSAO blur");
+				}
+				else
+				{
+					buildReducedResolutionCommands(drawCmdBuffers[i], i);
+				}
 			}
 
 			/*
@@ -606,6 +847,7 @@ public:
 				renderPassBeginInfo.clearValueCount = 2;
 				renderPassBeginInfo.pClearValues = clearValues.data();
 
+				gpuProfiler.cmdBeginScope(drawCmdBuffers[i], i, "Composition");
 				vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 				VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
@@ -620,11 +862,12 @@ public:
 				vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.composition);
 				vkCmdDraw(drawCmdBuffers[i], 3, 1, 0, 0);
 
-				drawUI(drawCmdBuffers[i]);
-
 				vkCmdEndRenderPass(drawCmdBuffers[i]);
+				gpuProfiler.cmdEndScope(drawCmdBuffers[i], i, "Composition");
 			}
 
+			gpuProfiler.cmdEndFrame(drawCmdBuffers[i], i);
+
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 		}
 	}
@@ -632,10 +875,11 @@ public:
 	void setupDescriptorPool()
 	{
 		std::vector<VkDescriptorPoolSize> poolSizes = {
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10),
-			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 12)
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10 + 3 * static_cast<uint32_t>(reducedLevels.size())),
+			vks::initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 12 + 10 * static_cast<uint32_t>(reducedLevels.size()))
 		};
-		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes,  descriptorSets.count);
+		// Each reduced resolution level uses four additional sets (downsample, SSAO, temporal, upsample)
+		VkDescriptorPoolCreateInfo descriptorPoolInfo = vks::initializers::descriptorPoolCreateInfo(poolSizes, descriptorSets.count + 4 * static_cast<uint32_t>(reducedLevels.size()));
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &descriptorPool));
 	}
 
@@ -743,6 +987,75 @@ public:
 			vks::initializers::writeDescriptorSet(descriptorSets.composition, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 5, &uniformBuffers.ssaoParams.descriptor),	// FS SSAO Params UBO
 		};
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+
+		// Downsample and upsample (reduced resolution modes)
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),						// FS Position+Depth (downsample) / SSAO (upsample)
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),						// FS Normals (downsample) / Position+Depth (upsample)
+		};
+		setLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.resample));
+		pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.resample;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.resample));
+
+		// Temporal accumulation (reduced resolution modes)
+		setLayoutBindings = {
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),						// FS SSAO
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),						// FS Position+Depth
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2),						// FS History
+			vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 3),								// FS Temporal Params UBO
+		};
+		setLayoutCreateInfo = vks::initializers::descriptorSetLayoutCreateInfo(setLayoutBindings.data(), static_cast<uint32_t>(setLayoutBindings.size()));
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, nullptr, &descriptorSetLayouts.temporal));
+		pipelineLayoutCreateInfo.pSetLayouts = &descriptorSetLayouts.temporal;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayouts.temporal));
+
+		for (uint32_t i = 0; i < static_cast<uint32_t>(reducedLevels.size()); i++)
+		{
+			ReducedResolutionLevel &level = reducedLevels[i];
+			// The first level is downsampled from the G-Buffer, all others from the previous level
+			const FrameBufferAttachment &srcPosition = (i == 0) ? frameBuffers.offscreen.position : reducedLevels[i - 1].depthNormal.position;
+			const FrameBufferAttachment &srcNormal = (i == 0) ? frameBuffers.offscreen.normal : reducedLevels[i - 1].depthNormal.normal;
+
+			descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.resample;
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &level.descriptorSets.downsample));
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &level.descriptorSets.upsample));
+			descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.ssao;
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &level.descriptorSets.ssao));
+			descriptorAllocInfo.pSetLayouts = &descriptorSetLayouts.temporal;
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &descriptorAllocInfo, &level.descriptorSets.temporal));
+
+			imageDescriptors = {
+				vks::initializers::descriptorImageInfo(colorSampler, srcPosition.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+				vks::initializers::descriptorImageInfo(colorSampler, srcNormal.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+				vks::initializers::descriptorImageInfo(colorSampler, level.depthNormal.position.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+				vks::initializers::descriptorImageInfo(colorSampler, level.depthNormal.normal.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+				vks::initializers::descriptorImageInfo(colorSampler, level.ssao.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+				vks::initializers::descriptorImageInfo(colorSampler, level.history.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+				vks::initializers::descriptorImageInfo(colorSampler, level.temporal.color.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+				vks::initializers::descriptorImageInfo(colorSampler, frameBuffers.offscreen.position.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			};
+			writeDescriptorSets = {
+				// Downsample
+				vks::initializers::writeDescriptorSet(level.descriptorSets.downsample, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[0]),		// FS Source Position+Depth
+				vks::initializers::writeDescriptorSet(level.descriptorSets.downsample, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[1]),		// FS Source Normals
+				// SSAO generation
+				vks::initializers::writeDescriptorSet(level.descriptorSets.ssao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[2]),			// FS Position+Depth
+				vks::initializers::writeDescriptorSet(level.descriptorSets.ssao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[3]),			// FS Normals
+				vks::initializers::writeDescriptorSet(level.descriptorSets.ssao, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &textures.ssaoNoise.descriptor),	// FS SSAO Noise
+				vks::initializers::writeDescriptorSet(level.descriptorSets.ssao, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &uniformBuffers.ssaoKernel.descriptor),	// FS SSAO Kernel UBO
+				vks::initializers::writeDescriptorSet(level.descriptorSets.ssao, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 4, &uniformBuffers.ssaoParams.descriptor),	// FS SSAO Params UBO
+				// Temporal accumulation
+				vks::initializers::writeDescriptorSet(level.descriptorSets.temporal, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[4]),		// FS SSAO
+				vks::initializers::writeDescriptorSet(level.descriptorSets.temporal, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[2]),		// FS Position+Depth
+				vks::initializers::writeDescriptorSet(level.descriptorSets.temporal, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, &imageDescriptors[5]),		// FS History
+				vks::initializers::writeDescriptorSet(level.descriptorSets.temporal, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &uniformBuffers.temporalParams.descriptor),	// FS Temporal Params UBO
+				// Upsample
+				vks::initializers::writeDescriptorSet(level.descriptorSets.upsample, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageDescriptors[6]),		// FS Accumulated SSAO
+				vks::initializers::writeDescriptorSet(level.descriptorSets.upsample, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, &imageDescriptors[7]),		// FS Full resolution Position+Depth
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, NULL);
+		}
 	}
 
 	void preparePipelines()
@@ -796,6 +1109,22 @@ public:
 			shaderStages[1] = loadShader(getShadersPath() + "ssao/ssao.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 			shaderStages[1].pSpecializationInfo = &specializationInfo;
 			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ssao));
+
+			// The reduced resolution modes evaluate only a part of the kernel per frame
+			struct ReducedSpecializationData {
+				uint32_t kernelSize = SSAO_KERNEL_SIZE;
+				float radius = SSAO_RADIUS;
+				uint32_t sampleCount = SSAO_REDUCED_SAMPLE_COUNT;
+			} reducedSpecializationData;
+			std::array<VkSpecializationMapEntry, 3> reducedSpecializationMapEntries = {
+				vks::initializers::specializationMapEntry(0, offsetof(ReducedSpecializationData, kernelSize), sizeof(ReducedSpecializationData::kernelSize)),
+				vks::initializers::specializationMapEntry(1, offsetof(ReducedSpecializationData, radius), sizeof(ReducedSpecializationData::radius)),
+				vks::initializers::specializationMapEntry(2, offsetof(ReducedSpecializationData, sampleCount), sizeof(ReducedSpecializationData::sampleCount))
+			};
+			VkSpecializationInfo reducedSpecializationInfo = vks::initializers::specializationInfo(3, reducedSpecializationMapEntries.data(), sizeof(reducedSpecializationData), &reducedSpecializationData);
+			shaderStages[1].pSpecializationInfo = &reducedSpecializationInfo;
+			pipelineCreateInfo.renderPass = reducedLevels[0].ssao.renderPass;
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ssaoReduced));
 		}
 
 		// SSAO blur pipeline
@@ -806,6 +1135,37 @@ public:
 			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.ssaoBlur));
 		}
 
+		// Depth-aware upsample pipeline (writes to the blur target)
+		{
+			pipelineCreateInfo.renderPass = frameBuffers.ssaoBlur.renderPass;
+			pipelineCreateInfo.layout = pipelineLayouts.resample;
+			shaderStages[1] = loadShader(getShadersPath() + "ssao/upsample.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.upsample));
+		}
+
+		// Temporal accumulation pipeline
+		{
+			// All levels use the same formats, so their render passes are compatible
+			pipelineCreateInfo.renderPass = reducedLevels[0].temporal.renderPass;
+			pipelineCreateInfo.layout = pipelineLayouts.temporal;
+			shaderStages[1] = loadShader(getShadersPath() + "ssao/temporal.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.temporal));
+		}
+
+		// G-Buffer downsample pipeline
+		{
+			pipelineCreateInfo.renderPass = reducedLevels[0].depthNormal.renderPass;
+			pipelineCreateInfo.layout = pipelineLayouts.resample;
+			std::array<VkPipelineColorBlendAttachmentState, 2> blendAttachmentStates = {
+				vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE),
+				vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE)
+			};
+			colorBlendState.attachmentCount = static_cast<uint32_t>(blendAttachmentStates.size());
+			colorBlendState.pAttachments = blendAttachmentStates.data();
+			shaderStages[1] = loadShader(getShadersPath() + "ssao/downsample.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+			VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipelines.downsample));
+		}
+
 		// Fill G-Buffer pipeline
 		{
 			// Vertex input state from glTF model loader
@@ -851,12 +1211,24 @@ public:
 			&uniformBuffers.ssaoParams,
 			sizeof(uboSSAOParams));
 
+		// Temporal accumulation parameters
+		vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&uniformBuffers.temporalParams,
+			sizeof(uboTemporalParams));
+
+		// Map persistent, the SSAO and temporal parameters change every frame
+		VK_CHECK_RESULT(uniformBuffers.sceneParams.map());
+		VK_CHECK_RESULT(uniformBuffers.ssaoParams.map());
+		VK_CHECK_RESULT(uniformBuffers.temporalParams.map());
+
 		// Update
 		updateUniformBufferMatrices();
 		updateUniformBufferSSAOParams();
 
 		// SSAO
-		std::default_random_engine rndEngine(benchmark.active ? 0 : (unsigned)time(nullptr));
+		std::default_random_engine rndEngine(benchmark.active ? benchmark.seed : (unsigned)time(nullptr));
 		std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
 
 		// Sample kernel
@@ -891,22 +1263,39 @@ public:
 
 	void updateUniformBufferMatrices()
 	{
+		VKS_PROFILE_FUNCTION();
 		uboSceneParams.projection = camera.matrices.perspective;
 		uboSceneParams.view = camera.matrices.view;
 		uboSceneParams.model = glm::mat4(1.0f);
 
-		VK_CHECK_RESULT(uniformBuffers.sceneParams.map());
-		uniformBuffers.sceneParams.copyTo(&uboSceneParams, sizeof(uboSceneParams));
-		uniformBuffers.sceneParams.unmap();
+		memcpy(uniformBuffers.sceneParams.mapped, &uboSceneParams, sizeof(uboSceneParams));
 	}
 
 	void updateUniformBufferSSAOParams()
 	{
 		uboSSAOParams.projection = camera.matrices.perspective;
 
-		VK_CHECK_RESULT(uniformBuffers.ssaoParams.map());
-		uniformBuffers.ssaoParams.copyTo(&uboSSAOParams, sizeof(uboSSAOParams));
-		uniformBuffers.ssaoParams.unmap();
+		// The reduced resolution modes always sample the upsampled result from the blur target
+		UBOSSAOParams params = uboSSAOParams;
+		if (ssaoMode != SSAO_MODE_FULL) {
+			params.ssaoBlur = true;
+		}
+
+		memcpy(uniformBuffers.ssaoParams.mapped, &params, sizeof(params));
+	}
+
+	// Update the reprojection into the previous frame and advance the per-frame kernel and noise rotation
+	void updateTemporalParams()
+	{
+		uboTemporalParams.reprojection = uboSceneParams.projection * previousView * glm::inverse(uboSceneParams.view);
+		uboTemporalParams.historyValid = temporalAccumulation && historyValid;
+		uboTemporalParams.blendFactor = temporalAccumulation ? 0.1f : 1.0f;
+		memcpy(uniformBuffers.temporalParams.mapped, &uboTemporalParams, sizeof(uboTemporalParams));
+		previousView = uboSceneParams.view;
+		historyValid = true;
+
+		uboSSAOParams.frameIndex = temporalAccumulation ? uboSSAOParams.frameIndex + 1 : 0;
+		updateUniformBufferSSAOParams();
 	}
 
 	void draw()
@@ -914,7 +1303,10 @@ public:
 		VulkanExampleBase::prepareFrame();
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		{
+			VKS_PROFILE_ZONE("vkQueueSubmit");
+			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		}
 		VulkanExampleBase::submitFrame();
 	}
 
@@ -923,6 +1315,7 @@ public:
 		VulkanExampleBase::prepare();
 		loadAssets();
 		prepareOffscreenFramebuffers();
+		prepareReducedResolutionFramebuffers();
 		prepareUniformBuffers();
 		setupDescriptorPool();
 		setupLayoutsAndDescriptors();
@@ -936,6 +1329,9 @@ public:
 		if (!prepared) {
 			return;
 		}
+		if (ssaoMode != SSAO_MODE_FULL) {
+			updateTemporalParams();
+		}
 		draw();
 		if (camera.updated) {
 			updateUniformBufferMatrices();
@@ -955,9 +1351,21 @@ public:
 			if (overlay->checkBox("Enable SSAO", &uboSSAOParams.ssao)) {
 				updateUniformBufferSSAOParams();
 			}
-			if (overlay->checkBox("SSAO blur", &uboSSAOParams.ssaoBlur)) {
+			if (overlay->comboBox("SSAO resolution", &ssaoMode, { "Full resolution", "Half resolution", "Quarter resolution" })) {
+				historyValid = false;
+				uboSSAOParams.frameIndex = 0;
+				buildCommandBuffers();
 				updateUniformBufferSSAOParams();
 			}
+			if (ssaoMode == SSAO_MODE_FULL) {
+				if (overlay->checkBox("SSAO blur", &uboSSAOParams.ssaoBlur)) {
+					updateUniformBufferSSAOParams();
+				}
+			} else {
+				if (overlay->checkBox("Temporal accumulation", &temporalAccumulation)) {
+					historyValid = false;
+				}
+			}
 			if (overlay->checkBox("SSAO pass only", &uboSSAOParams.ssaoOnly)) {
 				updateUniformBufferSSAOParams();
 			}
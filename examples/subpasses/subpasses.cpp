@@ -105,7 +105,6 @@ public:
 		camera.setPosition(glm::vec3(-3.2f, 1.0f, 5.9f));
 		camera.setRotation(glm::vec3(0.5f, 210.05f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
-		UIOverlay.subpass = 2;
 	}
 
 	~VulkanExample()
@@ -511,8 +510,6 @@ public:
 				vks::debugmarker::endRegion(drawCmdBuffers[i]);
 			}
 
-			drawUI(drawCmdBuffers[i]);
-
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
@@ -847,7 +844,7 @@ public:
 			glm::vec3(1.0f, 1.0f, 0.0f),
 		};
 
-		std::default_random_engine rndGen(benchmark.active ? 0 : (unsigned)time(nullptr));
+		std::default_random_engine rndGen(benchmark.active ? benchmark.seed : (unsigned)time(nullptr));
 		std::uniform_real_distribution<float> rndDist(-1.0f, 1.0f);
 		std::uniform_int_distribution<uint32_t> rndCol(0, static_cast<uint32_t>(colors.size()-1));
 
@@ -9,10 +9,17 @@
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
 #include "frustum.hpp"
+#include "VulkanHeightmap.hpp"
 #include <ktx.h>
 #include <ktxvulkan.h>
+#if defined(_WIN32)
+#include <direct.h>
+#endif
 
 #define ENABLE_VALIDATION false
+// Number of quad patches along the edge of a terrain chunk
+#define TERRAIN_TILE_SIZE 16
+#define TERRAIN_WORLD_SIZE 128.0f
 
 class VulkanExample : public VulkanExampleBase
 {
@@ -20,18 +27,8 @@ public:
 	bool wireframe = false;
 	bool tessellation = true;
 
-	// Holds the buffers for rendering the tessellated terrain
-	struct {
-		struct Vertices {
-			VkBuffer buffer;
-			VkDeviceMemory memory;
-		} vertices;
-		struct Indices {
-			int count;
-			VkBuffer buffer;
-			VkDeviceMemory memory;
-		} indices;
-	} terrain;
+	// Chunked quadtree terrain streamed from a tiled version of the height map, chunks are rendered as quad patches
+	vks::HeightMap *terrain = nullptr;
 
 	struct {
 		vks::Texture2D heightMap;
@@ -88,11 +85,8 @@ public:
 	} descriptorSets;
 
 	// Pipeline statistics
-	struct {
-		VkBuffer buffer;
-		VkDeviceMemory memory;
-	} queryResult;
-	VkQueryPool queryPool = VK_NULL_HANDLE;
+	vks::QueryManager queryManager;
+	uint32_t statisticsQuery;
 	uint64_t pipelineStats[2] = { 0 };
 
 	// View frustum passed to tessellation control shader for culling
@@ -131,15 +125,10 @@ public:
 		textures.skySphere.destroy();
 		textures.terrainArray.destroy();
 
-		vkDestroyBuffer(device, terrain.vertices.buffer, nullptr);
-		vkFreeMemory(device, terrain.vertices.memory, nullptr);
-		vkDestroyBuffer(device, terrain.indices.buffer, nullptr);
-		vkFreeMemory(device, terrain.indices.memory, nullptr);
+		delete terrain;
 
-		if (queryPool != VK_NULL_HANDLE) {
-			vkDestroyQueryPool(device, queryPool, nullptr);
-			vkDestroyBuffer(device, queryResult.buffer, nullptr);
-			vkFreeMemory(device, queryResult.memory, nullptr);
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			queryManager.destroy();
 		}
 	}
 
@@ -177,52 +166,15 @@ public:
 		}
 	}
 
-	// Setup pool and buffer for storing pipeline statistics results
+	// Setup the query manager for storing pipeline statistics results
 	void setupQueryResultBuffer()
 	{
-		uint32_t bufSize = 2 * sizeof(uint64_t);
-
-		VkMemoryRequirements memReqs;
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-		VkBufferCreateInfo bufferCreateInfo =
-			vks::initializers::bufferCreateInfo(
-				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-				bufSize);
-
-		// Results are saved in a host visible buffer for easy access by the application
-		VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &queryResult.buffer));
-		vkGetBufferMemoryRequirements(device, queryResult.buffer, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &queryResult.memory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device, queryResult.buffer, queryResult.memory, 0));
-
-		// Create query pool
-		if (deviceFeatures.pipelineStatisticsQuery) {
-			VkQueryPoolCreateInfo queryPoolInfo = {};
-			queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
-			queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
-			queryPoolInfo.pipelineStatistics =
-				VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
-				VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_EVALUATION_SHADER_INVOCATIONS_BIT;
-			queryPoolInfo.queryCount = 2;
-			VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolInfo, NULL, &queryPool));
-		}
-	}
-
-	// Retrieves the results of the pipeline statistics query submitted to the command buffer
-	void getQueryResults()
-	{
-		// We use vkGetQueryResults to copy the results into a host visible buffer
-		vkGetQueryPoolResults(
-			device,
-			queryPool,
-			0,
-			1,
-			sizeof(pipelineStats),
-			pipelineStats,
-			sizeof(uint64_t),
-			VK_QUERY_RESULT_64_BIT);
+		// Results are copied on the GPU into a host visible buffer for easy access by the application
+		queryManager.prepare(vulkanDevice, static_cast<uint32_t>(drawCmdBuffers.size()));
+		statisticsQuery = queryManager.addQuerySet(VK_QUERY_TYPE_PIPELINE_STATISTICS, 1, [this](const std::vector<uint64_t> &results, uint32_t frameIndex, uint32_t latency) {
+			pipelineStats[0] = results[0];
+			pipelineStats[1] = results[1];
+		}, VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_TESSELLATION_EVALUATION_SHADER_INVOCATIONS_BIT, true);
 	}
 
 	void loadAssets()
@@ -276,8 +228,12 @@ public:
 		textures.terrainArray.descriptor.sampler = textures.terrainArray.sampler;
 	}
 
-	void buildCommandBuffers()
+	/*
+		The command buffer is recorded every frame, as the set of terrain chunks selected for rendering changes from frame to frame
+	*/
+	void buildCommandBuffer(uint32_t index)
 	{
+		VkCommandBuffer commandBuffer = drawCmdBuffers[index];
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
 
 		VkClearValue clearValues[2];
@@ -293,258 +249,86 @@ public:
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
 
-		for (int32_t i = 0; i < drawCmdBuffers.size(); ++i)
-		{
-			renderPassBeginInfo.framebuffer = frameBuffers[i];
-
-			VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
-
-			if (deviceFeatures.pipelineStatisticsQuery) {
-				vkCmdResetQueryPool(drawCmdBuffers[i], queryPool, 0, 2);
-			}
-
-			vkCmdBeginRenderPass(drawCmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		renderPassBeginInfo.framebuffer = frameBuffers[index];
 
-			VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
-			vkCmdSetViewport(drawCmdBuffers[i], 0, 1, &viewport);
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
 
-			VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
-			vkCmdSetScissor(drawCmdBuffers[i], 0, 1, &scissor);
-
-			vkCmdSetLineWidth(drawCmdBuffers[i], 1.0f);
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			queryManager.cmdReset(commandBuffer, index);
+		}
 
-			VkDeviceSize offsets[1] = { 0 };
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-			// Skysphere
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.skysphere);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.skysphere, 0, 1, &descriptorSets.skysphere, 0, nullptr);
-			models.skysphere.draw(drawCmdBuffers[i]);
+		VkViewport viewport = vks::initializers::viewport((float)width, (float)height, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-			// Tessellated terrain
-			if (deviceFeatures.pipelineStatisticsQuery) {
-				// Begin pipeline statistics query
-				vkCmdBeginQuery(drawCmdBuffers[i], queryPool, 0, 0);
-			}
-			// Render
-			vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wireframe : pipelines.terrain);
-			vkCmdBindDescriptorSets(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.terrain, 0, 1, &descriptorSets.terrain, 0, nullptr);
-			vkCmdBindVertexBuffers(drawCmdBuffers[i], 0, 1, &terrain.vertices.buffer, offsets);
-			vkCmdBindIndexBuffer(drawCmdBuffers[i], terrain.indices.buffer, 0, VK_INDEX_TYPE_UINT32);
-			vkCmdDrawIndexed(drawCmdBuffers[i], terrain.indices.count, 1, 0, 0, 0);
-			if (deviceFeatures.pipelineStatisticsQuery) {
-				// End pipeline statistics query
-				vkCmdEndQuery(drawCmdBuffers[i], queryPool, 0);
-			}
+		VkRect2D scissor = vks::initializers::rect2D(width, height, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-			drawUI(drawCmdBuffers[i]);
+		vkCmdSetLineWidth(commandBuffer, 1.0f);
 
-			vkCmdEndRenderPass(drawCmdBuffers[i]);
+		// Skysphere
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.skysphere);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.skysphere, 0, 1, &descriptorSets.skysphere, 0, nullptr);
+		models.skysphere.draw(commandBuffer);
 
-			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
+		// Tessellated terrain
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			// Begin pipeline statistics query
+			queryManager.cmdBeginQuery(commandBuffer, statisticsQuery, index, 0);
+		}
+		// Render
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, wireframe ? pipelines.wireframe : pipelines.terrain);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayouts.terrain, 0, 1, &descriptorSets.terrain, 0, nullptr);
+		terrain->draw(commandBuffer);
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			// End pipeline statistics query
+			queryManager.cmdEndQuery(commandBuffer, statisticsQuery, index, 0);
 		}
-	}
-
-	// Encapsulate height map data for easy sampling
-	struct HeightMap
-	{
-	private:
-		uint16_t *heightdata;
-		uint32_t dim;
-		uint32_t scale;
-	public:
-#if defined(__ANDROID__)
-		HeightMap(std::string filename, uint32_t patchsize, AAssetManager* assetManager)
-#else
-		HeightMap(std::string filename, uint32_t patchsize)
-#endif
-		{
-			ktxResult result;
-			ktxTexture* ktxTexture;
-#if defined(__ANDROID__)
-			AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
-			assert(asset);
-			size_t size = AAsset_getLength(asset);
-			assert(size > 0);
-			ktx_uint8_t* textureData = new ktx_uint8_t[size];
-			AAsset_read(asset, textureData, size);
-			AAsset_close(asset);
-			result = ktxTexture_CreateFromMemory(textureData, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
-			delete[] textureData;
 
-#else
-			result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
-#endif
-			assert(result == KTX_SUCCESS);
-			ktx_size_t ktxSize = ktxTexture_GetImageSize(ktxTexture, 0);
-			ktx_uint8_t* ktxImage = ktxTexture_GetData(ktxTexture);
-			dim = ktxTexture->baseWidth;
-			heightdata = new uint16_t[dim * dim];
-			memcpy(heightdata, ktxImage, ktxSize);
-			this->scale = dim / patchsize;
-			ktxTexture_Destroy(ktxTexture);
-		};
+		vkCmdEndRenderPass(commandBuffer);
 
-		~HeightMap()
-		{
-			delete[] heightdata;
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			// Copy the statistics to the host visible result buffer (must be done outside of the render pass)
+			queryManager.cmdCopyResults(commandBuffer, index);
 		}
 
-		float getHeight(uint32_t x, uint32_t y)
-		{
-			glm::ivec2 rpos = glm::ivec2(x, y) * glm::ivec2(scale);
-			rpos.x = std::max(0, std::min(rpos.x, (int)dim-1));
-			rpos.y = std::max(0, std::min(rpos.y, (int)dim-1));
-			rpos /= glm::ivec2(scale);
-			return *(heightdata + (rpos.x + rpos.y * dim) * scale) / 65535.0f;
-		}
-	};
+		VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+	}
 
-	// Generate a terrain quad patch for feeding to the tessellation control shader
-	void generateTerrain()
+	void buildCommandBuffers()
 	{
-		#define PATCH_SIZE 64
-		#define UV_SCALE 1.0f
-
-		const uint32_t vertexCount = PATCH_SIZE * PATCH_SIZE;
-		// We use the Vertex definition from the glTF model loader, so we can re-use the vertex input state
-		vkglTF::Vertex *vertices = new vkglTF::Vertex[vertexCount];
-
-		const float wx = 2.0f;
-		const float wy = 2.0f;
-
-		for (auto x = 0; x < PATCH_SIZE; x++)
+		for (uint32_t i = 0; i < drawCmdBuffers.size(); ++i)
 		{
-			for (auto y = 0; y < PATCH_SIZE; y++)
-			{
-				uint32_t index = (x + y * PATCH_SIZE);
-				vertices[index].pos[0] = x * wx + wx / 2.0f - (float)PATCH_SIZE * wx / 2.0f;
-				vertices[index].pos[1] = 0.0f;
-				vertices[index].pos[2] = y * wy + wy / 2.0f - (float)PATCH_SIZE * wy / 2.0f;
-				vertices[index].uv = glm::vec2((float)x / PATCH_SIZE, (float)y / PATCH_SIZE) * UV_SCALE;
-			}
+			buildCommandBuffer(i);
 		}
+	}
 
-		// Calculate normals from height map using a sobel filter
+	// Load the chunked terrain, the tiled height map file is generated from the KTX height map on first use
+	void prepareTerrain()
+	{
 #if defined(__ANDROID__)
-		HeightMap heightMap(getAssetPath() + "textures/terrain_heightmap_r16.ktx", PATCH_SIZE, androidApp->activity->assetManager);
+		const std::string cacheDirectory = std::string(androidApp->activity->internalDataPath) + "/";
+#else
+		const std::string cacheDirectory = "cache/";
+#if defined(_WIN32)
+		_mkdir(cacheDirectory.c_str());
 #else
-		HeightMap heightMap(getAssetPath() + "textures/terrain_heightmap_r16.ktx", PATCH_SIZE);
+		mkdir(cacheDirectory.c_str(), 0755);
 #endif
-		for (auto x = 0; x < PATCH_SIZE; x++)
-		{
-			for (auto y = 0; y < PATCH_SIZE; y++)
-			{
-				// Get height samples centered around current position
-				float heights[3][3];
-				for (auto hx = -1; hx <= 1; hx++)
-				{
-					for (auto hy = -1; hy <= 1; hy++)
-					{
-						heights[hx+1][hy+1] = heightMap.getHeight(x + hx, y + hy);
-					}
-				}
-
-				// Calculate the normal
-				glm::vec3 normal;
-				// Gx sobel filter
-				normal.x = heights[0][0] - heights[2][0] + 2.0f * heights[0][1] - 2.0f * heights[2][1] + heights[0][2] - heights[2][2];
-				// Gy sobel filter
-				normal.z = heights[0][0] + 2.0f * heights[1][0] + heights[2][0] - heights[0][2] - 2.0f * heights[1][2] - heights[2][2];
-				// Calculate missing up component of the normal using the filtered x and y axis
-				// The first value controls the bump strength
-				normal.y = 0.25f * sqrt( 1.0f - normal.x * normal.x - normal.z * normal.z);
-
-				vertices[x + y * PATCH_SIZE].normal = glm::normalize(normal * glm::vec3(2.0f, 1.0f, 2.0f));
-			}
-		}
-
-		// Indices
-		const uint32_t w = (PATCH_SIZE - 1);
-		const uint32_t indexCount = w * w * 4;
-		uint32_t *indices = new uint32_t[indexCount];
-		for (auto x = 0; x < w; x++)
-		{
-			for (auto y = 0; y < w; y++)
-			{
-				uint32_t index = (x + y * w) * 4;
-				indices[index] = (x + y * PATCH_SIZE);
-				indices[index + 1] = indices[index] + PATCH_SIZE;
-				indices[index + 2] = indices[index + 1] + 1;
-				indices[index + 3] = indices[index] + 1;
+#endif
+		const std::string tiledFilename = cacheDirectory + "terrain_heightmap_r16_" + std::to_string(TERRAIN_TILE_SIZE) + ".tiles";
+
+		terrain = new vks::HeightMap(vulkanDevice, queue);
+		terrain->heightScale = uboTess.displacementFactor;
+		if (!terrain->open(tiledFilename, TERRAIN_WORLD_SIZE, vks::HeightMap::topologyQuads)) {
+			auto tStart = std::chrono::high_resolution_clock::now();
+			if (!vks::HeightMap::createTiledFile(getAssetPath() + "textures/terrain_heightmap_r16.ktx", tiledFilename, TERRAIN_TILE_SIZE) || !terrain->open(tiledFilename, TERRAIN_WORLD_SIZE, vks::HeightMap::topologyQuads)) {
+				vks::tools::exitFatal("Could not create the tiled terrain height map " + tiledFilename, -1);
 			}
+			auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+			std::cout << "Generating tiled terrain height map took " << tDiff << " ms" << std::endl;
 		}
-		terrain.indices.count = indexCount;
-
-		uint32_t vertexBufferSize = vertexCount * sizeof(vkglTF::Vertex);
-		uint32_t indexBufferSize = indexCount * sizeof(uint32_t);
-
-		struct {
-			VkBuffer buffer;
-			VkDeviceMemory memory;
-		} vertexStaging, indexStaging;
-
-		// Create staging buffers
-
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			vertexBufferSize,
-			&vertexStaging.buffer,
-			&vertexStaging.memory,
-			vertices));
-
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			indexBufferSize,
-			&indexStaging.buffer,
-			&indexStaging.memory,
-			indices));
-
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			vertexBufferSize,
-			&terrain.vertices.buffer,
-			&terrain.vertices.memory));
-
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-			indexBufferSize,
-			&terrain.indices.buffer,
-			&terrain.indices.memory));
-
-		// Copy from staging buffers
-		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-		VkBufferCopy copyRegion = {};
-
-		copyRegion.size = vertexBufferSize;
-		vkCmdCopyBuffer(
-			copyCmd,
-			vertexStaging.buffer,
-			terrain.vertices.buffer,
-			1,
-			&copyRegion);
-
-		copyRegion.size = indexBufferSize;
-		vkCmdCopyBuffer(
-			copyCmd,
-			indexStaging.buffer,
-			terrain.indices.buffer,
-			1,
-			&copyRegion);
-
-		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
-
-		vkDestroyBuffer(device, vertexStaging.buffer, nullptr);
-		vkFreeMemory(device, vertexStaging.memory, nullptr);
-		vkDestroyBuffer(device, indexStaging.buffer, nullptr);
-		vkFreeMemory(device, indexStaging.memory, nullptr);
-
-		delete[] vertices;
-		delete[] indices;
 	}
 
 	void setupDescriptorPool()
@@ -702,7 +486,17 @@ public:
 		pipelineCI.pTessellationState = &tessellationState;
 		pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
 		pipelineCI.pStages = shaderStages.data();
-		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV });
+		// Terrain chunks use the height map's vertex layout
+		std::vector<VkVertexInputBindingDescription> vertexInputBindings = {
+			vks::initializers::vertexInputBindingDescription(0, sizeof(vks::HeightMap::Vertex), VK_VERTEX_INPUT_RATE_VERTEX),
+		};
+		std::vector<VkVertexInputAttributeDescription> vertexInputAttributes = {
+			vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vks::HeightMap::Vertex, pos)),
+			vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vks::HeightMap::Vertex, normal)),
+			vks::initializers::vertexInputAttributeDescription(0, 2, VK_FORMAT_R32G32_SFLOAT, offsetof(vks::HeightMap::Vertex, uv)),
+		};
+		VkPipelineVertexInputStateCreateInfo vertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo(vertexInputBindings, vertexInputAttributes);
+		pipelineCI.pVertexInputState = &vertexInputState;
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.terrain));
 
 		// Terrain wireframe pipeline
@@ -722,6 +516,7 @@ public:
 		depthStencilState.depthWriteEnable = VK_FALSE;
 		pipelineCI.stageCount = 2;
 		pipelineCI.layout = pipelineLayouts.skysphere;
+		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({ vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV });
 		shaderStages[0] = loadShader(getShadersPath() + "terraintessellation/skysphere.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 		shaderStages[1] = loadShader(getShadersPath() + "terraintessellation/skysphere.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.skysphere));
@@ -786,6 +581,15 @@ public:
 	{
 		VulkanExampleBase::prepareFrame();
 
+		if (deviceFeatures.pipelineStatisticsQuery) {
+			// Fetch query results of previous frames that have become available
+			queryManager.update(currentBuffer);
+		}
+
+		// Select the terrain chunks for the current view and record the command buffer drawing them
+		terrain->update(camera.matrices.perspective, camera.matrices.view, (float)height);
+		buildCommandBuffer(currentBuffer);
+
 		// Command buffer to be submitted to the queue
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
@@ -793,11 +597,6 @@ public:
 		// Submit to queue
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
-		if (deviceFeatures.pipelineStatisticsQuery) {
-			// Read query results for displaying in next frame
-			getQueryResults();
-		}
-
 		VulkanExampleBase::submitFrame();
 	}
 
@@ -805,7 +604,7 @@ public:
 	{
 		VulkanExampleBase::prepare();
 		loadAssets();
-		generateTerrain();
+		prepareTerrain();
 		if (deviceFeatures.pipelineStatisticsQuery) {
 			setupQueryResultBuffer();
 		}
@@ -844,11 +643,17 @@ public:
 				updateUniformBuffers();
 			}
 			if (deviceFeatures.fillModeNonSolid) {
-				if (overlay->checkBox("Wireframe", &wireframe)) {
-					buildCommandBuffers();
-				}
+				overlay->checkBox("Wireframe", &wireframe);
 			}
 		}
+		if (overlay->header("Terrain chunks")) {
+			overlay->sliderFloat("Pixel error", &terrain->pixelError, 0.5f, 32.0f);
+			overlay->text("Levels: %d (max. selected %d)", terrain->getLevelCount(), terrain->statistics.maxLevel);
+			overlay->text("Selected: %d", terrain->statistics.selectedChunks);
+			overlay->text("Visible: %d", terrain->statistics.visibleChunks);
+			overlay->text("Resident: %d / %d", terrain->statistics.residentChunks, terrain->maxResidentChunks);
+			overlay->text("Loading: %d", terrain->statistics.pendingChunks);
+		}
 		if (deviceFeatures.pipelineStatisticsQuery) {
 			if (overlay->header("Pipeline statistics")) {
 				overlay->text("VS invocations: %d", pipelineStats[0]);
@@ -6,23 +6,55 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
-#include <sstream>
-#include <iomanip>
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
 #include "../external/stb/stb_font_consolas_24_latin1.inl"
 
 #define ENABLE_VALIDATION false
 
-// Max. number of chars the text overlay buffer can hold
-#define TEXTOVERLAY_MAX_CHAR_COUNT 2048
+// Max. number of glyphs the text overlay buffer can hold
+#define TEXTOVERLAY_MAX_CHAR_COUNT 65536
+// Smallest glyph range allocated for a text, ranges grow in powers of two
+#define TEXTOVERLAY_MIN_RANGE_SIZE 16
 
 /*
 	Mostly self-contained text overlay class
+
+	Texts are retained: each one gets a handle and is only laid out again when its content changes.
+	Glyphs are stored as instanced quads in a persistently mapped buffer with one region per command buffer (ring),
+	the number of instances is read from an indirect draw command in the same region.
+	So changing text never requires re-recording the overlay's command buffers.
 */
 class TextOverlay
 {
+public:
+	enum TextAlign { alignLeft, alignCenter, alignRight };
+
+	typedef uint32_t TextHandle;
+
 private:
+	// Per instance data for a single glyph quad
+	struct GlyphInstance {
+		// Screen space rectangle in pixels (x0, y0, x1, y1)
+		glm::vec4 rect;
+		// Font texture coordinates (s0, t0, s1, t1)
+		glm::vec4 uv;
+	};
+
+	struct Text {
+		std::string content;
+		float x = 0.0f;
+		float y = 0.0f;
+		TextAlign align = alignLeft;
+		bool visible = true;
+		bool used = false;
+		// Glyphs laid out relative to the text's origin, only updated when the content changes
+		std::vector<GlyphInstance> glyphs;
+		// Range in the global glyph array
+		uint32_t firstGlyph = 0;
+		uint32_t glyphCapacity = 0;
+	};
+
 	vks::VulkanDevice *vulkanDevice;
 
 	VkQueue queue;
@@ -36,8 +68,6 @@ private:
 	VkSampler sampler;
 	VkImage image;
 	VkImageView view;
-	VkBuffer buffer;
-	VkDeviceMemory memory;
 	VkDeviceMemory imageMemory;
 	VkDescriptorPool descriptorPool;
 	VkDescriptorSetLayout descriptorSetLayout;
@@ -50,15 +80,158 @@ private:
 	std::vector<VkFramebuffer*> frameBuffers;
 	std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
 
-	// Pointer to mapped vertex buffer
-	glm::vec4 *mapped = nullptr;
+	// Ring of glyph buffers, each region starts with the indirect draw command followed by the glyph instances
+	vks::Buffer glyphBuffer;
+	VkDeviceSize regionSize = 0;
+	VkDeviceSize glyphOffset = 0;
 
 	stb_fontchar stbFontData[STB_FONT_consolas_24_latin1_NUM_CHARS];
-	uint32_t numLetters;
-public:
 
-	enum TextAlign { alignLeft, alignCenter, alignRight };
+	std::vector<Text> texts;
+	std::vector<TextHandle> freeHandles;
+	// CPU copy of all glyph instances, ranges changed since a region was last written are copied from here
+	std::vector<GlyphInstance> glyphs;
+	std::vector<std::vector<std::pair<uint32_t, uint32_t>>> dirtyRanges;
+	// Set if glyphs changed while the overlay was hidden, all regions are then written in full once it's shown again
+	bool fullUpdatePending = false;
+	// Free glyph ranges per power of two size class
+	std::vector<std::vector<uint32_t>> freeRanges;
+	// Number of glyph slots in use (including freed ones below it), this is the instance count of the draw
+	uint32_t glyphHighWaterMark = 0;
+
+	void createGlyphBuffer()
+	{
+		const VkDeviceSize alignment = std::max(VkDeviceSize(16), vulkanDevice->properties.limits.nonCoherentAtomSize);
+		glyphOffset = alignment;
+		regionSize = glyphOffset + TEXTOVERLAY_MAX_CHAR_COUNT * sizeof(GlyphInstance);
+		regionSize = (regionSize + alignment - 1) & ~(alignment - 1);
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&glyphBuffer,
+			regionSize * cmdBuffers.size()));
+		VK_CHECK_RESULT(glyphBuffer.map());
+		// All regions need to be written in full on their next update
+		dirtyRanges.assign(cmdBuffers.size(), { std::make_pair(0u, glyphHighWaterMark) });
+	}
+
+	void markDirty(uint32_t first, uint32_t count)
+	{
+		if (count == 0) {
+			return;
+		}
+		// Regions aren't updated while the overlay is hidden, so don't let their ranges pile up
+		if (!visible) {
+			fullUpdatePending = true;
+			return;
+		}
+		for (auto& ranges : dirtyRanges) {
+			ranges.push_back(std::make_pair(first, count));
+		}
+	}
+
+	static uint32_t getSizeClass(uint32_t count)
+	{
+		uint32_t sizeClass = 0;
+		while ((uint32_t(TEXTOVERLAY_MIN_RANGE_SIZE) << sizeClass) < count) {
+			sizeClass++;
+		}
+		return sizeClass;
+	}
+
+	// Returns false if the glyph buffer is full
+	bool allocateGlyphRange(Text& text, uint32_t count)
+	{
+		const uint32_t sizeClass = getSizeClass(count);
+		const uint32_t size = TEXTOVERLAY_MIN_RANGE_SIZE << sizeClass;
+		if (freeRanges.size() <= sizeClass) {
+			freeRanges.resize(sizeClass + 1);
+		}
+		if (!freeRanges[sizeClass].empty()) {
+			text.firstGlyph = freeRanges[sizeClass].back();
+			freeRanges[sizeClass].pop_back();
+		} else {
+			if (glyphHighWaterMark + size > TEXTOVERLAY_MAX_CHAR_COUNT) {
+				return false;
+			}
+			text.firstGlyph = glyphHighWaterMark;
+			glyphHighWaterMark += size;
+		}
+		text.glyphCapacity = size;
+		return true;
+	}
 
+	void freeGlyphRange(Text& text)
+	{
+		if (text.glyphCapacity == 0) {
+			return;
+		}
+		// Zero sized quads don't produce any fragments
+		std::fill(glyphs.begin() + text.firstGlyph, glyphs.begin() + text.firstGlyph + text.glyphCapacity, GlyphInstance{});
+		markDirty(text.firstGlyph, text.glyphCapacity);
+		freeRanges[getSizeClass(text.glyphCapacity)].push_back(text.firstGlyph);
+		text.glyphCapacity = 0;
+	}
+
+	// Generate the glyph quads of a text relative to its origin
+	void layoutText(Text& text)
+	{
+		const uint32_t firstChar = STB_FONT_consolas_24_latin1_FIRST_CHAR;
+		const float charScale = 0.75f * scale;
+
+		text.glyphs.resize(text.content.size());
+		float x = 0.0f;
+		for (size_t i = 0; i < text.content.size(); i++)
+		{
+			stb_fontchar *charData = &stbFontData[(uint32_t)(uint8_t)text.content[i] - firstChar];
+			text.glyphs[i].rect = glm::vec4((x + charData->x0) * charScale, charData->y0 * charScale, (x + charData->x1) * charScale, charData->y1 * charScale);
+			text.glyphs[i].uv = glm::vec4(charData->s0, charData->t0, charData->s1, charData->t1);
+			x += charData->advance;
+		}
+
+		float offset = 0.0f;
+		switch (text.align)
+		{
+			case alignRight:
+				offset = x * charScale;
+				break;
+			case alignCenter:
+				offset = x * charScale / 2.0f;
+				break;
+			case alignLeft:
+				break;
+		}
+		for (auto& glyph : text.glyphs) {
+			glyph.rect.x -= offset;
+			glyph.rect.z -= offset;
+		}
+	}
+
+	// Write the laid out glyphs of a text at its current position into the global glyph array
+	void placeText(Text& text)
+	{
+		const uint32_t glyphCount = text.visible ? static_cast<uint32_t>(text.glyphs.size()) : 0;
+		if (glyphCount > text.glyphCapacity || (text.glyphCapacity > TEXTOVERLAY_MIN_RANGE_SIZE && glyphCount * 4 < text.glyphCapacity)) {
+			freeGlyphRange(text);
+			if (glyphCount > 0 && !allocateGlyphRange(text, glyphCount)) {
+				std::cerr << "Text overlay glyph buffer is full, \"" << text.content << "\" is not displayed" << std::endl;
+				return;
+			}
+		}
+		if (text.glyphCapacity == 0) {
+			return;
+		}
+		const glm::vec4 origin(text.x, text.y, text.x, text.y);
+		GlyphInstance* dst = &glyphs[text.firstGlyph];
+		for (uint32_t i = 0; i < glyphCount; i++) {
+			dst[i].rect = text.glyphs[i].rect + origin;
+			dst[i].uv = text.glyphs[i].uv;
+		}
+		std::fill(dst + glyphCount, dst + text.glyphCapacity, GlyphInstance{});
+		markDirty(text.firstGlyph, text.glyphCapacity);
+	}
+
+public:
 	bool visible = true;
 
 	std::vector<VkCommandBuffer> cmdBuffers;
@@ -91,10 +264,13 @@ public:
 		this->frameBufferHeight = framebufferheight;
 		this->scale = scale;
 
+		glyphs.resize(TEXTOVERLAY_MAX_CHAR_COUNT);
+
 		cmdBuffers.resize(framebuffers.size());
 		prepareResources();
 		prepareRenderPass();
 		preparePipeline();
+		updateCommandBuffers();
 	}
 
 	~TextOverlay()
@@ -103,8 +279,7 @@ public:
 		vkDestroySampler(vulkanDevice->logicalDevice, sampler, nullptr);
 		vkDestroyImage(vulkanDevice->logicalDevice, image, nullptr);
 		vkDestroyImageView(vulkanDevice->logicalDevice, view, nullptr);
-		vkDestroyBuffer(vulkanDevice->logicalDevice, buffer, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, memory, nullptr);
+		glyphBuffer.destroy();
 		vkFreeMemory(vulkanDevice->logicalDevice, imageMemory, nullptr);
 		vkDestroyDescriptorSetLayout(vulkanDevice->logicalDevice, descriptorSetLayout, nullptr);
 		vkDestroyDescriptorPool(vulkanDevice->logicalDevice, descriptorPool, nullptr);
@@ -142,22 +317,12 @@ public:
 
 		VK_CHECK_RESULT(vkAllocateCommandBuffers(vulkanDevice->logicalDevice, &cmdBufAllocateInfo, cmdBuffers.data()));
 
-		// Vertex buffer
-		VkDeviceSize bufferSize = TEXTOVERLAY_MAX_CHAR_COUNT * sizeof(glm::vec4);
-
-		VkBufferCreateInfo bufferInfo = vks::initializers::bufferCreateInfo(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, bufferSize);
-		VK_CHECK_RESULT(vkCreateBuffer(vulkanDevice->logicalDevice, &bufferInfo, nullptr, &buffer));
+		// Glyph instance buffer ring
+		createGlyphBuffer();
 
 		VkMemoryRequirements memReqs;
 		VkMemoryAllocateInfo allocInfo = vks::initializers::memoryAllocateInfo();
 
-		vkGetBufferMemoryRequirements(vulkanDevice->logicalDevice, buffer, &memReqs);
-		allocInfo.allocationSize = memReqs.size;
-		allocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-		VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &allocInfo, nullptr, &memory));
-		VK_CHECK_RESULT(vkBindBufferMemory(vulkanDevice->logicalDevice, buffer, memory, 0));
-
 		// Font texture
 		VkImageCreateInfo imageInfo = vks::initializers::imageCreateInfo();
 		imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -318,6 +483,10 @@ public:
 			vks::initializers::pipelineLayoutCreateInfo(
 				&descriptorSetLayout,
 				1);
+		// Pixel to normalized device coordinate scale
+		VkPushConstantRange pushConstantRange = vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::vec2), 0);
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 		VK_CHECK_RESULT(vkCreatePipelineLayout(vulkanDevice->logicalDevice, &pipelineLayoutInfo, nullptr, &pipelineLayout));
 
 		// Descriptor set
@@ -368,13 +537,13 @@ public:
 		std::vector<VkDynamicState> dynamicStateEnables = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
 		VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
 
-		std::array<VkVertexInputBindingDescription, 2> vertexInputBindings = {
-			vks::initializers::vertexInputBindingDescription(0, sizeof(glm::vec4), VK_VERTEX_INPUT_RATE_VERTEX),
-			vks::initializers::vertexInputBindingDescription(1, sizeof(glm::vec4), VK_VERTEX_INPUT_RATE_VERTEX),
+		// One instance per glyph, the quad's corners are generated in the vertex shader
+		std::array<VkVertexInputBindingDescription, 1> vertexInputBindings = {
+			vks::initializers::vertexInputBindingDescription(0, sizeof(GlyphInstance), VK_VERTEX_INPUT_RATE_INSTANCE),
 		};
 		std::array<VkVertexInputAttributeDescription, 2> vertexInputAttributes = {
-			vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32_SFLOAT, 0),					// Location 0: Position
-			vks::initializers::vertexInputAttributeDescription(1, 1, VK_FORMAT_R32G32_SFLOAT, sizeof(glm::vec2)),	// Location 1: UV
+			vks::initializers::vertexInputAttributeDescription(0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(GlyphInstance, rect)),	// Location 0: Screen rectangle
+			vks::initializers::vertexInputAttributeDescription(0, 1, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(GlyphInstance, uv)),		// Location 1: UV rectangle
 		};
 
 		VkPipelineVertexInputStateCreateInfo vertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
@@ -478,93 +647,117 @@ public:
 		VK_CHECK_RESULT(vkCreateRenderPass(vulkanDevice->logicalDevice, &renderPassInfo, nullptr, &renderPass));
 	}
 
-	// Map buffer
-	void beginTextUpdate()
+	// Add a new text and return the handle used to change it later on
+	TextHandle addText(const std::string &content, float x, float y, TextAlign align)
 	{
-		VK_CHECK_RESULT(vkMapMemory(vulkanDevice->logicalDevice, memory, 0, VK_WHOLE_SIZE, 0, (void **)&mapped));
-		numLetters = 0;
+		TextHandle handle;
+		if (!freeHandles.empty()) {
+			handle = freeHandles.back();
+			freeHandles.pop_back();
+		} else {
+			handle = static_cast<TextHandle>(texts.size());
+			texts.push_back(Text());
+		}
+		Text& text = texts[handle];
+		text = Text();
+		text.used = true;
+		text.content = content;
+		text.x = x;
+		text.y = y;
+		text.align = align;
+		layoutText(text);
+		placeText(text);
+		return handle;
 	}
 
-	// Add text to the current buffer
-	// todo : drop shadow? color attribute?
-	void addText(std::string text, float x, float y, TextAlign align)
+	// Change the content of a text, glyphs are only laid out again if it actually differs
+	void setText(TextHandle handle, const std::string &content)
 	{
-		const uint32_t firstChar = STB_FONT_consolas_24_latin1_FIRST_CHAR;
-
-		assert(mapped != nullptr);
-
-		const float charW = 1.5f * scale / *frameBufferWidth;
-		const float charH = 1.5f * scale / *frameBufferHeight;
-
-		float fbW = (float)*frameBufferWidth;
-		float fbH = (float)*frameBufferHeight;
-		x = (x / fbW * 2.0f) - 1.0f;
-		y = (y / fbH * 2.0f) - 1.0f;
-
-		// Calculate text width
-		float textWidth = 0;
-		for (auto letter : text)
-		{
-			stb_fontchar *charData = &stbFontData[(uint32_t)letter - firstChar];
-			textWidth += charData->advance * charW;
+		Text& text = texts[handle];
+		if (text.content == content) {
+			return;
 		}
+		text.content = content;
+		layoutText(text);
+		placeText(text);
+	}
 
-		switch (align)
-		{
-			case alignRight:
-				x -= textWidth;
-				break;
-			case alignCenter:
-				x -= textWidth / 2.0f;
-				break;
-			case alignLeft:
-				break;
+	// Moving a text only offsets the already laid out glyphs
+	void setPosition(TextHandle handle, float x, float y)
+	{
+		Text& text = texts[handle];
+		if (text.x == x && text.y == y) {
+			return;
 		}
+		text.x = x;
+		text.y = y;
+		placeText(text);
+	}
 
-		// Generate a uv mapped quad per char in the new text
-		for (auto letter : text)
-		{
-			stb_fontchar *charData = &stbFontData[(uint32_t)letter - firstChar];
-
-			mapped->x = (x + (float)charData->x0 * charW);
-			mapped->y = (y + (float)charData->y0 * charH);
-			mapped->z = charData->s0;
-			mapped->w = charData->t0;
-			mapped++;
-
-			mapped->x = (x + (float)charData->x1 * charW);
-			mapped->y = (y + (float)charData->y0 * charH);
-			mapped->z = charData->s1;
-			mapped->w = charData->t0;
-			mapped++;
-
-			mapped->x = (x + (float)charData->x0 * charW);
-			mapped->y = (y + (float)charData->y1 * charH);
-			mapped->z = charData->s0;
-			mapped->w = charData->t1;
-			mapped++;
+	void setVisible(TextHandle handle, bool visible)
+	{
+		Text& text = texts[handle];
+		if (text.visible == visible) {
+			return;
+		}
+		text.visible = visible;
+		placeText(text);
+	}
 
-			mapped->x = (x + (float)charData->x1 * charW);
-			mapped->y = (y + (float)charData->y1 * charH);
-			mapped->z = charData->s1;
-			mapped->w = charData->t1;
-			mapped++;
+	void removeText(TextHandle handle)
+	{
+		Text& text = texts[handle];
+		freeGlyphRange(text);
+		text = Text();
+		freeHandles.push_back(handle);
+	}
 
-			x += charData->advance * charW;
+	uint32_t getGlyphCount()
+	{
+		return glyphHighWaterMark;
+	}
 
-			numLetters++;
+	// Copy all glyphs changed since the last update of the given ring region, needs to be called before submitting the matching command buffer
+	void update(uint32_t bufferIndex)
+	{
+		uint8_t* region = static_cast<uint8_t*>(glyphBuffer.mapped) + regionSize * bufferIndex;
+		GlyphInstance* dst = reinterpret_cast<GlyphInstance*>(region + glyphOffset);
+		if (fullUpdatePending) {
+			dirtyRanges.assign(dirtyRanges.size(), { std::make_pair(0u, glyphHighWaterMark) });
+			fullUpdatePending = false;
+		}
+		for (auto& range : dirtyRanges[bufferIndex]) {
+			memcpy(dst + range.first, &glyphs[range.first], range.second * sizeof(GlyphInstance));
 		}
+		dirtyRanges[bufferIndex].clear();
+
+		VkDrawIndirectCommand* drawCommand = reinterpret_cast<VkDrawIndirectCommand*>(region);
+		drawCommand->vertexCount = 4;
+		drawCommand->instanceCount = glyphHighWaterMark;
+		drawCommand->firstVertex = 0;
+		drawCommand->firstInstance = 0;
 	}
 
-	// Unmap buffer and update command buffers
-	void endTextUpdate()
+	// Needs to be called by the application after the swap chain has been recreated, texts are kept
+	void resize(std::vector<VkFramebuffer> &framebuffers)
 	{
-		vkUnmapMemory(vulkanDevice->logicalDevice, memory);
-		mapped = nullptr;
+		vkFreeCommandBuffers(vulkanDevice->logicalDevice, commandPool, static_cast<uint32_t>(cmdBuffers.size()), cmdBuffers.data());
+		this->frameBuffers.resize(framebuffers.size());
+		for (uint32_t i = 0; i < framebuffers.size(); i++)
+		{
+			this->frameBuffers[i] = &framebuffers[i];
+		}
+		if (cmdBuffers.size() != framebuffers.size()) {
+			cmdBuffers.resize(framebuffers.size());
+			glyphBuffer.destroy();
+			createGlyphBuffer();
+		}
+		VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, static_cast<uint32_t>(cmdBuffers.size()));
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(vulkanDevice->logicalDevice, &cmdBufAllocateInfo, cmdBuffers.data()));
 		updateCommandBuffers();
 	}
 
-	// Needs to be called by the application
+	// Only needs to be called when the framebuffers change, text updates are picked up by the indirect draw
 	void updateCommandBuffers()
 	{
 		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
@@ -579,6 +772,9 @@ public:
 		renderPassBeginInfo.clearValueCount = 2;
 		renderPassBeginInfo.pClearValues = clearValues;
 
+		// Converts pixel coordinates to normalized device coordinates
+		glm::vec2 pixelToNDC(2.0f / (float)*frameBufferWidth, 2.0f / (float)*frameBufferHeight);
+
 		for (int32_t i = 0; i < cmdBuffers.size(); ++i)
 		{
 			renderPassBeginInfo.framebuffer = *frameBuffers[i];
@@ -595,15 +791,13 @@ public:
 
 			vkCmdBindPipeline(cmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 			vkCmdBindDescriptorSets(cmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+			vkCmdPushConstants(cmdBuffers[i], pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::vec2), &pixelToNDC);
 
-			VkDeviceSize offsets = 0;
-			vkCmdBindVertexBuffers(cmdBuffers[i], 0, 1, &buffer, &offsets);
-			vkCmdBindVertexBuffers(cmdBuffers[i], 1, 1, &buffer, &offsets);
-			for (uint32_t j = 0; j < numLetters; j++)
-			{
-				vkCmdDraw(cmdBuffers[i], 4, 1, j * 4, 0);
-			}
-
+			// Each command buffer reads from its own region of the ring
+			const VkDeviceSize regionOffset = regionSize * i;
+			VkDeviceSize offsets = regionOffset + glyphOffset;
+			vkCmdBindVertexBuffers(cmdBuffers[i], 0, 1, &glyphBuffer.buffer, &offsets);
+			vkCmdDrawIndirect(cmdBuffers[i], glyphBuffer.buffer, regionOffset, 1, sizeof(VkDrawIndirectCommand));
 
 			vkCmdEndRenderPass(cmdBuffers[i]);
 
@@ -620,6 +814,18 @@ class VulkanExample : public VulkanExampleBase
 public:
 	TextOverlay *textOverlay = nullptr;
 
+	// Handles of the texts displayed by the overlay, these are created once and then only changed
+	struct {
+		TextOverlay::TextHandle frameTime;
+		TextOverlay::TextHandle matrixHeader;
+		std::array<TextOverlay::TextHandle, 4> matrixRows;
+		TextOverlay::TextHandle cube;
+		// Grid of labels attached to points in the scene to stress the overlay
+		std::vector<TextOverlay::TextHandle> labels;
+	} texts;
+	static const uint32_t labelGridSize = 32;
+	bool displayLabels = false;
+
 	vkglTF::Model model;
 
 	vks::Buffer uniformBuffer;
@@ -698,39 +904,86 @@ public:
 		vkQueueWaitIdle(queue);
 	}
 
-	// Update the text buffer displayed by the text overlay
-	void updateTextOverlay(void)
+	// Create all texts displayed by the overlay, they are only changed afterwards
+	void createTexts()
 	{
-		textOverlay->beginTextUpdate();
-
 		textOverlay->addText(title, 5.0f * UIOverlay.scale, 5.0f * UIOverlay.scale, TextOverlay::alignLeft);
-
-		std::stringstream ss;
-		ss << std::fixed << std::setprecision(2) << (frameTimer * 1000.0f) << "ms (" << lastFPS << " fps)";
-		textOverlay->addText(ss.str(), 5.0f * UIOverlay.scale, 25.0f * UIOverlay.scale, TextOverlay::alignLeft);
-
+		texts.frameTime = textOverlay->addText("", 5.0f * UIOverlay.scale, 25.0f * UIOverlay.scale, TextOverlay::alignLeft);
 		textOverlay->addText(deviceProperties.deviceName, 5.0f * UIOverlay.scale, 45.0f * UIOverlay.scale, TextOverlay::alignLeft);
 
 		// Display current model view matrix
-		textOverlay->addText("model view matrix", (float)width - 5.0f * UIOverlay.scale, 5.0f * UIOverlay.scale, TextOverlay::alignRight);
-
+		texts.matrixHeader = textOverlay->addText("model view matrix", 0.0f, 5.0f * UIOverlay.scale, TextOverlay::alignRight);
 		for (uint32_t i = 0; i < 4; i++)
 		{
-			ss.str("");
-			ss << std::fixed << std::setprecision(2) << std::showpos;
-			ss << uboVS.modelView[0][i] << " " << uboVS.modelView[1][i] << " " << uboVS.modelView[2][i] << " " << uboVS.modelView[3][i];
-			textOverlay->addText(ss.str(), (float)width - 5.0f * UIOverlay.scale, (25.0f + (float)i * 20.0f) * UIOverlay.scale, TextOverlay::alignRight);
+			texts.matrixRows[i] = textOverlay->addText("", 0.0f, (25.0f + (float)i * 20.0f) * UIOverlay.scale, TextOverlay::alignRight);
 		}
 
-		glm::vec3 projected = glm::project(glm::vec3(0.0f), uboVS.modelView, uboVS.projection, glm::vec4(0, 0, (float)width, (float)height));
-		textOverlay->addText("A cube", projected.x, projected.y, TextOverlay::alignCenter);
+		texts.cube = textOverlay->addText("A cube", 0.0f, 0.0f, TextOverlay::alignCenter);
+
+		char label[16];
+		texts.labels.resize(labelGridSize * labelGridSize);
+		for (uint32_t y = 0; y < labelGridSize; y++)
+		{
+			for (uint32_t x = 0; x < labelGridSize; x++)
+			{
+				snprintf(label, sizeof(label), "%u,%u", x, y);
+				TextOverlay::TextHandle handle = textOverlay->addText(label, 0.0f, 0.0f, TextOverlay::alignCenter);
+				textOverlay->setVisible(handle, displayLabels);
+				texts.labels[y * labelGridSize + x] = handle;
+			}
+		}
 
 #if defined(__ANDROID__)
 #else
 		textOverlay->addText("Press \"space\" to toggle text overlay", 5.0f * UIOverlay.scale, 65.0f * UIOverlay.scale, TextOverlay::alignLeft);
-		textOverlay->addText("Hold middle mouse button and drag to move", 5.0f * UIOverlay.scale, 85.0f * UIOverlay.scale, TextOverlay::alignLeft);
+		textOverlay->addText("Press \"l\" to toggle scene labels", 5.0f * UIOverlay.scale, 85.0f * UIOverlay.scale, TextOverlay::alignLeft);
+		textOverlay->addText("Hold middle mouse button and drag to move", 5.0f * UIOverlay.scale, 105.0f * UIOverlay.scale, TextOverlay::alignLeft);
 #endif
-		textOverlay->endTextUpdate();
+
+		updateFrameTimeText();
+		updateViewTexts();
+	}
+
+	void updateFrameTimeText()
+	{
+		char text[64];
+		snprintf(text, sizeof(text), "%.2fms (%u fps)", frameTimer * 1000.0f, lastFPS);
+		textOverlay->setText(texts.frameTime, text);
+	}
+
+	// Update all texts that depend on the camera or the window size
+	void updateViewTexts()
+	{
+		const float right = (float)width - 5.0f * UIOverlay.scale;
+		textOverlay->setPosition(texts.matrixHeader, right, 5.0f * UIOverlay.scale);
+
+		char text[64];
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			snprintf(text, sizeof(text), "%+.2f %+.2f %+.2f %+.2f", uboVS.modelView[0][i], uboVS.modelView[1][i], uboVS.modelView[2][i], uboVS.modelView[3][i]);
+			textOverlay->setText(texts.matrixRows[i], text);
+			textOverlay->setPosition(texts.matrixRows[i], right, (25.0f + (float)i * 20.0f) * UIOverlay.scale);
+		}
+
+		const glm::vec4 viewport(0.0f, 0.0f, (float)width, (float)height);
+		glm::vec3 projected = glm::project(glm::vec3(0.0f), uboVS.modelView, uboVS.projection, viewport);
+		textOverlay->setPosition(texts.cube, projected.x, projected.y);
+
+		if (displayLabels)
+		{
+			// Labels are placed on a plane around the cube (in model space) and hidden if behind the camera
+			for (uint32_t y = 0; y < labelGridSize; y++)
+			{
+				for (uint32_t x = 0; x < labelGridSize; x++)
+				{
+					glm::vec3 pos(((float)x - (float)(labelGridSize - 1) / 2.0f) * 2.5f, 5.0f, ((float)y - (float)(labelGridSize - 1) / 2.0f) * 2.5f);
+					projected = glm::project(pos, uboVS.modelView, uboVS.projection, viewport);
+					const TextOverlay::TextHandle handle = texts.labels[y * labelGridSize + x];
+					textOverlay->setVisible(handle, projected.z > 0.0f && projected.z < 1.0f);
+					textOverlay->setPosition(handle, projected.x, projected.y);
+				}
+			}
+		}
 	}
 
 	void loadAssets()
@@ -848,7 +1101,7 @@ public:
 			UIOverlay.scale,
 			shaderStages
 			);
-		updateTextOverlay();
+		createTexts();
 	}
 
 	void draw()
@@ -859,6 +1112,8 @@ public:
 			drawCmdBuffers[currentBuffer]
 		};
 		if (textOverlay->visible) {
+			// Copy changed glyphs to the ring region used by this frame, the command buffer itself stays the same
+			textOverlay->update(currentBuffer);
 			commandBuffers.push_back(textOverlay->cmdBuffers[currentBuffer]);
 		}
 
@@ -897,22 +1152,20 @@ public:
 		}
 		if (frameCounter == 0)
 		{
-			vkDeviceWaitIdle(device);
-			updateTextOverlay();
+			updateFrameTimeText();
 		}
 	}
 
 	virtual void windowResized()
 	{
-		// SRS - Recreate text overlay resources in case number of swapchain images has changed on resize
-		delete textOverlay;
-		prepareTextOverlay();
+		// Texts are kept, only the command buffers (and glyph buffer ring if the number of swapchain images changed) are recreated
+		textOverlay->resize(frameBuffers);
 	}
 
 	virtual void viewChanged()
 	{
 		updateUniformBuffers();
-		updateTextOverlay();
+		updateViewTexts();
 	}
 
 	virtual void keyPressed(uint32_t keyCode)
@@ -922,6 +1175,14 @@ public:
 		case KEY_KPADD:
 		case KEY_SPACE:
 			textOverlay->visible = !textOverlay->visible;
+			break;
+		case KEY_L:
+			displayLabels = !displayLabels;
+			for (auto handle : texts.labels) {
+				textOverlay->setVisible(handle, displayLabels);
+			}
+			updateViewTexts();
+			break;
 		}
 	}
 };
@@ -7,10 +7,18 @@
 */
 
 #include "vulkanexamplebase.h"
+#include "threadpool.hpp"
+#include <atomic>
 
 #define VERTEX_BUFFER_BIND_ID 0
 #define ENABLE_VALIDATION false
 
+// Number of voxels evaluated together by the noise kernels
+// The lane loops are kept free of data dependent branches so the compiler can map them to SIMD registers
+#define NOISE_LANE_COUNT 8
+// Number of voxel rows (of a single slice) processed by a thread pool job in one go
+#define NOISE_TILE_ROWS 16
+
 // Vertex layout for this example
 struct Vertex {
 	float pos[3];
@@ -24,15 +32,15 @@ class PerlinNoise
 {
 private:
 	uint32_t permutations[512];
-	T fade(T t)
+	T fade(T t) const
 	{
 		return t * t * t * (t * (t * (T)6 - (T)15) + (T)10);
 	}
-	T lerp(T t, T a, T b)
+	T lerp(T t, T a, T b) const
 	{
 		return a + t * (b - a);
 	}
-	T grad(int hash, T x, T y, T z)
+	T grad(int hash, T x, T y, T z) const
 	{
 		// Convert LO 4 bits of hash code into 12 gradient directions
 		int h = hash & 15;
@@ -40,6 +48,12 @@ private:
 		T v = h < 4 ? y : h == 12 || h == 14 ? x : z;
 		return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
 	}
+	// Floor for the lane kernel that (unlike std::floor) doesn't require SSE4.1 to be vectorized
+	static int32_t floorToInt(T x)
+	{
+		int32_t i = (int32_t)x;
+		return i - (x < (T)i ? 1 : 0);
+	}
 public:
 	PerlinNoise()
 	{
@@ -55,7 +69,7 @@ public:
 			permutations[i] = permutations[256 + i] = plookup[i];
 		}
 	}
-	T noise(T x, T y, T z)
+	T noise(T x, T y, T z) const
 	{
 		// Find unit cube that contains point
 		int32_t X = (int32_t)floor(x) & 255;
@@ -85,6 +99,58 @@ public:
 			lerp(v, lerp(u, grad(permutations[AA + 1], x, y, z - 1), grad(permutations[BA + 1], x - 1, y, z - 1)), lerp(u, grad(permutations[AB + 1], x, y - 1, z - 1), grad(permutations[BB + 1], x - 1, y - 1, z - 1))));
 		return res;
 	}
+	// Same as noise() but for NOISE_LANE_COUNT points at once
+	// The work is split into passes over all lanes (cell setup, permutation lookups, gradients and blending) so that only the table lookups remain scalar
+	void noiseLanes(const T *px, const T *py, const T *pz, T *out) const
+	{
+		int32_t X[NOISE_LANE_COUNT], Y[NOISE_LANE_COUNT], Z[NOISE_LANE_COUNT];
+		T x[NOISE_LANE_COUNT], y[NOISE_LANE_COUNT], z[NOISE_LANE_COUNT];
+		T u[NOISE_LANE_COUNT], v[NOISE_LANE_COUNT], w[NOISE_LANE_COUNT];
+		for (uint32_t l = 0; l < NOISE_LANE_COUNT; l++)
+		{
+			const int32_t fx = floorToInt(px[l]);
+			const int32_t fy = floorToInt(py[l]);
+			const int32_t fz = floorToInt(pz[l]);
+			X[l] = fx & 255;
+			Y[l] = fy & 255;
+			Z[l] = fz & 255;
+			x[l] = px[l] - (T)fx;
+			y[l] = py[l] - (T)fy;
+			z[l] = pz[l] - (T)fz;
+			u[l] = fade(x[l]);
+			v[l] = fade(y[l]);
+			w[l] = fade(z[l]);
+		}
+
+		// Hashes of the 8 cube corners, in the same order as used by noise()
+		int32_t hash[8][NOISE_LANE_COUNT];
+		for (uint32_t l = 0; l < NOISE_LANE_COUNT; l++)
+		{
+			const uint32_t A = permutations[X[l]] + Y[l];
+			const uint32_t AA = permutations[A] + Z[l];
+			const uint32_t AB = permutations[A + 1] + Z[l];
+			const uint32_t B = permutations[X[l] + 1] + Y[l];
+			const uint32_t BA = permutations[B] + Z[l];
+			const uint32_t BB = permutations[B + 1] + Z[l];
+			hash[0][l] = permutations[AA];
+			hash[1][l] = permutations[BA];
+			hash[2][l] = permutations[AB];
+			hash[3][l] = permutations[BB];
+			hash[4][l] = permutations[AA + 1];
+			hash[5][l] = permutations[BA + 1];
+			hash[6][l] = permutations[AB + 1];
+			hash[7][l] = permutations[BB + 1];
+		}
+
+		for (uint32_t l = 0; l < NOISE_LANE_COUNT; l++)
+		{
+			const T x0 = x[l], y0 = y[l], z0 = z[l];
+			const T x1 = x0 - 1, y1 = y0 - 1, z1 = z0 - 1;
+			out[l] = lerp(w[l], lerp(v[l],
+				lerp(u[l], grad(hash[0][l], x0, y0, z0), grad(hash[1][l], x1, y0, z0)), lerp(u[l], grad(hash[2][l], x0, y1, z0), grad(hash[3][l], x1, y1, z0))),
+				lerp(v[l], lerp(u[l], grad(hash[4][l], x0, y0, z1), grad(hash[5][l], x1, y0, z1)), lerp(u[l], grad(hash[6][l], x0, y1, z1), grad(hash[7][l], x1, y1, z1))));
+		}
+	}
 };
 
 // Fractal noise generator based on perlin noise above
@@ -106,7 +172,7 @@ public:
 		persistence = (T)0.5;
 	}
 
-	T noise(T x, T y, T z)
+	T noise(T x, T y, T z) const
 	{
 		T sum = 0;
 		T frequency = (T)1;
@@ -123,6 +189,131 @@ public:
 		sum = sum / max;
 		return (sum + (T)1.0) / (T)2.0;
 	}
+
+	// Same as noise() but for NOISE_LANE_COUNT points at once
+	void noiseLanes(const T *x, const T *y, const T *z, T *out) const
+	{
+		T sum[NOISE_LANE_COUNT] = {};
+		T px[NOISE_LANE_COUNT], py[NOISE_LANE_COUNT], pz[NOISE_LANE_COUNT], n[NOISE_LANE_COUNT];
+		T frequency = (T)1;
+		T amplitude = (T)1;
+		T max = (T)0;
+		for (uint32_t i = 0; i < octaves; i++)
+		{
+			for (uint32_t l = 0; l < NOISE_LANE_COUNT; l++)
+			{
+				px[l] = x[l] * frequency;
+				py[l] = y[l] * frequency;
+				pz[l] = z[l] * frequency;
+			}
+			perlinNoise.noiseLanes(px, py, pz, n);
+			for (uint32_t l = 0; l < NOISE_LANE_COUNT; l++)
+			{
+				sum[l] += n[l] * amplitude;
+			}
+			max += amplitude;
+			amplitude *= persistence;
+			frequency *= (T)2;
+		}
+
+		for (uint32_t l = 0; l < NOISE_LANE_COUNT; l++)
+		{
+			out[l] = (sum[l] / max + (T)1.0) / (T)2.0;
+		}
+	}
+};
+
+// Generates a fractal noise volume in tiles of NOISE_TILE_ROWS rows into a (mapped) byte buffer
+// Any number of threads can call generateTiles() to help with the work, tiles are handed out via an atomic counter
+class NoiseVolumeJob
+{
+private:
+	FractalNoise<float> fractalNoise;
+	uint8_t *dst;
+	uint32_t width, height, depth;
+	float noiseScale;
+	uint32_t tilesPerSlice;
+	uint32_t tileCount;
+	std::atomic<uint32_t> nextTile;
+	std::atomic<uint32_t> activeWorkers;
+
+	void generateTile(uint32_t tile)
+	{
+		const uint32_t z = tile / tilesPerSlice;
+		const uint32_t yStart = (tile % tilesPerSlice) * NOISE_TILE_ROWS;
+		const uint32_t yEnd = std::min(yStart + NOISE_TILE_ROWS, height);
+		const float scaleX = noiseScale / (float)width;
+		const float scaleY = noiseScale / (float)height;
+		const float nz = (float)z / (float)depth * noiseScale;
+
+		float px[NOISE_LANE_COUNT], py[NOISE_LANE_COUNT], pz[NOISE_LANE_COUNT], n[NOISE_LANE_COUNT];
+		uint8_t values[NOISE_LANE_COUNT];
+		for (uint32_t l = 0; l < NOISE_LANE_COUNT; l++)
+		{
+			pz[l] = nz;
+		}
+		for (uint32_t y = yStart; y < yEnd; y++)
+		{
+			const float ny = (float)y * scaleY;
+			uint8_t *row = dst + (size_t)z * width * height + (size_t)y * width;
+			for (uint32_t x = 0; x < width; x += NOISE_LANE_COUNT)
+			{
+				for (uint32_t l = 0; l < NOISE_LANE_COUNT; l++)
+				{
+					px[l] = (float)(x + l) * scaleX;
+					py[l] = ny;
+				}
+				fractalNoise.noiseLanes(px, py, pz, n);
+				for (uint32_t l = 0; l < NOISE_LANE_COUNT; l++)
+				{
+					// Noise values are always positive, so truncation equals floor here
+					const float v = n[l] - (float)(int32_t)n[l];
+					values[l] = static_cast<uint8_t>(v * 255.0f);
+				}
+				// Staging memory is usually write-combined, so store the whole lane group at once instead of single bytes
+				memcpy(row + x, values, std::min<uint32_t>(NOISE_LANE_COUNT, width - x));
+			}
+		}
+	}
+
+public:
+	NoiseVolumeJob(const PerlinNoise<float> &perlinNoise, uint8_t *dst, uint32_t width, uint32_t height, uint32_t depth, float noiseScale)
+		: fractalNoise(perlinNoise), dst(dst), width(width), height(height), depth(depth), noiseScale(noiseScale)
+	{
+		tilesPerSlice = (height + NOISE_TILE_ROWS - 1) / NOISE_TILE_ROWS;
+		tileCount = tilesPerSlice * depth;
+		nextTile = 0;
+		activeWorkers = 0;
+	}
+
+	// Distributes the job across all threads of the pool without waiting for it to finish
+	void dispatch(vks::ThreadPool &threadPool)
+	{
+		activeWorkers = static_cast<uint32_t>(threadPool.threads.size());
+		for (auto &thread : threadPool.threads)
+		{
+			thread->addJob([this] {
+				generateTiles();
+				activeWorkers.fetch_sub(1, std::memory_order_release);
+			});
+		}
+	}
+
+	// Generates tiles on the calling thread until all of them have been handed out
+	void generateTiles()
+	{
+		uint32_t tile;
+		while ((tile = nextTile.fetch_add(1, std::memory_order_relaxed)) < tileCount)
+		{
+			generateTile(tile);
+		}
+	}
+
+	// True once all tiles have been generated by the workers started with dispatch()
+	bool finished() const
+	{
+		return nextTile.load(std::memory_order_relaxed) >= tileCount && activeWorkers.load(std::memory_order_acquire) == 0;
+	}
 };
 
 class VulkanExample : public VulkanExampleBase
@@ -168,6 +359,22 @@ public:
 	VkDescriptorSet descriptorSet;
 	VkDescriptorSetLayout descriptorSetLayout;
 
+	vks::ThreadPool threadPool;
+
+	// New noise volumes are generated on the thread pool while rendering continues
+	// The workers write straight into the persistently mapped staging buffer, once they are done the copy to the 3D texture is submitted along with the next frame
+	struct {
+		std::unique_ptr<NoiseVolumeJob> job;
+		vks::Buffer stagingBuffer;
+		VkCommandBuffer uploadCmdBuffer = VK_NULL_HANDLE;
+		bool uploadPending = false;
+		std::chrono::time_point<std::chrono::high_resolution_clock> tStart;
+		double lastTime = 0.0;
+	} noiseGeneration;
+
+	// Set with --noisebenchmark, measures the noise generation throughput at different volume sizes on startup
+	bool runNoiseBenchmark = false;
+
 	VulkanExample() : VulkanExampleBase(ENABLE_VALIDATION)
 	{
 		title = "3D textures";
@@ -176,6 +383,12 @@ public:
 		camera.setRotation(glm::vec3(0.0f, 15.0f, 0.0f));
 		camera.setPerspective(60.0f, (float)width / (float)height, 0.1f, 256.0f);
 		srand((unsigned int)time(NULL));
+		threadPool.setThreadCount(std::max(1u, std::thread::hardware_concurrency()));
+		for (auto arg : args) {
+			if (strcmp(arg, "--noisebenchmark") == 0) {
+				runNoiseBenchmark = true;
+			}
+		}
 	}
 
 	~VulkanExample()
@@ -183,6 +396,12 @@ public:
 		// Clean up used Vulkan resources
 		// Note : Inherited destructor cleans up resources stored in base class
 
+		// Workers may still be writing to the staging buffer
+		threadPool.wait();
+		noiseGeneration.stagingBuffer.destroy();
+		if (noiseGeneration.uploadCmdBuffer != VK_NULL_HANDLE)
+			vkFreeCommandBuffers(device, cmdPool, 1, &noiseGeneration.uploadCmdBuffer);
+
 		destroyTextureImage(texture);
 
 		vkDestroyPipeline(device, pipelines.solid, nullptr);
@@ -196,7 +415,7 @@ public:
 	}
 
 	// Prepare all Vulkan resources for the 3D texture (including descriptors)
-	// Does not fill the texture with data
+	// Fills the texture with an initial noise volume
 	void prepareNoiseTexture(uint32_t width, uint32_t height, uint32_t depth)
 	{
 		// A 3D texture is described as width x height x depth
@@ -284,82 +503,56 @@ public:
 		texture.descriptor.imageView = texture.view;
 		texture.descriptor.sampler = texture.sampler;
 
-		updateNoiseTexture();
+		// Host visible staging buffer for the noise data, stays mapped so the workers can write to it directly
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&noiseGeneration.stagingBuffer,
+			texture.width * texture.height * texture.depth));
+		VK_CHECK_RESULT(noiseGeneration.stagingBuffer.map());
+
+		VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &noiseGeneration.uploadCmdBuffer));
+
+		// The first volume is generated up-front as the texture needs valid contents before the first frame
+		startNoiseGeneration();
+		threadPool.wait();
+		finishNoiseGeneration();
+		VkSubmitInfo uploadSubmitInfo = vks::initializers::submitInfo();
+		uploadSubmitInfo.commandBufferCount = 1;
+		uploadSubmitInfo.pCommandBuffers = &noiseGeneration.uploadCmdBuffer;
+		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &uploadSubmitInfo, VK_NULL_HANDLE));
+		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+		noiseGeneration.uploadPending = false;
 	}
 
-	// Generate randomized noise and upload it to the 3D texture using staging
-	void updateNoiseTexture()
+	// Starts generating a new randomized noise volume on the thread pool, returns immediately
+	void startNoiseGeneration()
 	{
-		const uint32_t texMemSize = texture.width * texture.height * texture.depth;
-
-		uint8_t *data = new uint8_t[texMemSize];
-		memset(data, 0, texMemSize);
-
-		// Generate perlin based noise
-		std::cout << "Generating " << texture.width << " x " << texture.height << " x " << texture.depth << " noise texture..." << std::endl;
-
-		auto tStart = std::chrono::high_resolution_clock::now();
+		if (noiseGeneration.job || noiseGeneration.uploadPending)
+			return;
 
 		PerlinNoise<float> perlinNoise;
-		FractalNoise<float> fractalNoise(perlinNoise);
-
 		const float noiseScale = static_cast<float>(rand() % 10) + 4.0f;
+		noiseGeneration.job.reset(new NoiseVolumeJob(perlinNoise, static_cast<uint8_t*>(noiseGeneration.stagingBuffer.mapped), texture.width, texture.height, texture.depth, noiseScale));
+		noiseGeneration.tStart = std::chrono::high_resolution_clock::now();
+		noiseGeneration.job->dispatch(threadPool);
+	}
 
-#pragma omp parallel for
-		for (int32_t z = 0; z < texture.depth; z++)
-		{
-			for (int32_t y = 0; y < texture.height; y++)
-			{
-				for (int32_t x = 0; x < texture.width; x++)
-				{
-					float nx = (float)x / (float)texture.width;
-					float ny = (float)y / (float)texture.height;
-					float nz = (float)z / (float)texture.depth;
-#define FRACTAL
-#ifdef FRACTAL
-					float n = fractalNoise.noise(nx * noiseScale, ny * noiseScale, nz * noiseScale);
-#else
-					float n = 20.0 * perlinNoise.noise(nx, ny, nz);
-#endif
-					n = n - floor(n);
-
-					data[x + y * texture.width + z * texture.width * texture.height] = static_cast<uint8_t>(floor(n * 255));
-				}
-			}
-		}
-
-		auto tEnd = std::chrono::high_resolution_clock::now();
-		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
-
-		std::cout << "Done in " << tDiff << "ms" << std::endl;
-
-		// Create a host-visible staging buffer that contains the raw image data
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingMemory;
-
-		// Buffer object
-		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-		bufferCreateInfo.size = texMemSize;
-		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-		VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-		// Allocate host visible memory for data upload
-		VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs = {};
-		vkGetBufferMemoryRequirements(device, stagingBuffer, &memReqs);
-		memAllocInfo.allocationSize = memReqs.size;
-		memAllocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &stagingMemory));
-		VK_CHECK_RESULT(vkBindBufferMemory(device, stagingBuffer, stagingMemory, 0));
+	// Records the copy from the staging buffer to the 3D texture once the workers are done
+	// Returns true if a new upload has been recorded
+	bool finishNoiseGeneration()
+	{
+		if (!noiseGeneration.job || !noiseGeneration.job->finished())
+			return false;
 
-		// Copy texture data into staging buffer
-		uint8_t *mapped;
-		VK_CHECK_RESULT(vkMapMemory(device, stagingMemory, 0, memReqs.size, 0, (void **)&mapped));
-		memcpy(mapped, data, texMemSize);
-		vkUnmapMemory(device, stagingMemory);
+		noiseGeneration.job.reset();
+		noiseGeneration.lastTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - noiseGeneration.tStart).count();
+		std::cout << "Generated " << texture.width << " x " << texture.height << " x " << texture.depth << " noise texture in " << noiseGeneration.lastTime << "ms" << std::endl;
 
-		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+		VkCommandBuffer copyCmd = noiseGeneration.uploadCmdBuffer;
+		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+		VK_CHECK_RESULT(vkBeginCommandBuffer(copyCmd, &cmdBufInfo));
 
 		// The sub resource range describes the regions of the image we will be transitioned
 		VkImageSubresourceRange subresourceRange = {};
@@ -368,8 +561,8 @@ public:
 		subresourceRange.levelCount = 1;
 		subresourceRange.layerCount = 1;
 
-		// Optimal image will be used as destination for the copy, so we must transfer from our
-		// initial undefined image layout to the transfer destination layout
+		// The whole image is overwritten, so the previous contents can be discarded by transitioning from the undefined layout
+		// The upload is submitted ahead of the frame's command buffer, which makes the transfer complete before the texture is sampled
 		vks::tools::setImageLayout(
 			copyCmd,
 			texture.image,
@@ -391,7 +584,7 @@ public:
 
 		vkCmdCopyBufferToImage(
 			copyCmd,
-			stagingBuffer,
+			noiseGeneration.stagingBuffer.buffer,
 			texture.image,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			1,
@@ -406,12 +599,55 @@ public:
 			texture.imageLayout,
 			subresourceRange);
 
-		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+		VK_CHECK_RESULT(vkEndCommandBuffer(copyCmd));
+		noiseGeneration.uploadPending = true;
+		return true;
+	}
 
-		// Clean up staging resources
-		delete[] data;
-		vkFreeMemory(device, stagingMemory, nullptr);
-		vkDestroyBuffer(device, stagingBuffer, nullptr);
+	// Compares the voxel throughput of the scalar reference implementation with the lane kernel (single threaded and on the thread pool)
+	void benchmarkNoiseGeneration()
+	{
+		const uint32_t dims[] = { 128, 256 };
+		for (uint32_t dim : dims)
+		{
+			const size_t voxelCount = (size_t)dim * dim * dim;
+			std::vector<uint8_t> data(voxelCount);
+			PerlinNoise<float> perlinNoise;
+			const float noiseScale = 8.0f;
+
+			auto report = [&](const char* name, std::chrono::time_point<std::chrono::high_resolution_clock> tStart) {
+				const double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - tStart).count();
+				std::cout << dim << "^3 " << name << ": " << seconds * 1000.0 << "ms, " << (double)voxelCount / seconds / 1.0e6 << " Mvoxels/s" << std::endl;
+			};
+
+			// Scalar reference, same evaluation as the lane kernel but one voxel at a time
+			FractalNoise<float> fractalNoise(perlinNoise);
+			auto tStart = std::chrono::high_resolution_clock::now();
+			for (uint32_t z = 0; z < dim; z++)
+			{
+				for (uint32_t y = 0; y < dim; y++)
+				{
+					for (uint32_t x = 0; x < dim; x++)
+					{
+						float n = fractalNoise.noise((float)x / (float)dim * noiseScale, (float)y / (float)dim * noiseScale, (float)z / (float)dim * noiseScale);
+						n = n - floor(n);
+						data[x + y * dim + z * dim * dim] = static_cast<uint8_t>(n * 255.0f);
+					}
+				}
+			}
+			report("scalar (1 thread)", tStart);
+
+			tStart = std::chrono::high_resolution_clock::now();
+			NoiseVolumeJob singleThreaded(perlinNoise, data.data(), dim, dim, dim, noiseScale);
+			singleThreaded.generateTiles();
+			report("lanes (1 thread)", tStart);
+
+			tStart = std::chrono::high_resolution_clock::now();
+			NoiseVolumeJob pooled(perlinNoise, data.data(), dim, dim, dim, noiseScale);
+			pooled.dispatch(threadPool);
+			threadPool.wait();
+			report(("lanes (" + std::to_string(threadPool.threads.size()) + " threads)").c_str(), tStart);
+		}
 	}
 
 	// Free all Vulkan resources used a texture object
@@ -467,8 +703,6 @@ public:
 			vkCmdBindIndexBuffer(drawCmdBuffers[i], indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
 			vkCmdDrawIndexed(drawCmdBuffers[i], indexCount, 1, 0, 0, 0);
 
-			drawUI(drawCmdBuffers[i]);
-
 			vkCmdEndRenderPass(drawCmdBuffers[i]);
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
@@ -479,14 +713,21 @@ public:
 	{
 		VulkanExampleBase::prepareFrame();
 
-		// Command buffer to be submitted to the queue
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+		finishNoiseGeneration();
+
+		// Command buffers to be submitted to the queue, a pending noise upload goes ahead of the frame
+		std::array<VkCommandBuffer, 2> commandBuffers = { noiseGeneration.uploadCmdBuffer, drawCmdBuffers[currentBuffer] };
+		const uint32_t firstCommandBuffer = noiseGeneration.uploadPending ? 0 : 1;
+		submitInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size()) - firstCommandBuffer;
+		submitInfo.pCommandBuffers = &commandBuffers[firstCommandBuffer];
 
 		// Submit to queue
 		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
 		VulkanExampleBase::submitFrame();
+
+		// submitFrame waits for the queue to become idle, so the staging buffer can be reused from here on
+		noiseGeneration.uploadPending = false;
 	}
 
 	void generateQuad()
@@ -751,6 +992,9 @@ public:
 	void prepare()
 	{
 		VulkanExampleBase::prepare();
+		if (runNoiseBenchmark) {
+			benchmarkNoiseGeneration();
+		}
 		generateQuad();
 		setupVertexDescriptions();
 		prepareUniformBuffers();
@@ -780,9 +1024,14 @@ public:
 	virtual void OnUpdateUIOverlay(vks::UIOverlay *overlay)
 	{
 		if (overlay->header("Settings")) {
-			if (overlay->button("Generate new texture")) {
-				updateNoiseTexture();
+			if (noiseGeneration.job) {
+				overlay->text("Generating new texture...");
+			} else if (overlay->button("Generate new texture")) {
+				startNoiseGeneration();
 			}
+			const double voxelCount = (double)texture.width * texture.height * texture.depth;
+			overlay->text("Last generation: %.2f ms (%.1f Mvoxels/s)", noiseGeneration.lastTime, voxelCount / (noiseGeneration.lastTime * 1000.0));
+			overlay->text("Threads: %d", static_cast<int32_t>(threadPool.threads.size()));
 		}
 	}
 };
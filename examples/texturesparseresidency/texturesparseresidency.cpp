@@ -521,8 +521,6 @@ void VulkanExample::buildCommandBuffers()
 		vkCmdBindPipeline(drawCmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 		plane.draw(drawCmdBuffers[i]);
 
-		drawUI(drawCmdBuffers[i]);
-
 		vkCmdEndRenderPass(drawCmdBuffers[i]);
 
 		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));